@@ -80,6 +80,18 @@ struct osmo_fsm {
 	const struct value_string *event_names;
 	/*! graceful exit function, called at the beginning of termination */
 	void (*pre_term)(struct osmo_fsm_inst *fi, enum osmo_fsm_term_cause cause);
+	/*! if set, state timeouts of instances are kept in a shared deadline
+	 *  queue of one second granularity instead of an osmo_timer per
+	 *  instance; timeouts then expire up to a second late */
+	bool coarse_timeouts;
+};
+
+/*! entry of an FSM instance in one of the lookup indexes kept by the core */
+struct osmo_fsm_inst_index_entry {
+	/*! member in a hash bucket, empty if not indexed */
+	struct llist_head list;
+	/*! hash value of the key */
+	uint32_t hash;
 };
 
 /*! a single instanceof an osmocom finite state machine */
@@ -117,6 +129,20 @@ struct osmo_fsm_inst {
 		/*! Indicator whether osmo_fsm_inst_term() was already invoked on this instance. */
 		bool terminating;
 	} proc;
+
+	/*! entry in the index used by osmo_fsm_inst_find_by_id() */
+	struct osmo_fsm_inst_index_entry index_id;
+	/*! entry in the index used by osmo_fsm_inst_find_by_name() */
+	struct osmo_fsm_inst_index_entry index_name;
+	/*! number of events posted to this instance that are still queued */
+	unsigned int pending_events;
+	/*! state timeout if the FSM uses \ref osmo_fsm.coarse_timeouts */
+	struct {
+		/*! member in a deadline bucket, empty if no timeout is pending */
+		struct llist_head list;
+		/*! absolute expiry time (osmo_gettimeofday() in ms) */
+		uint64_t deadline_ms;
+	} coarse_timer;
 };
 
 void osmo_fsm_log_addr(bool log_addr);
@@ -224,6 +250,7 @@ int osmo_fsm_inst_update_id_f_sanitize(struct osmo_fsm_inst *fi, char replace_wi
 
 const char *osmo_fsm_event_name(struct osmo_fsm *fsm, uint32_t event);
 const char *osmo_fsm_inst_name(struct osmo_fsm_inst *fi);
+int osmo_fsm_inst_timer_remaining(struct osmo_fsm_inst *fi, struct timeval *remaining);
 const char *osmo_fsm_state_name(struct osmo_fsm *fsm, uint32_t state);
 
 /*! return the name of the state the FSM instance is currently in. */
@@ -299,6 +326,39 @@ int _osmo_fsm_inst_state_chg_keep_or_start_timer_ms(struct osmo_fsm_inst *fi, ui
 int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data,
 			    const char *file, int line);
 
+/*! post an event to the deferred event queue of osmocom FSM instances
+ *
+ *  This is a macro that calls _osmo_fsm_inst_post() with the given
+ *  parameters as well as the caller's source file and line number for logging
+ *  purposes. See there for documentation.
+ */
+#define osmo_fsm_inst_post(fi, event, data) \
+	_osmo_fsm_inst_post(fi, event, data, __FILE__, __LINE__)
+int _osmo_fsm_inst_post(struct osmo_fsm_inst *fi, uint32_t event, void *data,
+			const char *file, int line);
+
+/*! post the same event to several osmocom FSM instances at once
+ *
+ *  This is a macro that calls _osmo_fsm_inst_post_batch() with the given
+ *  parameters as well as the caller's source file and line number for logging
+ *  purposes. See there for documentation.
+ */
+#define osmo_fsm_inst_post_batch(fis, num_fi, event, data) \
+	_osmo_fsm_inst_post_batch(fis, num_fi, event, data, __FILE__, __LINE__)
+int _osmo_fsm_inst_post_batch(struct osmo_fsm_inst * const *fis, unsigned int num_fi,
+			      uint32_t event, void *data, const char *file, int line);
+
+/*! statistics items of the deferred FSM event queue */
+enum osmo_fsm_event_queue_stat {
+	OSMO_FSM_EVQ_STAT_DEPTH,	/*!< number of queued events */
+	OSMO_FSM_EVQ_STAT_LATENCY,	/*!< time between posting and dispatching an event (us) */
+};
+
+int osmo_fsm_event_queue_init(void *ctx, unsigned int num_prealloc);
+unsigned int osmo_fsm_event_queue_run(unsigned int max_events);
+unsigned int osmo_fsm_event_queue_depth(void);
+struct osmo_stat_item_group *osmo_fsm_event_queue_statg(void);
+
 /*! Terminate FSM instance with given cause
  *
  *  This is a macro that calls _osmo_fsm_inst_term() with the given parameters
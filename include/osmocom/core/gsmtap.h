@@ -301,6 +301,10 @@ struct gsmtap_hdr {
 
 } __attribute__((packed));
 
+/* sub-types for GSMTAP_TYPE_OSMOCORE_LOG */
+#define GSMTAP_OSMOCORE_LOG_SINGLE	0x00	/* one log record */
+#define GSMTAP_OSMOCORE_LOG_BATCH	0x01	/* log records, each preceded by its 16-bit length */
+
 /*! Structure of the GSMTAP libosmocore logging header */
 struct gsmtap_osmocore_log_hdr {
 	struct {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <osmocom/core/write_queue.h>
 #include <osmocom/core/select.h>
 
@@ -19,11 +21,50 @@ struct msgb *gsmtap_makemsg(uint16_t arfcn, uint8_t ts, uint8_t chan_type,
 			    uint8_t ss, uint32_t fn, int8_t signal_dbm,
 			    uint8_t snr, const uint8_t *data, unsigned int len);
 
+struct rate_ctr_group;
+struct gsmtap_capture;
+
+/*! counters of a gsmtap instance */
+enum gsmtap_ctr {
+	GSMTAP_CTR_TX_SENT,		/*!< messages sent to the socket */
+	GSMTAP_CTR_TX_DROPPED,		/*!< messages dropped due to a full queue or ring */
+	GSMTAP_CTR_TX_ERROR,		/*!< messages dropped due to a send error */
+	GSMTAP_CTR_PCAP_WRITTEN,	/*!< messages written to the pcap file */
+	GSMTAP_CTR_PCAP_ROTATED,	/*!< pcap file rotations */
+	GSMTAP_CTR_TX_FILTERED,		/*!< messages discarded by the filter or sampling */
+	GSMTAP_CTR_TX_RATE_LIMITED,	/*!< messages discarded by the rate limit */
+};
+
+/*! filter applied at a GSMTAP source before a message is built.
+ *  Each mask with no bit set permits any value. */
+struct gsmtap_filter {
+	uint32_t type_mask[8];	/*!< permitted GSMTAP types */
+	uint32_t chan_mask[4];	/*!< permitted GSMTAP channel types, ignoring GSMTAP_CHANNEL_ACCH */
+	uint32_t ss_mask;	/*!< permitted sub-slots 0..31 */
+	uint8_t ts_mask;	/*!< permitted timeslots */
+	uint16_t arfcn_min;	/*!< lowest permitted ARFCN, ignoring GSMTAP_ARFCN_F_* */
+	uint16_t arfcn_max;	/*!< highest permitted ARFCN, ignoring GSMTAP_ARFCN_F_* */
+	unsigned int sample_n;	/*!< pass only one in sample_n messages; 0 or 1 to pass all */
+	unsigned int rate_max;	/*!< maximum number of messages per second; 0 for no limit */
+
+	/* private state */
+	unsigned int sample_cnt;
+	unsigned int rate_cnt;
+	long rate_sec;
+};
+
+void gsmtap_filter_init(struct gsmtap_filter *flt);
+int gsmtap_filter_parse(struct gsmtap_filter *flt, const char *spec);
+int gsmtap_filter_to_str_buf(char *buf, size_t buf_len, const struct gsmtap_filter *flt);
+
 /*! one gsmtap instance */
 struct gsmtap_inst {
 	int ofd_wq_mode;	/*!< wait queue mode? */
 	struct osmo_wqueue wq;	/*!< the wait queue */
 	struct osmo_fd sink_ofd;/*!< file descriptor */
+	struct rate_ctr_group *ctrg;	/*!< counters, see \ref gsmtap_ctr */
+	struct gsmtap_capture *capture;	/*!< capture mode state, NULL if disabled */
+	struct gsmtap_filter *filter;	/*!< source filter, NULL if disabled */
 };
 
 /*! obtain the file descriptor associated with a gsmtap instance
@@ -55,6 +96,17 @@ int gsmtap_send(struct gsmtap_inst *gti, uint16_t arfcn, uint8_t ts,
 		int8_t signal_dbm, uint8_t snr, const uint8_t *data,
 		unsigned int len);
 
+int gsmtap_inst_set_filter(struct gsmtap_inst *gti, const struct gsmtap_filter *flt);
+
+int gsmtap_inst_set_wqueue_mode(struct gsmtap_inst *gti, enum osmo_wqueue_mode mode);
+
+int gsmtap_capture_enable(struct gsmtap_inst *gti, unsigned int num_records,
+			  unsigned int max_len);
+void gsmtap_capture_disable(struct gsmtap_inst *gti);
+int gsmtap_capture_flush(struct gsmtap_inst *gti);
+int gsmtap_capture_set_pcap(struct gsmtap_inst *gti, const char *path,
+			    unsigned long max_bytes, unsigned int max_files);
+
 extern const struct value_string gsmtap_gsm_channel_names[];
 extern const struct value_string gsmtap_type_names[];
 
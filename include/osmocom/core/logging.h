@@ -187,6 +187,7 @@ typedef int log_filter(const struct log_context *ctx,
 struct log_info;
 struct vty;
 struct gsmtap_inst;
+struct log_gsmtap_batch;
 
 typedef void log_print_filters(struct vty *vty,
 			       const struct log_info *info,
@@ -288,6 +289,11 @@ struct log_target {
 			struct gsmtap_inst *gsmtap_inst;
 			const char *ident;
 			const char *hostname;
+			/*! maximum size of a batch datagram; 0 if not batching */
+			unsigned int batch_size;
+			/*! maximum time in ms a record is held back for batching */
+			unsigned int batch_flush_ms;
+			struct log_gsmtap_batch *batch;
 		} tgt_gsmtap;
 	};
 
@@ -370,6 +376,8 @@ struct log_target *log_target_create_gsmtap(const char *host, uint16_t port,
 					    const char *ident,
 					    bool ofd_wq_mode,
 					    bool add_sink);
+int log_target_gsmtap_set_batch(struct log_target *target, unsigned int max_size,
+				unsigned int flush_ms);
 int log_target_file_reopen(struct log_target *tgt);
 int log_targets_reopen(void);
 
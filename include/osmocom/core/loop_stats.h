@@ -0,0 +1,66 @@
+/*! \file loop_stats.h
+ *  Statistics about the select loop and the call-backs it invokes.
+ */
+
+#pragma once
+
+/*! \defgroup loop_stats Event loop statistics
+ *  @{
+ * \file loop_stats.h */
+
+#include <stdint.h>
+
+/*! Kind of call-back invoked from the select loop */
+enum osmo_loop_cb_type {
+	OSMO_LOOP_CB_FD,	/*!< \ref osmo_fd call-back, per registered \ref osmo_fd */
+	OSMO_LOOP_CB_TIMER,	/*!< \ref osmo_timer_list call-back, per call-back function */
+};
+
+/*! Statistics of one call-back site */
+struct osmo_loop_cb_stats {
+	/*! kind of call-back */
+	enum osmo_loop_cb_type type;
+	/*! the \ref osmo_fd, or the timer call-back function */
+	const void *key;
+	/*! the call-back function */
+	const void *cb;
+	/*! file descriptor number, -1 for timers */
+	int fd;
+	/*! number of invocations */
+	uint64_t count;
+	/*! number of invocations whose duration was measured */
+	uint64_t sampled;
+	/*! sum of all measured durations in nanoseconds */
+	uint64_t total_ns;
+	/*! longest measured duration in nanoseconds */
+	uint64_t max_ns;
+	/*! invocations since the last sampled one */
+	unsigned int sample_ctr;
+};
+
+/*! Statistics of the select loop itself */
+struct osmo_loop_stats {
+	/*! number of loop iterations */
+	uint64_t iterations;
+	/*! time spent in call-backs, in nanoseconds */
+	uint64_t busy_ns;
+	/*! time spent waiting in select(), in nanoseconds */
+	uint64_t idle_ns;
+	/*! longest time spent in call-backs during one iteration, in nanoseconds */
+	uint64_t max_busy_ns;
+	/*! number of invocations not accounted for, as the call-back table was full */
+	uint64_t dropped;
+};
+
+/*! Measure every n-th call-back; 0 if statistics are disabled. Read-only, see \ref osmo_loop_stats_enable */
+extern unsigned int osmo_loop_stats_sample_rate;
+
+int osmo_loop_stats_enable(unsigned int sample_rate);
+void osmo_loop_stats_disable(void);
+void osmo_loop_stats_reset(void);
+const struct osmo_loop_stats *osmo_loop_stats_get(void);
+
+typedef int (*osmo_loop_cb_stats_handler_t)(const struct osmo_loop_cb_stats *, void *);
+int osmo_loop_stats_for_each_cb(osmo_loop_cb_stats_handler_t handle_cb, void *data);
+
+/*! @} */
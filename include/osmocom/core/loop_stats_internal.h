@@ -0,0 +1,18 @@
+#pragma once
+
+/*! \defgroup loop_stats_internal Event loop statistics internals
+ *  @{
+ * \file loop_stats_internal.h
+ *  Hooks called by the select loop and the timer code. */
+
+#include <stdint.h>
+
+#include <osmocom/core/loop_stats.h>
+
+uint64_t osmo_loop_stats_now(void);
+uint64_t osmo_loop_stats_cb_begin(enum osmo_loop_cb_type type, const void *key, const void *cb, int fd);
+void osmo_loop_stats_cb_end(enum osmo_loop_cb_type type, const void *key, uint64_t start);
+void osmo_loop_stats_iteration(uint64_t start, uint64_t woken, uint64_t end);
+void osmo_loop_stats_fd_unregister(const void *ofd);
+
+/*! @} */
@@ -0,0 +1,297 @@
+#pragma once
+
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include <stdint.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/msgb.h>
+
+/*! \addtogroup msgb
+ *  @{
+ * \file msgb_compact.h */
+
+/*! Offset value of a layer header that is not set */
+#define MSGBC_NO_HDR	0xffff
+
+/*! Compact Osmocom message buffer, for small signalling messages.
+ *
+ * Carries the same message state as \ref msgb, but stores the data start
+ * and the layer headers as 16 bit offsets from the start of the data
+ * array, has no dst/trx and lchan references, and has a control buffer
+ * only if one was requested at allocation time.  The control buffer
+ * (if any) sits between this header and the data array.  The msgbc_*()
+ * functions and macros mirror their msgb_*() counterparts. */
+struct msgb_compact {
+	struct llist_head list; /*!< linked list header */
+
+	uint16_t data_len;	/*!< length of underlying data array */
+	uint16_t len;		/*!< length of bytes used in msgb */
+	uint16_t data;		/*!< offset of start of message in data array */
+
+	uint16_t l1h;		/*!< offset of Layer 1 header, or MSGBC_NO_HDR */
+	uint16_t l2h;		/*!< offset of Layer 2 header, or MSGBC_NO_HDR */
+	uint16_t l3h;		/*!< offset of Layer 3 header, or MSGBC_NO_HDR */
+	uint16_t l4h;		/*!< offset of Layer 4 header, or MSGBC_NO_HDR */
+
+	uint8_t cb_len;		/*!< number of control buffer entries */
+	uint8_t _reserved;
+
+	unsigned long cb[0];	/*!< control buffer of cb_len entries, followed by the data array */
+};
+
+struct msgb_compact *msgbc_alloc_c(const void *ctx, uint16_t size, uint8_t cb_len);
+struct msgb_compact *msgbc_alloc(uint16_t size, uint8_t cb_len);
+void msgbc_free(struct msgb_compact *m);
+void msgbc_reset(struct msgb_compact *m);
+struct msgb_compact *msgbc_from_msgb_c(const void *ctx, const struct msgb *msg, uint8_t cb_len);
+struct msgb *msgb_from_msgbc_c(const void *ctx, const struct msgb_compact *m, const char *name);
+
+/*! obtain start of underlying data array of compact msgb */
+static inline unsigned char *msgbc_head(const struct msgb_compact *m)
+{
+	return (unsigned char *)&m->cb[m->cb_len];
+}
+
+/*! obtain start of message in compact msgb */
+static inline unsigned char *msgbc_data(const struct msgb_compact *m)
+{
+	return msgbc_head(m) + m->data;
+}
+
+/*! obtain end of message in compact msgb */
+static inline unsigned char *msgbc_tail(const struct msgb_compact *m)
+{
+	return msgbc_head(m) + m->data + m->len;
+}
+
+/*! obtain length of message in compact msgb */
+static inline uint16_t msgbc_length(const struct msgb_compact *m)
+{
+	return m->len;
+}
+
+/*! obtain control buffer of compact msgb, or NULL if allocated without one */
+static inline unsigned long *msgbc_cb(struct msgb_compact *m)
+{
+	return m->cb_len ? m->cb : NULL;
+}
+
+/*! Convert a layer header offset to a pointer, NULL if not set */
+static inline void *msgbc_hdr(const struct msgb_compact *m, uint16_t off)
+{
+	return off == MSGBC_NO_HDR ? NULL : msgbc_head(m) + off;
+}
+
+/*! Convert a pointer into the data array to a layer header offset, MSGBC_NO_HDR for NULL */
+static inline uint16_t msgbc_hdr_off(const struct msgb_compact *m, const void *hdr)
+{
+	return hdr ? (uint16_t)((const unsigned char *)hdr - msgbc_head(m)) : MSGBC_NO_HDR;
+}
+
+/*! obtain L1 header of compact msgb */
+#define msgbc_l1(m)	msgbc_hdr(m, (m)->l1h)
+/*! obtain L2 header of compact msgb */
+#define msgbc_l2(m)	msgbc_hdr(m, (m)->l2h)
+/*! obtain L3 header of compact msgb */
+#define msgbc_l3(m)	msgbc_hdr(m, (m)->l3h)
+/*! obtain L4 header of compact msgb */
+#define msgbc_l4(m)	msgbc_hdr(m, (m)->l4h)
+
+/*! set L1 header of compact msgb, like assigning msg->l1h of a \ref msgb */
+#define msgbc_set_l1(m, hdr)	((m)->l1h = msgbc_hdr_off(m, hdr))
+/*! set L2 header of compact msgb, like assigning msg->l2h of a \ref msgb */
+#define msgbc_set_l2(m, hdr)	((m)->l2h = msgbc_hdr_off(m, hdr))
+/*! set L3 header of compact msgb, like assigning msg->l3h of a \ref msgb */
+#define msgbc_set_l3(m, hdr)	((m)->l3h = msgbc_hdr_off(m, hdr))
+/*! set L4 header of compact msgb, like assigning msg->l4h of a \ref msgb */
+#define msgbc_set_l4(m, hdr)	((m)->l4h = msgbc_hdr_off(m, hdr))
+
+/*! determine number of bytes between a layer header and the end of the message */
+static inline unsigned int msgbc_hdrlen(const struct msgb_compact *m, uint16_t off)
+{
+	return m->data + m->len - off;
+}
+
+/*! determine length of L1 message in compact msgb */
+#define msgbc_l1len(m)	msgbc_hdrlen(m, (m)->l1h)
+/*! determine length of L2 message in compact msgb */
+#define msgbc_l2len(m)	msgbc_hdrlen(m, (m)->l2h)
+/*! determine length of L3 message in compact msgb */
+#define msgbc_l3len(m)	msgbc_hdrlen(m, (m)->l3h)
+/*! determine length of L4 message in compact msgb */
+#define msgbc_l4len(m)	msgbc_hdrlen(m, (m)->l4h)
+
+/*! determine how much tail room is left in compact msgb */
+static inline int msgbc_tailroom(const struct msgb_compact *m)
+{
+	return m->data_len - (m->data + m->len);
+}
+
+/*! determine the amount of headroom in compact msgb */
+static inline int msgbc_headroom(const struct msgb_compact *m)
+{
+	return m->data;
+}
+
+/*! append data to end of compact msgb, see \ref msgb_put */
+static inline unsigned char *msgbc_put(struct msgb_compact *m, unsigned int len)
+{
+	unsigned char *tmp = msgbc_tail(m);
+	if (msgbc_tailroom(m) < (int) len)
+		MSGB_ABORT(m, "Not enough tailroom msgbc_put (%u < %u)\n",
+			   msgbc_tailroom(m), len);
+	m->len += len;
+	return tmp;
+}
+
+/*! append a uint8 value to the end of compact msgb */
+static inline void msgbc_put_u8(struct msgb_compact *m, uint8_t word)
+{
+	uint8_t *space = msgbc_put(m, 1);
+	space[0] = word;
+}
+
+/*! append a uint16 value to the end of compact msgb */
+static inline void msgbc_put_u16(struct msgb_compact *m, uint16_t word)
+{
+	osmo_store16be(word, msgbc_put(m, 2));
+}
+
+/*! append a uint32 value to the end of compact msgb */
+static inline void msgbc_put_u32(struct msgb_compact *m, uint32_t word)
+{
+	osmo_store32be(word, msgbc_put(m, 4));
+}
+
+/*! prepend (push) data to the front of compact msgb, see \ref msgb_push */
+static inline unsigned char *msgbc_push(struct msgb_compact *m, unsigned int len)
+{
+	if (msgbc_headroom(m) < (int) len)
+		MSGB_ABORT(m, "Not enough headroom msgbc_push (%u < %u)\n",
+			   msgbc_headroom(m), len);
+	m->data -= len;
+	m->len += len;
+	return msgbc_data(m);
+}
+
+/*! prepend a uint8 value to the front of compact msgb */
+static inline void msgbc_push_u8(struct msgb_compact *m, uint8_t word)
+{
+	uint8_t *space = msgbc_push(m, 1);
+	space[0] = word;
+}
+
+/*! prepend a uint16 value to the front of compact msgb */
+static inline void msgbc_push_u16(struct msgb_compact *m, uint16_t word)
+{
+	osmo_store16be(word, msgbc_push(m, 2));
+}
+
+/*! prepend a uint32 value to the front of compact msgb */
+static inline void msgbc_push_u32(struct msgb_compact *m, uint32_t word)
+{
+	osmo_store32be(word, msgbc_push(m, 4));
+}
+
+/*! remove (pull) a header from the front of compact msgb, see \ref msgb_pull */
+static inline unsigned char *msgbc_pull(struct msgb_compact *m, unsigned int len)
+{
+	if (msgbc_length(m) < len)
+		MSGB_ABORT(m, "msgbc too small to pull %u (len %u)\n",
+			   len, msgbc_length(m));
+	m->len -= len;
+	m->data += len;
+	return msgbc_data(m);
+}
+
+/*! remove uint8 from front of compact msgb */
+static inline uint8_t msgbc_pull_u8(struct msgb_compact *m)
+{
+	uint8_t *space = msgbc_pull(m, 1) - 1;
+	return space[0];
+}
+
+/*! remove uint16 from front of compact msgb */
+static inline uint16_t msgbc_pull_u16(struct msgb_compact *m)
+{
+	return osmo_load16be(msgbc_pull(m, 2) - 2);
+}
+
+/*! remove uint32 from front of compact msgb */
+static inline uint32_t msgbc_pull_u32(struct msgb_compact *m)
+{
+	return osmo_load32be(msgbc_pull(m, 4) - 4);
+}
+
+/*! Increase headroom of empty compact msgb, see \ref msgb_reserve */
+static inline void msgbc_reserve(struct msgb_compact *m, int len)
+{
+	m->data += len;
+}
+
+/*! Trim compact msgb to a given absolute length, see \ref msgb_trim */
+static inline int msgbc_trim(struct msgb_compact *m, int len)
+{
+	if (len < 0)
+		MSGB_ABORT(m, "Negative length is not allowed\n");
+	if (m->data + len > m->data_len)
+		return -1;
+
+	m->len = len;
+	return 0;
+}
+
+/*! Allocate compact msgb with specified headroom from specified talloc context.
+ *  \param[in] ctx talloc context from which to allocate
+ *  \param[in] size size in bytes, including headroom
+ *  \param[in] headroom headroom in bytes
+ *  \param[in] cb_len number of control buffer entries, may be zero
+ *  \returns allocated compact message buffer with specified headroom */
+static inline struct msgb_compact *msgbc_alloc_headroom_c(const void *ctx, int size, int headroom,
+							  uint8_t cb_len)
+{
+	osmo_static_assert(size > headroom, headroom_bigger);
+
+	struct msgb_compact *m = msgbc_alloc_c(ctx, size, cb_len);
+	if (m)
+		msgbc_reserve(m, headroom);
+	return m;
+}
+
+/*! Allocate compact msgb with specified headroom.
+ *  \param[in] size size in bytes, including headroom
+ *  \param[in] headroom headroom in bytes
+ *  \param[in] cb_len number of control buffer entries, may be zero
+ *  \returns allocated compact message buffer with specified headroom */
+static inline struct msgb_compact *msgbc_alloc_headroom(int size, int headroom, uint8_t cb_len)
+{
+	osmo_static_assert(size > headroom, headroom_bigger);
+
+	struct msgb_compact *m = msgbc_alloc(size, cb_len);
+	if (m)
+		msgbc_reserve(m, headroom);
+	return m;
+}
+
+/*! @} */
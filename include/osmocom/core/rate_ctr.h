@@ -5,6 +5,7 @@
  * \file rate_ctr.h */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include <osmocom/core/linuxlist.h>
 
@@ -29,6 +30,10 @@ struct rate_ctr_per_intv {
 struct rate_ctr {
 	uint64_t current;	/*!< current value */
 	uint64_t previous;	/*!< previous value, used for delta */
+	/*! number of one-second ticks already accounted for in \a intv, for
+	 *  counters of lazy groups.  Kept next to \a current, as \ref
+	 *  rate_ctr_add checks it. */
+	uint64_t ticks;
 	/*! per-interval data */
 	struct rate_ctr_per_intv intv[RATE_CTR_INTV_NUM];
 };
@@ -61,6 +66,10 @@ struct rate_ctr_group {
 	const struct rate_ctr_group_desc *desc;
 	/*! The index of this ctr_group within its class */
 	unsigned int idx;
+	/*! If true, intervals are only computed on access, see \ref rate_ctr_group_set_lazy */
+	bool lazy;
+	/*! Per-thread counter slots, see \ref rate_ctr_group_alloc_sharded */
+	struct rate_ctr_shards *shards;
 	/*! Actual counter structures below */
 	struct rate_ctr ctr[0];
 };
@@ -69,13 +78,17 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 					    const struct rate_ctr_group_desc *desc,
 					    unsigned int idx);
 
-static inline void rate_ctr_group_upd_idx(struct rate_ctr_group *grp, unsigned int idx)
-{
-	grp->idx = idx;
-}
+void rate_ctr_group_upd_idx(struct rate_ctr_group *grp, unsigned int idx);
+
+struct rate_ctr_group *rate_ctr_group_alloc_sharded(void *ctx,
+						    const struct rate_ctr_group_desc *desc,
+						    unsigned int idx, unsigned int num_shards);
 
 void rate_ctr_group_free(struct rate_ctr_group *grp);
 
+void rate_ctr_group_set_lazy(struct rate_ctr_group *grp, bool lazy);
+void rate_ctr_group_update(struct rate_ctr_group *grp);
+
 /*! Increment the counter by \a inc
  *  \param ctr \ref rate_ctr to increment
  *  \param inc quantity to increment \a ctr by */
@@ -96,6 +109,9 @@ static inline void rate_ctr_inc2(struct rate_ctr_group *ctrg, unsigned int idx)
 	rate_ctr_inc(&ctrg->ctr[idx]);
 }
 
+void rate_ctr_group_shard_add(struct rate_ctr_group *ctrg, unsigned int shard,
+			      unsigned int idx, int inc);
+
 
 /*! Return the counter difference since the last call to this function */
 int64_t rate_ctr_difference(struct rate_ctr *ctr);
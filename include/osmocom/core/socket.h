@@ -35,6 +35,27 @@ struct osmo_fd;
 #define OSMO_SOCK_F_NO_MCAST_ALL  (1 << 4)
 /*! use SO_REUSEADDR on UDP ports (required for multicast) */
 #define OSMO_SOCK_F_UDP_REUSEADDR (1 << 5)
+/*! use SO_REUSEPORT, so that several sockets can bind the same address and port
+ *  and the kernel shards the incoming traffic between them */
+#define OSMO_SOCK_F_REUSEPORT	(1 << 6)
+/*! receive the local address of each datagram (IP_PKTINFO / IPV6_RECVPKTINFO) */
+#define OSMO_SOCK_F_PKTINFO	(1 << 7)
+/*! enable UDP generic receive offload (UDP_GRO), if supported */
+#define OSMO_SOCK_F_UDP_GRO	(1 << 8)
+/*! apply the process-wide tuning set by osmo_sock_tuning_set() */
+#define OSMO_SOCK_F_TUNING	(1 << 9)
+
+/*! Process-wide socket tuning, see \ref OSMO_SOCK_F_TUNING. A value of 0 keeps the system default. */
+struct osmo_sock_tuning {
+	/*! kernel receive buffer size in bytes (SO_RCVBUF) */
+	unsigned int rcvbuf;
+	/*! kernel send buffer size in bytes (SO_SNDBUF) */
+	unsigned int sndbuf;
+	/*! busy polling time in microseconds (SO_BUSY_POLL) */
+	unsigned int busy_poll_us;
+	/*! UDP segmentation offload size in bytes (UDP_SEGMENT), UDP sockets only */
+	unsigned int udp_segment;
+};
 
 int osmo_sock_init(uint16_t family, uint16_t type, uint8_t proto,
 		   const char *host, uint16_t port, unsigned int flags);
@@ -82,6 +103,16 @@ int osmo_sock_mcast_ttl_set(int fd, uint8_t ttl);
 int osmo_sock_mcast_all_set(int fd, bool enable);
 int osmo_sock_mcast_subscribe(int fd, const char *grp_addr);
 
+int osmo_sock_reuseport_set(int fd, bool enable);
+int osmo_sock_bufsize_set(int fd, unsigned int rcvbuf, unsigned int sndbuf);
+int osmo_sock_busy_poll_set(int fd, unsigned int usec);
+int osmo_sock_udp_segment_set(int fd, unsigned int size);
+int osmo_sock_udp_gro_set(int fd, bool enable);
+int osmo_sock_pktinfo_set(int fd, bool enable);
+
+void osmo_sock_tuning_set(const struct osmo_sock_tuning *tuning);
+const struct osmo_sock_tuning *osmo_sock_tuning_get(void);
+
 int osmo_sock_local_ip(char *local_ip, const char *remote_ip);
 
 /*! @} */
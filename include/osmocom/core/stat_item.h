@@ -19,6 +19,33 @@ struct osmo_stat_item_value {
 	int32_t value;		/*!< actual value */
 };
 
+/*! Value range and precision of a histogram item */
+struct osmo_stat_hist_desc {
+	/*! largest value to be recorded, larger ones end up in the last bucket */
+	uint32_t max_value;
+	/*! each power of two is split in 2^precision_bits buckets, i.e. the
+	 *  relative error of a percentile is below 2^-precision_bits */
+	uint8_t precision_bits;
+};
+
+/*! Log-linear bucketed histogram of values */
+struct osmo_stat_hist {
+	/*! number of values recorded */
+	uint64_t count;
+	/*! sum of all values recorded */
+	uint64_t sum;
+	/*! smallest value recorded */
+	uint32_t min;
+	/*! largest value recorded */
+	uint32_t max;
+	/*! see \ref osmo_stat_hist_desc */
+	uint8_t precision_bits;
+	/*! number of entries in \a buckets */
+	unsigned int num_buckets;
+	/*! number of values per bucket */
+	uint64_t buckets[0];
+};
+
 /*! data we keep for each actual item */
 struct osmo_stat_item {
 	/*! back-reference to the item description */
@@ -27,6 +54,10 @@ struct osmo_stat_item {
 	int32_t last_value_index;
 	/*! offset to the freshest value in the value FIFO */
 	int16_t last_offs;
+	/*! distribution of all values set, if \ref osmo_stat_item_desc.hist is set */
+	struct osmo_stat_hist *hist;
+	/*! copy of \a hist at the time of the last report, see \ref osmo_stats_report */
+	struct osmo_stat_hist *hist_reported;
 	/*! value FIFO */
 	struct osmo_stat_item_value values[0];
 };
@@ -38,6 +69,8 @@ struct osmo_stat_item_desc {
 	const char *unit;	/*!< unit of a value */
 	unsigned int num_values;/*!< number of values to store in FIFO */
 	int32_t default_value;	/*!< default value */
+	/*! if set, the item also keeps a histogram of its values */
+	const struct osmo_stat_hist_desc *hist;
 };
 
 /*! Description of a statistics item group */
@@ -110,6 +143,13 @@ int osmo_stat_item_for_each_item(struct osmo_stat_item_group *statg,
 
 int osmo_stat_item_for_each_group(osmo_stat_item_group_handler_t handle_group, void *data);
 
+struct osmo_stat_hist *osmo_stat_hist_alloc(void *ctx, const struct osmo_stat_hist_desc *desc);
+void osmo_stat_hist_record(struct osmo_stat_hist *hist, uint32_t value);
+int osmo_stat_hist_merge(struct osmo_stat_hist *dst, const struct osmo_stat_hist *src);
+void osmo_stat_hist_reset(struct osmo_stat_hist *hist);
+int osmo_stat_hist_since(struct osmo_stat_hist *prev, const struct osmo_stat_hist *cur);
+uint32_t osmo_stat_hist_percentile(const struct osmo_stat_hist *hist, unsigned int percent);
+
 static inline int32_t osmo_stat_item_get_last(const struct osmo_stat_item *item)
 {
 	return item->values[item->last_offs].value;
@@ -46,6 +46,7 @@ const char *get_value_string_or_null(const struct value_string *vs,
 				     uint32_t val);
 
 int get_string_value(const struct value_string *vs, const char *str);
+int osmo_value_string_index(const struct value_string *vs);
 
 char osmo_bcd2char(uint8_t bcd);
 /* only works for numbers in ASCII */
@@ -63,6 +64,7 @@ char *osmo_hexdump_nospc(const unsigned char *buf, int len);
 char *osmo_hexdump_nospc_c(const void *ctx, const unsigned char *buf, int len);
 const char *osmo_hexdump_buf(char *out_buf, size_t out_buf_size, const unsigned char *buf, int len, const char *delim,
 			     bool delim_after_last);
+size_t osmo_hexdump_len(int len, const char *delim, bool delim_after_last);
 
 char *osmo_osmo_hexdump_nospc(const unsigned char *buf, int len) __attribute__((__deprecated__));
 
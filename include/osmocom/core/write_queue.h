@@ -30,6 +30,21 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/msgb.h>
 
+struct osmo_stat_item;
+struct rate_ctr;
+
+/*! How \ref osmo_wqueue_bfd_cb writes queued messages */
+enum osmo_wqueue_mode {
+	/*! pass one message per write event to \ref osmo_wqueue.write_cb */
+	OSMO_WQUEUE_MODE_CB = 0,
+	/*! write as many messages as possible with writev(), for stream sockets,
+	 *  pipes and the like; partial writes are resumed on the next event */
+	OSMO_WQUEUE_MODE_WRITEV,
+	/*! send as many messages as possible with sendmmsg(), one datagram each,
+	 *  for connected datagram sockets */
+	OSMO_WQUEUE_MODE_SENDMMSG,
+};
+
 /*! write queue instance */
 struct osmo_wqueue {
 	/*! osmocom file descriptor */
@@ -48,9 +63,24 @@ struct osmo_wqueue {
 	int (*write_cb)(struct osmo_fd *fd, struct msgb *msg);
 	/*! call-back in case qeueue has exceptions. Return -EBADF if fd is freed inside cb. */
 	int (*except_cb)(struct osmo_fd *fd);
+
+	/*! maximum number of bytes in the write queue, 0 for no limit */
+	unsigned int max_bytes;
+	/*! current number of bytes in the write queue */
+	unsigned int current_bytes;
+	/*! how queued messages are written, see \ref osmo_wqueue_set_mode */
+	enum osmo_wqueue_mode mode;
+	/*! if set, updated with current_length whenever it changes */
+	struct osmo_stat_item *length_item;
+	/*! if set, updated with current_bytes whenever it changes */
+	struct osmo_stat_item *bytes_item;
+	/*! if set, incremented for each message written; in OSMO_WQUEUE_MODE_CB
+	 *  for each message write_cb returned success for */
+	struct rate_ctr *sent_ctr;
 };
 
 void osmo_wqueue_init(struct osmo_wqueue *queue, int max_length);
+int osmo_wqueue_set_mode(struct osmo_wqueue *queue, enum osmo_wqueue_mode mode);
 void osmo_wqueue_clear(struct osmo_wqueue *queue);
 int osmo_wqueue_enqueue(struct osmo_wqueue *queue, struct msgb *data);
 int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what);
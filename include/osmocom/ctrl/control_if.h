@@ -18,6 +18,11 @@ struct ctrl_handle {
 
 	/* List of control connections */
 	struct llist_head ccon_list;
+
+	/*! How accepted connections write their replies, see osmo_wqueue_set_mode().
+	 *  OSMO_WQUEUE_MODE_WRITEV sends the replies to pipelined requests in one
+	 *  writev(), but bypasses the write_cb of the connection. */
+	enum osmo_wqueue_mode wqueue_mode;
 };
 
 
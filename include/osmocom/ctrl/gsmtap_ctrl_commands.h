@@ -0,0 +1,8 @@
+/*! \file gsmtap_ctrl_commands.h */
+
+#pragma once
+
+struct gsmtap_inst;
+
+/* Install the 'gsmtap-filter' CTRL command for the source filter of a GSMTAP instance. */
+int gsmtap_ctrl_cmds_install(struct gsmtap_inst *gti);
@@ -72,11 +72,20 @@ struct bssgp_flow_control {
 	uint32_t max_queue_depth;	/*!< how many packets to queue (mgs) */
 	uint32_t queue_depth;		/*!< current length of queue (msgs) */
 	struct llist_head queue;	/*!< linked list of msgb's */
-	struct osmo_timer_list timer;	/*!< timer-based dequeueing */
+	struct osmo_timer_list timer;	/*!< unused, queues are served by a shared scheduler */
 
 	/*! callback to be called at output of flow control */
 	int (*out_cb)(struct bssgp_flow_control *fc, struct msgb *msg,
 			uint32_t llc_pdu_len, void *priv);
+
+	uint32_t max_queue_bytes;	/*!< how many octets to queue, 0 for no limit */
+	uint32_t queue_bytes;		/*!< current length of queue (octets) */
+	/*! stat items to report the queue depth and delay to, see enum bssgp_bvc_stat; may be NULL */
+	struct osmo_stat_item_group *statg;
+	/*! entry in the shared flow control scheduler while the queue is not empty */
+	struct llist_head sched_list;
+	/*! scheduler tick at which the first PDU of the queue may be sent */
+	uint64_t sched_tick;
 };
 
 #define BVC_S_BLOCKED	0x0001
@@ -106,12 +115,17 @@ struct bssgp_bvc_ctx {
 	/* we might want to add this as a shortcut later, avoiding the NSVC
 	 * lookup for every packet, similar to a routing cache */
 	//struct gprs_nsvc *nsvc;
+
+	/*! flow control statistics, see enum bssgp_bvc_stat */
+	struct osmo_stat_item_group *statg;
 };
 extern struct llist_head bssgp_bvc_ctxts;
 /* Find a BTS Context based on parsed RA ID and Cell ID */
 struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid);
 /* Find a BTS context based on BVCI+NSEI tuple */
 struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei);
+/* Allocate a BTS context for a BVCI+NSEI tuple */
+struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei);
 
 #define BVC_F_BLOCKED	0x0001
 
@@ -125,6 +139,12 @@ enum bssgp_ctr {
 	BSSGP_CTR_STATUS,
 };
 
+enum bssgp_bvc_stat {
+	BSSGP_STAT_FC_QUEUE_DEPTH,
+	BSSGP_STAT_FC_QUEUE_BYTES,
+	BSSGP_STAT_FC_QUEUE_DELAY,
+};
+
 
 #include <osmocom/gsm/tlv.h>
 #include <osmocom/gprs/gprs_msgb.h>
@@ -150,6 +170,22 @@ struct bssgp_dl_ud_par {
 int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 		   struct bssgp_dl_ud_par *dup);
 
+/*! maximum size of the pre-encoded MS Radio Access Capability, DRX
+ *  Parameters and IMSI IEs of a DL-UNITDATA */
+#define BSSGP_DL_UD_IE_CACHE_MAXLEN	(3 + 255 + 4 + 2 + 9)
+
+/*! Pre-encoded per-MS IEs of a DL-UNITDATA (MS Radio Access Capability,
+ *  DRX Parameters, IMSI), to be re-used for every PDU to that MS */
+struct bssgp_dl_ud_ie_cache {
+	uint16_t len;		/*!< length of the encoded IEs in \a data */
+	uint8_t data[BSSGP_DL_UD_IE_CACHE_MAXLEN];
+};
+int bssgp_dl_ud_ie_cache_update(struct bssgp_dl_ud_ie_cache *iec,
+				const struct bssgp_dl_ud_par *dup);
+int bssgp_tx_dl_ud_cached(struct msgb *msg, uint16_t pdu_lifetime,
+			  struct bssgp_dl_ud_par *dup,
+			  const struct bssgp_dl_ud_ie_cache *iec);
+
 uint16_t bssgp_parse_cell_id(struct gprs_ra_id *raid, const uint8_t *buf);
 int bssgp_create_cell_id(uint8_t *buf, const struct gprs_ra_id *raid,
 			 uint16_t cid);
@@ -29,6 +29,15 @@
 /* Educated guess - LLC user payload is 1500 bytes plus possible headers */
 #define NS_ALLOC_SIZE	3072
 #define NS_ALLOC_HEADROOM 20
+/*! length of the NS-UNITDATA header (PDU type, spare, BVCI) prepended by gprs_ns_sendmsg() */
+#define NS_UNITDATA_HDR_LEN 4
+/*! number of slots of the per-instance NS-VC lookup caches, must be a power of two */
+#define NS_LOOKUP_CACHE_SIZE 64
+/*! number of buckets of the load sharing table of an NSE (log2 and value) */
+#define NS_LSP_BUCKETS_BITS 6
+#define NS_LSP_BUCKETS (1 << NS_LSP_BUCKETS_BITS)
+
+struct gprs_ns_lsp_table;
 
 enum ns_timeout {
 	NS_TOUT_TNS_BLOCK,
@@ -106,6 +115,16 @@ struct gprs_ns_inst {
 	} frgre;
 
 	struct osmo_fsm_inst *bss_sns_fi;
+
+	/*! NS-VC lookup caches of the NS-UNITDATA fast path. They are flushed
+	 *  whenever an NS-VC is created or deleted, or changes its state, NSEI,
+	 *  weights or peer address. rx hits are re-checked against the address. */
+	struct {
+		/*! load sharing tables by NSEI, chained per slot, see gprs_ns_sendmsg() */
+		struct gprs_ns_lsp_table *tx[NS_LOOKUP_CACHE_SIZE];
+		/*! NS-VC by remote peer address */
+		struct gprs_nsvc *rx[NS_LOOKUP_CACHE_SIZE];
+	} cache;
 };
 
 enum nsvc_timer_mode {
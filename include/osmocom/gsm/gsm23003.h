@@ -4,6 +4,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* 23.003 Chapter 12.1 */
 struct osmo_plmn_id {
@@ -100,6 +101,61 @@ struct osmo_guti {
 	uint32_t mtmsi;
 };
 
+/*! An IMSI or TMSI packed into a single 64 bit value, to key subscriber tables without string conversions.
+ * The top nibble holds the number of IMSI digits (GSM23003_IMSI_MIN_DIGITS..GSM23003_IMSI_MAX_DIGITS), or
+ * OSMO_MI_PACKED_TMSI for a TMSI, or zero for no identity. The IMSI digits follow one per nibble, most significant
+ * digit first; e.g. IMSI 901700000004620 is 0xf901700000004620. A TMSI takes the lower 32 bits. Two identities are
+ * equal iff their values are equal. */
+struct osmo_mi_packed {
+	uint64_t val;
+};
+
+#define OSMO_MI_PACKED_TMSI	0x1
+#define OSMO_MI_PACKED_KIND(mi)	((uint8_t)((mi)->val >> 60))
+
+/*! Return true if mi holds an IMSI. */
+static inline bool osmo_mi_packed_is_imsi(const struct osmo_mi_packed *mi)
+{
+	return OSMO_MI_PACKED_KIND(mi) > OSMO_MI_PACKED_TMSI;
+}
+
+/*! Return true if mi holds a TMSI. */
+static inline bool osmo_mi_packed_is_tmsi(const struct osmo_mi_packed *mi)
+{
+	return OSMO_MI_PACKED_KIND(mi) == OSMO_MI_PACKED_TMSI;
+}
+
+/*! Set mi to the given TMSI. */
+static inline void osmo_mi_packed_set_tmsi(struct osmo_mi_packed *mi, uint32_t tmsi)
+{
+	mi->val = ((uint64_t)OSMO_MI_PACKED_TMSI << 60) | tmsi;
+}
+
+/*! Return the TMSI held by mi; only meaningful if osmo_mi_packed_is_tmsi(mi). */
+static inline uint32_t osmo_mi_packed_tmsi(const struct osmo_mi_packed *mi)
+{
+	return (uint32_t)mi->val;
+}
+
+/*! Return a 32 bit hash of mi, suitable as hash table index.
+ * For tables smaller than 2^32 buckets, use the upper bits. */
+static inline uint32_t osmo_mi_packed_hash(const struct osmo_mi_packed *mi)
+{
+	return (uint32_t)((mi->val * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/*! Compare two packed identities; TMSIs sort before IMSIs, shorter IMSIs before longer ones.
+ * \returns 0 if equal, negative if a < b, positive if a > b. */
+static inline int osmo_mi_packed_cmp(const struct osmo_mi_packed *a, const struct osmo_mi_packed *b)
+{
+	return (a->val > b->val) - (a->val < b->val);
+}
+
+int osmo_mi_packed_from_imsi_str(struct osmo_mi_packed *mi, const char *imsi);
+int osmo_mi_packed_to_imsi_str(char *buf, size_t buf_len, const struct osmo_mi_packed *mi);
+char *osmo_mi_packed_name_buf(char *buf, size_t buf_len, const struct osmo_mi_packed *mi);
+const char *osmo_mi_packed_name(const struct osmo_mi_packed *mi);
+
 bool osmo_imsi_str_valid(const char *imsi);
 bool osmo_msisdn_str_valid(const char *msisdn);
 bool osmo_imei_str_valid(const char *imei, bool with_15th_digit);
@@ -51,6 +51,8 @@ void gsm48_generate_lai2(struct gsm48_loc_area_id *lai48, const struct osmo_loca
 int gsm48_generate_mid_from_tmsi(uint8_t *buf, uint32_t tmsi);
 int gsm48_generate_mid_from_imsi(uint8_t *buf, const char *imsi);
 uint8_t gsm48_generate_mid(uint8_t *buf, const char *id, uint8_t mi_type);
+uint8_t gsm48_generate_mid_from_packed(uint8_t *buf, const struct osmo_mi_packed *mi);
+int osmo_mi_packed_from_mi(struct osmo_mi_packed *packed, const uint8_t *mi, uint8_t mi_len);
 
 /* Convert Mobile Identity (10.5.1.4) to string */
 int gsm48_mi_to_string(char *string, const int str_len,
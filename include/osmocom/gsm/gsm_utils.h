@@ -110,6 +110,11 @@ int gsm_7bit_encode_n(uint8_t *result, size_t n, const char *data, int *octets_w
  */
 int gsm_7bit_encode_n_ussd(uint8_t *result, size_t n, const char *data, int *octets_written);
 
+int gsm_7bit_encode_n_utf8(uint8_t *result, size_t n, const char *utf8, int *octets_written);
+int gsm_7bit_decode_n_utf8(char *decoded, size_t n, const uint8_t *user_data, uint8_t length, uint8_t ud_hdr_ind);
+int gsm_ucs2_encode_utf8(uint8_t *result, size_t n, const char *utf8);
+int gsm_ucs2_decode_utf8(char *decoded, size_t n, const uint8_t *ucs2, size_t len);
+
 /* the four functions below are helper functions and here for the unit test */
 int gsm_septets2octets(uint8_t *result, const uint8_t *rdata, uint8_t septet_len, uint8_t padding);
 int gsm_septet_encode(uint8_t *result, const char *data);
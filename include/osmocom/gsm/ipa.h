@@ -79,3 +79,12 @@ struct msgb *ipa_msg_alloc(int headroom);
 
 int ipa_msg_recv(int fd, struct msgb **rmsg);
 int ipa_msg_recv_buffered(int fd, struct msgb **rmsg, struct msgb **tmp_msg);
+
+/* streaming receiver, reading many IPA frames per recv() */
+struct ipaccess_head;
+struct ipa_stream_rx;
+struct ipa_stream_rx *ipa_stream_rx_alloc(void *ctx, unsigned int size);
+void ipa_stream_rx_free(struct ipa_stream_rx *srx);
+int ipa_stream_rx_recv(struct ipa_stream_rx *srx, int fd);
+int ipa_stream_rx_next(struct ipa_stream_rx *srx, const struct ipaccess_head **hh);
+int ipa_msg_recv_batch(int fd, struct ipa_stream_rx *srx, struct llist_head *msgs);
@@ -0,0 +1,27 @@
+/*! \file gsmtap_vty.h
+ * API to configure the source filter of a GSMTAP instance from VTY. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#pragma once
+
+#include <osmocom/vty/command.h>
+
+struct vty;
+struct gsmtap_inst;
+
+int gsmtap_vty_init(enum node_type parent_node, struct gsmtap_inst *gti);
+void gsmtap_vty_write(struct vty *vty, const char *indent);
@@ -28,6 +28,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -58,32 +59,158 @@ const struct value_string ctrl_type_vals[] = {
 /* Functions from libosmocom */
 extern vector cmd_make_descvec(const char *string, const char *descstr);
 
+/* Number of hash buckets per CTRL node, power of two */
+#define CTRL_IDX_BUCKETS	64
+
+/* An installed command, in the order of installation */
+struct ctrl_idx_entry {
+	struct ctrl_cmd_element *cmd_el;
+	unsigned int seq;
+};
+
+struct ctrl_idx_bucket {
+	struct ctrl_idx_entry *entries;
+	unsigned int num;
+};
+
+/* Index of the commands of one CTRL node by their first word, so that a
+ * lookup compares against a handful of commands instead of all of them. */
+struct ctrl_node_idx {
+	/* the command vector of the node in ctrl_node_vec */
+	vector cmds;
+	/* number of commands indexed */
+	unsigned int num_cmds;
+	struct ctrl_idx_bucket buckets[CTRL_IDX_BUCKETS];
+	/* commands starting with a wildcard, to be tried for every lookup */
+	struct ctrl_idx_bucket wildcards;
+};
+
+static vector ctrl_node_idx_vec;
+
+static unsigned int ctrl_idx_hash(const char *word)
+{
+	uint32_t h = 2166136261U;
+
+	while (*word)
+		h = (h ^ (uint8_t)*word++) * 16777619U;
+	return h & (CTRL_IDX_BUCKETS - 1);
+}
+
+static struct ctrl_node_idx *ctrl_node_idx_find(vector cmds)
+{
+	unsigned int i;
+
+	if (!ctrl_node_idx_vec)
+		return NULL;
+
+	for (i = 0; i < vector_active(ctrl_node_idx_vec); i++) {
+		struct ctrl_node_idx *idx = vector_slot(ctrl_node_idx_vec, i);
+		if (idx && idx->cmds == cmds)
+			return idx;
+	}
+	return NULL;
+}
+
+static int ctrl_idx_bucket_add(struct ctrl_node_idx *idx, struct ctrl_idx_bucket *b,
+			       struct ctrl_cmd_element *cmd_el)
+{
+	struct ctrl_idx_entry *entries;
+
+	entries = talloc_realloc(idx, b->entries, struct ctrl_idx_entry, b->num + 1);
+	if (!entries)
+		return -ENOMEM;
+	b->entries = entries;
+	b->entries[b->num++] = (struct ctrl_idx_entry){
+		.cmd_el = cmd_el,
+		.seq = idx->num_cmds,
+	};
+	return 0;
+}
+
+/* Add an installed command to the index of its node */
+static int ctrl_node_idx_add(enum ctrl_node_type node, vector cmds, struct ctrl_cmd_element *cmd_el)
+{
+	struct ctrl_cmd_struct *cmd_desc = &cmd_el->strcmd;
+	struct ctrl_node_idx *idx;
+	int rc;
+
+	if (!ctrl_node_idx_vec) {
+		ctrl_node_idx_vec = vector_init(5);
+		if (!ctrl_node_idx_vec)
+			return -ENOMEM;
+	}
+
+	idx = vector_lookup(ctrl_node_idx_vec, node);
+	if (!idx || idx->cmds != cmds) {
+		/* a previous ctrl_node_vec may have been discarded */
+		talloc_free(idx);
+		idx = talloc_zero(tall_vty_vec_ctx, struct ctrl_node_idx);
+		if (!idx)
+			return -ENOMEM;
+		idx->cmds = cmds;
+		vector_set_index(ctrl_node_idx_vec, node, idx);
+	}
+
+	if (!cmd_desc->nr_commands || cmd_desc->command[0][0] == '*')
+		rc = ctrl_idx_bucket_add(idx, &idx->wildcards, cmd_el);
+	else
+		rc = ctrl_idx_bucket_add(idx, &idx->buckets[ctrl_idx_hash(cmd_desc->command[0])], cmd_el);
+	if (rc)
+		return rc;
+
+	idx->num_cmds++;
+	return 0;
+}
+
+static bool ctrl_cmd_element_matches(struct ctrl_cmd_element *cmd_el, vector vline)
+{
+	struct ctrl_cmd_struct *cmd_desc = &cmd_el->strcmd;
+	int j;
+
+	if (cmd_desc->nr_commands > vector_active(vline))
+		return false;
+	for (j = 0; j < vector_active(vline) && j < cmd_desc->nr_commands; j++) {
+		const char *str = vector_slot(vline, j);
+		const char *desc = cmd_desc->command[j];
+		if (desc[0] == '*')
+			return true; /* Partial match */
+		if (strcmp(desc, str) != 0)
+			return false;
+	}
+	/* We went through all the elements and all matched */
+	return j == cmd_desc->nr_commands;
+}
+
 /* Get the ctrl_cmd_element that matches this command */
 static struct ctrl_cmd_element *ctrl_cmd_get_element_match(vector vline, vector node)
 {
-	int index, j;
-	const char *desc;
-	struct ctrl_cmd_element *cmd_el;
-	struct ctrl_cmd_struct *cmd_desc;
-	char *str;
+	struct ctrl_node_idx *idx = ctrl_node_idx_find(node);
+	struct ctrl_idx_bucket *b;
+	unsigned int i, w;
+	int index;
+
+	if (idx && idx->num_cmds == vector_active(node) && vector_active(vline)) {
+		/* The first matching command in the order of installation wins, so
+		 * merge the commands starting with this word and the wildcards. */
+		b = &idx->buckets[ctrl_idx_hash(vector_slot(vline, 0))];
+		for (i = 0, w = 0; i < b->num || w < idx->wildcards.num;) {
+			struct ctrl_idx_entry *e;
+			if (w == idx->wildcards.num ||
+			    (i < b->num && b->entries[i].seq < idx->wildcards.entries[w].seq))
+				e = &b->entries[i++];
+			else
+				e = &idx->wildcards.entries[w++];
+			if (ctrl_cmd_element_matches(e->cmd_el, vline))
+				return e->cmd_el;
+		}
+		return NULL;
+	}
 
+	/* not installed by ctrl_cmd_install(), search the whole node */
 	for (index = 0; index < vector_active(node); index++) {
-		if ((cmd_el = vector_slot(node, index))) {
-			cmd_desc = &cmd_el->strcmd;
-			if (cmd_desc->nr_commands > vector_active(vline))
-				continue;
-			for (j =0; j < vector_active(vline) && j < cmd_desc->nr_commands; j++) {
-				str = vector_slot(vline, j);
-				desc = cmd_desc->command[j];
-				if (desc[0] == '*')
-					return cmd_el; /* Partial match */
-				if (strcmp(desc, str) != 0)
-					break;
-			}
-			/* We went through all the elements and all matched */
-			if (j == cmd_desc->nr_commands)
-				return cmd_el;
-		}
+		struct ctrl_cmd_element *cmd_el = vector_slot(node, index);
+		if (cmd_el && ctrl_cmd_element_matches(cmd_el, vline))
+			return cmd_el;
 	}
 
 	return NULL;
@@ -228,7 +355,7 @@ int ctrl_cmd_install(enum ctrl_node_type node, struct ctrl_cmd_element *cmd)
 	vector_set(cmds_vec, cmd);
 
 	create_cmd_struct(&cmd->strcmd, cmd->name);
-	return 0;
+	return ctrl_node_idx_add(node, cmds_vec, cmd);
 }
 
 /*! Allocate a control command of given \a type.
@@ -402,7 +529,8 @@ struct ctrl_cmd *ctrl_cmd_parse3(void *ctx, struct msgb *msg, bool *parse_failed
 				     osmo_escape_str(str, -1));
 				goto err;
 			}
-			if (!osmo_separated_identifiers_valid(var, ".")) {
+			/* a GET may list several variables separated by ',' */
+			if (!osmo_separated_identifiers_valid(var, ".,")) {
 				cmd->type = CTRL_TYPE_ERROR;
 				cmd->reply = "GET variable contains invalid characters";
 				LOGP(DLCTRL, LOGL_NOTICE, "GET variable contains invalid characters: \"%s\"\n",
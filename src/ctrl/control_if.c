@@ -53,6 +53,7 @@
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/counter.h>
 #include <osmocom/core/talloc.h>
@@ -211,6 +212,62 @@ static void control_close_conn(struct ctrl_connection *ccon)
 	talloc_free(ccon);
 }
 
+/* A GET of several variables separated by ',' gets one reply line per
+ * variable, "<variable> <value>" or "<variable> ERROR <reason>", so that many
+ * variables can be polled with a single round-trip. */
+static int ctrl_cmd_handle_bulk(struct ctrl_handle *ctrl, struct ctrl_cmd *cmd, void *data)
+{
+	char *vars, *var, *saveptr;
+	char *reply;
+
+	vars = talloc_strdup(cmd, cmd->variable);
+	reply = talloc_strdup(cmd, "");
+	if (!vars || !reply)
+		goto oom;
+
+	for (var = strtok_r(vars, ",", &saveptr); var; var = strtok_r(NULL, ",", &saveptr)) {
+		struct ctrl_cmd *sub = ctrl_cmd_create(cmd, CTRL_TYPE_GET);
+		int rc;
+
+		if (!sub)
+			goto oom;
+		sub->id = talloc_strdup(sub, cmd->id);
+		sub->variable = talloc_strdup(sub, var);
+		if (!sub->id || !sub->variable)
+			goto oom;
+		rc = ctrl_cmd_handle(ctrl, sub, data);
+
+		/* without a connection, replies can not be deferred */
+		if (rc == CTRL_CMD_HANDLED)
+			reply = talloc_asprintf_append(reply, "%s%s ERROR Deferred reply not supported in bulk GET",
+						       *reply ? "\n" : "", var);
+		else if (rc == CTRL_CMD_ERROR || !sub->reply)
+			reply = talloc_asprintf_append(reply, "%s%s ERROR %s", *reply ? "\n" : "", var,
+						       sub->reply ? sub->reply : "No reply");
+		else
+			reply = talloc_asprintf_append(reply, "%s%s %s", *reply ? "\n" : "", var, sub->reply);
+
+		/* like in ctrl_handle_msg(), a deferred command belongs to its ctrl_cmd_def */
+		if (sub->defer)
+			talloc_steal(ctrl, sub);
+		else
+			talloc_free(sub);
+		if (!reply)
+			goto oom;
+	}
+
+	talloc_free(vars);
+	cmd->reply = reply;
+	cmd->type = CTRL_TYPE_GET_REPLY;
+	return CTRL_CMD_REPLY;
+
+oom:
+	talloc_free(vars);
+	cmd->reply = "OOM";
+	cmd->type = CTRL_TYPE_ERROR;
+	return CTRL_CMD_ERROR;
+}
+
 int ctrl_cmd_handle(struct ctrl_handle *ctrl, struct ctrl_cmd *cmd,
 		    void *data)
 {
@@ -236,6 +293,9 @@ int ctrl_cmd_handle(struct ctrl_handle *ctrl, struct ctrl_cmd *cmd,
 			return CTRL_CMD_HANDLED;
 	}
 
+	if (cmd->type == CTRL_TYPE_GET && strchr(cmd->variable, ','))
+		return ctrl_cmd_handle_bulk(ctrl, cmd, data);
+
 	ret = CTRL_CMD_ERROR;
 	cmd->reply = NULL;
 	node = CTRL_NODE_ROOT;
@@ -555,6 +615,7 @@ static int listen_fd_cb(struct osmo_fd *listen_bfd, unsigned int what)
 
 	ccon->write_queue.bfd.fd = fd;
 	ccon->write_queue.bfd.when = OSMO_FD_READ;
+	osmo_wqueue_set_mode(&ccon->write_queue, ctrl->wqueue_mode);
 
 	ret = osmo_fd_register(&ccon->write_queue.bfd);
 	if (ret < 0) {
@@ -681,6 +742,8 @@ static int get_rate_ctr(struct ctrl_cmd *cmd, void *data)
 		goto err;
 	}
 
+	rate_ctr_group_update(ctrg);
+
 	if (!strlen(saveptr)) {
 		talloc_free(dup);
 		return get_rate_ctr_group_idx(ctrg, intv, cmd);
@@ -718,6 +781,151 @@ static int verify_rate_ctr(struct ctrl_cmd *cmd, const char *value, void *data)
 	return 0;
 }
 
+/* stat_item: the last value, or the distribution of a histogram item */
+enum stat_item_field {
+	STAT_ITEM_LAST,
+	STAT_ITEM_P50,
+	STAT_ITEM_P90,
+	STAT_ITEM_P99,
+	STAT_ITEM_MAX,
+	STAT_ITEM_COUNT,
+};
+
+static const struct value_string stat_item_field_names[] = {
+	{ STAT_ITEM_LAST,	"last" },
+	{ STAT_ITEM_P50,	"p50" },
+	{ STAT_ITEM_P90,	"p90" },
+	{ STAT_ITEM_P99,	"p99" },
+	{ STAT_ITEM_MAX,	"max" },
+	{ STAT_ITEM_COUNT,	"count" },
+	{ 0, NULL }
+};
+
+static int get_stat_item_value(const struct osmo_stat_item *item, int field, int64_t *value)
+{
+	if (field == STAT_ITEM_LAST) {
+		*value = osmo_stat_item_get_last(item);
+		return 0;
+	}
+
+	if (!item->hist)
+		return -EINVAL;
+
+	switch (field) {
+	case STAT_ITEM_P50:
+		*value = osmo_stat_hist_percentile(item->hist, 50);
+		break;
+	case STAT_ITEM_P90:
+		*value = osmo_stat_hist_percentile(item->hist, 90);
+		break;
+	case STAT_ITEM_P99:
+		*value = osmo_stat_hist_percentile(item->hist, 99);
+		break;
+	case STAT_ITEM_MAX:
+		*value = item->hist->max;
+		break;
+	case STAT_ITEM_COUNT:
+		*value = item->hist->count;
+		break;
+	}
+	return 0;
+}
+
+static int get_stat_item_group_idx(const struct osmo_stat_item_group *statg, int field, struct ctrl_cmd *cmd)
+{
+	unsigned int i;
+	int64_t value;
+
+	for (i = 0; i < statg->desc->num_items; i++) {
+		if (get_stat_item_value(statg->items[i], field, &value))
+			continue;
+		ctrl_cmd_reply_printf(cmd, "%s %"PRId64";", statg->desc->item_desc[i].name, value);
+		if (!cmd->reply) {
+			cmd->reply = "OOM";
+			return CTRL_CMD_ERROR;
+		}
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
+CTRL_CMD_DEFINE_RO(stat_item, "stat_item *");
+static int get_stat_item(struct ctrl_cmd *cmd, void *data)
+{
+	int field;
+	unsigned int idx;
+	char *statg_name, *statg_idx, *tmp, *dup, *saveptr, *field_name;
+	struct osmo_stat_item_group *statg;
+	const struct osmo_stat_item *item;
+	int64_t value;
+
+	dup = talloc_strdup(cmd, cmd->variable);
+	if (!dup)
+		goto oom;
+
+	/* Skip over possible prefixes (net.) */
+	tmp = strstr(dup, "stat_item");
+	if (!tmp) {
+		talloc_free(dup);
+		cmd->reply = "stat_item not a token in stat_item command!";
+		goto err;
+	}
+
+	strtok_r(tmp, ".", &saveptr);
+	field_name = strtok_r(NULL, ".", &saveptr);
+	field = field_name ? get_string_value(stat_item_field_names, field_name) : -EINVAL;
+	if (field < 0) {
+		talloc_free(dup);
+		cmd->reply = "Wrong field. Expecting 'last', 'p50', 'p90', 'p99', 'max' or 'count' value.";
+		goto err;
+	}
+
+	statg_name = strtok_r(NULL, ".", &saveptr);
+	statg_idx = strtok_r(NULL, ".", &saveptr);
+	if (!statg_name || !statg_idx) {
+		talloc_free(dup);
+		cmd->reply = "Stat item group must be of name.index form e. g. "
+			"bts.0";
+		goto err;
+	}
+
+	idx = atoi(statg_idx);
+
+	statg = osmo_stat_item_get_group_by_name_idx(statg_name, idx);
+	if (!statg) {
+		talloc_free(dup);
+		cmd->reply = "Stat item group with given name and index not found";
+		goto err;
+	}
+
+	if (!strlen(saveptr)) {
+		talloc_free(dup);
+		return get_stat_item_group_idx(statg, field, cmd);
+	}
+
+	item = osmo_stat_item_get_by_name(statg, saveptr);
+	talloc_free(dup);
+	if (!item) {
+		cmd->reply = "Stat item name not found.";
+		goto err;
+	}
+
+	if (get_stat_item_value(item, field, &value)) {
+		cmd->reply = "Stat item has no histogram.";
+		goto err;
+	}
+
+	cmd->reply = talloc_asprintf(cmd, "%"PRId64, value);
+	if (!cmd->reply)
+		goto oom;
+
+	return CTRL_CMD_REPLY;
+oom:
+	cmd->reply = "OOM";
+err:
+	return CTRL_CMD_ERROR;
+}
+
 /* counter */
 CTRL_CMD_DEFINE(counter, "counter *");
 static int get_counter(struct ctrl_cmd *cmd, void *data)
@@ -806,6 +1014,9 @@ static int ctrl_init(unsigned int node_count)
 	if (ret)
 		goto err_vec;
 	ret = ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_counter);
+	if (ret)
+		goto err_vec;
+	ret = ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_stat_item);
 	if (ret)
 		goto err_vec;
 
@@ -117,7 +117,7 @@ static int get_fsm_inst_timer(struct ctrl_cmd *cmd, void *data)
 		cmd->reply = "No such FSM found";
 		return CTRL_CMD_ERROR;
 	}
-	if (osmo_timer_remaining(&fi->timer, NULL, &remaining) < 0)
+	if (osmo_fsm_inst_timer_remaining(fi, &remaining) < 0)
 		cmd->reply = "0,0,0";
 	else
 		cmd->reply = talloc_asprintf(cmd, "%u,%ld,%ld", fi->T, remaining.tv_sec, remaining.tv_usec);
@@ -146,7 +146,7 @@ static int get_fsm_inst_dump(struct ctrl_cmd *cmd, void *data)
 	if (fi->T) {
 		struct timeval remaining;
 		int rc;
-		rc = osmo_timer_remaining(&fi->timer, NULL, &remaining);
+		rc = osmo_fsm_inst_timer_remaining(fi, &remaining);
 		if (rc == 0) {
 			cmd->reply = talloc_asprintf_append(cmd->reply, ",timeout_sec=%ld,timeout_usec=%ld",
 							    remaining.tv_sec, remaining.tv_usec);
@@ -0,0 +1,91 @@
+/*! \file gsmtap_ctrl_commands.c
+ * Configure the source filter of a GSMTAP instance from the control interface. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/ctrl/control_cmd.h>
+#include <osmocom/ctrl/control_if.h>
+#include <osmocom/ctrl/gsmtap_ctrl_commands.h>
+
+/*! GSMTAP instance as set by gsmtap_ctrl_cmds_install() */
+static struct gsmtap_inst *ctrl_gti;
+
+CTRL_CMD_DEFINE(gsmtap_filter, "gsmtap-filter");
+static int get_gsmtap_filter(struct ctrl_cmd *cmd, void *data)
+{
+	char buf[256];
+
+	if (!ctrl_gti->filter) {
+		cmd->reply = "none";
+		return CTRL_CMD_REPLY;
+	}
+
+	gsmtap_filter_to_str_buf(buf, sizeof(buf), ctrl_gti->filter);
+	cmd->reply = talloc_strdup(cmd, buf);
+	if (!cmd->reply) {
+		cmd->reply = "OOM";
+		return CTRL_CMD_ERROR;
+	}
+	return CTRL_CMD_REPLY;
+}
+
+static int set_gsmtap_filter(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsmtap_filter flt;
+
+	if (!strcmp(cmd->value, "none")) {
+		gsmtap_inst_set_filter(ctrl_gti, NULL);
+		return get_gsmtap_filter(cmd, data);
+	}
+
+	/* verified by verify_gsmtap_filter() */
+	gsmtap_filter_parse(&flt, cmd->value);
+	if (gsmtap_inst_set_filter(ctrl_gti, &flt) < 0) {
+		cmd->reply = "OOM";
+		return CTRL_CMD_ERROR;
+	}
+	return get_gsmtap_filter(cmd, data);
+}
+
+static int verify_gsmtap_filter(struct ctrl_cmd *cmd, const char *value, void *data)
+{
+	struct gsmtap_filter flt;
+
+	if (!strcmp(value, "none"))
+		return 0;
+	if (gsmtap_filter_parse(&flt, value) < 0) {
+		cmd->reply = "Invalid GSMTAP filter";
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*! Install the CTRL command 'gsmtap-filter' for the source filter of a GSMTAP instance.
+ *  \param[in] gti GSMTAP instance to configure.
+ *  \returns 0 on success; -EEXIST if already installed; negative on other errors
+ *
+ *  GET returns the filter in the format of \ref gsmtap_filter_parse or "none";
+ *  SET takes such a filter or "none" to remove it. Call this after the control
+ *  interface was set up. Only a single GSMTAP instance is supported. */
+int gsmtap_ctrl_cmds_install(struct gsmtap_inst *gti)
+{
+	int rc;
+
+	if (ctrl_gti)
+		return -EEXIST;
+
+	rc = ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_gsmtap_filter);
+	if (rc == 0)
+		ctrl_gti = gti;
+	return rc;
+}
@@ -30,6 +30,9 @@
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/stat_item.h>
 
 /*! \addtogroup fsm
  *  @{
@@ -199,9 +202,155 @@ static void osmo_fsm_defer_free(void *talloc_object)
 	talloc_steal(fsm_term_safely.collect_ctx, talloc_object);
 }
 
+/* Hash index of FSM instances, keyed by the FSM and a string (id or name).
+ * Buckets are doubled whenever the average chain length exceeds two, so that
+ * lookups stay O(1) with hundreds of thousands of instances. */
+struct fsm_inst_index {
+	struct llist_head *buckets;
+	unsigned int bits;
+	unsigned int count;
+};
+
+#define FSM_INST_INDEX_MIN_BITS	6
+
+static struct fsm_inst_index fsm_inst_by_id;
+static struct fsm_inst_index fsm_inst_by_name;
+
+/* FNV-1a over the string, seeded with the FSM descriptor */
+static uint32_t fsm_inst_hash(const struct osmo_fsm *fsm, const char *str)
+{
+	uintptr_t p = (uintptr_t)fsm;
+	uint32_t h = 2166136261u ^ (uint32_t)(p ^ (p >> 16 >> 16));
+
+	while (*str) {
+		h ^= (uint8_t)*str++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static struct llist_head *fsm_inst_index_bucket(const struct fsm_inst_index *idx, uint32_t hash)
+{
+	return &idx->buckets[hash & ((1u << idx->bits) - 1)];
+}
+
+static void fsm_inst_index_resize(struct fsm_inst_index *idx, unsigned int bits)
+{
+	struct llist_head *old = idx->buckets;
+	unsigned int old_bits = idx->bits;
+	struct osmo_fsm_inst_index_entry *e, *e2;
+	unsigned int i;
+
+	idx->buckets = talloc_array(NULL, struct llist_head, 1u << bits);
+	if (!idx->buckets) {
+		/* keep going with longer chains */
+		idx->buckets = old;
+		return;
+	}
+	talloc_set_name_const(idx->buckets, "fsm_inst_index");
+	idx->bits = bits;
+	for (i = 0; i < (1u << bits); i++)
+		INIT_LLIST_HEAD(&idx->buckets[i]);
+
+	if (!old)
+		return;
+	for (i = 0; i < (1u << old_bits); i++) {
+		llist_for_each_entry_safe(e, e2, &old[i], list) {
+			llist_del(&e->list);
+			llist_add_tail(&e->list, fsm_inst_index_bucket(idx, e->hash));
+		}
+	}
+	talloc_free(old);
+}
+
+static void fsm_inst_index_add(struct fsm_inst_index *idx, struct osmo_fsm_inst_index_entry *e,
+			       const struct osmo_fsm *fsm, const char *key)
+{
+	if (!idx->buckets)
+		fsm_inst_index_resize(idx, FSM_INST_INDEX_MIN_BITS);
+	else if (idx->count > (2u << idx->bits))
+		fsm_inst_index_resize(idx, idx->bits + 1);
+	if (!idx->buckets)
+		return;
+
+	e->hash = fsm_inst_hash(fsm, key);
+	llist_add(&e->list, fsm_inst_index_bucket(idx, e->hash));
+	idx->count++;
+}
+
+static void fsm_inst_index_del(struct fsm_inst_index *idx, struct osmo_fsm_inst_index_entry *e)
+{
+	if (llist_empty(&e->list))
+		return;
+	llist_del_init(&e->list);
+	idx->count--;
+}
+
+/* (re-)insert fi into both indexes according to its current id and name */
+static void fsm_inst_index(struct osmo_fsm_inst *fi)
+{
+	fsm_inst_index_del(&fsm_inst_by_id, &fi->index_id);
+	fsm_inst_index_del(&fsm_inst_by_name, &fi->index_name);
+	if (fi->id)
+		fsm_inst_index_add(&fsm_inst_by_id, &fi->index_id, fi->fsm, fi->id);
+	if (fi->name)
+		fsm_inst_index_add(&fsm_inst_by_name, &fi->index_name, fi->fsm, fi->name);
+}
+
+static void fsm_inst_unindex(struct osmo_fsm_inst *fi)
+{
+	fsm_inst_index_del(&fsm_inst_by_id, &fi->index_id);
+	fsm_inst_index_del(&fsm_inst_by_name, &fi->index_name);
+}
+
+/* Registered FSMs by name, open addressing with linear probing; rebuilt
+ * whenever an FSM is registered or unregistered. */
+static struct {
+	struct osmo_fsm **slots;
+	unsigned int size;
+} fsm_by_name;
+
+static void fsm_by_name_rebuild(void)
+{
+	struct osmo_fsm *fsm;
+	unsigned int num = 0, size = 16;
+
+	llist_for_each_entry(fsm, &osmo_g_fsms, list)
+		num++;
+	while (size < 2 * num)
+		size <<= 1;
+
+	talloc_free(fsm_by_name.slots);
+	fsm_by_name.size = 0;
+	fsm_by_name.slots = talloc_zero_array(NULL, struct osmo_fsm *, size);
+	if (!fsm_by_name.slots)
+		return;
+	talloc_set_name_const(fsm_by_name.slots, "fsm_by_name");
+	fsm_by_name.size = size;
+
+	llist_for_each_entry(fsm, &osmo_g_fsms, list) {
+		unsigned int i = fsm_inst_hash(NULL, fsm->name) & (size - 1);
+		while (fsm_by_name.slots[i])
+			i = (i + 1) & (size - 1);
+		fsm_by_name.slots[i] = fsm;
+	}
+}
+
 struct osmo_fsm *osmo_fsm_find_by_name(const char *name)
 {
 	struct osmo_fsm *fsm;
+	unsigned int i;
+
+	if (fsm_by_name.size) {
+		i = fsm_inst_hash(NULL, name) & (fsm_by_name.size - 1);
+		while ((fsm = fsm_by_name.slots[i])) {
+			if (!strcmp(name, fsm->name))
+				return fsm;
+			i = (i + 1) & (fsm_by_name.size - 1);
+		}
+		return NULL;
+	}
+
 	llist_for_each_entry(fsm, &osmo_g_fsms, list) {
 		if (!strcmp(name, fsm->name))
 			return fsm;
@@ -212,15 +361,19 @@ struct osmo_fsm *osmo_fsm_find_by_name(const char *name)
 struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 						 const char *name)
 {
+	struct osmo_fsm_inst_index_entry *e;
 	struct osmo_fsm_inst *fi;
+	uint32_t hash;
 
-	if (!name)
+	if (!name || !fsm_inst_by_name.buckets)
 		return NULL;
 
-	llist_for_each_entry(fi, &fsm->instances, list) {
-		if (!fi->name)
+	hash = fsm_inst_hash(fsm, name);
+	llist_for_each_entry(e, fsm_inst_index_bucket(&fsm_inst_by_name, hash), list) {
+		if (e->hash != hash)
 			continue;
-		if (!strcmp(name, fi->name))
+		fi = container_of(e, struct osmo_fsm_inst, index_name);
+		if (fi->fsm == fsm && !strcmp(name, fi->name))
 			return fi;
 	}
 	return NULL;
@@ -229,10 +382,19 @@ struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 struct osmo_fsm_inst *osmo_fsm_inst_find_by_id(const struct osmo_fsm *fsm,
 						const char *id)
 {
+	struct osmo_fsm_inst_index_entry *e;
 	struct osmo_fsm_inst *fi;
+	uint32_t hash;
+
+	if (!id || !fsm_inst_by_id.buckets)
+		return NULL;
 
-	llist_for_each_entry(fi, &fsm->instances, list) {
-		if (!strcmp(id, fi->id))
+	hash = fsm_inst_hash(fsm, id);
+	llist_for_each_entry(e, fsm_inst_index_bucket(&fsm_inst_by_id, hash), list) {
+		if (e->hash != hash)
+			continue;
+		fi = container_of(e, struct osmo_fsm_inst, index_id);
+		if (fi->fsm == fsm && !strcmp(id, fi->id))
 			return fi;
 	}
 	return NULL;
@@ -241,7 +403,8 @@ struct osmo_fsm_inst *osmo_fsm_inst_find_by_id(const struct osmo_fsm *fsm,
 /*! register a FSM with the core
  *
  *  A FSM descriptor needs to be registered with the core before any
- *  instances can be created for it.
+ *  instances can be created for it. Its event_names are indexed by
+ *  osmo_value_string_index(), so they must not be modified afterwards.
  *
  *  \param[in] fsm Descriptor of Finite State Machine to be registered
  *  \returns 0 on success; negative on error
@@ -256,8 +419,12 @@ int osmo_fsm_register(struct osmo_fsm *fsm)
 		return -EEXIST;
 	if (fsm->event_names == NULL)
 		LOGP(DLGLOBAL, LOGL_ERROR, "FSM '%s' has no event names! Please fix!\n", fsm->name);
+	else
+		/* resolve event names by index instead of scanning the value_string */
+		osmo_value_string_index(fsm->event_names);
 	llist_add_tail(&fsm->list, &osmo_g_fsms);
 	INIT_LLIST_HEAD(&fsm->instances);
+	fsm_by_name_rebuild();
 
 	return 0;
 }
@@ -272,8 +439,11 @@ int osmo_fsm_register(struct osmo_fsm *fsm)
 void osmo_fsm_unregister(struct osmo_fsm *fsm)
 {
 	llist_del(&fsm->list);
+	fsm_by_name_rebuild();
 }
 
+static void fsm_evq_drop(struct osmo_fsm_inst *fi);
+
 /* small wrapper function around timer expiration (for logging) */
 static void fsm_tmr_cb(void *data)
 {
@@ -299,6 +469,169 @@ static void fsm_tmr_cb(void *data)
 	osmo_fsm_inst_term(fi, OSMO_FSM_TERM_TIMEOUT, &T);
 }
 
+
+/* Shared deadline queue for FSMs with coarse_timeouts: one bucket per second
+ * in a wheel, driven by a single osmo_timer.  Scheduling and cancelling a
+ * timeout are O(1) list operations instead of rbtree insert/erase. */
+#define FSM_TMO_SLOTS	64
+
+static struct {
+	bool initialized;
+	/* entries hashed by expiry second % FSM_TMO_SLOTS */
+	struct llist_head slot[FSM_TMO_SLOTS];
+	unsigned int num_entries;
+	/* last second that has been processed */
+	uint64_t cur_sec;
+	/* second for which timer is armed */
+	uint64_t armed_sec;
+	struct osmo_timer_list timer;
+} fsm_tmo;
+
+static uint64_t fsm_tmo_now_ms(void)
+{
+	struct timeval tv;
+	osmo_gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static uint64_t fsm_tmo_sec(const struct osmo_fsm_inst *fi)
+{
+	/* expire at the first full second at or after the deadline */
+	return (fi->coarse_timer.deadline_ms + 999) / 1000;
+}
+
+static void fsm_tmo_arm(void)
+{
+	uint64_t s, now_ms, due_ms;
+
+	if (!fsm_tmo.num_entries) {
+		osmo_timer_del(&fsm_tmo.timer);
+		return;
+	}
+
+	for (s = fsm_tmo.cur_sec + 1; s < fsm_tmo.cur_sec + FSM_TMO_SLOTS; s++) {
+		if (!llist_empty(&fsm_tmo.slot[s % FSM_TMO_SLOTS]))
+			break;
+	}
+
+	if (osmo_timer_pending(&fsm_tmo.timer) && fsm_tmo.armed_sec == s)
+		return;
+
+	now_ms = fsm_tmo_now_ms();
+	due_ms = s * 1000 > now_ms ? s * 1000 - now_ms : 0;
+	fsm_tmo.armed_sec = s;
+	osmo_timer_schedule(&fsm_tmo.timer, due_ms / 1000, (due_ms % 1000) * 1000);
+}
+
+static void fsm_tmo_timer_cb(void *data)
+{
+	struct osmo_fsm_inst *fi, *fi2;
+	uint64_t now_sec, s, last;
+	LLIST_HEAD(due);
+
+	now_sec = fsm_tmo_now_ms() / 1000;
+
+	/* collect what expired since the last run; a wheel revolution covers
+	 * all buckets, entries further in the future stay where they are */
+	last = OSMO_MIN(now_sec, fsm_tmo.cur_sec + FSM_TMO_SLOTS);
+	for (s = fsm_tmo.cur_sec + 1; s <= last; s++) {
+		llist_for_each_entry_safe(fi, fi2, &fsm_tmo.slot[s % FSM_TMO_SLOTS], coarse_timer.list) {
+			if (fsm_tmo_sec(fi) > now_sec)
+				continue;
+			llist_del(&fi->coarse_timer.list);
+			llist_add_tail(&fi->coarse_timer.list, &due);
+		}
+	}
+	if (now_sec > fsm_tmo.cur_sec)
+		fsm_tmo.cur_sec = now_sec;
+
+	/* a timeout may free other instances in the due list, which removes
+	 * them from it, so always take the first one */
+	while (!llist_empty(&due)) {
+		fi = llist_first_entry(&due, struct osmo_fsm_inst, coarse_timer.list);
+		llist_del_init(&fi->coarse_timer.list);
+		fsm_tmo.num_entries--;
+		fsm_tmr_cb(fi);
+	}
+
+	fsm_tmo_arm();
+}
+
+/* stop the state timeout of fi, whichever engine it is running on */
+static void fsm_timer_del(struct osmo_fsm_inst *fi)
+{
+	osmo_timer_del(&fi->timer);
+	if (!llist_empty(&fi->coarse_timer.list)) {
+		llist_del_init(&fi->coarse_timer.list);
+		fsm_tmo.num_entries--;
+	}
+}
+
+static bool fsm_timer_pending(struct osmo_fsm_inst *fi)
+{
+	return osmo_timer_pending(&fi->timer) || !llist_empty(&fi->coarse_timer.list);
+}
+
+static int fsm_timer_remaining(struct osmo_fsm_inst *fi, struct timeval *remaining)
+{
+	uint64_t now_ms, left_ms;
+
+	if (llist_empty(&fi->coarse_timer.list))
+		return osmo_timer_remaining(&fi->timer, NULL, remaining);
+
+	now_ms = fsm_tmo_now_ms();
+	left_ms = fi->coarse_timer.deadline_ms > now_ms ? fi->coarse_timer.deadline_ms - now_ms : 0;
+	remaining->tv_sec = left_ms / 1000;
+	remaining->tv_usec = (left_ms % 1000) * 1000;
+	return 0;
+}
+
+/*! Determine the time remaining until the timeout of an FSM instance
+ *  \param[in] fi FSM instance
+ *  \param[out] remaining remaining time until the timeout fires
+ *  \returns 0 if a timeout is pending; -1 otherwise
+ *
+ *  Unlike osmo_timer_remaining() on \a fi->timer, this also covers the
+ *  timeouts of FSMs with \ref osmo_fsm.coarse_timeouts set. */
+int osmo_fsm_inst_timer_remaining(struct osmo_fsm_inst *fi, struct timeval *remaining)
+{
+	if (!fsm_timer_pending(fi))
+		return -1;
+	return fsm_timer_remaining(fi, remaining);
+}
+
+static void fsm_timer_schedule(struct osmo_fsm_inst *fi, unsigned long timeout_ms)
+{
+	unsigned int i;
+	uint64_t sec;
+
+	if (!fi->fsm->coarse_timeouts) {
+		osmo_timer_schedule(&fi->timer, timeout_ms / 1000, (timeout_ms % 1000) * 1000);
+		return;
+	}
+
+	if (!fsm_tmo.initialized) {
+		for (i = 0; i < FSM_TMO_SLOTS; i++)
+			INIT_LLIST_HEAD(&fsm_tmo.slot[i]);
+		osmo_timer_setup(&fsm_tmo.timer, fsm_tmo_timer_cb, NULL);
+		fsm_tmo.initialized = true;
+	}
+
+	fsm_timer_del(fi);
+	if (!fsm_tmo.num_entries)
+		fsm_tmo.cur_sec = fsm_tmo_now_ms() / 1000;
+
+	fi->coarse_timer.deadline_ms = fsm_tmo_now_ms() + timeout_ms;
+	sec = fsm_tmo_sec(fi);
+	if (sec <= fsm_tmo.cur_sec)
+		sec = fsm_tmo.cur_sec + 1;
+	llist_add_tail(&fi->coarse_timer.list, &fsm_tmo.slot[sec % FSM_TMO_SLOTS]);
+	fsm_tmo.num_entries++;
+
+	if (!osmo_timer_pending(&fsm_tmo.timer) || sec < fsm_tmo.armed_sec)
+		fsm_tmo_arm();
+}
+
 /*! Change id of the FSM instance
  * \param[in] fi FSM instance
  * \param[in] id new ID
@@ -347,6 +680,12 @@ int osmo_fsm_inst_update_id_f(struct osmo_fsm_inst *fi, const char *fmt, ...)
 		id = talloc_vasprintf(fi, fmt, ap);
 		va_end(ap);
 
+		/* same id as before: name and indexes stay as they are */
+		if (fi->id && id && !strcmp(id, fi->id)) {
+			talloc_free(id);
+			return 0;
+		}
+
 		if (!osmo_identifier_valid(id)) {
 			LOGP(DLGLOBAL, LOGL_ERROR,
 			     "Attempting to set illegal id for FSM instance of type '%s': %s\n",
@@ -361,6 +700,9 @@ int osmo_fsm_inst_update_id_f(struct osmo_fsm_inst *fi, const char *fmt, ...)
 	fi->id = id;
 
 	update_name(fi);
+	/* during osmo_fsm_inst_alloc(), indexing happens once fi is complete */
+	if (!llist_empty(&fi->index_name.list))
+		fsm_inst_index(fi);
 	return 0;
 }
 
@@ -410,6 +752,9 @@ struct osmo_fsm_inst *osmo_fsm_inst_alloc(struct osmo_fsm *fsm, void *ctx, void
 	fi->priv = priv;
 	fi->log_level = log_level;
 	osmo_timer_setup(&fi->timer, fsm_tmr_cb, fi);
+	INIT_LLIST_HEAD(&fi->coarse_timer.list);
+	INIT_LLIST_HEAD(&fi->index_id.list);
+	INIT_LLIST_HEAD(&fi->index_name.list);
 
 	if (osmo_fsm_inst_update_id(fi, id) < 0) {
 			talloc_free(fi);
@@ -419,6 +764,7 @@ struct osmo_fsm_inst *osmo_fsm_inst_alloc(struct osmo_fsm *fsm, void *ctx, void
 	INIT_LLIST_HEAD(&fi->proc.children);
 	INIT_LLIST_HEAD(&fi->proc.child);
 	llist_add(&fi->list, &fsm->instances);
+	fsm_inst_index(fi);
 
 	LOGPFSM(fi, "Allocated\n");
 
@@ -502,8 +848,10 @@ void osmo_fsm_inst_change_parent(struct osmo_fsm_inst *fi,
  */
 void osmo_fsm_inst_free(struct osmo_fsm_inst *fi)
 {
-	osmo_timer_del(&fi->timer);
+	fsm_timer_del(fi);
 	llist_del(&fi->list);
+	fsm_inst_unindex(fi);
+	fsm_evq_drop(fi);
 
 	if (fsm_term_safely.depth) {
 		/* Another FSM instance has caused this one to free and is still busy with its termination. Don't free
@@ -602,51 +950,54 @@ static int state_chg(struct osmo_fsm_inst *fi, uint32_t new_state,
 
 	if (!keep_timer) {
 		/* delete the old timer */
-		osmo_timer_del(&fi->timer);
+		fsm_timer_del(fi);
 	}
 
 	if (st->onleave)
 		st->onleave(fi, new_state);
 
-	if (fsm_log_timeouts) {
-		char trailer[64];
-		trailer[0] = '\0';
-		if (keep_timer && fi->timer.active) {
-			/* This should always give us a timeout, but just in case the return value indicates error, omit
-			 * logging the remaining time. */
-			if (osmo_timer_remaining(&fi->timer, NULL, &remaining))
-				snprintf(trailer, sizeof(trailer), "(keeping " OSMO_T_FMT ")",
-					 OSMO_T_FMT_ARGS(fi->T));
-			else
-				snprintf(trailer, sizeof(trailer), "(keeping " OSMO_T_FMT
-					  ", %ld.%03lds remaining)", OSMO_T_FMT_ARGS(fi->T),
-					  remaining.tv_sec, remaining.tv_usec / 1000);
-		} else if (timeout_ms) {
-			if (timeout_ms % 1000 == 0)
-				/* keep log output legacy compatible to avoid autotest failures */
-				snprintf(trailer, sizeof(trailer), "(" OSMO_T_FMT ", %lus)",
-					   OSMO_T_FMT_ARGS(T), timeout_ms/1000);
-			else
-				snprintf(trailer, sizeof(trailer), "(" OSMO_T_FMT ", %lums)",
-					   OSMO_T_FMT_ARGS(T), timeout_ms);
-		} else
-			snprintf(trailer, sizeof(trailer), "(no timeout)");
-
-		LOGPFSMSRC(fi, file, line, "State change to %s %s\n",
-			   osmo_fsm_state_name(fsm, new_state), trailer);
-	} else {
-		LOGPFSMSRC(fi, file, line, "state_chg to %s\n",
-			   osmo_fsm_state_name(fsm, new_state));
+	/* don't format anything for an FSM instance that isn't logged */
+	if (log_check_level(fsm->log_subsys, fi->log_level)) {
+		if (fsm_log_timeouts) {
+			char trailer[64];
+			trailer[0] = '\0';
+			if (keep_timer && fsm_timer_pending(fi)) {
+				/* This should always give us a timeout, but just in case the return value indicates error, omit
+				 * logging the remaining time. */
+				if (fsm_timer_remaining(fi, &remaining))
+					snprintf(trailer, sizeof(trailer), "(keeping " OSMO_T_FMT ")",
+						 OSMO_T_FMT_ARGS(fi->T));
+				else
+					snprintf(trailer, sizeof(trailer), "(keeping " OSMO_T_FMT
+						  ", %ld.%03lds remaining)", OSMO_T_FMT_ARGS(fi->T),
+						  remaining.tv_sec, remaining.tv_usec / 1000);
+			} else if (timeout_ms) {
+				if (timeout_ms % 1000 == 0)
+					/* keep log output legacy compatible to avoid autotest failures */
+					snprintf(trailer, sizeof(trailer), "(" OSMO_T_FMT ", %lus)",
+						   OSMO_T_FMT_ARGS(T), timeout_ms/1000);
+				else
+					snprintf(trailer, sizeof(trailer), "(" OSMO_T_FMT ", %lums)",
+						   OSMO_T_FMT_ARGS(T), timeout_ms);
+			} else
+				snprintf(trailer, sizeof(trailer), "(no timeout)");
+
+			LOGPFSMSRC(fi, file, line, "State change to %s %s\n",
+				   osmo_fsm_state_name(fsm, new_state), trailer);
+		} else {
+			LOGPFSMSRC(fi, file, line, "state_chg to %s\n",
+				   osmo_fsm_state_name(fsm, new_state));
+		}
 	}
 
 	fi->state = new_state;
 	st = &fsm->states[new_state];
 
 	if (!keep_timer
-	    || (keep_timer && !osmo_timer_pending(&fi->timer))) {
+	    || (keep_timer && !fsm_timer_pending(fi))) {
 		fi->T = T;
 		if (timeout_ms)
-			osmo_timer_schedule(&fi->timer, timeout_ms / 1000, timeout_ms % 1000);
+			fsm_timer_schedule(fi, timeout_ms);
 	}
 
 	/* Call 'onenter' last, user might terminate FSM from there */
@@ -826,6 +1177,305 @@ int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data
 	return 0;
 }
 
+/* One event posted to an FSM instance, waiting in the deferred event queue */
+struct fsm_event {
+	struct llist_head list;
+	struct osmo_fsm_inst *fi;
+	uint32_t event;
+	void *data;
+	const char *file;
+	int line;
+	/* CLOCK_MONOTONIC time of posting (us) */
+	uint64_t posted_us;
+};
+
+/* Don't starve file descriptors and timers: the queue is served in chunks of
+ * this many events per select loop iteration */
+#define FSM_EVQ_BUDGET	1024
+
+static struct {
+	bool initialized;
+	void *ctx;
+	/* pending struct fsm_event, in the order they were posted */
+	struct llist_head queue;
+	/* recycled struct fsm_event records */
+	struct llist_head free;
+	unsigned int depth;
+	/* zero timeout timer to serve the queue from the select loop */
+	struct osmo_timer_list timer;
+	struct osmo_stat_item_group *statg;
+} fsm_evq;
+
+static const struct osmo_stat_hist_desc fsm_evq_latency_hist_desc = {
+	.max_value = 10000000,
+	.precision_bits = 3,
+};
+
+static const struct osmo_stat_item_desc fsm_evq_stat_desc[] = {
+	[OSMO_FSM_EVQ_STAT_DEPTH] = { "depth", "Queued FSM events            ", "", 16, 0 },
+	[OSMO_FSM_EVQ_STAT_LATENCY] = { "latency", "FSM event queuing latency    ", "us", 16, 0,
+					&fsm_evq_latency_hist_desc },
+};
+
+static const struct osmo_stat_item_group_desc fsm_evq_statg_desc = {
+	.group_name_prefix = "fsm.event_queue",
+	.group_description = "Deferred FSM event queue",
+	.num_items = ARRAY_SIZE(fsm_evq_stat_desc),
+	.item_desc = fsm_evq_stat_desc,
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+};
+
+static void fsm_evq_timer_cb(void *data)
+{
+	osmo_fsm_event_queue_run(FSM_EVQ_BUDGET);
+}
+
+static void fsm_evq_setup(void)
+{
+	if (fsm_evq.initialized)
+		return;
+	INIT_LLIST_HEAD(&fsm_evq.queue);
+	INIT_LLIST_HEAD(&fsm_evq.free);
+	osmo_timer_setup(&fsm_evq.timer, fsm_evq_timer_cb, NULL);
+	fsm_evq.initialized = true;
+}
+
+static uint64_t fsm_evq_now_us(void)
+{
+	struct timespec ts;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fsm_evq_stat_depth(void)
+{
+	if (fsm_evq.statg)
+		osmo_stat_item_set(fsm_evq.statg->items[OSMO_FSM_EVQ_STAT_DEPTH], fsm_evq.depth);
+}
+
+static void fsm_evq_release(struct fsm_event *ev)
+{
+	llist_del(&ev->list);
+	llist_add(&ev->list, &fsm_evq.free);
+	fsm_evq.depth--;
+}
+
+/* drop all events still queued for fi, which is going away */
+static void fsm_evq_drop(struct osmo_fsm_inst *fi)
+{
+	struct fsm_event *ev, *ev2;
+
+	if (!fi->pending_events)
+		return;
+	llist_for_each_entry_safe(ev, ev2, &fsm_evq.queue, list) {
+		if (ev->fi != fi)
+			continue;
+		LOGPFSMSRC(fi, ev->file, ev->line, "Dropping queued Event %s\n",
+			   osmo_fsm_event_name(fi->fsm, ev->event));
+		fsm_evq_release(ev);
+		if (!--fi->pending_events)
+			break;
+	}
+	fsm_evq_stat_depth();
+}
+
+/*! Set up the deferred FSM event queue
+ *
+ *  Calling this is optional: the queue is set up on first use of
+ *  osmo_fsm_inst_post().  Doing it explicitly allows to preallocate event
+ *  records and enables the queue depth and latency statistics.
+ *
+ *  \param[in] ctx talloc context for event records and statistics
+ *  \param[in] num_prealloc number of event records to preallocate
+ *  \returns 0 on success; negative on error
+ */
+int osmo_fsm_event_queue_init(void *ctx, unsigned int num_prealloc)
+{
+	unsigned int i;
+
+	fsm_evq_setup();
+	fsm_evq.ctx = ctx;
+
+	if (!fsm_evq.statg) {
+		fsm_evq.statg = osmo_stat_item_group_alloc(ctx, &fsm_evq_statg_desc, 0);
+		if (!fsm_evq.statg)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < num_prealloc; i++) {
+		struct fsm_event *ev = talloc_zero(ctx, struct fsm_event);
+		if (!ev)
+			return -ENOMEM;
+		llist_add(&ev->list, &fsm_evq.free);
+	}
+	return 0;
+}
+
+/* take num records from the free list (allocating where needed) into list */
+static int fsm_evq_get_records(struct llist_head *list, unsigned int num)
+{
+	struct fsm_event *ev;
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (!llist_empty(&fsm_evq.free)) {
+			ev = llist_first_entry(&fsm_evq.free, struct fsm_event, list);
+			llist_del(&ev->list);
+		} else {
+			ev = talloc_zero(fsm_evq.ctx, struct fsm_event);
+			if (!ev) {
+				llist_splice_init(list, &fsm_evq.free);
+				return -ENOMEM;
+			}
+		}
+		llist_add_tail(&ev->list, list);
+	}
+	return 0;
+}
+
+/*! post the same event to several FSM instances via the deferred event queue
+ *
+ *  Best invoke via the osmo_fsm_inst_post_batch() macro. Event records for all
+ *  instances are reserved at once, so either all or none of the events are
+ *  posted.
+ *
+ *  \param[in] fis array of FSM instances
+ *  \param[in] num_fi number of entries in \a fis
+ *  \param[in] event Event to send to the FSM instances
+ *  \param[in] data Data to pass along with the event
+ *  \param[in] file Calling source file (from osmo_fsm_inst_post_batch macro)
+ *  \param[in] line Calling source line (from osmo_fsm_inst_post_batch macro)
+ *  \returns 0 in case of success; negative on error
+ */
+int _osmo_fsm_inst_post_batch(struct osmo_fsm_inst * const *fis, unsigned int num_fi,
+			      uint32_t event, void *data, const char *file, int line)
+{
+	LLIST_HEAD(batch);
+	struct fsm_event *ev;
+	uint64_t now_us;
+	unsigned int i = 0;
+
+	for (i = 0; i < num_fi; i++) {
+		if (!fis[i]) {
+			LOGPSRC(DLGLOBAL, LOGL_ERROR, file, line,
+				"Trying to post event %"PRIu32" to non-existent"
+				" FSM instance!\n", event);
+			return -ENODEV;
+		}
+	}
+
+	fsm_evq_setup();
+	if (fsm_evq_get_records(&batch, num_fi) < 0)
+		return -ENOMEM;
+
+	now_us = fsm_evq_now_us();
+	i = 0;
+	llist_for_each_entry(ev, &batch, list) {
+		ev->fi = fis[i++];
+		ev->event = event;
+		ev->data = data;
+		ev->file = file;
+		ev->line = line;
+		ev->posted_us = now_us;
+		ev->fi->pending_events++;
+	}
+
+	/* append the batch at the tail of the queue */
+	llist_splice_init(&batch, fsm_evq.queue.prev);
+	fsm_evq.depth += num_fi;
+	fsm_evq_stat_depth();
+
+	if (!osmo_timer_pending(&fsm_evq.timer))
+		osmo_timer_schedule(&fsm_evq.timer, 0, 0);
+	return 0;
+}
+
+/*! post an event to an FSM instance via the deferred event queue
+ *
+ *  Best invoke via the osmo_fsm_inst_post() macro.
+ *
+ *  Unlike osmo_fsm_inst_dispatch(), the event is not handled right away but
+ *  appended to a queue that is served from the select loop.  Each event runs
+ *  to completion before the next one is dispatched, in the order they were
+ *  posted; events that state actions post in turn are appended to the queue
+ *  instead of recursing.  Events for an instance that is freed in the
+ *  meantime are dropped.
+ *
+ *  \param[in] fi FSM instance
+ *  \param[in] event Event to send to FSM instance
+ *  \param[in] data Data to pass along with the event
+ *  \param[in] file Calling source file (from osmo_fsm_inst_post macro)
+ *  \param[in] line Calling source line (from osmo_fsm_inst_post macro)
+ *  \returns 0 in case of success; negative on error
+ */
+int _osmo_fsm_inst_post(struct osmo_fsm_inst *fi, uint32_t event, void *data,
+			const char *file, int line)
+{
+	return _osmo_fsm_inst_post_batch(&fi, 1, event, data, file, line);
+}
+
+/*! dispatch events from the deferred FSM event queue
+ *
+ *  This is called from the select loop, but may also be invoked directly.
+ *
+ *  \param[in] max_events maximum number of events to dispatch, 0 for all
+ *	       (including those posted while running)
+ *  \returns number of dispatched events
+ */
+unsigned int osmo_fsm_event_queue_run(unsigned int max_events)
+{
+	struct fsm_event *ev;
+	unsigned int count = 0;
+
+	if (!fsm_evq.initialized)
+		return 0;
+
+	while (!llist_empty(&fsm_evq.queue) && (!max_events || count < max_events)) {
+		struct osmo_fsm_inst *fi;
+		uint32_t event;
+		void *data;
+		const char *file;
+		int line;
+
+		ev = llist_first_entry(&fsm_evq.queue, struct fsm_event, list);
+		fi = ev->fi;
+		event = ev->event;
+		data = ev->data;
+		file = ev->file;
+		line = ev->line;
+		if (fsm_evq.statg)
+			osmo_stat_item_set(fsm_evq.statg->items[OSMO_FSM_EVQ_STAT_LATENCY],
+					   fsm_evq_now_us() - ev->posted_us);
+
+		/* recycle the record first, the action may post new events */
+		fsm_evq_release(ev);
+		fi->pending_events--;
+		fsm_evq_stat_depth();
+
+		_osmo_fsm_inst_dispatch(fi, event, data, file, line);
+		count++;
+	}
+
+	if (!llist_empty(&fsm_evq.queue) && !osmo_timer_pending(&fsm_evq.timer))
+		osmo_timer_schedule(&fsm_evq.timer, 0, 0);
+
+	return count;
+}
+
+/*! \returns number of events in the deferred FSM event queue */
+unsigned int osmo_fsm_event_queue_depth(void)
+{
+	return fsm_evq.depth;
+}
+
+/*! \returns statistics of the deferred FSM event queue (see enum
+ *  osmo_fsm_event_queue_stat), NULL unless osmo_fsm_event_queue_init() was
+ *  called */
+struct osmo_stat_item_group *osmo_fsm_event_queue_statg(void)
+{
+	return fsm_evq.statg;
+}
+
 /*! Terminate FSM instance with given cause
  *
  *  This safely terminates the given FSM instance by first iterating
@@ -15,6 +15,7 @@ int gprs_sns_init(void);
 /* gprs_ns.c */
 void gprs_nsvc_start_test(struct gprs_nsvc *nsvc);
 void gprs_start_alive_all_nsvcs(struct gprs_ns_inst *nsi);
+void gprs_ns_cache_flush(struct gprs_ns_inst *nsi);
 int gprs_ns_tx_sns_ack(struct gprs_nsvc *nsvc, uint8_t trans_id, uint8_t *cause,
 		       const struct gprs_ns_ie_ip4_elem *ip4_elems,unsigned int num_ip4_elems);
 
@@ -35,6 +35,7 @@
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/stats.h>
+#include <osmocom/core/stat_item.h>
 
 #include <osmocom/gprs/gprs_bssgp.h>
 #include <osmocom/gprs/gprs_bssgp_bss.h>
@@ -62,6 +63,26 @@ static const struct rate_ctr_group_desc bssgp_ctrg_desc = {
 	.class_id = OSMO_STATS_CLASS_PEER,
 };
 
+static const struct osmo_stat_hist_desc fc_delay_hist_desc = {
+	.max_value = 10000,
+	.precision_bits = 3,
+};
+
+static const struct osmo_stat_item_desc bssgp_stat_description[] = {
+	[BSSGP_STAT_FC_QUEUE_DEPTH] = { "fc.queue.depth", "BVC flow control queue length  ", "msgs", 16, 0 },
+	[BSSGP_STAT_FC_QUEUE_BYTES] = { "fc.queue.bytes", "BVC flow control queue size    ", "B", 16, 0 },
+	[BSSGP_STAT_FC_QUEUE_DELAY] = { "fc.queue.delay", "BVC flow control queuing delay ", "ms", 16, 0,
+					&fc_delay_hist_desc },
+};
+
+static const struct osmo_stat_item_group_desc bssgp_statg_desc = {
+	.group_name_prefix = "bssgp.bss_ctx",
+	.group_description = "BSSGP Peer Statistics",
+	.num_items = ARRAY_SIZE(bssgp_stat_description),
+	.item_desc = bssgp_stat_description,
+	.class_id = OSMO_STATS_CLASS_PEER,
+};
+
 LLIST_HEAD(bssgp_bvc_ctxts);
 
 static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
@@ -132,9 +153,16 @@ struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei)
 		talloc_free(ctx);
 		return NULL;
 	}
+	ctx->statg = osmo_stat_item_group_alloc(ctx, &bssgp_statg_desc, bvci);
+	if (!ctx->statg) {
+		rate_ctr_group_free(ctx->ctrg);
+		talloc_free(ctx);
+		return NULL;
+	}
 	ctx->fc = talloc_zero(ctx, struct bssgp_flow_control);
 	/* cofigure for 2Mbit, 30 packets in queue */
 	bssgp_fc_init(ctx->fc, 100000, 2*1024*1024/8, 30, &_bssgp_tx_dl_ud);
+	ctx->fc->statg = ctx->statg;
 
 	llist_add(&ctx->list, &bssgp_bvc_ctxts);
 
@@ -588,95 +616,253 @@ struct bssgp_fc_queue_element {
 	uint32_t llc_pdu_len;
 	/* private pointer passed to the flow control out_cb function */
 	void *priv;
+	/* time at which the PDU was enqueued (microseconds) */
+	uint64_t enqueued_us;
 };
 
-static int fc_queue_timer_cfg(struct bssgp_flow_control *fc);
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len);
+/* All flow control instances with a non-empty queue are kept in one
+ * hashed timer wheel, keyed by the tick at which the first PDU of their
+ * queue may be sent.  Only a single osmo_timer is running, no matter
+ * how many MS are being flow controlled. */
+#define FC_SCHED_TICK_US	10000
+#define FC_SCHED_SLOTS		256
+
+static struct {
+	bool initialized;
+	/* entries hashed by sched_tick % FC_SCHED_SLOTS */
+	struct llist_head slot[FC_SCHED_SLOTS];
+	/* number of flow control instances in the wheel */
+	unsigned int num_entries;
+	/* last tick that has been processed */
+	uint64_t cur_tick;
+	/* tick for which timer has been armed */
+	uint64_t armed_tick;
+	struct osmo_timer_list timer;
+} fc_sched;
+
+static void fc_sched_timer_cb(void *data);
+
+static uint64_t fc_time_us(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
 
-static void fc_timer_cb(void *data)
+static uint64_t fc_now_us(void)
 {
-	struct bssgp_flow_control *fc = data;
-	struct bssgp_fc_queue_element *fcqe;
-	struct timeval time_now;
+	struct timeval tv;
+	osmo_gettimeofday(&tv, NULL);
+	return fc_time_us(&tv);
+}
 
-	/* if the queue is empty, we return without sending something
-	 * and without re-starting the timer */
-	if (llist_empty(&fc->queue))
+static void fc_stat_set(struct bssgp_flow_control *fc, unsigned int idx, int32_t value)
+{
+	if (fc->statg)
+		osmo_stat_item_set(fc->statg->items[idx], value);
+}
+
+/* (re-)arm the scheduler timer for the next non-empty slot of the wheel */
+static void fc_sched_arm(void)
+{
+	uint64_t t, now_us, due_us;
+
+	if (!fc_sched.num_entries) {
+		osmo_timer_del(&fc_sched.timer);
 		return;
+	}
 
-	/* get the first entry from the queue */
-	fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
-			   list);
+	for (t = fc_sched.cur_tick + 1; t <= fc_sched.cur_tick + FC_SCHED_SLOTS; t++) {
+		if (!llist_empty(&fc_sched.slot[t % FC_SCHED_SLOTS]))
+			break;
+	}
 
-	if (bssgp_fc_needs_queueing(fc, fcqe->llc_pdu_len)) {
-		LOGP(DBSSGP, LOGL_NOTICE, "BSSGP-FC: fc_timer_cb() but still "
-			"not able to send PDU of %u bytes\n", fcqe->llc_pdu_len);
-		/* make sure we re-start the timer */
-		fc_queue_timer_cfg(fc);
+	if (osmo_timer_pending(&fc_sched.timer) && fc_sched.armed_tick == t)
 		return;
+
+	now_us = fc_now_us();
+	due_us = t * FC_SCHED_TICK_US;
+	due_us = due_us > now_us ? due_us - now_us : 0;
+	fc_sched.armed_tick = t;
+	osmo_timer_schedule(&fc_sched.timer, due_us / 1000000, due_us % 1000000);
+}
+
+static void fc_sched_del(struct bssgp_flow_control *fc)
+{
+	if (llist_empty(&fc->sched_list))
+		return;
+	llist_del_init(&fc->sched_list);
+	fc_sched.num_entries--;
+}
+
+static void fc_sched_add(struct bssgp_flow_control *fc, uint64_t tick)
+{
+	unsigned int i;
+
+	if (!fc_sched.initialized) {
+		for (i = 0; i < FC_SCHED_SLOTS; i++)
+			INIT_LLIST_HEAD(&fc_sched.slot[i]);
+		osmo_timer_setup(&fc_sched.timer, fc_sched_timer_cb, NULL);
+		fc_sched.initialized = true;
 	}
 
-	/* remove from the queue */
-	llist_del(&fcqe->list);
+	if (!fc_sched.num_entries)
+		fc_sched.cur_tick = fc_now_us() / FC_SCHED_TICK_US;
+	if (tick <= fc_sched.cur_tick)
+		tick = fc_sched.cur_tick + 1;
 
-	fc->queue_depth--;
+	fc->sched_tick = tick;
+	llist_add_tail(&fc->sched_list, &fc_sched.slot[tick % FC_SCHED_SLOTS]);
+	fc_sched.num_entries++;
 
-	/* record the time we transmitted this PDU */
-	osmo_gettimeofday(&time_now, NULL);
-	fc->time_last_pdu = time_now;
+	if (!osmo_timer_pending(&fc_sched.timer) || tick < fc_sched.armed_tick)
+		fc_sched_arm();
+}
 
-	/* call the output callback for this FC instance */
-	fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+/* According to Section 8.2: if the PDU fits into the bucket, account for
+ * it and return 0, otherwise return 1 */
+static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len)
+{
+	struct timeval time_now, time_diff;
+	uint64_t leaked = 0, level;
 
-	/* we expect that out_cb will in the end free the msgb once
-	 * it is no longer needed */
+	/* B' = B + L(p) - (Tc - Tp)*R */
 
-	/* but we have to free the queue element ourselves */
-	talloc_free(fcqe);
+	/* compute number of octets that have leaked since transmitting the
+	 * last PDU (Tc - Tp)*R, in integer arithmetic and without overflow */
+	osmo_gettimeofday(&time_now, NULL);
+	timersub(&time_now, &fc->time_last_pdu, &time_diff);
+	if (time_diff.tv_sec >= 0) {
+		uint64_t secs = OSMO_MIN(time_diff.tv_sec, 1000000);
+		leaked = secs * fc->bucket_leak_rate +
+			 (uint64_t)time_diff.tv_usec * fc->bucket_leak_rate / 1000000;
+	}
+	level = fc->bucket_counter > leaked ? fc->bucket_counter - leaked : 0;
 
-	/* re-configure the timer for the next PDU */
-	fc_queue_timer_cfg(fc);
+	/* bucket is full, PDU needs to be delayed */
+	if (level + pdu_len > fc->bucket_size_max)
+		return 1;
+
+	/* the bucket is not full yet, we can pass the packet */
+	fc->bucket_counter = level + pdu_len;
+	fc->time_last_pdu = time_now;
+	return 0;
 }
 
-/* configure/schedule the flow control timer to expire once the bucket
- * will have leaked a sufficient number of bytes to transmit the next
- * PDU in the queue */
+/* put the flow control instance into the scheduler for the point in time
+ * at which the bucket will have leaked a sufficient number of bytes to
+ * transmit the first PDU in the queue */
 static int fc_queue_timer_cfg(struct bssgp_flow_control *fc)
 {
 	struct bssgp_fc_queue_element *fcqe;
-	uint32_t msecs;
+	uint64_t due_us, need;
+
+	fc_sched_del(fc);
 
 	if (llist_empty(&fc->queue))
 		return 0;
 
+	/* If the PCU is telling us to not send any more data at all,
+	 * there's no point in scheduling anything. */
+	if (fc->bucket_leak_rate == 0)
+		return 0;
+
 	fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
 			   list);
 
-	if (fc->bucket_leak_rate != 0) {
-		/* Calculate the point in time at which we will have leaked
-		 * a sufficient number of bytes from the bucket to transmit
-		 * the first PDU in the queue */
-		msecs = (fcqe->llc_pdu_len * 1000) / fc->bucket_leak_rate;
-		/* FIXME: add that time to fc->time_last_pdu and subtract it from
-		 * current time */
-		osmo_timer_setup(&fc->timer, fc_timer_cb, fc);
-		osmo_timer_schedule(&fc->timer, msecs / 1000, (msecs % 1000) * 1000);
-	} else {
-		/* If the PCU is telling us to not send any more data at all,
-		* there's no point starting a timer. */
+	due_us = fc_time_us(&fc->time_last_pdu);
+	if (fc->bucket_counter + fcqe->llc_pdu_len > fc->bucket_size_max) {
+		need = fc->bucket_counter + fcqe->llc_pdu_len - fc->bucket_size_max;
+		due_us += (need * 1000000 + fc->bucket_leak_rate - 1) / fc->bucket_leak_rate;
 	}
 
+	/* the tick in which the PDU becomes due; should it still not fit when
+	 * the tick starts, it is simply re-scheduled for the next one */
+	fc_sched_add(fc, due_us / FC_SCHED_TICK_US);
+
 	return 0;
 }
 
+/* transmit as many PDUs from the queue as the bucket permits */
+static void fc_dequeue(struct bssgp_flow_control *fc)
+{
+	struct bssgp_fc_queue_element *fcqe;
+
+	while (!llist_empty(&fc->queue)) {
+		/* get the first entry from the queue */
+		fcqe = llist_entry(fc->queue.next, struct bssgp_fc_queue_element,
+				   list);
+
+		if (bssgp_fc_needs_queueing(fc, fcqe->llc_pdu_len))
+			break;
+
+		/* remove from the queue */
+		llist_del(&fcqe->list);
+		fc->queue_depth--;
+		fc->queue_bytes -= fcqe->llc_pdu_len;
+
+		if (fc->statg) {
+			fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_DEPTH, fc->queue_depth);
+			fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_BYTES, fc->queue_bytes);
+			fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_DELAY,
+				    (fc_time_us(&fc->time_last_pdu) - fcqe->enqueued_us) / 1000);
+		}
+
+		/* call the output callback for this FC instance */
+		fc->out_cb(fcqe->priv, fcqe->msg, fcqe->llc_pdu_len, NULL);
+
+		/* we expect that out_cb will in the end free the msgb once
+		 * it is no longer needed */
+
+		/* but we have to free the queue element ourselves */
+		talloc_free(fcqe);
+	}
+
+	/* re-schedule for the next PDU */
+	fc_queue_timer_cfg(fc);
+}
+
+static void fc_sched_timer_cb(void *data)
+{
+	struct bssgp_flow_control *fc, *tmp;
+	uint64_t now_tick, t, last;
+	LLIST_HEAD(due);
+
+	now_tick = fc_now_us() / FC_SCHED_TICK_US;
+
+	/* collect everything that has become due since the last run; after a
+	 * long stall, one revolution of the wheel covers all slots */
+	last = OSMO_MIN(now_tick, fc_sched.cur_tick + FC_SCHED_SLOTS);
+	for (t = fc_sched.cur_tick + 1; t <= last; t++) {
+		llist_for_each_entry_safe(fc, tmp, &fc_sched.slot[t % FC_SCHED_SLOTS], sched_list) {
+			if (fc->sched_tick > now_tick)
+				continue;
+			llist_del(&fc->sched_list);
+			llist_add_tail(&fc->sched_list, &due);
+		}
+	}
+	if (now_tick > fc_sched.cur_tick)
+		fc_sched.cur_tick = now_tick;
+
+	while (!llist_empty(&due)) {
+		fc = llist_entry(due.next, struct bssgp_flow_control, sched_list);
+		llist_del_init(&fc->sched_list);
+		fc_sched.num_entries--;
+		fc_dequeue(fc);
+	}
+
+	fc_sched_arm();
+}
+
 /* Enqueue a PDU in the flow control queue for delayed transmission */
 static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
 		      uint32_t llc_pdu_len, void *priv)
 {
 	struct bssgp_fc_queue_element *fcqe;
+	bool was_empty = llist_empty(&fc->queue);
 
 	if (fc->queue_depth >= fc->max_queue_depth)
 		return -ENOSPC;
+	if (fc->max_queue_bytes && fc->queue_bytes + llc_pdu_len > fc->max_queue_bytes)
+		return -ENOSPC;
 
 	fcqe = talloc_zero(fc, struct bssgp_fc_queue_element);
 	if (!fcqe)
@@ -684,51 +870,21 @@ static int fc_enqueue(struct bssgp_flow_control *fc, struct msgb *msg,
 	fcqe->msg = msg;
 	fcqe->llc_pdu_len = llc_pdu_len;
 	fcqe->priv = priv;
+	fcqe->enqueued_us = fc_now_us();
 
 	llist_add_tail(&fcqe->list, &fc->queue);
 
 	fc->queue_depth++;
+	fc->queue_bytes += llc_pdu_len;
 
-	/* re-configure the timer for dequeueing the pdu */
-	fc_queue_timer_cfg(fc);
-
-	return 0;
-}
-
-/* According to Section 8.2 */
-static int bssgp_fc_needs_queueing(struct bssgp_flow_control *fc, uint32_t pdu_len)
-{
-	struct timeval time_now, time_diff;
-	int64_t bucket_predicted;
-	uint32_t csecs_elapsed, leaked;
-
-	/* B' = B + L(p) - (Tc - Tp)*R */
-
-	/* compute number of centi-seconds that have elapsed since transmitting
-	 * the last PDU (Tc - Tp) */
-	osmo_gettimeofday(&time_now, NULL);
-	timersub(&time_now, &fc->time_last_pdu, &time_diff);
-	csecs_elapsed = time_diff.tv_sec*100 + time_diff.tv_usec/10000;
-
-	/* compute number of bytes that have leaked in the elapsed number
-	 * of centi-seconds */
-	leaked = csecs_elapsed * (fc->bucket_leak_rate / 100);
-	/* add the current PDU length to the last bucket level */
-	bucket_predicted = fc->bucket_counter + pdu_len;
-	/* ... and subtract the number of leaked bytes */
-	bucket_predicted -= leaked;
+	fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_DEPTH, fc->queue_depth);
+	fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_BYTES, fc->queue_bytes);
 
-	if (bucket_predicted < pdu_len)
-		return 0;
-
-	if (bucket_predicted <= fc->bucket_size_max) {
-		/* the bucket is not full yet, we can pass the packet */
-		fc->bucket_counter = bucket_predicted;
-		return 0;
-	}
+	/* only the head of the queue determines when to dequeue next */
+	if (was_empty)
+		fc_queue_timer_cfg(fc);
 
-	/* bucket is full, PDU needs to be delayed */
-	return 1;
+	return 0;
 }
 
 /* output callback for BVC flow control */
@@ -744,7 +900,7 @@ static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		uint32_t llc_pdu_len, void *priv)
 {
-	struct timeval time_now;
+	int rc;
 
 	if (llc_pdu_len > fc->bucket_size_max) {
 		LOGP(DBSSGP, LOGL_NOTICE, "Single PDU (size=%u) is larger "
@@ -754,18 +910,17 @@ int bssgp_fc_in(struct bssgp_flow_control *fc, struct msgb *msg,
 		return -EIO;
 	}
 
-	if (bssgp_fc_needs_queueing(fc, llc_pdu_len)) {
-		int rc;
+	/* keep the PDUs in order: as long as something is queued, the
+	 * scheduler takes care of the bucket */
+	if (!llist_empty(&fc->queue) || bssgp_fc_needs_queueing(fc, llc_pdu_len)) {
 		rc = fc_enqueue(fc, msg, llc_pdu_len, priv);
 		if (rc)
 			msgb_free(msg);
 		return rc;
-	} else {
-		/* record the time we transmitted this PDU */
-		osmo_gettimeofday(&time_now, NULL);
-		fc->time_last_pdu = time_now;
-		return fc->out_cb(priv, msg, llc_pdu_len, NULL);
 	}
+
+	fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_DELAY, 0);
+	return fc->out_cb(priv, msg, llc_pdu_len, NULL);
 }
 
 
@@ -780,7 +935,12 @@ void bssgp_fc_init(struct bssgp_flow_control *fc,
 	fc->bucket_size_max = bucket_size_max;
 	fc->bucket_leak_rate = bucket_leak_rate;
 	fc->max_queue_depth = max_queue_depth;
+	fc->max_queue_bytes = 0;
+	fc->queue_depth = 0;
+	fc->queue_bytes = 0;
+	fc->bucket_counter = 0;
 	INIT_LLIST_HEAD(&fc->queue);
+	INIT_LLIST_HEAD(&fc->sched_list);
 	osmo_gettimeofday(&fc->time_last_pdu, NULL);
 }
 
@@ -1106,18 +1266,86 @@ int bssgp_rcvmsg(struct msgb *msg)
 	return rc;
 }
 
-int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
-		   struct bssgp_dl_ud_par *dup)
+/* encode the per-MS IEs MS Radio Access Capability, DRX Parameters and
+ * IMSI (in the order they appear in a DL-UNITDATA) into buf, which must
+ * be at least BSSGP_DL_UD_IE_CACHE_MAXLEN long */
+static int dl_ud_encode_ms_ies(uint8_t *buf, const struct bssgp_dl_ud_par *dup)
+{
+	uint8_t *cur = buf;
+	uint16_t drx_params = osmo_htons(dup->drx_parms);
+
+	/* MS Radio Access Capability */
+	if (dup->ms_ra_cap.len) {
+		if (dup->ms_ra_cap.len > 255)
+			return -EINVAL;
+		cur = tvlv_put(cur, BSSGP_IE_MS_RADIO_ACCESS_CAP,
+			       dup->ms_ra_cap.len, dup->ms_ra_cap.v);
+	}
+
+	/* FIXME: Priority */
+
+	/* DRX parameters */
+	cur = tvlv_put(cur, BSSGP_IE_DRX_PARAMS, 2, (uint8_t *) &drx_params);
+
+	/* IMSI */
+	if (dup->imsi && dup->imsi[0]) {
+		uint8_t mi[GSM48_MID_MAX_SIZE];
+/* gsm48_generate_mid_from_imsi() is guaranteed to never return more than 11,
+ * but somehow gcc (8.2) is not smart enough to figure this out and claims that
+ * the memcpy in tvlv_put() below will cause and out-of-bounds access up to
+ * mi[131], which is wrong */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+		int imsi_len = gsm48_generate_mid_from_imsi(mi, dup->imsi);
+		if (imsi_len > 2)
+			cur = tvlv_put(cur, BSSGP_IE_IMSI, imsi_len-2, mi+2);
+#pragma GCC diagnostic pop
+	}
+
+	return cur - buf;
+}
+
+/*! Pre-encode the per-MS IEs of a DL-UNITDATA
+ *  \param[out] iec cache to fill, to be passed to bssgp_tx_dl_ud_cached()
+ *  \param[in] dup parameters from which IMSI, DRX and MS RA capability are used
+ *  \returns 0 on success; negative on error
+ *
+ *  The cache needs to be updated whenever one of the above parameters of
+ *  the MS changes. */
+int bssgp_dl_ud_ie_cache_update(struct bssgp_dl_ud_ie_cache *iec,
+				const struct bssgp_dl_ud_par *dup)
+{
+	int rc = dl_ud_encode_ms_ies(iec->data, dup);
+	if (rc < 0)
+		return rc;
+	iec->len = rc;
+	return 0;
+}
+
+/*! Transmit a BSSGP DL-UNITDATA, re-using pre-encoded per-MS IEs
+ *  \param[in] msg message containing the LLC PDU, TLLI/BVCI/NSEI in msgb->cb
+ *  \param[in] pdu_lifetime PDU lifetime in centi-seconds
+ *  \param[in] dup parameters of the PDU
+ *  \param[in] iec pre-encoded IEs (see bssgp_dl_ud_ie_cache_update()) which
+ *	       replace IMSI, DRX parameters and MS RA capability of \a dup;
+ *	       NULL to encode them from \a dup
+ *  \returns 0 on success; negative on error
+ *
+ *  The whole BSSGP header is written in one forward pass in front of the
+ *  LLC PDU, after its total size has been determined. */
+int bssgp_tx_dl_ud_cached(struct msgb *msg, uint16_t pdu_lifetime,
+			  struct bssgp_dl_ud_par *dup,
+			  const struct bssgp_dl_ud_ie_cache *iec)
 {
 	struct bssgp_bvc_ctx *bctx;
 	struct bssgp_ud_hdr *budh;
-	uint8_t llc_pdu_tlv_hdr_len = 2;
-	uint8_t *llc_pdu_tlv;
+	struct bssgp_dl_ud_ie_cache iec_tmp;
+	uint8_t *cur;
 	uint16_t msg_len = msg->len;
 	uint16_t bvci = msgb_bvci(msg);
 	uint16_t nsei = msgb_nsei(msg);
 	uint16_t _pdu_lifetime = osmo_htons(pdu_lifetime); /* centi-seconds */
-	uint16_t drx_params;
+	unsigned int hdr_len;
 
 	OSMO_ASSERT(dup != NULL);
 
@@ -1137,64 +1365,54 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 		return -ENODEV;
 	}
 
-	if (msg->len > TVLV_MAX_ONEBYTE)
-		llc_pdu_tlv_hdr_len += 1;
-
-	/* prepend the tag and length of the LLC-PDU TLV */
-	llc_pdu_tlv = msgb_push(msg, llc_pdu_tlv_hdr_len);
-	llc_pdu_tlv[0] = BSSGP_IE_LLC_PDU;
-	if (llc_pdu_tlv_hdr_len > 2) {
-		llc_pdu_tlv[1] = msg_len >> 8;
-		llc_pdu_tlv[2] = msg_len & 0xff;
-	} else {
-		llc_pdu_tlv[1] = msg_len & 0x7f;
-		llc_pdu_tlv[1] |= 0x80;
+	if (!iec) {
+		if (bssgp_dl_ud_ie_cache_update(&iec_tmp, dup) < 0) {
+			LOGP(DBSSGP, LOGL_ERROR, "Cannot encode DL-UD IEs for BVCI %u\n",
+			     bvci);
+			msgb_free(msg);
+			return -EINVAL;
+		}
+		iec = &iec_tmp;
 	}
 
-	/* FIXME: optional elements: Alignment, UTRAN CCO, LSA, PFI */
+	/* size of everything in front of the LLC PDU value */
+	hdr_len = sizeof(*budh) + TVLV_GROSS_LEN(2) + iec->len;
+	if (dup->tlli)
+		hdr_len += TVLV_GROSS_LEN(4);
+	hdr_len += TVLV_GROSS_LEN(msg_len) - msg_len;
 
-	/* Old TLLI to help BSS map from old->new */
-	if (dup->tlli) {
-		uint32_t tlli = osmo_htonl(*dup->tlli);
-		msgb_tvlv_push(msg, BSSGP_IE_TLLI, 4, (uint8_t *) &tlli);
-	}
+	/* one push, then write all IEs front to back */
+	budh = (struct bssgp_ud_hdr *) msgb_push(msg, hdr_len);
 
-	/* IMSI */
-	if (dup->imsi && strlen(dup->imsi)) {
-		uint8_t mi[GSM48_MID_MAX_SIZE];
-/* gsm48_generate_mid_from_imsi() is guaranteed to never return more than 11,
- * but somehow gcc (8.2) is not smart enough to figure this out and claims that
- * the memcpy in msgb_tvlv_put() below will cause and out-of-bounds access up to
- * mi[131], which is wrong */
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Warray-bounds"
-		int imsi_len = gsm48_generate_mid_from_imsi(mi, dup->imsi);
-		if (imsi_len > 2)
-			msgb_tvlv_push(msg, BSSGP_IE_IMSI,
-				imsi_len-2, mi+2);
-#pragma GCC diagnostic pop
-	}
+	/* QoS profile, TLLI and pdu type */
+	budh->pdu_type = BSSGP_PDUT_DL_UNITDATA;
+	budh->tlli = osmo_htonl(msgb_tlli(msg));
+	memcpy(budh->qos_profile, dup->qos_profile, sizeof(budh->qos_profile));
+	cur = budh->data;
 
-	/* DRX parameters */
-	drx_params = osmo_htons(dup->drx_parms);
-	msgb_tvlv_push(msg, BSSGP_IE_DRX_PARAMS, 2,
-		(uint8_t *) &drx_params);
+	/* PDU lifetime */
+	cur = tvlv_put(cur, BSSGP_IE_PDU_LIFETIME, 2, (uint8_t *) &_pdu_lifetime);
 
-	/* FIXME: Priority */
+	/* MS Radio Access Capability, DRX parameters, IMSI */
+	memcpy(cur, iec->data, iec->len);
+	cur += iec->len;
 
-	/* MS Radio Access Capability */
-	if (dup->ms_ra_cap.len)
-		msgb_tvlv_push(msg, BSSGP_IE_MS_RADIO_ACCESS_CAP,
-			dup->ms_ra_cap.len, dup->ms_ra_cap.v);
+	/* Old TLLI to help BSS map from old->new */
+	if (dup->tlli) {
+		uint32_t tlli = osmo_htonl(*dup->tlli);
+		cur = tvlv_put(cur, BSSGP_IE_TLLI, 4, (uint8_t *) &tlli);
+	}
 
-	/* prepend the pdu lifetime */
-	msgb_tvlv_push(msg, BSSGP_IE_PDU_LIFETIME, 2, (uint8_t *)&_pdu_lifetime);
+	/* FIXME: optional elements: Alignment, UTRAN CCO, LSA, PFI */
 
-	/* prepend the QoS profile, TLLI and pdu type */
-	budh = (struct bssgp_ud_hdr *) msgb_push(msg, sizeof(*budh));
-	memcpy(budh->qos_profile, dup->qos_profile, sizeof(budh->qos_profile));
-	budh->tlli = osmo_htonl(msgb_tlli(msg));
-	budh->pdu_type = BSSGP_PDUT_DL_UNITDATA;
+	/* tag and length of the LLC-PDU TLV, the value is already in place */
+	*cur++ = BSSGP_IE_LLC_PDU;
+	if (msg_len > TVLV_MAX_ONEBYTE) {
+		*cur++ = msg_len >> 8;
+		*cur++ = msg_len & 0xff;
+	} else
+		*cur++ = 0x80 | msg_len;
+	OSMO_ASSERT(cur + msg_len == msg->tail);
 
 	rate_ctr_inc(&bctx->ctrg->ctr[BSSGP_CTR_PKTS_OUT]);
 	rate_ctr_add(&bctx->ctrg->ctr[BSSGP_CTR_BYTES_OUT], msg->len);
@@ -1209,6 +1427,12 @@ int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
 		return bssgp_fc_in(bctx->fc, msg, msg_len, NULL);
 }
 
+int bssgp_tx_dl_ud(struct msgb *msg, uint16_t pdu_lifetime,
+		   struct bssgp_dl_ud_par *dup)
+{
+	return bssgp_tx_dl_ud_cached(msg, pdu_lifetime, dup, NULL);
+}
+
 /* Send a single GMM-PAGING.req to a given NSEI/NS-BVCI */
 int bssgp_tx_paging(uint16_t nsei, uint16_t ns_bvci,
 		     struct bssgp_paging_info *pinfo)
@@ -1291,11 +1515,17 @@ void bssgp_fc_flush_queue(struct bssgp_flow_control *fc)
 {
 	struct bssgp_fc_queue_element *element, *tmp;
 
+	fc_sched_del(fc);
+
 	llist_for_each_entry_safe(element, tmp, &fc->queue, list) {
 		msgb_free(element->msg);
 		llist_del(&element->list);
 		talloc_free(element);
 	}
+	fc->queue_depth = 0;
+	fc->queue_bytes = 0;
+	fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_DEPTH, 0);
+	fc_stat_set(fc, BSSGP_STAT_FC_QUEUE_BYTES, 0);
 }
 
 /*!
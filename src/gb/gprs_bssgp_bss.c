@@ -104,8 +104,9 @@ int bssgp_tx_ra_capa_upd(struct bssgp_bvc_ctx *bctx, uint32_t tlli, uint8_t tag)
 	LOGP(DBSSGP, LOGL_NOTICE, "BSSGP (BVCI=%u) Tx RA-CAPA-UPD (TLLI=0x%04x)\n",
 		bctx->bvci, tlli);
 
-	/* set NSEI and BVCI in msgb cb */
+	/* set NSEI, BVCI and TLLI (NS Link Selector Parameter) in msgb cb */
 	msgb_nsei(msg) = bctx->nsei;
+	msgb_tlli(msg) = tlli;
 	msgb_bvci(msg) = bctx->bvci;
 
 	bgph->pdu_type = BSSGP_PDUT_RA_CAPA_UDPATE;
@@ -466,8 +467,9 @@ int bssgp_tx_ul_ud(struct bssgp_bvc_ctx *bctx, uint32_t tlli,
 	memcpy(budh->qos_profile, qos_profile, 3);
 	budh->pdu_type = BSSGP_PDUT_UL_UNITDATA;
 
-	/* set NSEI and BVCI in msgb cb */
+	/* set NSEI, BVCI and TLLI (NS Link Selector Parameter) in msgb cb */
 	msgb_nsei(msg) = bctx->nsei;
+	msgb_tlli(msg) = tlli;
 	msgb_bvci(msg) = bctx->bvci;
 
 	rate_ctr_inc(&bctx->ctrg->ctr[BSSGP_CTR_PKTS_OUT]);
@@ -153,6 +153,13 @@ const char *bssgp_pdu_str(enum bssgp_pdu_type pdu)
 	return get_value_string(bssgp_pdu_strings, pdu);
 }
 
+static __attribute__((constructor)) void on_dso_load_bssgp_util(void)
+{
+	/* PDU and cause names are looked up for every logged BSSGP PDU */
+	osmo_value_string_index(bssgp_cause_strings);
+	osmo_value_string_index(bssgp_pdu_strings);
+}
+
 struct msgb *bssgp_msgb_alloc(void)
 {
 	struct msgb *msg = msgb_alloc_headroom(4096, 128, "BSSGP");
@@ -203,6 +203,12 @@ static bool nsvc_is_not_used(const struct gprs_nsvc *nsvc)
 		return false;
 }
 
+osmo_static_assert(NS_ALLOC_HEADROOM >= NS_UNITDATA_HDR_LEN, ns_alloc_headroom_fits_unitdata_hdr);
+osmo_static_assert((NS_LOOKUP_CACHE_SIZE & (NS_LOOKUP_CACHE_SIZE - 1)) == 0, ns_lookup_cache_size_pow2);
+
+/*! Allocate a msgb for a NS PDU
+ *  \returns msgb with at least NS_ALLOC_HEADROOM bytes of headroom, so that
+ *  gprs_ns_sendmsg() can prepend the NS-UNITDATA header in place. */
 struct msgb *gprs_ns_msgb_alloc(void)
 {
 	struct msgb *msg = msgb_alloc_headroom(NS_ALLOC_SIZE, NS_ALLOC_HEADROOM,
@@ -227,8 +233,12 @@ static inline void ns_set_state_with_log(struct gprs_nsvc *nsvc, uint32_t state,
 
 	if (is_remote)
 		nsvc->remote_state = state;
-	else
+	else {
 		nsvc->state = state;
+		/* rebalance the load sharing among the NS-VCs of the NSE */
+		if (nsvc->nsi)
+			gprs_ns_cache_flush(nsvc->nsi);
+	}
 }
 
 /*! Lookup struct gprs_nsvc based on NSVCI
@@ -261,41 +271,188 @@ struct gprs_nsvc *gprs_nsvc_by_nsei(struct gprs_ns_inst *nsi, uint16_t nsei)
 	return NULL;
 }
 
+/* Can the NS-VC carry traffic of given NSEI and BVCI? */
+static inline bool nsvc_is_active_for(const struct gprs_nsvc *nsvc, uint16_t nsei, uint16_t bvci)
+{
+	/* if signalling BVCI, skip any NSVC with signalling weight == 0 */
+	if (bvci == 0 && nsvc->sig_weight == 0)
+		return false;
+	/* if point-to-point BVCI, skip any NSVC with data weight == 0 */
+	if (bvci != 0 && nsvc->data_weight == 0)
+		return false;
+	return nsvc->nsei == nsei && !(nsvc->state & NSE_S_BLOCKED) && (nsvc->state & NSE_S_ALIVE);
+}
+
+/*! Load sharing table of one NSE (TS 48.016 Section 4.4): maps the hashed
+ *  Link Selector Parameter to one of the active NS-VCs, in proportion to
+ *  their signalling [0] or data [1] weight. */
+struct gprs_ns_lsp_table {
+	/*! next table in the same slot of the tx cache */
+	struct gprs_ns_lsp_table *next;
+	/*! table is up to date; cleared by gprs_ns_cache_flush() */
+	bool valid;
+	uint16_t nsei;
+	/*! number of active NS-VCs in the table, 0 if none */
+	uint8_t num_nsvc[2];
+	struct gprs_nsvc *bucket[2][NS_LSP_BUCKETS];
+};
+
+/* Distribute the NS_LSP_BUCKETS of one table among the active NS-VCs of the
+ * NSE, proportionally to their weight but with at least one bucket each. */
+static void ns_lsp_table_fill(struct gprs_ns_lsp_table *t, struct gprs_ns_inst *nsi, unsigned int data)
+{
+	struct gprs_nsvc *active[NS_LSP_BUCKETS];
+	unsigned int count[NS_LSP_BUCKETS];
+	unsigned int i, j, n = 0, b = 0, total = 0, assigned = 0;
+	struct gprs_nsvc *nsvc;
+
+	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
+		if (!nsvc_is_active_for(nsvc, t->nsei, data))
+			continue;
+		active[n++] = nsvc;
+		total += data ? nsvc->data_weight : nsvc->sig_weight;
+		if (n == NS_LSP_BUCKETS)
+			break;
+	}
+	t->num_nsvc[data] = n;
+	if (!n)
+		return;
+
+	for (i = 0; i < n; i++) {
+		unsigned int weight = data ? active[i]->data_weight : active[i]->sig_weight;
+		count[i] = OSMO_MAX(weight * NS_LSP_BUCKETS / total, 1);
+		assigned += count[i];
+	}
+	/* correct rounding: take from the largest, give round-robin */
+	while (assigned > NS_LSP_BUCKETS) {
+		unsigned int max = 0;
+		for (i = 1; i < n; i++) {
+			if (count[i] > count[max])
+				max = i;
+		}
+		count[max]--;
+		assigned--;
+	}
+	for (i = 0; assigned < NS_LSP_BUCKETS; i = (i + 1) % n) {
+		count[i]++;
+		assigned++;
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < count[i]; j++)
+			t->bucket[data][b++] = active[i];
+	}
+}
+
+/* Get the up to date load sharing table of an NSE, (re-)building it if needed.
+ * NSEIs sharing a slot are chained, so each keeps its own table. Tables
+ * invalidated by gprs_ns_cache_flush() are reused for other NSEIs of the slot
+ * before a new one is allocated. */
+static struct gprs_ns_lsp_table *ns_lsp_table_get(struct gprs_ns_inst *nsi, uint16_t nsei)
+{
+	struct gprs_ns_lsp_table **slot = &nsi->cache.tx[nsei & (NS_LOOKUP_CACHE_SIZE - 1)];
+	struct gprs_ns_lsp_table *t, *spare = NULL;
+
+	for (t = *slot; t; t = t->next) {
+		if (t->nsei == nsei)
+			break;
+		if (!t->valid && !spare)
+			spare = t;
+	}
+
+	if (t && t->valid)
+		return t;
+
+	if (!t)
+		t = spare;
+	if (!t) {
+		t = talloc_zero(nsi, struct gprs_ns_lsp_table);
+		if (!t)
+			return NULL;
+		t->next = *slot;
+		*slot = t;
+	}
+	t->nsei = nsei;
+	ns_lsp_table_fill(t, nsi, 0);
+	ns_lsp_table_fill(t, nsi, 1);
+	t->valid = true;
+	return t;
+}
+
 /*! Determine active NS-VC for given NSEI + BVCI.
  *  Use this function to determine which of the NS-VCs inside the NS Instance
- *  shall be used to transmit data for given NSEI + BVCI */
+ *  shall be used to transmit data for given NSEI + BVCI. The traffic is shared
+ *  among all active NS-VCs of the NSE according to their weight, a given
+ *  Link Selector Parameter always maps to the same NS-VC as long as the set of
+ *  active NS-VCs doesn't change. */
 static struct gprs_nsvc *gprs_active_nsvc_by_nsei(struct gprs_ns_inst *nsi,
-						  uint16_t nsei, uint16_t bvci)
+						  uint16_t nsei, uint16_t bvci, uint32_t lsp)
 {
+	struct gprs_ns_lsp_table *t = ns_lsp_table_get(nsi, nsei);
+	unsigned int data = bvci != 0;
 	struct gprs_nsvc *nsvc;
+
+	if (t) {
+		if (!t->num_nsvc[data])
+			return NULL;
+		return t->bucket[data][(lsp * 2654435761U) >> (32 - NS_LSP_BUCKETS_BITS)];
+	}
+
+	/* out of memory: fall back to the first active NS-VC */
 	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
-		/* if signalling BVCI, skip any NSVC with signalling weight == 0 */
-		if (bvci == 0 && nsvc->sig_weight == 0)
-			continue;
-		/* if point-to-point BVCI, skip any NSVC with data weight == 0 */
-		if (bvci != 0 && nsvc->data_weight == 0)
-			continue;
-		if (nsvc->nsei == nsei) {
-			if (!(nsvc->state & NSE_S_BLOCKED) &&
-			    nsvc->state & NSE_S_ALIVE)
-				return nsvc;
-		}
+		if (nsvc_is_active_for(nsvc, nsei, bvci))
+			return nsvc;
 	}
 	return NULL;
 }
 
+static inline unsigned int ns_addr_hash(const struct sockaddr_in *sin)
+{
+	uint32_t h = sin->sin_addr.s_addr ^ ((uint32_t)sin->sin_port * 2654435761U);
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return h & (NS_LOOKUP_CACHE_SIZE - 1);
+}
+
+/* Flush the NS-VC lookup caches, needed whenever a NS-VC is added, removed,
+ * changes its peer address, NSEI, weight or state, as the caches must
+ * reflect the current set of NS-VCs. */
+void gprs_ns_cache_flush(struct gprs_ns_inst *nsi)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(nsi->cache.tx); i++) {
+		struct gprs_ns_lsp_table *t;
+		for (t = nsi->cache.tx[i]; t; t = t->next)
+			t->valid = false;
+	}
+	memset(nsi->cache.rx, 0, sizeof(nsi->cache.rx));
+}
+
 /*! Lookup NS-VC based on specified remote peer socket addr.
  *  \param[in] nsi NS Instance within which we shall look up the NS-VC
  *  \param[in] sin Remote peer Socket Address (IP + UDP Port)
  *  \returns NS-VC matching the given peer; NULL in case of none */
 struct gprs_nsvc *gprs_nsvc_by_rem_addr(struct gprs_ns_inst *nsi, const struct sockaddr_in *sin)
 {
+	struct gprs_nsvc **slot = &nsi->cache.rx[ns_addr_hash(sin)];
 	struct gprs_nsvc *nsvc;
+
+	nsvc = *slot;
+	if (nsvc && nsvc->ip.bts_addr.sin_addr.s_addr == sin->sin_addr.s_addr &&
+	    nsvc->ip.bts_addr.sin_port == sin->sin_port)
+		return nsvc;
+
 	llist_for_each_entry(nsvc, &nsi->gprs_nsvcs, list) {
 		if (nsvc->ip.bts_addr.sin_addr.s_addr ==
 					sin->sin_addr.s_addr &&
-		    nsvc->ip.bts_addr.sin_port == sin->sin_port)
+		    nsvc->ip.bts_addr.sin_port == sin->sin_port) {
+			/* the address of the unknown NS-VC changes with every
+			 * unknown peer, never cache it */
+			if (nsvc != nsi->unknown_nsvc)
+				*slot = nsvc;
 			return nsvc;
+		}
 	}
 	return NULL;
 }
@@ -342,6 +499,7 @@ struct gprs_nsvc *gprs_nsvc_create2(struct gprs_ns_inst *nsi, uint16_t nsvci,
 	nsvc->data_weight = data_weight;
 
 	llist_add(&nsvc->list, &nsi->gprs_nsvcs);
+	gprs_ns_cache_flush(nsi);
 
 	return nsvc;
 }
@@ -360,6 +518,7 @@ void gprs_nsvc_delete(struct gprs_nsvc *nsvc)
 	if (osmo_timer_pending(&nsvc->timer))
 		osmo_timer_del(&nsvc->timer);
 	llist_del(&nsvc->list);
+	gprs_ns_cache_flush(nsvc->nsi);
 	rate_ctr_group_free(nsvc->ctrg);
 	osmo_stat_item_group_free(nsvc->statg);
 	talloc_free(nsvc);
@@ -453,6 +612,13 @@ const char *gprs_ns_cause_str(enum ns_cause cause)
 	return get_value_string(ns_cause_str, cause);
 }
 
+static __attribute__((constructor)) void on_dso_load_ns(void)
+{
+	/* PDU and cause names are looked up for every logged NS PDU */
+	osmo_value_string_index(gprs_ns_pdu_strings);
+	osmo_value_string_index(ns_cause_str);
+}
+
 static int nsip_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg);
 extern int grps_ns_frgre_sendmsg(struct gprs_nsvc *nsvc, struct msgb *msg);
 
@@ -1081,15 +1247,20 @@ int gprs_ns_tx_sns_size_ack(struct gprs_nsvc *nsvc, uint8_t *cause)
  * if the NS-VC is ALIVEV and not BLOCKED.  After that, it adds a NS
  * header for the NS-UNITDATA message type and sends it off.
  *
+ * If the NSE has several active NS-VCs, the load is shared among them by
+ * the Link Selector Parameter, which is msgb_tlli(msg) if set and the BVCI
+ * otherwise, see gprs_active_nsvc_by_nsei().
+ *
  * Section 9.2.10: transmit side / NS-UNITDATA-REQUEST primitive 
  */
 int gprs_ns_sendmsg(struct gprs_ns_inst *nsi, struct msgb *msg)
 {
 	struct gprs_nsvc *nsvc;
-	struct gprs_ns_hdr *nsh;
 	uint16_t bvci = msgb_bvci(msg);
+	uint32_t hdr;
 
-	nsvc = gprs_active_nsvc_by_nsei(nsi, msgb_nsei(msg), msgb_bvci(msg));
+	/* Link Selector Parameter: keep the PDUs of one MS in order on one NS-VC */
+	nsvc = gprs_active_nsvc_by_nsei(nsi, msgb_nsei(msg), bvci, msgb_tlli(msg) ? : bvci);
 	if (!nsvc) {
 		int rc;
 		if (gprs_nsvc_by_nsei(nsi, msgb_nsei(msg))) {
@@ -1108,18 +1279,31 @@ int gprs_ns_sendmsg(struct gprs_ns_inst *nsi, struct msgb *msg)
 	}
 	log_set_context(LOG_CTX_GB_NSVC, nsvc);
 
-	msg->l2h = msgb_push(msg, sizeof(*nsh) + 3);
-	nsh = (struct gprs_ns_hdr *) msg->l2h;
-	if (!nsh) {
+	/* msgb from gprs_ns_msgb_alloc() always have enough headroom */
+	if (msgb_headroom(msg) < NS_UNITDATA_HDR_LEN) {
 		LOGP(DNS, LOGL_ERROR, "Not enough headroom for NS header\n");
 		msgb_free(msg);
 		return -EIO;
 	}
 
-	nsh->pdu_type = NS_PDUT_UNITDATA;
-	/* spare octet in data[0] */
-	nsh->data[1] = bvci >> 8;
-	nsh->data[2] = bvci & 0xff;
+	/* PDU type, spare octet and BVCI in a single store */
+	msg->l2h = msgb_push(msg, NS_UNITDATA_HDR_LEN);
+	hdr = htonl(NS_PDUT_UNITDATA << 24 | bvci);
+	memcpy(msg->l2h, &hdr, sizeof(hdr));
+
+	/* fast path: an active NS-VC has a non-zero weight for the BVCI, so
+	 * none of the checks of gprs_ns_tx() apply to the NS-UNITDATA */
+	if (nsvc->ll == GPRS_NS_LL_UDP) {
+		int rc;
+
+		rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_PKTS_OUT]);
+		rate_ctr_add(&nsvc->ctrg->ctr[NS_CTR_BYTES_OUT], msgb_l2len(msg));
+		rc = nsip_sendmsg(nsvc, msg);
+		if (rc < 0)
+			LOGP(DNS, LOGL_INFO, "failed to send NS message via UDP: %s\n",
+			     strerror(-rc));
+		return rc;
+	}
 
 	return gprs_ns_tx(nsvc, msg);
 }
@@ -1291,6 +1475,7 @@ static int gprs_ns_rx_reset(struct gprs_nsvc **nsvc, struct msgb *msg)
 		/* NSEI has changed */
 		rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_NSEI_CHG]);
 		(*nsvc)->nsei = nsei;
+		gprs_ns_cache_flush((*nsvc)->nsi);
 	}
 
 	/* Mark NS-VC as blocked and alive */
@@ -1430,6 +1615,7 @@ static int gprs_ns_rx_reset_ack(struct gprs_nsvc **nsvc, struct msgb *msg)
 		/* NSEI has changed */
 		rate_ctr_inc(&(*nsvc)->ctrg->ctr[NS_CTR_NSEI_CHG]);
 		(*nsvc)->nsei = nsei;
+		gprs_ns_cache_flush((*nsvc)->nsi);
 	}
 
 	/* Mark NS-VC as blocked and alive */
@@ -1507,6 +1693,18 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 	/* look up the NSVC based on source address */
 	nsvc = gprs_nsvc_by_rem_addr(nsi, saddr);
 
+	/* fast path: NS-UNITDATA on a known, unblocked NS-VC in use goes
+	 * straight to gprs_ns_rx_unitdata(), skipping the NS automaton */
+	if (nsvc && nsvc != nsi->unknown_nsvc && msgb_l2len(msg) >= NS_UNITDATA_HDR_LEN &&
+	    msg->l2h[0] == NS_PDUT_UNITDATA && !(nsvc->state & NSE_S_BLOCKED) &&
+	    !nsvc_is_not_used(nsvc)) {
+		msgb_nsei(msg) = nsvc->nsei;
+		log_set_context(LOG_CTX_GB_NSVC, nsvc);
+		rate_ctr_inc(&nsvc->ctrg->ctr[NS_CTR_PKTS_IN]);
+		rate_ctr_add(&nsvc->ctrg->ctr[NS_CTR_BYTES_IN], msgb_l2len(msg));
+		return gprs_ns_rx_unitdata(nsvc, msg);
+	}
+
 	if (!nsvc) {
 		struct gprs_nsvc *fallback_nsvc;
 
@@ -1566,6 +1764,8 @@ char *gprs_ns_ll_str_c(const void *ctx, const struct gprs_nsvc *nsvc)
 
 void gprs_ns_ll_copy(struct gprs_nsvc *nsvc, struct gprs_nsvc *other)
 {
+	if (nsvc->nsi)
+		gprs_ns_cache_flush(nsvc->nsi);
 	nsvc->ll = other->ll;
 
 	switch (nsvc->ll) {
@@ -1582,6 +1782,8 @@ void gprs_ns_ll_copy(struct gprs_nsvc *nsvc, struct gprs_nsvc *other)
 
 void gprs_ns_ll_clear(struct gprs_nsvc *nsvc)
 {
+	if (nsvc->nsi)
+		gprs_ns_cache_flush(nsvc->nsi);
 	switch (nsvc->ll) {
 	case GPRS_NS_LL_UDP:
 		nsvc->ip.bts_addr.sin_addr.s_addr = INADDR_ANY;
@@ -1708,6 +1910,7 @@ int gprs_ns_vc_create(struct gprs_ns_inst *nsi, struct msgb *msg,
 
 		/* Override old NSEI */
 		existing_nsvc->nsei  = nsei;
+		gprs_ns_cache_flush(nsi);
 
 		/* Do statistics */
 		rate_ctr_inc(&existing_nsvc->ctrg->ctr[NS_CTR_NSEI_CHG]);
@@ -2142,6 +2345,7 @@ struct gprs_nsvc *gprs_ns_nsip_connect(struct gprs_ns_inst *nsi,
 	if (!nsvc)
 		nsvc = gprs_nsvc_create(nsi, nsvci);
 	nsvc->ip.bts_addr = *dest;
+	gprs_ns_cache_flush(nsi);
 	nsvc->nsei = nsei;
 	nsvc->remote_end_is_sgsn = 1;
 
@@ -2184,6 +2388,7 @@ struct gprs_nsvc *gprs_ns_nsip_connect_sns(struct gprs_ns_inst *nsi,
 		nsvc = gprs_nsvc_create2(nsi, nsvci, 0, 0);
 	}
 	nsvc->ip.bts_addr = *dest;
+	gprs_ns_cache_flush(nsi);
 	nsvc->nsei = nsei;
 	nsvc->remote_end_is_sgsn = 1;
 	/* NSVCs are always UNBLOCKED in IP-SNS */
@@ -101,6 +101,7 @@ static struct gprs_nsvc *gprs_nsvc_create_ip4(struct gprs_ns_inst *nsi,
 	nsvc->nsei = gss->nsvc_hack->nsei;
 	nsvc->nsvci_is_valid = 0;
 	nsvc->ip.bts_addr = sin;
+	gprs_ns_cache_flush(nsi);
 
 	return nsvc;
 }
@@ -125,6 +126,7 @@ static int create_missing_nsvcs(struct osmo_fsm_inst *fi)
 			/* update data / signalling weight */
 			nsvc->data_weight = ip4->data_weight;
 			nsvc->sig_weight = ip4->sig_weight;
+			gprs_ns_cache_flush(nsvc->nsi);
 		}
 		LOGPFSML(fi, LOGL_INFO, "NS-VC %s data_weight=%u, sig_weight=%u\n",
 			 gprs_ns_ll_str(nsvc), nsvc->data_weight, nsvc->sig_weight);
@@ -204,6 +206,7 @@ static int do_sns_change_weight(struct osmo_fsm_inst *fi, const struct gprs_ns_i
 
 	nsvc->data_weight = ip4->data_weight;
 	nsvc->sig_weight = ip4->sig_weight;
+	gprs_ns_cache_flush(nsvc->nsi);
 
 	return 0;
 }
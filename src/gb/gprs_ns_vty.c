@@ -288,6 +288,7 @@ DEFUN(cfg_nse_nsvc, cfg_nse_nsvci_cmd,
 	if (!nsvc) {
 		nsvc = gprs_nsvc_create(vty_nsi, nsvci);
 		nsvc->nsei = nsei;
+		gprs_ns_cache_flush(vty_nsi);
 	}
 	nsvc->nsvci = nsvci;
 	/* All NSVCs that are explicitly configured by VTY are
@@ -313,6 +314,7 @@ DEFUN(cfg_nse_remoteip, cfg_nse_remoteip_cmd,
 		return CMD_WARNING;
 	}
 	inet_aton(argv[1], &nsvc->ip.bts_addr.sin_addr);
+	gprs_ns_cache_flush(vty_nsi);
 
 	return CMD_SUCCESS;
 
@@ -341,6 +343,7 @@ DEFUN(cfg_nse_remoteport, cfg_nse_remoteport_cmd,
 	}
 
 	nsvc->ip.bts_addr.sin_port = osmo_htons(port);
+	gprs_ns_cache_flush(vty_nsi);
 
 	return CMD_SUCCESS;
 }
@@ -368,6 +371,7 @@ DEFUN(cfg_nse_fr_dlci, cfg_nse_fr_dlci_cmd,
 	}
 
 	nsvc->frgre.bts_addr.sin_port = osmo_htons(dlci);
+	gprs_ns_cache_flush(vty_nsi);
 
 	return CMD_SUCCESS;
 }
@@ -1648,6 +1648,14 @@ const char *gsm0808_cause_name(enum gsm0808_cause cause)
 	return get_value_string(gsm0808_cause_names, cause);
 }
 
+static __attribute__((constructor)) void on_dso_load_gsm0808(void)
+{
+	/* message type and cause names are looked up for every logged BSSMAP message */
+	osmo_value_string_index(gsm0808_msgt_names);
+	osmo_value_string_index(gsm0808_cause_names);
+	osmo_value_string_index(gsm0808_cause_class_names);
+}
+
 const struct value_string gsm0808_lcls_config_names[] = {
 	{ GSM0808_LCLS_CFG_BOTH_WAY, "Connect both-way" },
 	{ GSM0808_LCLS_CFG_BOTH_WAY_AND_BICAST_UL,
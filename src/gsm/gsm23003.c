@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <osmocom/gsm/gsm23003.h>
 #include <osmocom/gsm/protocol/gsm_23_003.h>
@@ -42,7 +43,7 @@ static bool is_n_digits(const char *str, int min_digits, int max_digits)
 	if (!pos)
 		return min_digits < 1;
 	for (len = 0; *pos && len < max_digits; len++, pos++)
-		if (!isdigit(*pos))
+		if ((uint8_t)(*pos - '0') > 9)
 			return false;
 	if (len < min_digits)
 		return false;
@@ -89,6 +90,92 @@ bool osmo_imei_str_valid(const char *imei, bool with_15th_digit)
 		return is_n_digits(imei, 14, 14);
 }
 
+/*! Pack an IMSI string into a struct osmo_mi_packed.
+ * \param[out] mi  Packed identity to write; left unchanged on error.
+ * \param[in] imsi  IMSI digits in ASCII string representation.
+ * \returns 0 on success, -EINVAL if imsi is not a valid IMSI as in osmo_imsi_str_valid().
+ */
+int osmo_mi_packed_from_imsi_str(struct osmo_mi_packed *mi, const char *imsi)
+{
+	const uint8_t *pos = (const uint8_t *)imsi;
+	uint64_t val = 0;
+	unsigned int invalid = 0;
+	unsigned int len;
+
+	if (!imsi)
+		return -EINVAL;
+
+	/* Stop one past the maximum to catch overlong IMSIs. (c - '0') + 6 exceeds 0xf exactly for characters other
+	 * than '0'..'9', so invalid characters are collected without branching. */
+	for (len = 0; len <= GSM23003_IMSI_MAX_DIGITS && pos[len]; len++) {
+		uint8_t digit = pos[len] - '0';
+		invalid |= digit + 6u;
+		val = (val << 4) | (digit & 0xf);
+	}
+	if ((invalid & ~0xfu) || len < GSM23003_IMSI_MIN_DIGITS || len > GSM23003_IMSI_MAX_DIGITS)
+		return -EINVAL;
+
+	mi->val = ((uint64_t)len << 60) | val;
+	return 0;
+}
+
+/*! Write the IMSI held by a struct osmo_mi_packed as ASCII digits.
+ * \param[out] buf  Caller-provided output buffer, nul terminated if buf_len > 0.
+ * \param[in] buf_len  Size of buf in bytes; OSMO_IMSI_BUF_SIZE always suffices.
+ * \param[in] mi  Packed identity.
+ * \returns number of IMSI digits, like snprintf() also when truncated; -EINVAL if mi holds no IMSI.
+ */
+int osmo_mi_packed_to_imsi_str(char *buf, size_t buf_len, const struct osmo_mi_packed *mi)
+{
+	static const char digits[16] = "0123456789ABCDEF";
+	unsigned int len, i, n;
+
+	if (!osmo_mi_packed_is_imsi(mi)) {
+		if (buf_len)
+			buf[0] = '\0';
+		return -EINVAL;
+	}
+	len = OSMO_MI_PACKED_KIND(mi);
+	if (!buf_len)
+		return len;
+
+	n = OSMO_MIN(len, buf_len - 1);
+	for (i = 0; i < n; i++)
+		buf[i] = digits[(mi->val >> (4 * (len - 1 - i))) & 0xf];
+	buf[n] = '\0';
+	return len;
+}
+
+/*! Return a human readable representation of a struct osmo_mi_packed in caller-provided buffer.
+ * \param[out] buf  Caller-provided output buffer.
+ * \param[in] buf_len  Size of buf in bytes.
+ * \param[in] mi  Packed identity.
+ * \returns buf, containing a string like "IMSI-901700000004620", "TMSI-0x1234ABCD" or "none".
+ */
+char *osmo_mi_packed_name_buf(char *buf, size_t buf_len, const struct osmo_mi_packed *mi)
+{
+	char imsi[OSMO_IMSI_BUF_SIZE];
+
+	if (osmo_mi_packed_is_imsi(mi)) {
+		osmo_mi_packed_to_imsi_str(imsi, sizeof(imsi), mi);
+		snprintf(buf, buf_len, "IMSI-%s", imsi);
+	} else if (osmo_mi_packed_is_tmsi(mi))
+		snprintf(buf, buf_len, "TMSI-0x%08" PRIX32, osmo_mi_packed_tmsi(mi));
+	else
+		snprintf(buf, buf_len, "none");
+	return buf;
+}
+
+/*! Return a human readable representation of a struct osmo_mi_packed in static buffer.
+ * \param[in] mi  Packed identity.
+ * \returns string like "IMSI-901700000004620", "TMSI-0x1234ABCD" or "none".
+ */
+const char *osmo_mi_packed_name(const struct osmo_mi_packed *mi)
+{
+	static __thread char buf[6 + OSMO_IMSI_BUF_SIZE];
+	return osmo_mi_packed_name_buf(buf, sizeof(buf), mi);
+}
+
 /*! Return MCC string as standardized 3-digit with leading zeros.
  * \param[out] buf caller-allocated output buffer
  * \param[in] buf_len size of buf in bytes
@@ -31,6 +31,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <errno.h>
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/byteswap.h>
@@ -44,6 +45,7 @@
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/gsm/protocol/gsm_04_80.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/gsm/protocol/gsm_23_003.h>
 #include <osmocom/gsm/protocol/gsm_04_08_gprs.h>
 
 /*! \addtogroup gsm0408
@@ -731,6 +733,89 @@ int gsm48_generate_mid_from_imsi(uint8_t *buf, const char *imsi)
 	return gsm48_generate_mid(buf, imsi, GSM_MI_TYPE_IMSI);
 }
 
+/*! Generate TS 04.08 Mobile ID from a packed IMSI or TMSI
+ *  \param[out] buf Caller-provided output buffer of at least GSM48_MID_MAX_SIZE bytes
+ *  \param[in] mi Packed identity to be encoded
+ *  \returns number of bytes used in \a buf; 0 if \a mi holds no identity */
+uint8_t gsm48_generate_mid_from_packed(uint8_t *buf, const struct osmo_mi_packed *mi)
+{
+	uint64_t val = mi->val;
+	unsigned int n, i;
+
+	if (osmo_mi_packed_is_tmsi(mi))
+		return gsm48_generate_mid_from_tmsi(buf, osmo_mi_packed_tmsi(mi));
+	if (!osmo_mi_packed_is_imsi(mi))
+		return 0;
+
+	/* Append the filler nibble for an even number of digits, then nibble p is (val >> 4 * (n - 1 - p)) */
+	n = OSMO_MI_PACKED_KIND(mi);
+	buf[1] = n / 2 + 1;
+	buf[2] = GSM_MI_TYPE_IMSI;
+	if (n & 1)
+		buf[2] |= GSM_MI_ODD;
+	else {
+		val = (val << 4) | 0xf;
+		n++;
+	}
+
+	buf[0] = GSM48_IE_MOBILE_ID;
+	buf[2] |= ((val >> (4 * (n - 1))) & 0xf) << 4;
+	for (i = 1; i < buf[1]; i++) {
+		uint8_t pair = val >> (4 * (n - 1 - 2 * i));
+		buf[2 + i] = (pair << 4) | ((pair >> 4) & 0xf);
+	}
+
+	return 2 + buf[1];
+}
+
+/*! Pack a TS 04.08 Mobile Identity (10.5.1.4) holding an IMSI or TMSI, without string conversion.
+ * Unlike gsm48_mi_to_string(), this rejects IMSI digits > 9 and a missing filler nibble.
+ *  \param[out] packed Packed identity to write; left unchanged on error
+ *  \param[in] mi Mobile Identity, i.e. the value part of the IE
+ *  \param[in] mi_len Length of \a mi in bytes
+ *  \returns 0 on success; -EINVAL for other identity types or invalid encoding */
+int osmo_mi_packed_from_mi(struct osmo_mi_packed *packed, const uint8_t *mi, uint8_t mi_len)
+{
+	uint64_t val;
+	unsigned int digits, i;
+
+	if (!mi || !mi_len)
+		return -EINVAL;
+
+	switch (mi[0] & GSM_MI_TYPE_MASK) {
+	case GSM_MI_TYPE_TMSI:
+		if (mi_len != GSM48_TMSI_LEN || mi[0] != (0xf0 | GSM_MI_TYPE_TMSI))
+			return -EINVAL;
+		osmo_mi_packed_set_tmsi(packed, osmo_load32be(&mi[1]));
+		return 0;
+
+	case GSM_MI_TYPE_IMSI:
+		digits = mi_len * 2 - ((mi[0] & GSM_MI_ODD) ? 1 : 2);
+		if (digits < GSM23003_IMSI_MIN_DIGITS || digits > GSM23003_IMSI_MAX_DIGITS)
+			return -EINVAL;
+
+		/* Swap the nibbles of each octet into most-significant-first order */
+		val = mi[0] >> 4;
+		for (i = 1; i < mi_len; i++)
+			val = (val << 8) | ((mi[i] & 0xf) << 4) | (mi[i] >> 4);
+		if (!(mi[0] & GSM_MI_ODD)) {
+			if ((val & 0xf) != 0xf)
+				return -EINVAL;
+			val >>= 4;
+		}
+
+		/* A nibble > 9 has bit 3 set together with bit 2 or bit 1; check all digits at once */
+		if (val & ((val << 1) | (val << 2)) & 0x8888888888888888ULL)
+			return -EINVAL;
+
+		packed->val = ((uint64_t)digits << 60) | val;
+		return 0;
+
+	default:
+		return -EINVAL;
+	}
+}
+
 /*! Convert TS 04.08 Mobile Identity (10.5.1.4) to string.
  * This function does not validate the Mobile Identity digits, i.e. digits > 9 are returned as 'A'-'F'.
  *  \param[out] string Caller-provided buffer for output
@@ -128,13 +128,20 @@ int gsm48_decode_bcd_number2(char *output, size_t output_len,
 /*! convert a single ASCII character to call-control BCD */
 static int asc_to_bcd(const char asc)
 {
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(bcd_num_digits); i++) {
-		if (bcd_num_digits[i] == asc)
-			return i;
+	if (asc >= '0' && asc <= '9')
+		return asc - '0';
+	switch (asc) {
+	case '*':
+		return 0xa;
+	case '#':
+		return 0xb;
+	case 'a':
+	case 'b':
+	case 'c':
+		return 0xc + (asc - 'a');
+	default:
+		return -EINVAL;
 	}
-	return -EINVAL;
 }
 
 /*! convert a ASCII phone number to 'called/calling/connect party BCD number'
@@ -81,6 +81,8 @@
 //#include <openbsc/gsm_data.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/bitvec.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/endian.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/meas_rep.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
@@ -174,15 +176,102 @@ static unsigned char gsm_7bit_alphabet[] = {
 	0xff, 0x7d, 0x08, 0xff, 0xff, 0xff, 0x7c, 0xff, 0x0c, 0x06, 0xff, 0xff, 0x7e, 0xff, 0xff
 };
 
-/* GSM 03.38 6.2.1 Character lookup for decoding */
-static int gsm_septet_lookup(uint8_t ch)
+/* GSM 03.38 6.2.1 Character lookup for decoding: the latin1 character for
+ * each septet at [0x00..0x7f], for each extension septet at [0x80..0xff];
+ * 0xff where there is none. Derived from gsm_7bit_alphabet on load. */
+static uint8_t gsm_7bit_decode_tbl[256];
+
+/* 3GPP TS 23.038 6.2.1 default alphabet, as Unicode code points; 0x1b is
+ * the escape to the extension table */
+static const uint16_t gsm_7bit_ucs[128] = {
+	0x0040, 0x00a3, 0x0024, 0x00a5, 0x00e8, 0x00e9, 0x00f9, 0x00ec,
+	0x00f2, 0x00c7, 0x000a, 0x00d8, 0x00f8, 0x000d, 0x00c5, 0x00e5,
+	0x0394, 0x005f, 0x03a6, 0x0393, 0x039b, 0x03a9, 0x03a0, 0x03a8,
+	0x03a3, 0x0398, 0x039e, 0x0000, 0x00c6, 0x00e6, 0x00df, 0x00c9,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x00a4, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002a, 0x002b, 0x002c, 0x002d, 0x002e, 0x002f,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003a, 0x003b, 0x003c, 0x003d, 0x003e, 0x003f,
+	0x00a1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004a, 0x004b, 0x004c, 0x004d, 0x004e, 0x004f,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005a, 0x00c4, 0x00d6, 0x00d1, 0x00dc, 0x00a7,
+	0x00bf, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006a, 0x006b, 0x006c, 0x006d, 0x006e, 0x006f,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007a, 0x00e4, 0x00f6, 0x00f1, 0x00fc, 0x00e0,
+};
+
+/* 3GPP TS 23.038 6.2.1.1 default alphabet extension table */
+static const struct {
+	uint8_t septet;
+	uint16_t ucs;
+} gsm_7bit_ext_ucs[] = {
+	{ 0x0a, 0x000c },
+	{ 0x14, 0x005e },
+	{ 0x28, 0x007b },
+	{ 0x29, 0x007d },
+	{ 0x2f, 0x005c },
+	{ 0x3c, 0x005b },
+	{ 0x3d, 0x007e },
+	{ 0x3e, 0x005d },
+	{ 0x40, 0x007c },
+	{ 0x65, 0x20ac },
+};
+
+/* UTF-8/UCS2 transcoding: the septet for each code point below 0x100,
+ * with GSM7_EXT set for extension characters; GSM7_NONE where there is none.
+ * Derived from the two tables above on load. */
+#define GSM7_EXT	0x80
+#define GSM7_NONE	0xff
+static uint8_t gsm_7bit_encode_tbl[256];
+
+/* latin1 characters that gsm_septet_encode() escapes into the extension table */
+static bool gsm_7bit_is_ext(uint8_t ch)
 {
-	int i = 0;
-	for (; i < sizeof(gsm_7bit_alphabet); i++) {
-		if (gsm_7bit_alphabet[i] == ch)
-			return i;
+	switch (ch) {
+	case 0x0c:
+	case 0x5e:
+	case 0x7b:
+	case 0x7d:
+	case 0x5c:
+	case 0x5b:
+	case 0x7e:
+	case 0x5d:
+	case 0x7c:
+		return true;
+	default:
+		return false;
 	}
-	return -1;
+}
+
+static __attribute__((constructor)) void on_dso_load_gsm_7bit(void)
+{
+	int i, c7;
+
+	memset(gsm_7bit_decode_tbl, 0xff, sizeof(gsm_7bit_decode_tbl));
+	/* first match, like the linear search through the merged table this replaces */
+	for (c7 = 0; c7 < 0x80; c7++) {
+		for (i = 0; i < sizeof(gsm_7bit_alphabet); i++) {
+			if (gsm_7bit_alphabet[i] == c7) {
+				gsm_7bit_decode_tbl[c7] = i;
+				break;
+			}
+		}
+		gsm_7bit_decode_tbl[0x80 | c7] = gsm_7bit_alphabet[0x7f + c7];
+	}
+
+	memset(gsm_7bit_encode_tbl, GSM7_NONE, sizeof(gsm_7bit_encode_tbl));
+	for (c7 = 0; c7 < 0x80; c7++) {
+		if (c7 != 0x1b && gsm_7bit_ucs[c7] < 0x100)
+			gsm_7bit_encode_tbl[gsm_7bit_ucs[c7]] = c7;
+	}
+	for (i = 0; i < ARRAY_SIZE(gsm_7bit_ext_ucs); i++) {
+		if (gsm_7bit_ext_ucs[i].ucs < 0x100)
+			gsm_7bit_encode_tbl[gsm_7bit_ext_ucs[i].ucs] = GSM7_EXT | gsm_7bit_ext_ucs[i].septet;
+	}
+	/* the small letter is commonly sent for the capital one, TS 23.038 only has the latter */
+	gsm_7bit_encode_tbl[0xe7] = gsm_7bit_encode_tbl[0xc7];
 }
 
 /*! Compute number of octets from number of septets.
@@ -197,6 +286,96 @@ uint8_t gsm_get_octet_len(const uint8_t sept_len){
 	return octet_len;
 }
 
+/* unaligned little endian word access for the septet packing, without
+ * going byte by byte where the host order already matches */
+static inline uint64_t septets_load64le(const uint8_t *p)
+{
+#if OSMO_IS_LITTLE_ENDIAN
+	uint64_t x;
+	memcpy(&x, p, sizeof(x));
+	return x;
+#else
+	return osmo_load64le(p);
+#endif
+}
+
+static inline void septets_store64le_ext(uint64_t x, uint8_t *p, uint8_t n)
+{
+#if OSMO_IS_LITTLE_ENDIAN
+	memcpy(p, &x, n);
+#else
+	osmo_store64le_ext(x, p, n);
+#endif
+}
+
+/* Unpack septets first .. first + count - 1 of the packed user data, of which
+ * maxlen octets may be read. Whole words of eight septets are expanded at once
+ * where possible. */
+static void gsm_septets_unpack(uint8_t *septets, const uint8_t *user_data, unsigned int first, unsigned int count,
+			       unsigned int maxlen)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; ) {
+		unsigned int bit = (first + i) * 7;
+		unsigned int r = bit >> 3;
+
+		if (count - i >= 8 && r + 8 <= maxlen) {
+			uint64_t x = septets_load64le(user_data + r) >> (bit & 7);
+			/* spread 8 x 7 bits over 8 octets */
+			x = (x & 0x000000000fffffffULL) | ((x & 0x00fffffff0000000ULL) << 4);
+			x = (x & 0x00003fff00003fffULL) | ((x & 0x0fffc0000fffc000ULL) << 2);
+			x = (x & 0x007f007f007f007fULL) | ((x & 0x3f803f803f803f80ULL) << 1);
+			septets_store64le_ext(x, septets + i, 8);
+			i += 8;
+		} else {
+			unsigned int v = user_data[r];
+			/* the next octet is beyond the user data for the last septet sometimes */
+			if (r + 1 < maxlen)
+				v |= user_data[r + 1] << 8;
+			septets[i++] = (v >> (bit & 7)) & 0x7f;
+		}
+	}
+}
+
+/* Pack septets behind padding zero bits, eight septets per word where
+ * possible. Returns the number of octets written. */
+static int gsm_septets_pack(uint8_t *result, const uint8_t *septets, unsigned int septet_len, unsigned int padding)
+{
+	uint64_t acc = 0;
+	unsigned int bits = padding;
+	unsigned int i = 0;
+	uint8_t *out = result;
+
+	for (; i + 8 <= septet_len; i += 8) {
+		uint64_t x = septets_load64le(septets + i);
+		/* squeeze 8 x 7 bits into 56 bits */
+		x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+		x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+		x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+		/* fewer than 8 bits are pending, so this all fits in 64 bits */
+		acc |= x << bits;
+		septets_store64le_ext(acc, out, 7);
+		out += 7;
+		acc = bits ? x >> (56 - bits) : 0;
+	}
+
+	for (; i < septet_len; i++) {
+		acc |= (uint64_t)(septets[i] & 0x7f) << bits;
+		bits += 7;
+		if (bits >= 8) {
+			*out++ = acc;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+
+	if (bits)
+		*out++ = acc;
+
+	return out - result;
+}
+
 /*! TS 03.38 7-bit Character unpacking (6.2.1)
  *  \param[out] text Caller-provided output text buffer
  *  \param[in] n Length of \a text
@@ -207,10 +386,12 @@ uint8_t gsm_get_octet_len(const uint8_t sept_len){
 int gsm_7bit_decode_n_hdr(char *text, size_t n, const uint8_t *user_data, uint8_t septet_l, uint8_t ud_hdr_ind)
 {
 	unsigned shift = 0;
-	uint8_t c7, c8, next_is_ext = 0, lu, ru;
+	uint8_t c7, c8, next_is_ext = 0;
 	const uint8_t maxlen = gsm_get_octet_len(septet_l);
 	const char *text_buf_begin = text;
 	const char *text_buf_end = text + n;
+	uint8_t septets[256];
+	unsigned i;
 
 	OSMO_ASSERT (n > 0);
 
@@ -223,34 +404,21 @@ int gsm_7bit_decode_n_hdr(char *text, size_t n, const uint8_t *user_data, uint8_
 		septet_l = septet_l - shift;
 	}
 
-	unsigned i, l, r;
-	for (i = 0; i < septet_l && text != text_buf_end - 1; i++) {
-
-		l = ((i + shift) * 7 + 7) >> 3;
-		r = ((i + shift) * 7) >> 3;
-
-		/* the left side index is always >= right side index
-		sometimes it even gets beyond array boundary
-		check for that explicitly and force 0 instead
-		 */
-		if (l >= maxlen)
-			lu = 0;
-		else
-			lu = user_data[l] << (7 - (((i + shift) * 7 + 7) & 7));
-
-		ru = user_data[r] >> (((i + shift) * 7) & 7);
+	/* no need to unpack more septets than fit into text */
+	gsm_septets_unpack(septets, user_data, shift, OSMO_MIN(septet_l, 2 * (n - 1)), maxlen);
 
-		c7 = (lu | ru) & 0x7f;
+	for (i = 0; i < septet_l && text != text_buf_end - 1; i++) {
+		c7 = septets[i];
 
 		if (next_is_ext) {
 			/* this is an extension character */
 			next_is_ext = 0;
-			c8 = gsm_7bit_alphabet[0x7f + c7];
+			c8 = gsm_7bit_decode_tbl[0x80 | c7];
 		} else if (c7 == 0x1b && i + 1 < septet_l) {
 			next_is_ext = 1;
 			continue;
 		} else {
-			c8 = gsm_septet_lookup(c7);
+			c8 = gsm_7bit_decode_tbl[c7];
 		}
 
 		*(text++) = c8;
@@ -291,28 +459,13 @@ int gsm_7bit_decode_n_ussd(char *text, size_t n, const uint8_t *user_data, uint8
  *  \returns number of octets used in \a result */
 int gsm_septet_encode(uint8_t *result, const char *data)
 {
-	int i, y = 0;
+	int y = 0;
 	uint8_t ch;
-	for (i = 0; i < strlen(data); i++) {
-		ch = data[i];
-		switch(ch){
-		/* fall-through for extension characters */
-		case 0x0c:
-		case 0x5e:
-		case 0x7b:
-		case 0x7d:
-		case 0x5c:
-		case 0x5b:
-		case 0x7e:
-		case 0x5d:
-		case 0x7c:
+
+	for (; (ch = *data); data++) {
+		if (gsm_7bit_is_ext(ch))
 			result[y++] = 0x1b;
-		/* fall-through */
-		default:
-			result[y] = gsm_7bit_alphabet[ch];
-			break;
-		}
-		y++;
+		result[y++] = gsm_7bit_alphabet[ch];
 	}
 
 	return y;
@@ -326,47 +479,7 @@ int gsm_septet_encode(uint8_t *result, const char *data)
  *  \returns number of bytes used in \a result */
 int gsm_septets2octets(uint8_t *result, const uint8_t *rdata, uint8_t septet_len, uint8_t padding)
 {
-	int i = 0, z = 0;
-	uint8_t cb, nb;
-	int shift = 0;
-	uint8_t *data = calloc(septet_len + 1, sizeof(uint8_t));
-
-	if (padding) {
-		shift = 7 - padding;
-		/* the first zero is needed for padding */
-		memcpy(data + 1, rdata, septet_len);
-		septet_len++;
-	} else
-		memcpy(data, rdata, septet_len);
-
-	for (i = 0; i < septet_len; i++) {
-		if (shift == 7) {
-			/*
-			 * special end case with the. This is necessary if the
-			 * last septet fits into the previous octet. E.g. 48
-			 * non-extension characters:
-			 *   ....ag ( a = 1100001, g = 1100111)
-			 * result[40] = 100001 XX, result[41] = 1100111 1 */
-			if (i + 1 < septet_len) {
-				shift = 0;
-				continue;
-			} else if (i + 1 == septet_len)
-				break;
-		}
-
-		cb = (data[i] & 0x7f) >> shift;
-		if (i + 1 < septet_len) {
-			nb = (data[i + 1] & 0x7f) << (7 - shift);
-			cb = cb | nb;
-		}
-
-		result[z++] = cb;
-		shift++;
-	}
-
-	free(data);
-
-	return z;
+	return gsm_septets_pack(result, rdata, septet_len, padding);
 }
 
 /*! GSM 7-bit alphabet TS 03.38 6.2.1 Character packing
@@ -380,9 +493,11 @@ int gsm_7bit_encode_n(uint8_t *result, size_t n, const char *data, int *octets)
 	int y = 0;
 	int o;
 	size_t max_septets = n * 8 / 7;
+	size_t len = strlen(data);
+	uint8_t buf[320];
 
 	/* prepare for the worst case, every character expanding to two bytes */
-	uint8_t *rdata = calloc(strlen(data) * 2, sizeof(uint8_t));
+	uint8_t *rdata = len * 2 <= sizeof(buf) ? buf : calloc(len * 2, sizeof(uint8_t));
 	y = gsm_septet_encode(rdata, data);
 
 	if (y > max_septets) {
@@ -398,7 +513,8 @@ int gsm_7bit_encode_n(uint8_t *result, size_t n, const char *data, int *octets)
 	if (octets)
 		*octets = o;
 
-	free(rdata);
+	if (rdata != buf)
+		free(rdata);
 
 	/*
 	 * We don't care about the number of octets, because they are not
@@ -437,6 +553,260 @@ int gsm_7bit_encode_n_ussd(uint8_t *result, size_t n, const char *data, int *oct
 	return y;
 }
 
+/* Decode one UTF-8 sequence; returns its length and sets *ucs, or returns
+ * -EINVAL for malformed, overlong or surrogate sequences. */
+static int utf8_decode(const char *str, uint32_t *ucs)
+{
+	const uint8_t *s = (const uint8_t *)str;
+	uint32_t c;
+	int len, i;
+
+	if (s[0] < 0x80) {
+		*ucs = s[0];
+		return 1;
+	} else if ((s[0] & 0xe0) == 0xc0) {
+		c = s[0] & 0x1f;
+		len = 2;
+	} else if ((s[0] & 0xf0) == 0xe0) {
+		c = s[0] & 0x0f;
+		len = 3;
+	} else if ((s[0] & 0xf8) == 0xf0) {
+		c = s[0] & 0x07;
+		len = 4;
+	} else
+		return -EINVAL;
+
+	for (i = 1; i < len; i++) {
+		if ((s[i] & 0xc0) != 0x80)
+			return -EINVAL;
+		c = (c << 6) | (s[i] & 0x3f);
+	}
+
+	if ((len == 2 && c < 0x80) || (len == 3 && c < 0x800) || (len == 4 && c < 0x10000)
+	    || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+		return -EINVAL;
+
+	*ucs = c;
+	return len;
+}
+
+/* Encode one code point as UTF-8 if it fits into the remaining \a n bytes;
+ * returns its length or 0 if it does not fit. */
+static int utf8_encode(char *out, size_t n, uint32_t c)
+{
+	if (c < 0x80 && n >= 1) {
+		out[0] = c;
+		return 1;
+	} else if (c < 0x800 && n >= 2) {
+		out[0] = 0xc0 | (c >> 6);
+		out[1] = 0x80 | (c & 0x3f);
+		return 2;
+	} else if (c >= 0x800 && c < 0x10000 && n >= 3) {
+		out[0] = 0xe0 | (c >> 12);
+		out[1] = 0x80 | ((c >> 6) & 0x3f);
+		out[2] = 0x80 | (c & 0x3f);
+		return 3;
+	} else if (c >= 0x10000 && n >= 4) {
+		out[0] = 0xf0 | (c >> 18);
+		out[1] = 0x80 | ((c >> 12) & 0x3f);
+		out[2] = 0x80 | ((c >> 6) & 0x3f);
+		out[3] = 0x80 | (c & 0x3f);
+		return 4;
+	}
+	return 0;
+}
+
+/* septet for a code point, with GSM7_EXT set for extension characters, or GSM7_NONE */
+static uint8_t gsm_7bit_from_ucs(uint32_t c)
+{
+	int i;
+
+	if (c < 0x100)
+		return gsm_7bit_encode_tbl[c];
+	for (i = 0; i < 0x80; i++) {
+		if (gsm_7bit_ucs[i] == c)
+			return i;
+	}
+	for (i = 0; i < ARRAY_SIZE(gsm_7bit_ext_ucs); i++) {
+		if (gsm_7bit_ext_ucs[i].ucs == c)
+			return GSM7_EXT | gsm_7bit_ext_ucs[i].septet;
+	}
+	return GSM7_NONE;
+}
+
+/* code point for an extension table septet, or 0 if there is none */
+static uint32_t gsm_7bit_ext_to_ucs(uint8_t septet)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gsm_7bit_ext_ucs); i++) {
+		if (gsm_7bit_ext_ucs[i].septet == septet)
+			return gsm_7bit_ext_ucs[i].ucs;
+	}
+	return 0;
+}
+
+/*! Encode a UTF-8 string into packed GSM 03.38 7 bit characters.
+ *  \param[out] result Caller-provided output buffer
+ *  \param[in] n Maximum length of \a result in bytes
+ *  \param[in] utf8 zero-terminated UTF-8 string
+ *  \param[out] octets Number of octets encoded, if not NULL
+ *  \returns number of septets encoded; -EINVAL if \a utf8 is not valid UTF-8 or contains a character that the
+ *	     default alphabet and its extension table cannot represent, e.g. to fall back to UCS2.
+ *
+ *  Unlike gsm_7bit_encode_n(), which maps latin1 characters, this understands the complete default alphabet
+ *  including the greek characters and the euro sign. If \a result is too small, the text is cut off in front of
+ *  the first character that does not fit completely. */
+int gsm_7bit_encode_n_utf8(uint8_t *result, size_t n, const char *utf8, int *octets)
+{
+	uint8_t septets[256];
+	size_t max_septets = OSMO_MIN(n * 8 / 7, sizeof(septets));
+	unsigned int y = 0;
+	bool full = false;
+	uint32_t c;
+	int len, o;
+
+	for (; *utf8; utf8 += len) {
+		uint8_t sept;
+
+		len = utf8_decode(utf8, &c);
+		if (len < 0)
+			return -EINVAL;
+		sept = gsm_7bit_from_ucs(c);
+		if (sept == GSM7_NONE)
+			return -EINVAL;
+		if (full || y + ((sept & GSM7_EXT) ? 2 : 1) > max_septets) {
+			/* keep validating, so that the result does not depend on n */
+			full = true;
+			continue;
+		}
+		if (sept & GSM7_EXT)
+			septets[y++] = 0x1b;
+		septets[y++] = sept & 0x7f;
+	}
+
+	o = gsm_septets_pack(result, septets, y, 0);
+	if (octets)
+		*octets = o;
+	return y;
+}
+
+/*! Decode packed GSM 03.38 7 bit characters into a UTF-8 string.
+ *  \param[out] text Caller-provided output buffer
+ *  \param[in] n Length of \a text, at least 1
+ *  \param[in] user_data Packed septets
+ *  \param[in] septet_l Number of septets in \a user_data
+ *  \param[in] ud_hdr_ind User Data Header present in data
+ *  \returns number of bytes written to \a text, excluding the terminating nul
+ *
+ *  Unknown extension characters map to their default alphabet character as in 3GPP TS 23.038 6.2.1.1, an escaped
+ *  escape to a space, and a trailing escape to U+FFFD. The output is cut off in front of the first character that does not fit. */
+int gsm_7bit_decode_n_utf8(char *text, size_t n, const uint8_t *user_data, uint8_t septet_l, uint8_t ud_hdr_ind)
+{
+	unsigned int shift = 0;
+	const uint8_t maxlen = gsm_get_octet_len(septet_l);
+	uint8_t septets[256];
+	size_t pos = 0;
+	unsigned int i;
+
+	OSMO_ASSERT(n > 0);
+
+	if (ud_hdr_ind) {
+		shift = ((user_data[0] + 1) * 8 + 6) / 7;
+		if (shift > septet_l)
+			shift = septet_l;
+		septet_l -= shift;
+	}
+
+	gsm_septets_unpack(septets, user_data, shift, septet_l, maxlen);
+
+	for (i = 0; i < septet_l; i++) {
+		uint32_t c = 0;
+		int len;
+
+		if (septets[i] == 0x1b && i + 1 < septet_l) {
+			c = gsm_7bit_ext_to_ucs(septets[++i]);
+			/* escape to a further extension table, to be shown as a space (TS 23.038 6.2.1.1) */
+			if (!c && septets[i] == 0x1b)
+				c = ' ';
+			else if (!c)
+				c = gsm_7bit_ucs[septets[i]];
+		} else
+			c = gsm_7bit_ucs[septets[i]];
+
+		/* only a trailing escape is left without a character */
+		len = utf8_encode(text + pos, n - 1 - pos, c ? : 0xfffd);
+		if (!len)
+			break;
+		pos += len;
+	}
+
+	text[pos] = '\0';
+	return pos;
+}
+
+/*! Encode a UTF-8 string as UCS2 (big endian, 3GPP TS 23.038 6.2.3).
+ *  \param[out] result Caller-provided output buffer
+ *  \param[in] n Maximum length of \a result in bytes
+ *  \param[in] utf8 zero-terminated UTF-8 string
+ *  \returns number of octets written; -EINVAL if \a utf8 is not valid UTF-8 or contains characters outside the
+ *	     basic multilingual plane. If \a result is too small, the text is cut off. */
+int gsm_ucs2_encode_utf8(uint8_t *result, size_t n, const char *utf8)
+{
+	size_t pos = 0;
+	uint32_t c;
+	int len;
+
+	for (; *utf8; utf8 += len) {
+		len = utf8_decode(utf8, &c);
+		if (len < 0 || c > 0xffff)
+			return -EINVAL;
+		if (pos + 2 > n)
+			continue;
+		result[pos++] = c >> 8;
+		result[pos++] = c;
+	}
+
+	return pos;
+}
+
+/*! Decode UCS2 (big endian, 3GPP TS 23.038 6.2.3) into a UTF-8 string.
+ *  \param[out] text Caller-provided output buffer
+ *  \param[in] n Length of \a text, at least 1
+ *  \param[in] ucs2 UCS2 encoded characters
+ *  \param[in] len Length of \a ucs2 in bytes; an odd last byte is ignored
+ *  \returns number of bytes written to \a text, excluding the terminating nul
+ *
+ *  UTF-16 surrogate pairs, as sent by some phones, are combined; lone surrogates map to U+FFFD. The output is cut
+ *  off in front of the first character that does not fit. */
+int gsm_ucs2_decode_utf8(char *text, size_t n, const uint8_t *ucs2, size_t len)
+{
+	size_t pos = 0;
+	size_t i;
+
+	OSMO_ASSERT(n > 0);
+
+	for (i = 0; i + 1 < len; i += 2) {
+		uint32_t c = (ucs2[i] << 8) | ucs2[i + 1];
+		int l;
+
+		if (c >= 0xd800 && c <= 0xdbff && i + 3 < len
+		    && (ucs2[i + 2] & 0xfc) == 0xdc) {
+			c = 0x10000 + ((c - 0xd800) << 10) + ((((ucs2[i + 2] << 8) | ucs2[i + 3])) - 0xdc00);
+			i += 2;
+		} else if (c >= 0xd800 && c <= 0xdfff)
+			c = 0xfffd;
+
+		l = utf8_encode(text + pos, n - 1 - pos, c);
+		if (!l)
+			break;
+		pos += l;
+	}
+
+	text[pos] = '\0';
+	return pos;
+}
+
 /*! Generate random identifier
  *  We use /dev/urandom (default when GRND_RANDOM flag is not set).
  *  Both /dev/(u)random numbers are coming from the same CSPRNG anyway (at least on GNU/Linux >= 4.8).
@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <sys/types.h>
 
@@ -689,6 +690,176 @@ discard_msg:
 	return ret;
 }
 
+/*! Receive buffer of a streaming IPA receiver */
+struct ipa_stream_rx {
+	/*! receive buffer */
+	uint8_t *buf;
+	/*! size of buf */
+	unsigned int size;
+	/*! offset of the first byte not yet handed out by ipa_stream_rx_next() */
+	unsigned int head;
+	/*! offset of the first free byte in buf */
+	unsigned int tail;
+	/*! sticky error, returned once the buffered frames have been consumed */
+	int error;
+};
+
+/*! Allocate a streaming IPA receiver.
+ *  \param[in] ctx talloc context to allocate from.
+ *  \param[in] size size of the receive buffer; at least IPA_ALLOC_SIZE.
+ *  \returns newly allocated receiver, or NULL on error.
+ *
+ *  Unlike \ref ipa_msg_recv_buffered, which issues two recv() calls per frame,
+ *  the streaming receiver reads as much as fits into its buffer with a single
+ *  recv() and then slices all complete frames out of it. A partial frame at the
+ *  end of the buffer is kept and completed by the next recv(). */
+struct ipa_stream_rx *ipa_stream_rx_alloc(void *ctx, unsigned int size)
+{
+	struct ipa_stream_rx *srx;
+
+	if (size < IPA_ALLOC_SIZE)
+		size = IPA_ALLOC_SIZE;
+
+	srx = talloc_zero(ctx, struct ipa_stream_rx);
+	if (!srx)
+		return NULL;
+	srx->buf = talloc_size(srx, size);
+	if (!srx->buf) {
+		talloc_free(srx);
+		return NULL;
+	}
+	srx->size = size;
+	return srx;
+}
+
+/*! Free a streaming IPA receiver and all data buffered in it. */
+void ipa_stream_rx_free(struct ipa_stream_rx *srx)
+{
+	talloc_free(srx);
+}
+
+/*! Read from a stream socket into the receive buffer of a streaming IPA receiver.
+ *  \param[in] srx streaming IPA receiver.
+ *  \param[in] fd The fd for the socket to read from.
+ *  \returns number of bytes read, -EAGAIN if nothing could be read, 0 if the
+ *  socket is found dead, other negative values on error.
+ *
+ *  Frames previously returned by \ref ipa_stream_rx_next become invalid. */
+int ipa_stream_rx_recv(struct ipa_stream_rx *srx, int fd)
+{
+	int rc;
+
+	if (srx->error)
+		return srx->error;
+
+	/* move the remaining partial frame (if any) to the start of the buffer */
+	if (srx->head > 0) {
+		if (srx->tail > srx->head)
+			memmove(srx->buf, srx->buf + srx->head, srx->tail - srx->head);
+		srx->tail -= srx->head;
+		srx->head = 0;
+	}
+
+	if (srx->tail == srx->size) {
+		/* a frame larger than the buffer; ipa_stream_rx_next() flags it */
+		return -EIO;
+	}
+
+	rc = recv(fd, srx->buf + srx->tail, srx->size - srx->tail, 0);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return -EAGAIN;
+		return -errno;
+	}
+	srx->tail += rc;
+	return rc;
+}
+
+/*! Obtain the next complete frame from the receive buffer without copying it.
+ *  \param[in] srx streaming IPA receiver.
+ *  \param[out] hh pointer to the IPA header of the frame, followed by its payload.
+ *  \returns payload length of the frame; 0 if no complete frame is buffered;
+ *  -EIO if the stream contains a frame of bad length and must be closed.
+ *
+ *  The returned frame stays valid until the next call of \ref ipa_stream_rx_recv.
+ *  Frames without payload are skipped, like in \ref ipa_msg_recv_buffered. */
+int ipa_stream_rx_next(struct ipa_stream_rx *srx, const struct ipaccess_head **hh)
+{
+	const struct ipaccess_head *h;
+	unsigned int avail, len;
+
+	while (!srx->error) {
+		avail = srx->tail - srx->head;
+		if (avail < sizeof(*h))
+			return 0;
+
+		h = (const struct ipaccess_head *) (srx->buf + srx->head);
+		len = osmo_ntohs(h->len);
+		if (IPA_ALLOC_SIZE < len + sizeof(*h) || srx->size < len + sizeof(*h)) {
+			LOGP(DLINP, LOGL_ERROR, "bad message length of %u bytes, "
+						"received %u bytes\n", len, avail);
+			srx->error = -EIO;
+			break;
+		}
+		if (avail < len + sizeof(*h))
+			return 0;
+
+		srx->head += len + sizeof(*h);
+		if (len == 0) {
+			LOGP(DLINP, LOGL_INFO,
+			     "Discarding IPA message without payload\n");
+			continue;
+		}
+		*hh = h;
+		return len;
+	}
+	return srx->error;
+}
+
+/*! Read all available IPA frames from socket fd with a single recv().
+ *  \param[in] fd The fd for the socket to read from.
+ *  \param[in] srx streaming IPA receiver buffering the stream of fd.
+ *  \param[out] msgs list to append one msgb per complete frame to.
+ *  \returns number of msgb appended to msgs, -EAGAIN if no frame is complete
+ *  yet, 0 if the socket is found dead, other negative values on error.
+ *
+ *  Each msgb is laid out as the ones returned by \ref ipa_msg_recv_buffered,
+ *  with l1h pointing to the IPA header and l2h to the payload. If an error is
+ *  detected after some frames were read, those are returned first and the
+ *  error is returned by the next call. */
+int ipa_msg_recv_batch(int fd, struct ipa_stream_rx *srx, struct llist_head *msgs)
+{
+	const struct ipaccess_head *hh;
+	struct msgb *msg;
+	int rc, len, num = 0;
+
+	rc = ipa_stream_rx_recv(srx, fd);
+	if (rc <= 0)
+		return rc;
+
+	while ((len = ipa_stream_rx_next(srx, &hh)) > 0) {
+		msg = ipa_msg_alloc(0);
+		if (!msg) {
+			srx->error = -ENOMEM;
+			break;
+		}
+		/* ipa_msg_alloc() reserves headroom for the header */
+		msgb_push(msg, sizeof(*hh));
+		msg->l1h = msg->data;
+		memcpy(msg->data, hh, sizeof(*hh) + len);
+		msgb_put(msg, len);
+		msg->l2h = msg->l1h + sizeof(*hh);
+		msgb_enqueue(msgs, msg);
+		num++;
+	}
+
+	if (num > 0)
+		return num;
+	if (srx->error)
+		return srx->error;
+	return -EAGAIN;
+}
+
 #endif /* SYS_SOCKET_H */
 
 struct msgb *ipa_msg_alloc(int headroom)
@@ -23,6 +23,7 @@
  *
  */
 
+#define _GNU_SOURCE
 #include "../config.h"
 
 #include <osmocom/core/gsmtap_util.h>
@@ -33,12 +34,20 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/byteswap.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/gsm/rsl.h>
 
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <string.h>
@@ -133,6 +142,23 @@ void chantype_gsmtap2rsl(uint8_t gsmtap_chantype, uint8_t *rsl_chantype,
 	*link_id = gsmtap_chantype & GSMTAP_CHANNEL_ACCH ? 0x40 : 0x00;
 }
 
+static void gsmtap_fill_hdr(struct gsmtap_hdr *gh, uint8_t type, uint16_t arfcn, uint8_t ts,
+			    uint8_t chan_type, uint8_t ss, uint32_t fn, int8_t signal_dbm,
+			    uint8_t snr)
+{
+	gh->version = GSMTAP_VERSION;
+	gh->hdr_len = sizeof(*gh)/4;
+	gh->type = type;
+	gh->timeslot = ts;
+	gh->sub_slot = ss;
+	gh->arfcn = osmo_htons(arfcn);
+	gh->snr_db = snr;
+	gh->signal_dbm = signal_dbm;
+	gh->frame_number = osmo_htonl(fn);
+	gh->sub_type = chan_type;
+	gh->antenna_nr = 0;
+}
+
 /*! create an arbitrary type GSMTAP message
  *  \param[in] type The GSMTAP_TYPE_xxx constant of the message to create
  *  \param[in] arfcn GSM ARFCN (Channel Number)
@@ -162,18 +188,7 @@ struct msgb *gsmtap_makemsg_ex(uint8_t type, uint16_t arfcn, uint8_t ts, uint8_t
 		return NULL;
 
 	gh = (struct gsmtap_hdr *) msgb_put(msg, sizeof(*gh));
-
-	gh->version = GSMTAP_VERSION;
-	gh->hdr_len = sizeof(*gh)/4;
-	gh->type = type;
-	gh->timeslot = ts;
-	gh->sub_slot = ss;
-	gh->arfcn = osmo_htons(arfcn);
-	gh->snr_db = snr;
-	gh->signal_dbm = signal_dbm;
-	gh->frame_number = osmo_htonl(fn);
-	gh->sub_type = chan_type;
-	gh->antenna_nr = 0;
+	gsmtap_fill_hdr(gh, type, arfcn, ts, chan_type, ss, fn, signal_dbm, snr);
 
 	dst = msgb_put(msg, len);
 	memcpy(dst, data, len);
@@ -204,6 +219,213 @@ struct msgb *gsmtap_makemsg(uint16_t arfcn, uint8_t ts, uint8_t chan_type,
 		ss, fn, signal_dbm, snr, data, len);
 }
 
+/*! Initialize a GSMTAP source filter that permits everything.
+ *  \param[out] flt filter to initialize */
+void gsmtap_filter_init(struct gsmtap_filter *flt)
+{
+	memset(flt, 0, sizeof(*flt));
+	flt->arfcn_max = GSMTAP_ARFCN_MASK;
+}
+
+static inline bool mask_empty(const uint32_t *mask, unsigned int words)
+{
+	unsigned int i;
+
+	for (i = 0; i < words; i++) {
+		if (mask[i])
+			return false;
+	}
+	return true;
+}
+
+/* an empty mask permits any value */
+static inline bool mask_test(const uint32_t *mask, unsigned int words, unsigned int bit)
+{
+	return mask_empty(mask, words) || (mask[bit / 32] & (1U << (bit % 32)));
+}
+
+/* Parse a list like "1,3-5,BCCH" into the bit mask; names are looked up in vs if given */
+static int filter_parse_list(uint32_t *mask, unsigned int max, const struct value_string *vs,
+			     const char *list)
+{
+	char buf[256], *item, *saveptr = NULL, *end;
+	unsigned long from, to, i;
+	int val;
+
+	if (osmo_strlcpy(buf, list, sizeof(buf)) >= sizeof(buf))
+		return -EINVAL;
+
+	for (item = strtok_r(buf, ",", &saveptr); item; item = strtok_r(NULL, ",", &saveptr)) {
+		if (vs && (val = get_string_value(vs, item)) >= 0) {
+			from = to = val & max;
+		} else {
+			from = strtoul(item, &end, 0);
+			if (end == item)
+				return -EINVAL;
+			to = from;
+			if (*end == '-') {
+				item = end + 1;
+				to = strtoul(item, &end, 0);
+				if (end == item)
+					return -EINVAL;
+			}
+			if (*end != '\0' || from > to || to > max)
+				return -EINVAL;
+		}
+		for (i = from; i <= to; i++)
+			mask[i / 32] |= 1U << (i % 32);
+	}
+	return 0;
+}
+
+static int filter_parse_uint(unsigned long *val, unsigned long max, const char *str)
+{
+	char *end;
+
+	*val = strtoul(str, &end, 0);
+	if (end == str || *end != '\0' || *val > max)
+		return -EINVAL;
+	return 0;
+}
+
+/*! Parse a textual GSMTAP source filter specification.
+ *  \param[out] flt filter to fill; unchanged on error
+ *  \param[in] spec specification, e.g. "type=1 chan=BCCH,CCCH arfcn=10-20 ts=0-1 sample=10 rate=100"
+ *  \returns 0 on success; -EINVAL on a syntax error
+ *
+ *  The keys are separated by spaces and may appear in any order; keys not
+ *  given permit any value. type, chan, ts and ss take comma separated lists
+ *  of numbers or ranges, chan also takes names of \ref gsmtap_gsm_channel_names.
+ *  arfcn takes a single number or range. An empty spec or "all" permits
+ *  everything. */
+int gsmtap_filter_parse(struct gsmtap_filter *flt, const char *spec)
+{
+	struct gsmtap_filter tmp;
+	char buf[512], *tok, *saveptr = NULL, *val;
+	unsigned long num, num2;
+	uint32_t mask[1];
+	char *dash;
+	int rc = 0;
+
+	if (osmo_strlcpy(buf, spec, sizeof(buf)) >= sizeof(buf))
+		return -EINVAL;
+
+	gsmtap_filter_init(&tmp);
+	for (tok = strtok_r(buf, " \t", &saveptr); tok && !rc; tok = strtok_r(NULL, " \t", &saveptr)) {
+		if (!strcmp(tok, "all"))
+			continue;
+		val = strchr(tok, '=');
+		if (!val)
+			return -EINVAL;
+		*val++ = '\0';
+
+		if (!strcmp(tok, "type")) {
+			rc = filter_parse_list(tmp.type_mask, 0xff, NULL, val);
+		} else if (!strcmp(tok, "chan")) {
+			rc = filter_parse_list(tmp.chan_mask, 0x7f, gsmtap_gsm_channel_names, val);
+		} else if (!strcmp(tok, "ts")) {
+			mask[0] = 0;
+			rc = filter_parse_list(mask, 7, NULL, val);
+			tmp.ts_mask = mask[0];
+		} else if (!strcmp(tok, "ss")) {
+			rc = filter_parse_list(&tmp.ss_mask, 31, NULL, val);
+		} else if (!strcmp(tok, "arfcn")) {
+			dash = strchr(val, '-');
+			if (dash)
+				*dash++ = '\0';
+			rc = filter_parse_uint(&num, GSMTAP_ARFCN_MASK, val);
+			num2 = num;
+			if (!rc && dash)
+				rc = filter_parse_uint(&num2, GSMTAP_ARFCN_MASK, dash);
+			if (!rc && num > num2)
+				rc = -EINVAL;
+			tmp.arfcn_min = num;
+			tmp.arfcn_max = num2;
+		} else if (!strcmp(tok, "sample")) {
+			rc = filter_parse_uint(&num, UINT_MAX, val);
+			tmp.sample_n = num;
+		} else if (!strcmp(tok, "rate")) {
+			rc = filter_parse_uint(&num, UINT_MAX, val);
+			tmp.rate_max = num;
+		} else
+			rc = -EINVAL;
+	}
+	if (rc)
+		return rc;
+
+	*flt = tmp;
+	return 0;
+}
+
+/* Print the set bits of mask as list, with runs of bits as ranges */
+static void filter_print_list(struct osmo_strbuf *sb, const char *key, const uint32_t *mask,
+			      unsigned int max, const struct value_string *vs)
+{
+	const char *sep = "";
+	const char *name;
+	unsigned int i, j;
+
+	if (mask_empty(mask, (max + 1 + 31) / 32))
+		return;
+
+	OSMO_STRBUF_PRINTF(*sb, " %s=", key);
+	for (i = 0; i <= max; i++) {
+		if (!(mask[i / 32] & (1U << (i % 32))))
+			continue;
+		name = vs ? get_value_string_or_null(vs, i) : NULL;
+		if (name && get_string_value(vs, name) == i) {
+			OSMO_STRBUF_PRINTF(*sb, "%s%s", sep, name);
+		} else {
+			for (j = i; j < max && (mask[(j + 1) / 32] & (1U << ((j + 1) % 32))); j++)
+				;
+			if (vs || j == i)
+				OSMO_STRBUF_PRINTF(*sb, "%s%u", sep, i);
+			else {
+				OSMO_STRBUF_PRINTF(*sb, "%s%u-%u", sep, i, j);
+				i = j;
+			}
+		}
+		sep = ",";
+	}
+}
+
+/*! Print a GSMTAP source filter in the format taken by \ref gsmtap_filter_parse.
+ *  \param[out] buf string buffer to write to
+ *  \param[in] buf_len size of buf
+ *  \param[in] flt filter to print
+ *  \returns number of characters that would have been written given enough space */
+int gsmtap_filter_to_str_buf(char *buf, size_t buf_len, const struct gsmtap_filter *flt)
+{
+	struct osmo_strbuf sb = { .buf = buf, .len = buf_len };
+	uint32_t mask;
+
+	filter_print_list(&sb, "type", flt->type_mask, 0xff, NULL);
+	filter_print_list(&sb, "chan", flt->chan_mask, 0x7f, gsmtap_gsm_channel_names);
+	if (flt->arfcn_min != 0 || flt->arfcn_max != GSMTAP_ARFCN_MASK) {
+		if (flt->arfcn_min == flt->arfcn_max)
+			OSMO_STRBUF_PRINTF(sb, " arfcn=%u", flt->arfcn_min);
+		else
+			OSMO_STRBUF_PRINTF(sb, " arfcn=%u-%u", flt->arfcn_min, flt->arfcn_max);
+	}
+	mask = flt->ts_mask;
+	filter_print_list(&sb, "ts", &mask, 7, NULL);
+	filter_print_list(&sb, "ss", &flt->ss_mask, 31, NULL);
+	if (flt->sample_n > 1)
+		OSMO_STRBUF_PRINTF(sb, " sample=%u", flt->sample_n);
+	if (flt->rate_max)
+		OSMO_STRBUF_PRINTF(sb, " rate=%u", flt->rate_max);
+
+	if (!sb.chars_needed) {
+		OSMO_STRBUF_PRINTF(sb, "all");
+		return sb.chars_needed;
+	}
+
+	/* each key was printed with a leading space */
+	if (buf_len > 1)
+		memmove(buf, buf + 1, strlen(buf));
+	return sb.chars_needed - 1;
+}
+
 #ifdef HAVE_SYS_SOCKET_H
 
 #include <sys/socket.h>
@@ -264,6 +486,565 @@ int gsmtap_source_add_sink_fd(int gsmtap_fd)
 	return -ENODEV;
 }
 
+static const struct rate_ctr_desc gsmtap_ctr_description[] = {
+	[GSMTAP_CTR_TX_SENT] =		{ "tx:sent",		"Messages sent to the GSMTAP socket" },
+	[GSMTAP_CTR_TX_DROPPED] =	{ "tx:dropped",		"Messages dropped due to a full queue" },
+	[GSMTAP_CTR_TX_ERROR] =		{ "tx:error",		"Messages dropped due to a send error" },
+	[GSMTAP_CTR_PCAP_WRITTEN] =	{ "pcap:written",	"Messages written to the pcap file" },
+	[GSMTAP_CTR_PCAP_ROTATED] =	{ "pcap:rotated",	"Rotations of the pcap file" },
+	[GSMTAP_CTR_TX_FILTERED] =	{ "tx:filtered",	"Messages discarded by the source filter or sampling" },
+	[GSMTAP_CTR_TX_RATE_LIMITED] =	{ "tx:rate_limited",	"Messages discarded by the rate limit" },
+};
+
+static const struct rate_ctr_group_desc gsmtap_ctrg_desc = {
+	.group_name_prefix = "gsmtap",
+	.group_description = "GSMTAP source",
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+	.num_ctr = ARRAY_SIZE(gsmtap_ctr_description),
+	.ctr_desc = gsmtap_ctr_description,
+};
+
+static unsigned int gsmtap_ctrg_idx;
+
+static inline void gsmtap_ctr_add(struct gsmtap_inst *gti, enum gsmtap_ctr ctr, int inc)
+{
+	if (gti->ctrg)
+		rate_ctr_add(&gti->ctrg->ctr[ctr], inc);
+}
+
+/* Run the source filter of gti; returns true if the message is to be sent */
+static bool gsmtap_filter_pass(struct gsmtap_inst *gti, uint8_t type, uint16_t arfcn, uint8_t ts,
+			       uint8_t chan_type, uint8_t ss)
+{
+	struct gsmtap_filter *flt = gti->filter;
+	struct timespec now;
+
+	arfcn &= GSMTAP_ARFCN_MASK;
+	chan_type &= ~GSMTAP_CHANNEL_ACCH;
+
+	if (!mask_test(flt->type_mask, ARRAY_SIZE(flt->type_mask), type)
+	    || !mask_test(flt->chan_mask, ARRAY_SIZE(flt->chan_mask), chan_type)
+	    || arfcn < flt->arfcn_min || arfcn > flt->arfcn_max
+	    || (flt->ts_mask && (ts > 7 || !(flt->ts_mask & (1 << ts))))
+	    || (flt->ss_mask && (ss > 31 || !(flt->ss_mask & (1U << ss))))) {
+		gsmtap_ctr_add(gti, GSMTAP_CTR_TX_FILTERED, 1);
+		return false;
+	}
+
+	if (flt->sample_n > 1) {
+		if (flt->sample_cnt++ % flt->sample_n) {
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_FILTERED, 1);
+			return false;
+		}
+	}
+
+	if (flt->rate_max) {
+		osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec != flt->rate_sec) {
+			flt->rate_sec = now.tv_sec;
+			flt->rate_cnt = 0;
+		}
+		if (flt->rate_cnt >= flt->rate_max) {
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_RATE_LIMITED, 1);
+			return false;
+		}
+		flt->rate_cnt++;
+	}
+
+	return true;
+}
+
+/*! Set or remove the source filter of a GSMTAP instance.
+ *  \param[in] gti GSMTAP instance
+ *  \param[in] flt filter to copy, see \ref gsmtap_filter_parse; NULL to send everything
+ *  \returns 0 on success; negative on error
+ *
+ *  The filter is applied by \ref gsmtap_send_ex before anything is allocated
+ *  or copied, and by \ref gsmtap_sendmsg based on the GSMTAP header. Messages
+ *  discarded by the filter count as success for the caller. */
+int gsmtap_inst_set_filter(struct gsmtap_inst *gti, const struct gsmtap_filter *flt)
+{
+	if (!flt) {
+		talloc_free(gti->filter);
+		gti->filter = NULL;
+		return 0;
+	}
+
+	if (!gti->filter) {
+		gti->filter = talloc_zero(gti, struct gsmtap_filter);
+		if (!gti->filter)
+			return -ENOMEM;
+	}
+	*gti->filter = *flt;
+	gti->filter->sample_cnt = 0;
+	gti->filter->rate_cnt = 0;
+	gti->filter->rate_sec = 0;
+	return 0;
+}
+
+/* Capture mode: GSMTAP messages are written into a ring of preallocated
+ * records instead of one msgb each, and the ring is flushed with a single
+ * sendmmsg() (or to a pcap file) once per event loop iteration. */
+
+/* libpcap file format, link type of raw IPv4 */
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_LINKTYPE_IPV4	228
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+} __attribute__ ((packed));
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+} __attribute__ ((packed));
+
+/* the IPv4 and UDP header put in front of each GSMTAP message in the pcap file */
+struct pcap_ip_udp_hdr {
+	uint8_t ver_ihl;
+	uint8_t tos;
+	uint16_t tot_len;
+	uint16_t id;
+	uint16_t frag_off;
+	uint8_t ttl;
+	uint8_t protocol;
+	uint16_t check;
+	uint32_t saddr;
+	uint32_t daddr;
+	uint16_t source;
+	uint16_t dest;
+	uint16_t len;
+	uint16_t udp_check;
+} __attribute__ ((packed));
+
+/* one record of the capture ring */
+struct gsmtap_capture_rec {
+	struct timeval tv;
+	unsigned int len;
+	uint8_t data[0];
+};
+
+struct gsmtap_capture {
+	/* ring of num_records records, rec_size bytes each; num_records is a
+	 * power of two, so the free-running counters below wrap cleanly */
+	uint8_t *ring;
+	unsigned int num_records;
+	unsigned int rec_size;
+	unsigned int max_len;
+	/* number of records written / flushed since enabling; free-running */
+	unsigned int head;
+	unsigned int tail;
+	/* the osmo_fd was registered by gsmtap_capture_enable() */
+	bool registered;
+
+	/* pcap sink, replacing the socket if set */
+	FILE *pcap;
+	char *pcap_path;
+	unsigned long pcap_bytes;
+	unsigned long pcap_max_bytes;
+	unsigned int pcap_max_files;
+};
+
+#define GSMTAP_CAPTURE_BATCH	64
+
+static inline struct gsmtap_capture_rec *capture_rec(struct gsmtap_capture *cap, unsigned int n)
+{
+	return (struct gsmtap_capture_rec *) (cap->ring + (n & (cap->num_records - 1)) * cap->rec_size);
+}
+
+/* Reserve the next free record, or NULL if the ring is full */
+static struct gsmtap_capture_rec *capture_rec_get(struct gsmtap_inst *gti, unsigned int len)
+{
+	struct gsmtap_capture *cap = gti->capture;
+	struct gsmtap_capture_rec *rec;
+
+	if (len > cap->max_len || cap->head - cap->tail >= cap->num_records) {
+		gsmtap_ctr_add(gti, GSMTAP_CTR_TX_DROPPED, 1);
+		return NULL;
+	}
+
+	rec = capture_rec(cap, cap->head);
+	osmo_gettimeofday(&rec->tv, NULL);
+	rec->len = len;
+	return rec;
+}
+
+/* Commit the record obtained by capture_rec_get() and schedule a flush */
+static void capture_rec_put(struct gsmtap_inst *gti)
+{
+	gti->capture->head++;
+	gti->wq.bfd.when |= OSMO_FD_WRITE;
+}
+
+static int pcap_open(struct gsmtap_capture *cap)
+{
+	struct pcap_file_hdr fh = {
+		.magic = PCAP_MAGIC,
+		.version_major = 2,
+		.version_minor = 4,
+		.snaplen = 65535,
+		.linktype = PCAP_LINKTYPE_IPV4,
+	};
+
+	cap->pcap = fopen(cap->pcap_path, "w");
+	if (!cap->pcap)
+		return -errno;
+	if (fwrite(&fh, sizeof(fh), 1, cap->pcap) != 1) {
+		fclose(cap->pcap);
+		cap->pcap = NULL;
+		return -EIO;
+	}
+	cap->pcap_bytes = sizeof(fh);
+	return 0;
+}
+
+/* Rename <path> to <path>.1, <path>.1 to <path>.2 and so on, dropping the
+ * oldest file, then start a new <path> */
+static int pcap_rotate(struct gsmtap_inst *gti)
+{
+	struct gsmtap_capture *cap = gti->capture;
+	char from[PATH_MAX], to[PATH_MAX];
+	unsigned int i;
+
+	fclose(cap->pcap);
+	cap->pcap = NULL;
+
+	for (i = cap->pcap_max_files - 1; i > 0; i--) {
+		if (i > 1)
+			snprintf(from, sizeof(from), "%s.%u", cap->pcap_path, i - 1);
+		else
+			OSMO_STRLCPY_ARRAY(from, cap->pcap_path);
+		snprintf(to, sizeof(to), "%s.%u", cap->pcap_path, i);
+		rename(from, to);
+	}
+
+	gsmtap_ctr_add(gti, GSMTAP_CTR_PCAP_ROTATED, 1);
+	return pcap_open(cap);
+}
+
+static uint16_t ip_checksum(const void *data, unsigned int len)
+{
+	const uint8_t *buf = data;
+	uint32_t sum = 0;
+	unsigned int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += (buf[i] << 8) | buf[i + 1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return osmo_htons(~sum & 0xffff);
+}
+
+static int capture_flush_pcap(struct gsmtap_inst *gti)
+{
+	struct gsmtap_capture *cap = gti->capture;
+	struct pcap_ip_udp_hdr iph = {
+		.ver_ihl = 0x45,
+		.ttl = 64,
+		.protocol = IPPROTO_UDP,
+		.saddr = osmo_htonl(0x7f000001),
+		.daddr = osmo_htonl(0x7f000001),
+		.source = osmo_htons(GSMTAP_UDP_PORT),
+		.dest = osmo_htons(GSMTAP_UDP_PORT),
+	};
+	struct gsmtap_capture_rec *rec;
+	struct pcap_rec_hdr rh;
+	int num = 0, rc;
+
+	while (cap->tail != cap->head) {
+		if (!cap->pcap) {
+			rc = pcap_open(cap);
+			if (rc < 0)
+				return rc;
+		}
+
+		rec = capture_rec(cap, cap->tail);
+		rh.ts_sec = rec->tv.tv_sec;
+		rh.ts_usec = rec->tv.tv_usec;
+		rh.incl_len = rh.orig_len = sizeof(iph) + rec->len;
+		iph.tot_len = osmo_htons(sizeof(iph) + rec->len);
+		iph.id = osmo_htons(cap->tail & 0xffff);
+		iph.check = 0;
+		iph.check = ip_checksum(&iph, 20);
+		iph.len = osmo_htons(8 + rec->len);
+
+		if (fwrite(&rh, sizeof(rh), 1, cap->pcap) != 1
+		    || fwrite(&iph, sizeof(iph), 1, cap->pcap) != 1
+		    || fwrite(rec->data, rec->len, 1, cap->pcap) != 1) {
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_ERROR, cap->head - cap->tail);
+			cap->tail = cap->head;
+			return -EIO;
+		}
+		cap->tail++;
+		num++;
+		cap->pcap_bytes += sizeof(rh) + rh.incl_len;
+
+		if (cap->pcap_max_bytes && cap->pcap_bytes >= cap->pcap_max_bytes)
+			pcap_rotate(gti);
+	}
+
+	if (cap->pcap)
+		fflush(cap->pcap);
+	gsmtap_ctr_add(gti, GSMTAP_CTR_PCAP_WRITTEN, num);
+	return num;
+}
+
+static int capture_flush_sock(struct gsmtap_inst *gti)
+{
+	struct gsmtap_capture *cap = gti->capture;
+	struct gsmtap_capture_rec *rec;
+	int fd = gsmtap_inst_fd(gti);
+	int num = 0, rc;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mmsg[GSMTAP_CAPTURE_BATCH];
+	struct iovec iov[GSMTAP_CAPTURE_BATCH];
+	unsigned int i, n;
+
+	while (cap->tail != cap->head) {
+		n = OSMO_MIN(cap->head - cap->tail, GSMTAP_CAPTURE_BATCH);
+		memset(mmsg, 0, n * sizeof(mmsg[0]));
+		for (i = 0; i < n; i++) {
+			rec = capture_rec(cap, cap->tail + i);
+			iov[i].iov_base = rec->data;
+			iov[i].iov_len = rec->len;
+			mmsg[i].msg_hdr.msg_iov = &iov[i];
+			mmsg[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		rc = sendmmsg(fd, mmsg, n, 0);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EINTR || errno == ENOBUFS)
+				break;
+			/* e.g. ECONNREFUSED: drop the datagram and carry on */
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_ERROR, 1);
+			cap->tail++;
+			continue;
+		}
+		cap->tail += rc;
+		num += rc;
+		if (rc < n)
+			break;
+	}
+#else
+	while (cap->tail != cap->head) {
+		rec = capture_rec(cap, cap->tail);
+		rc = send(fd, rec->data, rec->len, 0);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EINTR || errno == ENOBUFS)
+				break;
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_ERROR, 1);
+		} else
+			num++;
+		cap->tail++;
+	}
+#endif
+	gsmtap_ctr_add(gti, GSMTAP_CTR_TX_SENT, num);
+	return num;
+}
+
+/*! Flush the records queued in capture mode.
+ *  \param[in] gti GSMTAP instance in capture mode
+ *  \returns number of records sent or written; negative on error
+ *
+ *  This is called automatically from the select loop. Applications with
+ *  their own event loop may call it once per iteration instead. Records that
+ *  cannot be sent because the socket buffer is full stay queued. */
+int gsmtap_capture_flush(struct gsmtap_inst *gti)
+{
+	if (!gti->capture)
+		return -EINVAL;
+	if (gti->capture->pcap_path)
+		return capture_flush_pcap(gti);
+	return capture_flush_sock(gti);
+}
+
+static int gsmtap_capture_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct gsmtap_inst *gti = ofd->data;
+	struct gsmtap_capture *cap = gti->capture;
+	bool wq_pending;
+	int rc = 0;
+
+	if (what & OSMO_FD_WRITE) {
+		gsmtap_capture_flush(gti);
+		/* messages queued before capture mode was enabled */
+		wq_pending = gti->ofd_wq_mode && !llist_empty(&gti->wq.msg_queue);
+		if (wq_pending)
+			rc = osmo_wqueue_bfd_cb(ofd, OSMO_FD_WRITE);
+		if (cap->head == cap->tail && !wq_pending)
+			ofd->when &= ~OSMO_FD_WRITE;
+		else
+			ofd->when |= OSMO_FD_WRITE;
+	}
+
+	return rc;
+}
+
+/*! Switch a GSMTAP instance to high-rate capture mode.
+ *  \param[in] gti GSMTAP instance
+ *  \param[in] num_records number of records in the capture ring, a power of two
+ *  \param[in] max_len maximum length of a GSMTAP message including its header
+ *  \returns 0 on success; negative on error
+ *
+ *  In capture mode \ref gsmtap_send_ex writes the message directly into a
+ *  preallocated ring of records, and no msgb is allocated. The ring is flushed
+ *  to the (then non-blocking) socket with sendmmsg() whenever the select loop
+ *  runs, or to a pcap file, see \ref gsmtap_capture_set_pcap. Messages that do
+ *  not fit into the ring are dropped and counted in GSMTAP_CTR_TX_DROPPED. */
+int gsmtap_capture_enable(struct gsmtap_inst *gti, unsigned int num_records,
+			  unsigned int max_len)
+{
+	struct gsmtap_capture *cap;
+	int flags, rc;
+
+	if (gti->capture || num_records == 0 || (num_records & (num_records - 1))
+	    || max_len < sizeof(struct gsmtap_hdr))
+		return -EINVAL;
+
+	cap = talloc_zero(gti, struct gsmtap_capture);
+	if (!cap)
+		return -ENOMEM;
+	cap->num_records = num_records;
+	cap->max_len = max_len;
+	cap->rec_size = (sizeof(struct gsmtap_capture_rec) + max_len + 7) & ~7;
+	cap->ring = talloc_size(cap, (size_t) num_records * cap->rec_size);
+	if (!cap->ring) {
+		talloc_free(cap);
+		return -ENOMEM;
+	}
+
+	flags = fcntl(gsmtap_inst_fd(gti), F_GETFL);
+	if (flags >= 0)
+		fcntl(gsmtap_inst_fd(gti), F_SETFL, flags | O_NONBLOCK);
+
+	gti->wq.bfd.cb = gsmtap_capture_fd_cb;
+	gti->wq.bfd.data = gti;
+	if (!gti->ofd_wq_mode) {
+		rc = osmo_fd_register(&gti->wq.bfd);
+		if (rc < 0) {
+			gti->wq.bfd.cb = NULL;
+			talloc_free(cap);
+			return rc;
+		}
+		cap->registered = true;
+	}
+
+	gti->capture = cap;
+	return 0;
+}
+
+/*! Leave capture mode, flushing what is left in the ring and closing the pcap file.
+ *  \param[in] gti GSMTAP instance */
+void gsmtap_capture_disable(struct gsmtap_inst *gti)
+{
+	struct gsmtap_capture *cap = gti->capture;
+
+	if (!cap)
+		return;
+
+	gsmtap_capture_flush(gti);
+	if (cap->pcap)
+		fclose(cap->pcap);
+
+	if (cap->registered) {
+		osmo_fd_unregister(&gti->wq.bfd);
+		gti->wq.bfd.when = 0;
+	} else {
+		gti->wq.bfd.cb = osmo_wqueue_bfd_cb;
+		if (llist_empty(&gti->wq.msg_queue))
+			gti->wq.bfd.when &= ~OSMO_FD_WRITE;
+	}
+
+	gti->capture = NULL;
+	talloc_free(cap);
+}
+
+/*! Write the messages of capture mode to a pcap file instead of the socket.
+ *  \param[in] gti GSMTAP instance in capture mode
+ *  \param[in] path file name of the pcap file; NULL to go back to the socket
+ *  \param[in] max_bytes rotate the file once it reaches this size; 0 to never rotate
+ *  \param[in] max_files number of files to keep on rotation, the current one included
+ *  \returns 0 on success; negative on error
+ *
+ *  Each message is stored with an IPv4/UDP header addressed to the GSMTAP port,
+ *  so that the file can be opened directly in wireshark. On rotation, <path> is
+ *  renamed to <path>.1, <path>.1 to <path>.2 and so on. */
+int gsmtap_capture_set_pcap(struct gsmtap_inst *gti, const char *path,
+			    unsigned long max_bytes, unsigned int max_files)
+{
+	struct gsmtap_capture *cap = gti->capture;
+	int rc;
+
+	if (!cap)
+		return -EINVAL;
+
+	gsmtap_capture_flush(gti);
+	if (cap->pcap) {
+		fclose(cap->pcap);
+		cap->pcap = NULL;
+	}
+	talloc_free(cap->pcap_path);
+	cap->pcap_path = NULL;
+	if (!path)
+		return 0;
+
+	cap->pcap_path = talloc_strdup(cap, path);
+	cap->pcap_max_bytes = max_bytes;
+	cap->pcap_max_files = max_files ? max_files : 1;
+	rc = pcap_open(cap);
+	if (rc < 0) {
+		talloc_free(cap->pcap_path);
+		cap->pcap_path = NULL;
+	}
+	return rc;
+}
+
+/* gsmtap_sendmsg() without the source filter, which the caller already applied */
+static int _gsmtap_sendmsg(struct gsmtap_inst *gti, struct msgb *msg)
+{
+	int rc;
+
+	if (gti->capture) {
+		struct gsmtap_capture_rec *rec = capture_rec_get(gti, msg->len);
+		if (!rec)
+			return -ENOSPC;
+		memcpy(rec->data, msg->data, msg->len);
+		capture_rec_put(gti);
+		msgb_free(msg);
+		return 0;
+	}
+
+	if (gti->ofd_wq_mode) {
+		rc = osmo_wqueue_enqueue(&gti->wq, msg);
+		if (rc < 0)
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_DROPPED, 1);
+		return rc;
+	} else {
+		/* try immediate send and return error if any */
+		rc = write(gsmtap_inst_fd(gti), msg->data, msg->len);
+		if (rc < 0) {
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_ERROR, 1);
+			return rc;
+		} else if (rc >= msg->len) {
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_SENT, 1);
+			msgb_free(msg);
+			return 0;
+		} else {
+			/* short write */
+			gsmtap_ctr_add(gti, GSMTAP_CTR_TX_ERROR, 1);
+			return -EIO;
+		}
+	}
+}
+
 /*! Send a \ref msgb through a GSMTAP source
  *  \param[in] gti GSMTAP instance
  *  \param[in] msg message buffer
@@ -277,23 +1058,16 @@ int gsmtap_sendmsg(struct gsmtap_inst *gti, struct msgb *msg)
 	if (!gti)
 		return -ENODEV;
 
-	if (gti->ofd_wq_mode)
-		return osmo_wqueue_enqueue(&gti->wq, msg);
-	else {
-		/* try immediate send and return error if any */
-		int rc;
-
-		rc = write(gsmtap_inst_fd(gti), msg->data, msg->len);
-		if (rc < 0) {
-			return rc;
-		} else if (rc >= msg->len) {
+	if (gti->filter && msg->len >= sizeof(struct gsmtap_hdr)) {
+		const struct gsmtap_hdr *gh = (const struct gsmtap_hdr *) msg->data;
+		if (!gsmtap_filter_pass(gti, gh->type, osmo_ntohs(gh->arfcn), gh->timeslot,
+					gh->sub_type, gh->sub_slot)) {
 			msgb_free(msg);
 			return 0;
-		} else {
-			/* short write */
-			return -EIO;
 		}
 	}
+
+	return _gsmtap_sendmsg(gti, msg);
 }
 
 /*! send an arbitrary type through GSMTAP.
@@ -310,12 +1084,29 @@ int gsmtap_send_ex(struct gsmtap_inst *gti, uint8_t type, uint16_t arfcn, uint8_
 	if (!gti)
 		return -ENODEV;
 
+	if (gti->filter && !gsmtap_filter_pass(gti, type, arfcn, ts, chan_type, ss))
+		return 0;
+
+	if (gti->capture) {
+		/* build the message in place, without a msgb */
+		struct gsmtap_capture_rec *rec;
+
+		rec = capture_rec_get(gti, sizeof(struct gsmtap_hdr) + len);
+		if (!rec)
+			return -ENOSPC;
+		gsmtap_fill_hdr((struct gsmtap_hdr *) rec->data, type, arfcn, ts, chan_type,
+				ss, fn, signal_dbm, snr);
+		memcpy(rec->data + sizeof(struct gsmtap_hdr), data, len);
+		capture_rec_put(gti);
+		return 0;
+	}
+
 	msg = gsmtap_makemsg_ex(type, arfcn, ts, chan_type, ss, fn, signal_dbm,
 			     snr, data, len);
 	if (!msg)
 		return -ENOMEM;
 
-	rc = gsmtap_sendmsg(gti, msg);
+	rc = _gsmtap_sendmsg(gti, msg);
 	if (rc)
 		msgb_free(msg);
 	return rc;
@@ -430,6 +1221,7 @@ struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 		return NULL;
 
 	gti = talloc_zero(NULL, struct gsmtap_inst);
+	gti->ctrg = rate_ctr_group_alloc(gti, &gsmtap_ctrg_desc, gsmtap_ctrg_idx++);
 	gti->ofd_wq_mode = ofd_wq_mode;
 	gti->wq.bfd.fd = fd;
 	gti->sink_ofd.fd = -1;
@@ -437,9 +1229,12 @@ struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 	if (ofd_wq_mode) {
 		osmo_wqueue_init(&gti->wq, 64);
 		gti->wq.write_cb = &gsmtap_wq_w_cb;
+		if (gti->ctrg)
+			gti->wq.sent_ctr = &gti->ctrg->ctr[GSMTAP_CTR_TX_SENT];
 
 		rc = osmo_fd_register(&gti->wq.bfd);
 		if (rc < 0) {
+			rate_ctr_group_free(gti->ctrg);
 			talloc_free(gti);
 			close(fd);
 			return NULL;
@@ -449,6 +1244,20 @@ struct gsmtap_inst *gsmtap_source_init(const char *host, uint16_t port,
 	return gti;
 }
 
+/*! Set how a GSMTAP instance in wait queue mode sends queued messages
+ *  \param[in] gti GSMTAP instance opened with ofd_wq_mode set
+ *  \param[in] mode e.g. OSMO_WQUEUE_MODE_SENDMMSG to send many messages per system call
+ *  \returns 0 on success; negative on error
+ *
+ *  By default each message is sent with its own send(), see \ref osmo_wqueue_set_mode. */
+int gsmtap_inst_set_wqueue_mode(struct gsmtap_inst *gti, enum osmo_wqueue_mode mode)
+{
+	if (!gti->ofd_wq_mode)
+		return -EINVAL;
+
+	return osmo_wqueue_set_mode(&gti->wq, mode);
+}
+
 #endif /* HAVE_SYS_SOCKET_H */
 
 const struct value_string gsmtap_gsm_channel_names[] = {
@@ -0,0 +1,62 @@
+/*! \file hexdump_sse.c
+ * Accelerated hex encoding / decoding
+ * for architectures with only SSSE3 available. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+/**
+ * Include common SSE implementation
+ */
+#include <hexdump_sse_impl.h>
+
+/* All functions return the number of input elements processed, the
+ * caller takes care of the remainder. */
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_enc(char *out, const uint8_t *in, size_t len)
+{
+	return _sse_hex_enc(out, in, len);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_enc_delim(char *out, const uint8_t *in, size_t len, char delim)
+{
+	return _sse_hex_enc_delim(out, in, len, delim);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_dec(uint8_t *out, const char *in, size_t len)
+{
+	return _sse_hex_dec(out, in, len);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_ubit_sse_dump(char *out, const uint8_t *bits, size_t len)
+{
+	return _sse_ubit_dump(out, bits, len);
+}
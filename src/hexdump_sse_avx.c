@@ -0,0 +1,118 @@
+/*! \file hexdump_sse_avx.c
+ * Accelerated hex encoding / decoding
+ * for architectures with both SSSE3 and AVX2 support. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+/**
+ * Include common SSE implementation
+ */
+#include <hexdump_sse_impl.h>
+
+/* All functions return the number of input elements processed, the
+ * caller takes care of the remainder. The 256-bit loops hand their tail
+ * to the 128-bit variants. */
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_avx_enc(char *out, const uint8_t *in, size_t len)
+{
+	const __m256i lut = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+					     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+					     '0', '1', '2', '3', '4', '5', '6', '7',
+					     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (in + i));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+		/* the unpacks work per 128-bit lane: bytes 0..7 and 16..23 / 8..15 and 24..31 */
+		__m256i h0 = _mm256_unpacklo_epi8(hi, lo);
+		__m256i h1 = _mm256_unpackhi_epi8(hi, lo);
+
+		_mm256_storeu_si256((__m256i *) (out + 2 * i), _mm256_permute2x128_si256(h0, h1, 0x20));
+		_mm256_storeu_si256((__m256i *) (out + 2 * i + 32), _mm256_permute2x128_si256(h0, h1, 0x31));
+	}
+
+	return i + _sse_hex_enc(out + 2 * i, in + i, len - i);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_avx_enc_delim(char *out, const uint8_t *in, size_t len, char delim)
+{
+	return _sse_hex_enc_delim(out, in, len, delim);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_hex_sse_avx_dec(uint8_t *out, const char *in, size_t len)
+{
+	const __m256i c0 = _mm256_set1_epi8('0');
+	const __m256i ca = _mm256_set1_epi8('a');
+	const __m256i lower = _mm256_set1_epi8(0x20);
+	const __m256i nine = _mm256_set1_epi8(9);
+	const __m256i five = _mm256_set1_epi8(5);
+	const __m256i ten = _mm256_set1_epi8(10);
+	const __m256i mul = _mm256_set1_epi16(0x0110);
+	size_t i;
+
+	for (i = 0; i + 64 <= len; i += 64) {
+		__m256i c[2], v[2];
+		int j;
+
+		c[0] = _mm256_loadu_si256((const __m256i *) (in + i));
+		c[1] = _mm256_loadu_si256((const __m256i *) (in + i + 32));
+
+		for (j = 0; j < 2; j++) {
+			__m256i dig = _mm256_sub_epi8(c[j], c0);
+			__m256i alp = _mm256_sub_epi8(_mm256_or_si256(c[j], lower), ca);
+			__m256i isd = _mm256_cmpeq_epi8(_mm256_min_epu8(dig, nine), dig);
+			__m256i isa = _mm256_cmpeq_epi8(_mm256_min_epu8(alp, five), alp);
+
+			if (_mm256_movemask_epi8(_mm256_or_si256(isd, isa)) != -1)
+				goto tail;
+			v[j] = _mm256_maddubs_epi16(_mm256_or_si256(_mm256_and_si256(isd, dig),
+								    _mm256_and_si256(isa, _mm256_add_epi8(alp, ten))),
+						    mul);
+		}
+
+		/* the pack works per 128-bit lane, restore the 64-bit quarters to 0, 2, 1, 3 */
+		_mm256_storeu_si256((__m256i *) (out + i / 2),
+				    _mm256_permute4x64_epi64(_mm256_packus_epi16(v[0], v[1]), 0xd8));
+	}
+
+tail:
+	return i + _sse_hex_dec(out + i / 2, in + i, len - i);
+}
+
+__attribute__ ((visibility("hidden")))
+size_t osmo_ubit_sse_avx_dump(char *out, const uint8_t *bits, size_t len)
+{
+	return _sse_ubit_dump(out, bits, len);
+}
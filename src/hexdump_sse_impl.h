@@ -0,0 +1,190 @@
+/*! \file hexdump_sse_impl.h
+ * Accelerated hex encoding / decoding:
+ * Actual definitions which are being included
+ * from both hexdump_sse.c and hexdump_sse_avx.c. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Some distributions (notably Alpine Linux) for some strange reason
+ * don't have this #define */
+#ifndef __always_inline
+#define __always_inline         inline __attribute__((always_inline))
+#endif
+
+/* Encode 16 bytes into 32 hex characters
+ *
+ * Input:
+ * V - 16 bytes to encode
+ *
+ * Output:
+ * H0 - hex characters of the bytes 0..7
+ * H1 - hex characters of the bytes 8..15
+ */
+static __always_inline void _sse_hex_enc16(__m128i V, __m128i *H0, __m128i *H1)
+{
+	const __m128i lut = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+					  '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	__m128i hi, lo;
+
+	hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(V, 4), mask));
+	lo = _mm_shuffle_epi8(lut, _mm_and_si128(V, mask));
+
+	*H0 = _mm_unpacklo_epi8(hi, lo);
+	*H1 = _mm_unpackhi_epi8(hi, lo);
+}
+
+/* Hex encode without delimiter, 16 input bytes per iteration */
+static __always_inline size_t _sse_hex_enc(char *out, const uint8_t *in, size_t len)
+{
+	size_t i;
+	__m128i h0, h1;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		_sse_hex_enc16(_mm_loadu_si128((const __m128i *) (in + i)), &h0, &h1);
+		_mm_storeu_si128((__m128i *) (out + 2 * i), h0);
+		_mm_storeu_si128((__m128i *) (out + 2 * i + 16), h1);
+	}
+
+	return i;
+}
+
+/* Hex encode with a single character delimiter after each byte,
+ * 16 input bytes (48 output characters) per iteration. The hex
+ * characters are spread out over three registers with a shuffle each,
+ * the gaps are then filled with the delimiter. */
+static __always_inline size_t _sse_hex_enc_delim(char *out, const uint8_t *in, size_t len, char delim)
+{
+	const __m128i sa0 = _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+	const __m128i sa1 = _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i sb1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, 2, 3, -1, 4, 5);
+	const __m128i sb2 = _mm_setr_epi8(-1, 6, 7, -1, 8, 9, -1, 10, 11, -1, 12, 13, -1, 14, 15, -1);
+	const __m128i d = _mm_set1_epi8(delim);
+	const __m128i d0 = _mm_and_si128(d, _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0));
+	const __m128i d1 = _mm_and_si128(d, _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0));
+	const __m128i d2 = _mm_and_si128(d, _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1));
+	size_t i;
+	__m128i h0, h1;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		char *o = out + 3 * i;
+
+		_sse_hex_enc16(_mm_loadu_si128((const __m128i *) (in + i)), &h0, &h1);
+		_mm_storeu_si128((__m128i *) o, _mm_or_si128(_mm_shuffle_epi8(h0, sa0), d0));
+		_mm_storeu_si128((__m128i *) (o + 16),
+				 _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(h0, sa1),
+							   _mm_shuffle_epi8(h1, sb1)), d1));
+		_mm_storeu_si128((__m128i *) (o + 32), _mm_or_si128(_mm_shuffle_epi8(h1, sb2), d2));
+	}
+
+	return i;
+}
+
+/* Decode 32 hex characters into 16 bytes
+ *
+ * Input:
+ * C0 - hex characters 0..15
+ * C1 - hex characters 16..31
+ *
+ * Output:
+ * V - the decoded bytes, only valid if the return value is nonzero
+ *
+ * Returns nonzero if all 32 characters are hex digits of either case.
+ */
+static __always_inline int _sse_hex_dec32(__m128i C0, __m128i C1, __m128i *V)
+{
+	const __m128i c0 = _mm_set1_epi8('0');
+	const __m128i ca = _mm_set1_epi8('a');
+	const __m128i lower = _mm_set1_epi8(0x20);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i five = _mm_set1_epi8(5);
+	const __m128i ten = _mm_set1_epi8(10);
+	/* high nibble at the even positions: multiply by 16 and add the odd one */
+	const __m128i mul = _mm_set1_epi16(0x0110);
+	__m128i dig0, dig1, alp0, alp1, isd0, isd1, isa0, isa1, val0, val1;
+
+	dig0 = _mm_sub_epi8(C0, c0);
+	dig1 = _mm_sub_epi8(C1, c0);
+	alp0 = _mm_sub_epi8(_mm_or_si128(C0, lower), ca);
+	alp1 = _mm_sub_epi8(_mm_or_si128(C1, lower), ca);
+
+	/* unsigned 'x <= max' as 'min(x, max) == x' */
+	isd0 = _mm_cmpeq_epi8(_mm_min_epu8(dig0, nine), dig0);
+	isd1 = _mm_cmpeq_epi8(_mm_min_epu8(dig1, nine), dig1);
+	isa0 = _mm_cmpeq_epi8(_mm_min_epu8(alp0, five), alp0);
+	isa1 = _mm_cmpeq_epi8(_mm_min_epu8(alp1, five), alp1);
+
+	if (_mm_movemask_epi8(_mm_and_si128(_mm_or_si128(isd0, isa0), _mm_or_si128(isd1, isa1))) != 0xffff)
+		return 0;
+
+	val0 = _mm_or_si128(_mm_and_si128(isd0, dig0), _mm_and_si128(isa0, _mm_add_epi8(alp0, ten)));
+	val1 = _mm_or_si128(_mm_and_si128(isd1, dig1), _mm_and_si128(isa1, _mm_add_epi8(alp1, ten)));
+
+	*V = _mm_packus_epi16(_mm_maddubs_epi16(val0, mul), _mm_maddubs_epi16(val1, mul));
+	return 1;
+}
+
+/* Hex decode, 32 input characters per iteration; stops in front of
+ * the first block that contains anything but hex digits */
+static __always_inline size_t _sse_hex_dec(uint8_t *out, const char *in, size_t len)
+{
+	size_t i;
+	__m128i v;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		if (!_sse_hex_dec32(_mm_loadu_si128((const __m128i *) (in + i)),
+				    _mm_loadu_si128((const __m128i *) (in + i + 16)), &v))
+			break;
+		_mm_storeu_si128((__m128i *) (out + i / 2), v);
+	}
+
+	return i;
+}
+
+/* Unpacked bits to '0', '1', '?' (0xff) or 'E' (anything else),
+ * 16 bits per iteration */
+static __always_inline size_t _sse_ubit_dump(char *out, const uint8_t *bits, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i ff = _mm_set1_epi8(-1);
+	const __m128i ch0 = _mm_set1_epi8('0');
+	const __m128i ch1 = _mm_set1_epi8('1');
+	const __m128i chq = _mm_set1_epi8('?');
+	const __m128i che = _mm_set1_epi8('E');
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (bits + i));
+		__m128i is0 = _mm_cmpeq_epi8(v, zero);
+		__m128i is1 = _mm_cmpeq_epi8(v, one);
+		__m128i isq = _mm_cmpeq_epi8(v, ff);
+		__m128i r;
+
+		r = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(is0, is1), isq), che);
+		r = _mm_or_si128(r, _mm_and_si128(is0, ch0));
+		r = _mm_or_si128(r, _mm_and_si128(is1, ch1));
+		r = _mm_or_si128(r, _mm_and_si128(isq, chq));
+		_mm_storeu_si128((__m128i *) (out + i), r);
+	}
+
+	return i;
+}
@@ -902,6 +902,10 @@ void log_target_destroy(struct log_target *target)
 	/* just in case, to make sure we don't have any references */
 	log_del_target(target);
 
+	/* send pending records and stop the flush timer */
+	if (target->type == LOG_TGT_TYPE_GSMTAP)
+		log_target_gsmtap_set_batch(target, 0, 0);
+
 #if (!EMBEDDED)
 	if (target->output == &_file_output) {
 /* since C89/C99 says stderr is a macro, we can safely do this! */
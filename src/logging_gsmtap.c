@@ -38,6 +38,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -50,37 +51,47 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/byteswap.h>
+#include <osmocom/core/bits.h>
 
 #define	GSMTAP_LOG_MAX_SIZE 4096
 
-static void _gsmtap_raw_output(struct log_target *target, int subsys,
-			       unsigned int level, const char *file,
-			       int line, int cont, const char *format,
-			       va_list ap)
-{
+/* several log records collected into one GSMTAP datagram */
+struct log_gsmtap_batch {
+	struct log_target *target;
+	/* datagram being filled, NULL if empty */
 	struct msgb *msg;
-	struct gsmtap_hdr *gh;
-	struct gsmtap_osmocore_log_hdr *golh;
-	const char *subsys_name = log_category_name(subsys);
-	struct timeval tv;
-	int rc;
-	const char *file_basename;
+	struct osmo_timer_list timer;
+};
 
-	/* get timestamp ASAP */
-	osmo_gettimeofday(&tv, NULL);
-
-	msg = msgb_alloc(sizeof(*gh)+sizeof(*golh)+GSMTAP_LOG_MAX_SIZE,
-			 "GSMTAP logging");
+static void gsmtap_fill_hdr(struct msgb *msg, uint8_t sub_type)
+{
+	struct gsmtap_hdr *gh;
 
-	/* GSMTAP header */
 	gh = (struct gsmtap_hdr *) msgb_put(msg, sizeof(*gh));
 	memset(gh, 0, sizeof(*gh));
 	gh->version = GSMTAP_VERSION;
 	gh->hdr_len = sizeof(*gh)/4;
 	gh->type = GSMTAP_TYPE_OSMOCORE_LOG;
+	gh->sub_type = sub_type;
+}
+
+/* Write logging header and message to buf. Returns the number of bytes
+ * written, or -ENOSPC if the message had to be truncated and !truncate */
+static int gsmtap_fill_record(uint8_t *buf, unsigned int len, struct log_target *target,
+			      int subsys, unsigned int level, const char *file, int line,
+			      const struct timeval *tv, const char *format, va_list ap,
+			      bool truncate)
+{
+	struct gsmtap_osmocore_log_hdr *golh = (struct gsmtap_osmocore_log_hdr *) buf;
+	const char *subsys_name = log_category_name(subsys);
+	const char *file_basename;
+	unsigned int room;
+	int rc;
+
+	if (len <= sizeof(*golh))
+		return -ENOSPC;
 
-	/* Logging header */
-	golh = (struct gsmtap_osmocore_log_hdr *) msgb_put(msg, sizeof(*golh));
+	memset(golh, 0, sizeof(*golh));
 	OSMO_STRLCPY_ARRAY(golh->proc_name, target->tgt_gsmtap.ident);
 	if (subsys_name)
 		OSMO_STRLCPY_ARRAY(golh->subsys, subsys_name + 1);
@@ -95,19 +106,126 @@ static void _gsmtap_raw_output(struct log_target *target, int subsys,
 	golh->level = level;
 	/* we always store the timestamp in the message, irrespective
 	 * of hat prrint_[ext_]timestamp say */
-	golh->ts.sec = osmo_htonl(tv.tv_sec);
-	golh->ts.usec = osmo_htonl(tv.tv_usec);
+	golh->ts.sec = osmo_htonl(tv->tv_sec);
+	golh->ts.usec = osmo_htonl(tv->tv_usec);
 
-	rc = vsnprintf((char *) msg->tail, msgb_tailroom(msg), format, ap);
-	if (rc < 0) {
-		msgb_free(msg);
-		return;
-	} else if (rc >= msgb_tailroom(msg)) {
+	room = len - sizeof(*golh);
+	rc = vsnprintf((char *) golh + sizeof(*golh), room, format, ap);
+	if (rc < 0)
+		return rc;
+	if (rc >= room) {
+		if (!truncate)
+			return -ENOSPC;
 		/* If the output was truncated, vsnprintf() returns the
 		 * number of characters which would have been written
 		 * if enough space had been available (excluding '\0'). */
-		rc = msgb_tailroom(msg);
-		msg->tail[rc - 1]  = '\0';
+		rc = room;
+		buf[len - 1] = '\0';
+	}
+
+	return sizeof(*golh) + rc;
+}
+
+static void gsmtap_batch_flush(struct log_gsmtap_batch *batch)
+{
+	struct msgb *msg = batch->msg;
+	int rc;
+
+	osmo_timer_del(&batch->timer);
+	if (!msg)
+		return;
+	batch->msg = NULL;
+
+	rc = gsmtap_sendmsg(batch->target->tgt_gsmtap.gsmtap_inst, msg);
+	if (rc)
+		msgb_free(msg);
+}
+
+static void gsmtap_batch_timer_cb(void *data)
+{
+	gsmtap_batch_flush(data);
+}
+
+/* Append one record to the batch; flush it when full or the record does not fit */
+static void gsmtap_batch_output(struct log_gsmtap_batch *batch, int subsys,
+				unsigned int level, const char *file, int line,
+				const struct timeval *tv, const char *format, va_list ap)
+{
+	struct msgb *msg;
+	va_list bp;
+	bool first;
+	int rc;
+
+	while (1) {
+		if (!batch->msg) {
+			batch->msg = msgb_alloc(batch->target->tgt_gsmtap.batch_size, "GSMTAP logging");
+			if (!batch->msg)
+				return;
+			gsmtap_fill_hdr(batch->msg, GSMTAP_OSMOCORE_LOG_BATCH);
+		}
+		msg = batch->msg;
+		first = msg->len == sizeof(struct gsmtap_hdr);
+
+		/* records are preceded by their 16-bit length */
+		if (msgb_tailroom(msg) <= 2) {
+			gsmtap_batch_flush(batch);
+			continue;
+		}
+
+		/* only the first record of a datagram may be truncated */
+		va_copy(bp, ap);
+		rc = gsmtap_fill_record(msg->tail + 2, msgb_tailroom(msg) - 2, batch->target, subsys,
+					level, file, line, tv, format, bp, first);
+		va_end(bp);
+		if (rc == -ENOSPC && !first) {
+			gsmtap_batch_flush(batch);
+			continue;
+		}
+		if (rc < 0)
+			return;
+		break;
+	}
+
+	osmo_store16be(rc, msgb_put(msg, 2));
+	msgb_put(msg, rc);
+
+	if (msgb_tailroom(msg) <= 2 + sizeof(struct gsmtap_osmocore_log_hdr))
+		gsmtap_batch_flush(batch);
+	else if (!osmo_timer_pending(&batch->timer)) {
+		unsigned int flush_ms = batch->target->tgt_gsmtap.batch_flush_ms;
+		osmo_timer_schedule(&batch->timer, flush_ms / 1000, (flush_ms % 1000) * 1000);
+	}
+}
+
+static void _gsmtap_raw_output(struct log_target *target, int subsys,
+			       unsigned int level, const char *file,
+			       int line, int cont, const char *format,
+			       va_list ap)
+{
+	struct msgb *msg;
+	struct timeval tv;
+	int rc;
+
+	/* get timestamp ASAP */
+	osmo_gettimeofday(&tv, NULL);
+
+	if (target->tgt_gsmtap.batch) {
+		gsmtap_batch_output(target->tgt_gsmtap.batch, subsys, level, file, line,
+				    &tv, format, ap);
+		return;
+	}
+
+	msg = msgb_alloc(sizeof(struct gsmtap_hdr) + sizeof(struct gsmtap_osmocore_log_hdr)
+			 + GSMTAP_LOG_MAX_SIZE, "GSMTAP logging");
+	if (!msg)
+		return;
+
+	gsmtap_fill_hdr(msg, GSMTAP_OSMOCORE_LOG_SINGLE);
+	rc = gsmtap_fill_record(msg->tail, msgb_tailroom(msg), target, subsys, level,
+				file, line, &tv, format, ap, true);
+	if (rc < 0) {
+		msgb_free(msg);
+		return;
 	}
 	msgb_put(msg, rc);
 
@@ -116,6 +234,53 @@ static void _gsmtap_raw_output(struct log_target *target, int subsys,
 		msgb_free(msg);
 }
 
+/*! Send several log records per GSMTAP datagram.
+ *  \param[in] target GSMTAP log target
+ *  \param[in] max_size maximum size of a datagram, at least 103 bytes to fit a record with a
+ *             one character message; 0 to send one datagram per record
+ *  \param[in] flush_ms maximum time in milliseconds a record is held back
+ *  \returns 0 on success; negative on error
+ *
+ *  Records are collected until the next one does not fit into max_size or
+ *  flush_ms have passed since the first one, which requires the select loop
+ *  to run. A flush_ms of 0 sends the records collected during one iteration
+ *  of the select loop. With a GSMTAP instance in capture mode, the
+ *  datagrams of several flushes are sent with a single sendmmsg().
+ *
+ *  The datagrams have the GSMTAP sub-type GSMTAP_OSMOCORE_LOG_BATCH. Each
+ *  record is a 16-bit length in network byte order followed by the
+ *  gsmtap_osmocore_log_hdr and the message, as sent in non-batched mode. */
+int log_target_gsmtap_set_batch(struct log_target *target, unsigned int max_size,
+				unsigned int flush_ms)
+{
+	struct log_gsmtap_batch *batch = target->tgt_gsmtap.batch;
+
+	if (target->type != LOG_TGT_TYPE_GSMTAP)
+		return -EINVAL;
+	if (max_size && (max_size > UINT16_MAX
+			 || max_size < sizeof(struct gsmtap_hdr) + 2 + sizeof(struct gsmtap_osmocore_log_hdr) + 1))
+		return -EINVAL;
+
+	if (batch) {
+		gsmtap_batch_flush(batch);
+		if (!max_size) {
+			talloc_free(batch);
+			target->tgt_gsmtap.batch = NULL;
+		}
+	} else if (max_size) {
+		batch = talloc_zero(target, struct log_gsmtap_batch);
+		if (!batch)
+			return -ENOMEM;
+		batch->target = target;
+		osmo_timer_setup(&batch->timer, gsmtap_batch_timer_cb, batch);
+		target->tgt_gsmtap.batch = batch;
+	}
+
+	target->tgt_gsmtap.batch_size = max_size;
+	target->tgt_gsmtap.batch_flush_ms = flush_ms;
+	return 0;
+}
+
 /*! Create a new logging target for GSMTAP logging
  *  \param[in] host remote host to send the logs to
  *  \param[in] port remote port to send the logs to
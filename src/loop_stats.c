@@ -0,0 +1,309 @@
+/*! \file loop_stats.c
+ * Statistics about the select loop and the call-backs it invokes. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*! \addtogroup loop_stats
+ *  @{
+ *  Finding out which call-back stalls a single-threaded osmocom
+ *  program.
+ *
+ *  Once enabled by \ref osmo_loop_stats_enable, the select loop counts
+ *  the invocations of each \ref osmo_fd call-back (per registered
+ *  osmo_fd) and of each timer call-back (per call-back function), and
+ *  measures the duration of every n-th invocation of each of them.  It also accounts
+ *  for the time spent in select() vs. the time spent in call-backs.
+ *
+ *  Durations are additionally recorded in the histograms of the
+ *  "event_loop" stat item group, and are thus exported via the stats
+ *  reporters and the CTRL interface.
+ *
+ *  The statistics of an osmo_fd are discarded when it is unregistered.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdbool.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/loop_stats_internal.h>
+
+/* number of call-back sites we can keep track of, power of two */
+#define LOOP_STATS_NUM_CB	1024
+
+unsigned int osmo_loop_stats_sample_rate;
+
+static struct osmo_loop_stats loop_stats;
+static struct osmo_loop_cb_stats cb_stats[LOOP_STATS_NUM_CB];
+
+/* the osmo_fd whose sampled call-back is running, and whether it was
+ * unregistered by it; see osmo_loop_stats_cb_end() */
+static const void *running_fd;
+static bool running_fd_unregistered;
+
+enum loop_stat_item {
+	LOOP_STAT_BUSY,
+	LOOP_STAT_IDLE,
+	LOOP_STAT_CB,
+};
+
+/* durations in microseconds, up to ten seconds within 12.5% */
+static const struct osmo_stat_hist_desc loop_hist_desc = {
+	.max_value = 10000000,
+	.precision_bits = 3,
+};
+
+static const struct osmo_stat_item_desc loop_stat_item_desc[] = {
+	[LOOP_STAT_BUSY] = { "iteration.busy", "Time spent in call-backs per loop iteration",
+			     "us", 16, 0, &loop_hist_desc },
+	[LOOP_STAT_IDLE] = { "iteration.idle", "Time spent waiting per loop iteration",
+			     "us", 16, 0, &loop_hist_desc },
+	[LOOP_STAT_CB] = { "callback.duration", "Duration of a sampled call-back",
+			   "us", 16, 0, &loop_hist_desc },
+};
+
+static const struct osmo_stat_item_group_desc loop_statg_desc = {
+	.group_name_prefix = "event_loop",
+	.group_description = "Event loop",
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+	.num_items = ARRAY_SIZE(loop_stat_item_desc),
+	.item_desc = loop_stat_item_desc,
+};
+
+static struct osmo_stat_item_group *loop_statg;
+
+/*! Enable event loop statistics
+ *  \param[in] sample_rate measure the duration of every n-th call-back, 1 to measure all
+ *  \returns 0 on success; negative on error */
+int osmo_loop_stats_enable(unsigned int sample_rate)
+{
+	if (!sample_rate)
+		return -EINVAL;
+
+	if (!loop_statg) {
+		loop_statg = osmo_stat_item_group_alloc(NULL, &loop_statg_desc, 0);
+		if (!loop_statg)
+			return -ENOMEM;
+	}
+
+	osmo_loop_stats_sample_rate = sample_rate;
+	return 0;
+}
+
+/*! Disable event loop statistics, keeping what was collected so far */
+void osmo_loop_stats_disable(void)
+{
+	osmo_loop_stats_sample_rate = 0;
+}
+
+/*! Discard all event loop statistics collected so far */
+void osmo_loop_stats_reset(void)
+{
+	memset(&loop_stats, 0, sizeof(loop_stats));
+	memset(cb_stats, 0, sizeof(cb_stats));
+	running_fd = NULL;
+}
+
+/*! Get the statistics of the select loop itself */
+const struct osmo_loop_stats *osmo_loop_stats_get(void)
+{
+	return &loop_stats;
+}
+
+/*! Iterate over the statistics of all call-back sites
+ *  \param[in] handle_cb Call-back function, aborts if rc < 0
+ *  \param[in] data Private data handed through to \a handle_cb */
+int osmo_loop_stats_for_each_cb(osmo_loop_cb_stats_handler_t handle_cb, void *data)
+{
+	unsigned int i;
+	int rc = 0;
+
+	for (i = 0; i < LOOP_STATS_NUM_CB; i++) {
+		if (!cb_stats[i].key)
+			continue;
+		rc = handle_cb(&cb_stats[i], data);
+		if (rc < 0)
+			return rc;
+	}
+
+	return rc;
+}
+
+/*! Current time of the monotonic clock in nanoseconds */
+uint64_t osmo_loop_stats_now(void)
+{
+	struct timespec ts;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned int cb_slot(enum osmo_loop_cb_type type, const void *key)
+{
+	return ((((uintptr_t)key >> 4) * 2654435761U) ^ type) & (LOOP_STATS_NUM_CB - 1);
+}
+
+/* open addressing with linear probing */
+static struct osmo_loop_cb_stats *cb_stats_find(enum osmo_loop_cb_type type, const void *key,
+						bool create)
+{
+	unsigned int i, slot = cb_slot(type, key);
+
+	for (i = 0; i < LOOP_STATS_NUM_CB; i++) {
+		struct osmo_loop_cb_stats *s = &cb_stats[(slot + i) & (LOOP_STATS_NUM_CB - 1)];
+
+		if (s->key == key && s->type == type)
+			return s;
+		if (!s->key) {
+			if (!create)
+				return NULL;
+			s->type = type;
+			s->key = key;
+			return s;
+		}
+	}
+
+	return NULL;
+}
+
+/*! Account for a call-back that is about to be invoked
+ *  \param[in] type kind of call-back
+ *  \param[in] key the \ref osmo_fd, or the timer call-back; only its address is used
+ *  \param[in] cb the call-back function
+ *  \param[in] fd file descriptor number, -1 for timers
+ *  \returns start time to pass to \ref osmo_loop_stats_cb_end; 0 if this invocation is not sampled
+ *
+ *  Every n-th invocation of each call-back site is sampled, so that call-backs
+ *  invoked in a fixed pattern are all measured alike. */
+uint64_t osmo_loop_stats_cb_begin(enum osmo_loop_cb_type type, const void *key, const void *cb, int fd)
+{
+	struct osmo_loop_cb_stats *s = cb_stats_find(type, key, true);
+
+	if (!s) {
+		loop_stats.dropped++;
+		return 0;
+	}
+
+	s->cb = cb;
+	s->fd = fd;
+	s->count++;
+
+	if (++s->sample_ctr < osmo_loop_stats_sample_rate)
+		return 0;
+	s->sample_ctr = 0;
+
+	if (type == OSMO_LOOP_CB_FD) {
+		running_fd = key;
+		running_fd_unregistered = false;
+	}
+	return osmo_loop_stats_now();
+}
+
+/*! Account for the duration of a call-back that has returned
+ *  \param[in] type kind of call-back
+ *  \param[in] key the \ref osmo_fd, or the timer call-back; only its address is used
+ *  \param[in] start as returned by \ref osmo_loop_stats_cb_begin
+ *
+ *  Nothing is accounted for an \ref osmo_fd that was unregistered by its own
+ *  call-back, as \a key may be dangling by now. */
+void osmo_loop_stats_cb_end(enum osmo_loop_cb_type type, const void *key, uint64_t start)
+{
+	struct osmo_loop_cb_stats *s;
+	uint64_t duration;
+
+	if (!start)
+		return;
+
+	if (type == OSMO_LOOP_CB_FD) {
+		running_fd = NULL;
+		if (running_fd_unregistered)
+			return;
+	}
+
+	s = cb_stats_find(type, key, false);
+	if (!s)
+		return;
+
+	duration = osmo_loop_stats_now() - start;
+	s->sampled++;
+	s->total_ns += duration;
+	if (duration > s->max_ns)
+		s->max_ns = duration;
+
+	if (loop_statg)
+		osmo_stat_item_set(loop_statg->items[LOOP_STAT_CB], duration / 1000);
+}
+
+/*! Account for one iteration of the select loop
+ *  \param[in] start time before waiting for file descriptors
+ *  \param[in] woken time when select() returned
+ *  \param[in] end time after all call-backs have returned */
+void osmo_loop_stats_iteration(uint64_t start, uint64_t woken, uint64_t end)
+{
+	uint64_t busy = end - woken;
+
+	loop_stats.iterations++;
+	loop_stats.idle_ns += woken - start;
+	loop_stats.busy_ns += busy;
+	if (busy > loop_stats.max_busy_ns)
+		loop_stats.max_busy_ns = busy;
+
+	/* only allocated by osmo_loop_stats_enable() */
+	if (!loop_statg)
+		return;
+	osmo_stat_item_set(loop_statg->items[LOOP_STAT_BUSY], busy / 1000);
+	osmo_stat_item_set(loop_statg->items[LOOP_STAT_IDLE], (woken - start) / 1000);
+}
+
+/*! Discard the statistics of an \ref osmo_fd that is being unregistered */
+void osmo_loop_stats_fd_unregister(const void *ofd)
+{
+	struct osmo_loop_cb_stats *s = cb_stats_find(OSMO_LOOP_CB_FD, ofd, false);
+	unsigned int hole, i;
+
+	if (ofd == running_fd)
+		running_fd_unregistered = true;
+
+	if (!s)
+		return;
+
+	/* backward shift deletion: move up any entry that would no longer
+	 * be found across the hole */
+	hole = s - cb_stats;
+	for (i = (hole + 1) & (LOOP_STATS_NUM_CB - 1); cb_stats[i].key;
+	     i = (i + 1) & (LOOP_STATS_NUM_CB - 1)) {
+		unsigned int home = cb_slot(cb_stats[i].type, cb_stats[i].key);
+
+		/* distance from the home slot, compared cyclically */
+		if (((i - home) & (LOOP_STATS_NUM_CB - 1)) >= ((i - hole) & (LOOP_STATS_NUM_CB - 1))) {
+			cb_stats[hole] = cb_stats[i];
+			hole = i;
+		}
+	}
+	memset(&cb_stats[hole], 0, sizeof(cb_stats[hole]));
+}
+
+/*! @} */
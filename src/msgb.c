@@ -61,6 +61,7 @@
 #include <errno.h>
 
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/msgb_compact.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/logging.h>
 
@@ -368,6 +369,134 @@ struct msgb *msgb_copy(const struct msgb *msg, const char *name)
 	return msgb_copy_c(tall_msgb_ctx, msg, name);
 }
 
+/*! Allocate a new compact message buffer from given talloc context
+ * \param[in] ctx talloc context from which to allocate
+ * \param[in] size Length in octets, including headroom
+ * \param[in] cb_len Number of control buffer entries, may be zero
+ * \returns dynamically-allocated \ref msgb_compact
+ *
+ * Header, control buffer and data array live in one unnamed talloc
+ * chunk.  The control buffer is zero-initialized, the data array is not.
+ */
+struct msgb_compact *msgbc_alloc_c(const void *ctx, uint16_t size, uint8_t cb_len)
+{
+	struct msgb_compact *m;
+	size_t hdr_size = sizeof(*m) + cb_len * sizeof(m->cb[0]);
+
+	m = talloc_size(ctx, hdr_size + size);
+	if (!m) {
+		LOGP(DLGLOBAL, LOGL_FATAL, "Unable to allocate a compact msgb: "
+			"size=%u\n", size);
+		return NULL;
+	}
+
+	*m = (struct msgb_compact) {
+		.data_len = size,
+		.l1h = MSGBC_NO_HDR,
+		.l2h = MSGBC_NO_HDR,
+		.l3h = MSGBC_NO_HDR,
+		.l4h = MSGBC_NO_HDR,
+		.cb_len = cb_len,
+	};
+	INIT_LLIST_HEAD(&m->list);
+	if (cb_len)
+		memset(m->cb, 0, cb_len * sizeof(m->cb[0]));
+
+	return m;
+}
+
+/*! Allocate a new compact message buffer from tall_msgb_ctx
+ * \param[in] size Length in octets, including headroom
+ * \param[in] cb_len Number of control buffer entries, may be zero
+ * \returns dynamically-allocated \ref msgb_compact
+ */
+struct msgb_compact *msgbc_alloc(uint16_t size, uint8_t cb_len)
+{
+	return msgbc_alloc_c(tall_msgb_ctx, size, cb_len);
+}
+
+/*! Release given compact message buffer
+ * \param[in] m Compact message buffer to be freed
+ */
+void msgbc_free(struct msgb_compact *m)
+{
+	talloc_free(m);
+}
+
+/*! Re-set all compact message buffer offsets, see \ref msgb_reset
+ *  \param[in] m compact message buffer that is to be resetted
+ */
+void msgbc_reset(struct msgb_compact *m)
+{
+	m->len = 0;
+	m->data = 0;
+	m->l1h = m->l2h = m->l3h = m->l4h = MSGBC_NO_HDR;
+	memset(m->cb, 0, m->cb_len * sizeof(m->cb[0]));
+}
+
+/*! Copy an msgb into a newly allocated compact msgb.
+ *
+ *  Copies the data buffer and the l1h-l4h headers, and as many control
+ *  buffer entries as both sides have.  dst/trx and lchan are dropped.
+ *  \param[in] ctx  talloc context on which the new compact msgb is allocated
+ *  \param[in] msg  The msgb to copy
+ *  \param[in] cb_len  Number of control buffer entries of the new compact msgb
+ *  \returns newly allocated compact msgb, NULL on error
+ */
+struct msgb_compact *msgbc_from_msgb_c(const void *ctx, const struct msgb *msg, uint8_t cb_len)
+{
+	struct msgb_compact *m;
+
+	m = msgbc_alloc_c(ctx, msg->data_len, cb_len);
+	if (!m)
+		return NULL;
+
+	memcpy(msgbc_head(m), msg->_data, msg->data_len);
+	memcpy(m->cb, msg->cb, OSMO_MIN(cb_len, ARRAY_SIZE(msg->cb)) * sizeof(m->cb[0]));
+	m->len = msg->len;
+	m->data = msg->data - msg->_data;
+
+	if (msg->l1h)
+		m->l1h = msg->l1h - msg->_data;
+	if (msg->l2h)
+		m->l2h = msg->l2h - msg->_data;
+	if (msg->l3h)
+		m->l3h = msg->l3h - msg->_data;
+	if (msg->l4h)
+		m->l4h = msg->l4h - msg->_data;
+
+	return m;
+}
+
+/*! Copy a compact msgb into a newly allocated msgb, e.g. to pass it to
+ *  API that takes a \ref msgb.
+ *  \param[in] ctx  talloc context on which the new msgb is allocated
+ *  \param[in] m  The compact msgb to copy
+ *  \param[in] name  Human-readable name to be associated with the new msgb
+ *  \returns newly allocated msgb, NULL on error
+ */
+struct msgb *msgb_from_msgbc_c(const void *ctx, const struct msgb_compact *m, const char *name)
+{
+	struct msgb *msg;
+
+	msg = msgb_alloc_c(ctx, m->data_len, name);
+	if (!msg)
+		return NULL;
+
+	memcpy(msg->_data, msgbc_head(m), m->data_len);
+	memcpy(msg->cb, m->cb, OSMO_MIN(m->cb_len, ARRAY_SIZE(msg->cb)) * sizeof(msg->cb[0]));
+	msg->len = m->len;
+	msg->data += m->data;
+	msg->tail = msg->data + m->len;
+
+	msg->l1h = m->l1h == MSGBC_NO_HDR ? NULL : msg->_data + m->l1h;
+	msg->l2h = m->l2h == MSGBC_NO_HDR ? NULL : msg->_data + m->l2h;
+	msg->l3h = m->l3h == MSGBC_NO_HDR ? NULL : msg->_data + m->l3h;
+	msg->l4h = m->l4h == MSGBC_NO_HDR ? NULL : msg->_data + m->l4h;
+
+	return msg;
+}
+
 /*! Resize an area within an msgb
  *
  *  This resizes a sub area of the msgb data and adjusts the pointers (incl
@@ -465,20 +594,24 @@ char *msgb_hexdump_buf(char *buf, size_t buf_len, const struct msgb *msg)
 			buf_offs += nchars;
 			continue;
 		}
-		nchars = snprintf(buf + buf_offs, buf_len - buf_offs,
-				  "%s[L%d]> ",
-				  osmo_hexdump(start, lxhs[i] - start),
-				  i+1);
+		/* dump straight into buf instead of going through osmo_hexdump()'s static buffer */
+		nchars = osmo_hexdump_len(lxhs[i] - start, " ", true);
+		if (nchars + buf_offs >= buf_len)
+			return "ERROR";
+		osmo_hexdump_buf(buf + buf_offs, buf_len - buf_offs, start, lxhs[i] - start, " ", true);
+		buf_offs += nchars;
+
+		nchars = snprintf(buf + buf_offs, buf_len - buf_offs, "[L%d]> ", i+1);
 		if (nchars < 0 || nchars + buf_offs >= buf_len)
 			return "ERROR";
 
 		buf_offs += nchars;
 		start = lxhs[i];
 	}
-	nchars = snprintf(buf + buf_offs, buf_len - buf_offs,
-			  "%s", osmo_hexdump(start, msg->tail - start));
-	if (nchars < 0 || nchars + buf_offs >= buf_len)
+	nchars = osmo_hexdump_len(msg->tail - start, " ", true);
+	if (nchars + buf_offs >= buf_len)
 		return "ERROR";
+	osmo_hexdump_buf(buf + buf_offs, buf_len - buf_offs, start, msg->tail - start, " ", true);
 
 	buf_offs += nchars;
 
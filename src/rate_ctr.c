@@ -51,12 +51,26 @@
  *  per-minute, per-hour and per-day averages based on the current
  *  value.
  *
+ *  Groups marked with \ref rate_ctr_group_set_lazy are skipped by that
+ *  timer.  Each of their counters remembers up to which tick its
+ *  intervals have been computed, and catches up on the next \ref
+ *  rate_ctr_add or \ref rate_ctr_group_update, which yields the very
+ *  same rates as the periodic computation at a cost independent of the
+ *  number of idle counters.  Counters of other groups skip that step.
+ *
+ *  Counters of a group allocated via \ref rate_ctr_group_alloc_sharded
+ *  may additionally be incremented from other threads via \ref
+ *  rate_ctr_group_shard_add.  Each thread owns one shard of counter
+ *  slots, which are summed up into \ref rate_ctr.current by the thread
+ *  running the select loop.
+ *
  *  The counters can be reported using \ref stats or by VTY
  *  introspection, as well as by any application-specific code accessing
  *  the \ref rate_ctr.intv array directly.
  *
  * \file rate_ctr.c */
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -72,6 +86,38 @@ static LLIST_HEAD(rate_ctr_groups);
 
 static void *tall_rate_ctr_ctx;
 
+static struct osmo_timer_list rate_ctr_timer;
+static uint64_t timer_ticks;
+
+/* rate_ctr.ticks of the counters of groups that are not lazy, whose
+ * intervals are computed by the timer */
+#define RATE_CTR_TICKS_EAGER	UINT64_MAX
+
+/* groups hashed by name and index, for rate_ctr_get_group_by_name_idx() */
+struct rate_ctr_group_bucket {
+	struct rate_ctr_group **grps;
+	unsigned int num;
+};
+static struct rate_ctr_group_bucket *grp_hash;
+/* number of buckets, power of two */
+static unsigned int grp_hash_size;
+static unsigned int grp_hash_count;
+
+/* number of counter slots per cache line */
+#define RATE_CTR_SHARD_ALIGN	(64 / sizeof(uint64_t))
+
+/*! per-thread counter slots of a sharded \ref rate_ctr_group */
+struct rate_ctr_shards {
+	/*! number of shards */
+	unsigned int num;
+	/*! distance between two shards in slots, multiple of a cache line */
+	unsigned int stride;
+	/*! sum of all shards already added to \ref rate_ctr.current */
+	uint64_t *folded;
+	/*! num * stride slots, each shard only written by its own thread */
+	uint64_t *slots;
+};
+
 
 static bool rate_ctrl_group_desc_validate(const struct rate_ctr_group_desc *desc)
 {
@@ -184,6 +230,92 @@ err_free:
 	return NULL;
 }
 
+static unsigned int grp_hash_bucket(const char *name, unsigned int idx)
+{
+	uint32_t h = 2166136261U;
+
+	while (*name)
+		h = (h ^ (uint8_t)*name++) * 16777619U;
+	h ^= idx * 2654435761U;
+	return h & (grp_hash_size - 1);
+}
+
+static int grp_hash_insert(struct rate_ctr_group *grp)
+{
+	struct rate_ctr_group_bucket *b = &grp_hash[grp_hash_bucket(grp->desc->group_name_prefix, grp->idx)];
+	struct rate_ctr_group **grps;
+
+	grps = talloc_realloc(grp_hash, b->grps, struct rate_ctr_group *, b->num + 1);
+	if (!grps)
+		return -ENOMEM;
+	b->grps = grps;
+	b->grps[b->num++] = grp;
+	return 0;
+}
+
+/* (re)build the hash table with a size suitable for the number of groups */
+static int grp_hash_rebuild(unsigned int size)
+{
+	struct rate_ctr_group_bucket *old = grp_hash;
+	struct rate_ctr_group *ctrg;
+
+	grp_hash = talloc_zero_array(tall_rate_ctr_ctx, struct rate_ctr_group_bucket, size);
+	if (!grp_hash) {
+		grp_hash = old;
+		return -ENOMEM;
+	}
+	grp_hash_size = size;
+	talloc_free(old);
+
+	/* oldest first, like the list is searched newest first */
+	llist_for_each_entry_reverse(ctrg, &rate_ctr_groups, list) {
+		if (grp_hash_insert(ctrg) < 0) {
+			talloc_free(grp_hash);
+			grp_hash = NULL;
+			grp_hash_size = 0;
+			return -ENOMEM;
+		}
+	}
+	return 0;
+}
+
+static void grp_hash_add(struct rate_ctr_group *grp)
+{
+	grp_hash_count++;
+
+	/* without a hash table, lookups fall back to walking the list */
+	if (!grp_hash || grp_hash_count > grp_hash_size * 4) {
+		grp_hash_rebuild(grp_hash_size ? grp_hash_size * 2 : 64);
+		return;
+	}
+	if (grp_hash_insert(grp) < 0) {
+		talloc_free(grp_hash);
+		grp_hash = NULL;
+		grp_hash_size = 0;
+	}
+}
+
+static bool grp_hash_del_from(struct rate_ctr_group_bucket *b, struct rate_ctr_group *grp)
+{
+	unsigned int i;
+
+	for (i = 0; i < b->num; i++) {
+		if (b->grps[i] == grp) {
+			memmove(&b->grps[i], &b->grps[i + 1], (b->num - i - 1) * sizeof(b->grps[0]));
+			b->num--;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void grp_hash_del(struct rate_ctr_group *grp)
+{
+	grp_hash_count--;
+	if (grp_hash)
+		grp_hash_del_from(&grp_hash[grp_hash_bucket(grp->desc->group_name_prefix, grp->idx)], grp);
+}
+
 /*! Find an unused index for this rate counter group.
  *  \param[in] name Name of the counter group
  *  \returns the largest used index number + 1, or 0 if none exist yet. */
@@ -205,6 +337,32 @@ static unsigned int rate_ctr_get_unused_name_idx(const char *name)
 	return idx;
 }
 
+static struct rate_ctr_shards *rate_ctr_shards_alloc(void *ctx, unsigned int num_ctr,
+						     unsigned int num_shards)
+{
+	struct rate_ctr_shards *shards;
+	uintptr_t slots;
+
+	shards = talloc_zero(ctx, struct rate_ctr_shards);
+	if (!shards)
+		return NULL;
+
+	shards->num = num_shards;
+	shards->stride = OSMO_MAX(1, (num_ctr + RATE_CTR_SHARD_ALIGN - 1) / RATE_CTR_SHARD_ALIGN)
+			 * RATE_CTR_SHARD_ALIGN;
+	shards->folded = talloc_zero_array(shards, uint64_t, num_ctr);
+	/* over-allocate so that each shard can start on its own cache line */
+	slots = (uintptr_t) talloc_zero_array(shards, uint64_t,
+					      num_shards * shards->stride + RATE_CTR_SHARD_ALIGN);
+	if (!shards->folded || !slots) {
+		talloc_free(shards);
+		return NULL;
+	}
+	shards->slots = (uint64_t *) ((slots + 63) & ~(uintptr_t)63);
+
+	return shards;
+}
+
 /*! Allocate a new group of counters according to description
  *  \param[in] ctx parent talloc context
  *  \param[in] desc Rate counter group description
@@ -214,7 +372,20 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 					    const struct rate_ctr_group_desc *desc,
 					    unsigned int idx)
 {
-	unsigned int size;
+	return rate_ctr_group_alloc_sharded(ctx, desc, idx, 0);
+}
+
+/*! Allocate a new group of counters which can be incremented from several threads
+ *  \param[in] ctx parent talloc context
+ *  \param[in] desc Rate counter group description
+ *  \param[in] idx Index of new counter group
+ *  \param[in] num_shards Number of threads which use \ref rate_ctr_group_shard_add, may be 0
+ */
+struct rate_ctr_group *rate_ctr_group_alloc_sharded(void *ctx,
+						    const struct rate_ctr_group_desc *desc,
+						    unsigned int idx, unsigned int num_shards)
+{
+	unsigned int i, size;
 	struct rate_ctr_group *group;
 
 	if (rate_ctr_get_group_by_name_idx(desc->group_name_prefix, idx)) {
@@ -244,10 +415,22 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 		}
 	}
 
+	for (i = 0; i < desc->num_ctr; i++)
+		group->ctr[i].ticks = RATE_CTR_TICKS_EAGER;
+
+	if (num_shards) {
+		group->shards = rate_ctr_shards_alloc(group, desc->num_ctr, num_shards);
+		if (!group->shards) {
+			talloc_free(group);
+			return NULL;
+		}
+	}
+
 	group->desc = desc;
 	group->idx = idx;
 
 	llist_add(&group->list, &rate_ctr_groups);
+	grp_hash_add(group);
 
 	return group;
 }
@@ -258,63 +441,181 @@ void rate_ctr_group_free(struct rate_ctr_group *grp)
 	if (!grp)
 		return;
 
-	if (!llist_empty(&grp->list))
+	if (!llist_empty(&grp->list)) {
 		llist_del(&grp->list);
+		grp_hash_del(grp);
+	}
 	talloc_free(grp);
 }
 
+/*! Change the index of a group of counters
+ *  \param[in] grp Rate counter group
+ *  \param[in] idx New index of the group */
+void rate_ctr_group_upd_idx(struct rate_ctr_group *grp, unsigned int idx)
+{
+	if (llist_empty(&grp->list)) {
+		grp->idx = idx;
+		return;
+	}
+
+	/* re-file the group under its new name/index key */
+	grp_hash_del(grp);
+	grp->idx = idx;
+	grp_hash_add(grp);
+}
+
+/* length of each interval in one-second ticks */
+static const uint64_t intv_ticks[RATE_CTR_INTV_NUM] = {
+	[RATE_CTR_INTV_SEC]	= 1,
+	[RATE_CTR_INTV_MIN]	= 60,
+	[RATE_CTR_INTV_HOUR]	= 60*60,
+	[RATE_CTR_INTV_DAY]	= 24*60*60,
+};
+
+/* Compute the intervals expired between tick \a since and now.  All
+ * events up to now were counted before the first of these ticks, so
+ * the outcome is identical to updating the intervals on every tick:
+ * only the first expiry of each interval sees a difference to the last
+ * value, all later ones yield a rate of zero. */
+static void rate_ctr_intv_update(struct rate_ctr *ctr, uint64_t since)
+{
+	uint64_t carry = 0;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(ctr->intv); i++) {
+		struct rate_ctr_per_intv *intv = &ctr->intv[i];
+		uint64_t expired = timer_ticks / intv_ticks[i] - since / intv_ticks[i];
+
+		if (!expired) {
+			/* update the rate of this bigger interval.  This will
+			 * be overwritten when this interval expires */
+			intv->rate += carry;
+			carry = 0;
+			continue;
+		}
+
+		/* calculate rate over last interval */
+		carry = ctr->current - intv->last;
+		intv->rate = expired > 1 ? 0 : carry;
+		/* save current counter for next interval */
+		intv->last = ctr->current;
+	}
+}
+
+/* Compute the intervals of a counter of a lazy group up to now */
+static void rate_ctr_catch_up(struct rate_ctr *ctr)
+{
+	if (ctr->ticks == timer_ticks)
+		return;
+
+	rate_ctr_intv_update(ctr, ctr->ticks);
+	ctr->ticks = timer_ticks;
+}
+
 /*! Add a number to the counter */
 void rate_ctr_add(struct rate_ctr *ctr, int inc)
 {
+	if (ctr->ticks != RATE_CTR_TICKS_EAGER)
+		rate_ctr_catch_up(ctr);
 	ctr->current += inc;
 }
 
-/*! Return the counter difference since the last call to this function */
-int64_t rate_ctr_difference(struct rate_ctr *ctr)
+/*! Add a number to a counter of a sharded group from a thread other than the main one
+ *  \param[in] ctrg Rate counter group allocated by \ref rate_ctr_group_alloc_sharded
+ *  \param[in] shard Index of the shard owned by the calling thread
+ *  \param[in] idx Index of the counter within \a ctrg
+ *  \param[in] inc quantity to increment the counter by
+ *
+ * Each shard must only ever be written by one thread.  The sum is added to
+ * \ref rate_ctr.current by \ref rate_ctr_group_update and the one-second
+ * timer, both running in the thread of the select loop. */
+void rate_ctr_group_shard_add(struct rate_ctr_group *ctrg, unsigned int shard,
+			      unsigned int idx, int inc)
 {
-	int64_t result = ctr->current - ctr->previous;
-	ctr->previous = ctr->current;
+	uint64_t *slot;
 
-	return result;
-}
+	OSMO_ASSERT(ctrg->shards && shard < ctrg->shards->num && idx < ctrg->desc->num_ctr);
 
-/* TODO: support update intervals > 1s */
-/* TODO: implement this as a special stats reporter */
+	slot = &ctrg->shards->slots[shard * ctrg->shards->stride + idx];
+	/* single writer: no need for an atomic read-modify-write */
+	__atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + inc, __ATOMIC_RELAXED);
+}
 
-static void interval_expired(struct rate_ctr *ctr, enum rate_ctr_intv intv)
+/* add everything counted in the shards since the last call to the counters */
+static void rate_ctr_shards_fold(struct rate_ctr_group *grp)
 {
-	/* calculate rate over last interval */
-	ctr->intv[intv].rate = ctr->current - ctr->intv[intv].last;
-	/* save current counter for next interval */
-	ctr->intv[intv].last = ctr->current;
-
-	/* update the rate of the next bigger interval.  This will
-	 * be overwritten when that next larger interval expires */
-	if (intv + 1 < ARRAY_SIZE(ctr->intv))
-		ctr->intv[intv+1].rate += ctr->intv[intv].rate;
+	struct rate_ctr_shards *shards = grp->shards;
+	unsigned int i, s;
+
+	for (i = 0; i < grp->desc->num_ctr; i++) {
+		uint64_t sum = 0;
+
+		for (s = 0; s < shards->num; s++)
+			sum += __atomic_load_n(&shards->slots[s * shards->stride + i], __ATOMIC_RELAXED);
+
+		grp->ctr[i].current += sum - shards->folded[i];
+		shards->folded[i] = sum;
+	}
 }
 
-static struct osmo_timer_list rate_ctr_timer;
-static uint64_t timer_ticks;
+/*! Bring all counters of a group up to date
+ *  \param[in] grp Rate counter group
+ *
+ * Computes the intervals of a lazy group and adds the shards of a sharded
+ * group.  There is no need to call this for other groups, but it does no
+ * harm either.  Anyone reading \ref rate_ctr.current or \ref rate_ctr.intv
+ * of such groups without going through \ref rate_ctr_for_each_counter
+ * must call this first. */
+void rate_ctr_group_update(struct rate_ctr_group *grp)
+{
+	unsigned int i;
+
+	/* the shards were counted before the ticks expired since the last update */
+	if (grp->shards)
+		rate_ctr_shards_fold(grp);
 
-/* The one-second interval has expired */
-static void rate_ctr_group_intv(struct rate_ctr_group *grp)
+	if (!grp->lazy)
+		return;
+
+	for (i = 0; i < grp->desc->num_ctr; i++)
+		rate_ctr_catch_up(&grp->ctr[i]);
+}
+
+/*! Enable or disable lazy interval computation for a group
+ *  \param[in] grp Rate counter group
+ *  \param[in] lazy true to skip \a grp in the one-second timer
+ *
+ * Lazy groups cost nothing while idle, but their \ref rate_ctr.intv is only
+ * valid after \ref rate_ctr_group_update.  Intended for applications
+ * with a large number of mostly idle groups. */
+void rate_ctr_group_set_lazy(struct rate_ctr_group *grp, bool lazy)
 {
 	unsigned int i;
 
-	for (i = 0; i < grp->desc->num_ctr; i++) {
-		struct rate_ctr *ctr = &grp->ctr[i];
-
-		interval_expired(ctr, RATE_CTR_INTV_SEC);
-		if ((timer_ticks % 60) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_MIN);
-		if ((timer_ticks % (60*60)) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_HOUR);
-		if ((timer_ticks % (24*60*60)) == 0)
-			interval_expired(ctr, RATE_CTR_INTV_DAY);
-	}
+	if (grp->lazy == lazy)
+		return;
+
+	rate_ctr_group_update(grp);
+	grp->lazy = lazy;
+
+	/* the intervals are up to date: the timer computed them so far, or
+	 * rate_ctr_group_update() just did */
+	for (i = 0; i < grp->desc->num_ctr; i++)
+		grp->ctr[i].ticks = lazy ? timer_ticks : RATE_CTR_TICKS_EAGER;
+}
+
+/*! Return the counter difference since the last call to this function */
+int64_t rate_ctr_difference(struct rate_ctr *ctr)
+{
+	int64_t result = ctr->current - ctr->previous;
+	ctr->previous = ctr->current;
+
+	return result;
 }
 
+/* TODO: support update intervals > 1s */
+/* TODO: implement this as a special stats reporter */
+
 static void rate_ctr_timer_cb(void *data)
 {
 	struct rate_ctr_group *ctrg;
@@ -323,8 +624,17 @@ static void rate_ctr_timer_cb(void *data)
 	 * as a counter value of 0 would already wrap all counters */
 	timer_ticks++;
 
-	llist_for_each_entry(ctrg, &rate_ctr_groups, list)
-		rate_ctr_group_intv(ctrg);
+	llist_for_each_entry(ctrg, &rate_ctr_groups, list) {
+		unsigned int i;
+
+		if (ctrg->lazy)
+			continue;
+		/* the shards were counted during the expired second */
+		if (ctrg->shards)
+			rate_ctr_shards_fold(ctrg);
+		for (i = 0; i < ctrg->desc->num_ctr; i++)
+			rate_ctr_intv_update(&ctrg->ctr[i], timer_ticks - 1);
+	}
 
 	osmo_timer_schedule(&rate_ctr_timer, 1, 0);
 }
@@ -349,6 +659,19 @@ struct rate_ctr_group *rate_ctr_get_group_by_name_idx(const char *name, const un
 {
 	struct rate_ctr_group *ctrg;
 
+	if (grp_hash) {
+		struct rate_ctr_group_bucket *b = &grp_hash[grp_hash_bucket(name, idx)];
+		unsigned int i;
+
+		for (i = b->num; i > 0; i--) {
+			ctrg = b->grps[i - 1];
+			if (ctrg->idx == idx && !strcmp(ctrg->desc->group_name_prefix, name))
+				return ctrg;
+		}
+		return NULL;
+	}
+
+	/* no hash table, as allocating it failed */
 	llist_for_each_entry(ctrg, &rate_ctr_groups, list) {
 		if (!ctrg->desc)
 			continue;
@@ -396,6 +719,8 @@ int rate_ctr_for_each_counter(struct rate_ctr_group *ctrg,
 	int rc = 0;
 	int i;
 
+	rate_ctr_group_update(ctrg);
+
 	for (i = 0; i < ctrg->desc->num_ctr; i++) {
 		struct rate_ctr *ctr = &ctrg->ctr[i];
 		rc = handle_counter(ctrg,
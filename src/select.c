@@ -36,6 +36,7 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/loop_stats_internal.h>
 
 #include "../config.h"
 
@@ -139,6 +140,7 @@ void osmo_fd_unregister(struct osmo_fd *fd)
 	 * osmo_fd_is_registered() */
 	unregistered_count++;
 	llist_del(&fd->list);
+	osmo_loop_stats_fd_unregister(fd);
 }
 
 /*! Close a file descriptor, mark it as closed + unregister from select loop abstraction
@@ -220,7 +222,13 @@ restart:
 			 * leaking" from processing of one message into processing of the next message as part
 			 * of one iteration through the list of file descriptors here.  See OS#3813 */
 			log_reset_context();
-			ufd->cb(ufd, flags);
+			if (osmo_loop_stats_sample_rate) {
+				uint64_t start = osmo_loop_stats_cb_begin(OSMO_LOOP_CB_FD, ufd, ufd->cb, ufd->fd);
+				/* ufd may be unregistered and freed by its own call-back */
+				ufd->cb(ufd, flags);
+				osmo_loop_stats_cb_end(OSMO_LOOP_CB_FD, ufd, start);
+			} else
+				ufd->cb(ufd, flags);
 		}
 		/* ugly, ugly hack. If more than one filedescriptor was
 		 * unregistered, they might have been consecutive and
@@ -242,6 +250,7 @@ int osmo_select_main(int polling)
 	fd_set readset, writeset, exceptset;
 	int rc;
 	struct timeval no_time = {0, 0};
+	uint64_t start = 0, woken = 0;
 
 	FD_ZERO(&readset);
 	FD_ZERO(&writeset);
@@ -252,15 +261,24 @@ int osmo_select_main(int polling)
 
 	if (!polling)
 		osmo_timers_prepare();
+	if (osmo_loop_stats_sample_rate)
+		start = osmo_loop_stats_now();
 	rc = select(maxfd+1, &readset, &writeset, &exceptset, polling ? &no_time : osmo_timers_nearest());
 	if (rc < 0)
 		return 0;
+	if (start)
+		woken = osmo_loop_stats_now();
 
 	/* fire timers */
 	osmo_timers_update();
 
 	/* call registered callback functions */
-	return osmo_fd_disp_fds(&readset, &writeset, &exceptset);
+	rc = osmo_fd_disp_fds(&readset, &writeset, &exceptset);
+
+	if (start && osmo_loop_stats_sample_rate)
+		osmo_loop_stats_iteration(start, woken, osmo_loop_stats_now());
+
+	return rc;
 }
 
 /*! find an osmo_fd based on the integer fd
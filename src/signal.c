@@ -26,6 +26,7 @@
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/linuxlist.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 
@@ -37,15 +38,81 @@
 
 
 void *tall_sigh_ctx;
-static LLIST_HEAD(signal_handler_list);
 
-struct signal_handler {
+/* Handlers are kept in one list per subsystem, and the subsystems in a small
+ * hash table, so that dispatching a signal only walks the handlers that are
+ * interested in it. */
+#define SIG_SUBSYS_HASH_BITS	5
+#define SIG_SUBSYS_HASH_SIZE	(1 << SIG_SUBSYS_HASH_BITS)
+
+struct signal_subsys {
+	/* entry in sig_subsys_hash[] */
 	struct llist_head entry;
 	unsigned int subsys;
+	/* list of struct signal_handler */
+	struct llist_head handlers;
+	/* nesting depth of osmo_signal_dispatch() for this subsystem */
+	unsigned int dispatching;
+	/* handlers unregistered during a dispatch, to be freed afterwards */
+	unsigned int num_removed;
+};
+
+struct signal_handler {
+	struct llist_head entry;
 	osmo_signal_cbfn *cbfn;
 	void *data;
+	bool removed;
 };
 
+static struct llist_head sig_subsys_hash[SIG_SUBSYS_HASH_SIZE];
+
+static struct llist_head *sig_subsys_bucket(unsigned int subsys)
+{
+	struct llist_head *bucket;
+
+	/* the library subsystems live at the upper half of the number space, fold it in */
+	bucket = &sig_subsys_hash[(subsys ^ (subsys >> 16) ^ (subsys >> 31)) & (SIG_SUBSYS_HASH_SIZE - 1)];
+	if (!bucket->next)
+		INIT_LLIST_HEAD(bucket);
+	return bucket;
+}
+
+static struct signal_subsys *sig_subsys_find(unsigned int subsys)
+{
+	struct llist_head *bucket = sig_subsys_bucket(subsys);
+	struct signal_subsys *ss;
+
+	llist_for_each_entry(ss, bucket, entry) {
+		if (ss->subsys == subsys)
+			return ss;
+	}
+	return NULL;
+}
+
+/* free all handlers unregistered during a dispatch, and the subsystem itself once it is unused */
+static void sig_subsys_cleanup(struct signal_subsys *ss)
+{
+	struct signal_handler *handler, *tmp;
+
+	if (ss->dispatching)
+		return;
+
+	if (ss->num_removed) {
+		llist_for_each_entry_safe(handler, tmp, &ss->handlers, entry) {
+			if (!handler->removed)
+				continue;
+			llist_del(&handler->entry);
+			talloc_free(handler);
+		}
+		ss->num_removed = 0;
+	}
+
+	if (llist_empty(&ss->handlers)) {
+		llist_del(&ss->entry);
+		talloc_free(ss);
+	}
+}
+
 /*! Initialize a signal_handler talloc context for \ref osmo_signal_register_handler.
  * Create a talloc context called "osmo_signal".
  *  \param[in] root_ctx talloc context used as parent for the new "osmo_signal" ctx.
@@ -61,23 +128,38 @@ void *osmo_signal_talloc_ctx_init(void *root_ctx) {
  *  \param[in] cbfn Callback function
  *  \param[in] data Data passed through to callback
  *  \returns 0 on success; negative in case of error
+ *
+ *  A handler registered from within a signal call-back of the same
+ *  subsystem is already invoked for the signal currently being dispatched.
  */
 int osmo_signal_register_handler(unsigned int subsys,
 				 osmo_signal_cbfn *cbfn, void *data)
 {
+	struct signal_subsys *ss;
 	struct signal_handler *sig_data;
 
-	sig_data = talloc_zero(tall_sigh_ctx, struct signal_handler);
-	if (!sig_data)
+	ss = sig_subsys_find(subsys);
+	if (!ss) {
+		ss = talloc_zero(tall_sigh_ctx, struct signal_subsys);
+		if (!ss)
+			return -ENOMEM;
+		ss->subsys = subsys;
+		INIT_LLIST_HEAD(&ss->handlers);
+		llist_add_tail(&ss->entry, sig_subsys_bucket(subsys));
+	}
+
+	sig_data = talloc_zero(ss, struct signal_handler);
+	if (!sig_data) {
+		sig_subsys_cleanup(ss);
 		return -ENOMEM;
+	}
 
-	sig_data->subsys = subsys;
 	sig_data->data = data;
 	sig_data->cbfn = cbfn;
 
 	/* FIXME: check if we already have a handler for this subsys/cbfn/data */
 
-	llist_add_tail(&sig_data->entry, &signal_handler_list);
+	llist_add_tail(&sig_data->entry, &ss->handlers);
 
 	return 0;
 }
@@ -86,37 +168,61 @@ int osmo_signal_register_handler(unsigned int subsys,
  *  \param[in] subsys Subsystem number
  *  \param[in] cbfn Callback function
  *  \param[in] data Data passed through to callback
+ *
+ *  This may be called from within a signal call-back; the handler is
+ *  then no longer invoked, and freed once the dispatch has completed.
  */
 void osmo_signal_unregister_handler(unsigned int subsys,
 				    osmo_signal_cbfn *cbfn, void *data)
 {
+	struct signal_subsys *ss;
 	struct signal_handler *handler;
 
-	llist_for_each_entry(handler, &signal_handler_list, entry) {
-		if (handler->cbfn == cbfn && handler->data == data 
-		    && subsys == handler->subsys) {
-			llist_del(&handler->entry);
-			talloc_free(handler);
+	ss = sig_subsys_find(subsys);
+	if (!ss)
+		return;
+
+	llist_for_each_entry(handler, &ss->handlers, entry) {
+		if (handler->removed)
+			continue;
+		if (handler->cbfn == cbfn && handler->data == data) {
+			handler->removed = true;
+			ss->num_removed++;
 			break;
 		}
 	}
+
+	sig_subsys_cleanup(ss);
 }
 
 /*! dispatch (deliver) a new signal to all registered handlers
  *  \param[in] subsys Subsystem number
  *  \param[in] signal Signal number,
  *  \param[in] signal_data Data to be passed along to handlers
+ *
+ *  Only the handlers registered for \a subsys are visited.
  */
 void osmo_signal_dispatch(unsigned int subsys, unsigned int signal,
 			  void *signal_data)
 {
+	struct signal_subsys *ss;
 	struct signal_handler *handler;
 
-	llist_for_each_entry(handler, &signal_handler_list, entry) {
-		if (handler->subsys != subsys)
+	ss = sig_subsys_find(subsys);
+	if (!ss)
+		return;
+
+	/* handlers are only marked as removed while we walk the list, so it
+	 * stays intact no matter what the call-backs (un)register */
+	ss->dispatching++;
+	llist_for_each_entry(handler, &ss->handlers, entry) {
+		if (handler->removed)
 			continue;
 		(*handler->cbfn)(subsys, signal, handler->data, signal_data);
 	}
+	ss->dispatching--;
+
+	sig_subsys_cleanup(ss);
 }
 
 /*! @} */
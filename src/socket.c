@@ -43,6 +43,7 @@
 #include <sys/un.h>
 
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 
 #include <stdio.h>
@@ -87,6 +88,52 @@ static struct addrinfo *addrinfo_helper(uint16_t family, uint16_t type, uint8_t
 	return result;
 }
 
+/*! Process-wide socket tuning applied to sockets created with \ref OSMO_SOCK_F_TUNING */
+static struct osmo_sock_tuning g_sock_tuning;
+
+/* Apply the options that have to be set before bind() / connect() */
+static int socket_helper_opts(int sfd, const struct addrinfo *rp, unsigned int flags)
+{
+	bool udp = rp->ai_socktype == SOCK_DGRAM && rp->ai_protocol == IPPROTO_UDP;
+	int rc;
+
+	if (flags & OSMO_SOCK_F_REUSEPORT) {
+		rc = osmo_sock_reuseport_set(sfd, true);
+		if (rc < 0) {
+			LOGP(DLGLOBAL, LOGL_ERROR, "cannot set SO_REUSEPORT: %s\n", strerror(errno));
+			return rc;
+		}
+	}
+
+	if (flags & OSMO_SOCK_F_PKTINFO) {
+		rc = osmo_sock_pktinfo_set(sfd, true);
+		if (rc < 0) {
+			LOGP(DLGLOBAL, LOGL_ERROR, "cannot enable packet info: %s\n", strerror(errno));
+			return rc;
+		}
+	}
+
+	/* The remaining options are optimizations only, don't fail if the
+	 * kernel doesn't support them */
+	if (udp && (flags & OSMO_SOCK_F_UDP_GRO)) {
+		if (osmo_sock_udp_gro_set(sfd, true) < 0)
+			LOGP(DLGLOBAL, LOGL_NOTICE, "cannot enable UDP_GRO: %s\n", strerror(errno));
+	}
+
+	if (flags & OSMO_SOCK_F_TUNING) {
+		const struct osmo_sock_tuning *t = &g_sock_tuning;
+
+		if ((t->rcvbuf || t->sndbuf) && osmo_sock_bufsize_set(sfd, t->rcvbuf, t->sndbuf) < 0)
+			LOGP(DLGLOBAL, LOGL_NOTICE, "cannot set socket buffer size: %s\n", strerror(errno));
+		if (t->busy_poll_us && osmo_sock_busy_poll_set(sfd, t->busy_poll_us) < 0)
+			LOGP(DLGLOBAL, LOGL_NOTICE, "cannot set SO_BUSY_POLL: %s\n", strerror(errno));
+		if (udp && t->udp_segment && osmo_sock_udp_segment_set(sfd, t->udp_segment) < 0)
+			LOGP(DLGLOBAL, LOGL_NOTICE, "cannot set UDP_SEGMENT: %s\n", strerror(errno));
+	}
+
+	return 0;
+}
+
 static int socket_helper(const struct addrinfo *rp, unsigned int flags)
 {
 	int sfd, on = 1;
@@ -106,6 +153,10 @@ static int socket_helper(const struct addrinfo *rp, unsigned int flags)
 			sfd = -EINVAL;
 		}
 	}
+	if (sfd >= 0 && socket_helper_opts(sfd, rp, flags) < 0) {
+		close(sfd);
+		sfd = -1;
+	}
 	return sfd;
 }
 
@@ -977,6 +1028,153 @@ int osmo_sock_mcast_subscribe(int fd, const char *grp_addr)
 	}
 }
 
+/* Not all libc versions expose the UDP offload options yet */
+#if defined(__linux__) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+#if defined(__linux__) && !defined(UDP_GRO)
+#define UDP_GRO 104
+#endif
+
+/*! Enable/disable SO_REUSEPORT on a socket
+ *  \param[in] fd file descriptor of related socket
+ *  \param[in] enable Enable (true) or disable (false) port sharing
+ *  \returns 0 on success; negative otherwise
+ *
+ *  Several sockets with SO_REUSEPORT may bind to the same address and port,
+ *  the kernel then distributes incoming datagrams / connections between
+ *  them by a hash of the remote address.  This must be set before bind(),
+ *  see \ref OSMO_SOCK_F_REUSEPORT. */
+int osmo_sock_reuseport_set(int fd, bool enable)
+{
+#ifdef SO_REUSEPORT
+	int on = enable ? 1 : 0;
+	return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*! Set the kernel receive and send buffer sizes of a socket
+ *  \param[in] fd file descriptor of related socket
+ *  \param[in] rcvbuf SO_RCVBUF size in bytes; 0 to leave unchanged
+ *  \param[in] sndbuf SO_SNDBUF size in bytes; 0 to leave unchanged
+ *  \returns 0 on success; negative otherwise */
+int osmo_sock_bufsize_set(int fd, unsigned int rcvbuf, unsigned int sndbuf)
+{
+	int rc, val;
+
+	if (rcvbuf) {
+		val = rcvbuf;
+		rc = setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val));
+		if (rc < 0)
+			return rc;
+	}
+	if (sndbuf) {
+		val = sndbuf;
+		rc = setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val));
+		if (rc < 0)
+			return rc;
+	}
+	return 0;
+}
+
+/*! Set the busy polling timeout (SO_BUSY_POLL) of a socket
+ *  \param[in] fd file descriptor of related socket
+ *  \param[in] usec time in microseconds to busy poll the device queue on a
+ *  blocking receive; 0 to disable
+ *  \returns 0 on success; negative otherwise */
+int osmo_sock_busy_poll_set(int fd, unsigned int usec)
+{
+#ifdef SO_BUSY_POLL
+	int val = usec;
+	return setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val));
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*! Set the UDP generic segmentation offload size (UDP_SEGMENT) of a socket
+ *  \param[in] fd file descriptor of related UDP socket
+ *  \param[in] size segment size in bytes; 0 to disable
+ *  \returns 0 on success; negative otherwise
+ *
+ *  With a segment size set, a single send() of up to 64 kB is split into
+ *  datagrams of \a size bytes by the kernel (or the NIC). */
+int osmo_sock_udp_segment_set(int fd, unsigned int size)
+{
+#ifdef UDP_SEGMENT
+	int val = size;
+	return setsockopt(fd, IPPROTO_UDP, UDP_SEGMENT, &val, sizeof(val));
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*! Enable/disable UDP generic receive offload (UDP_GRO) on a socket
+ *  \param[in] fd file descriptor of related UDP socket
+ *  \param[in] enable Enable (true) or disable (false) receive offload
+ *  \returns 0 on success; negative otherwise
+ *
+ *  With GRO enabled, one recvmsg() may return several datagrams of the same
+ *  flow concatenated; the segment size is passed in a UDP_GRO control
+ *  message.  Only enable this if the receive path handles that. */
+int osmo_sock_udp_gro_set(int fd, bool enable)
+{
+#ifdef UDP_GRO
+	int on = enable ? 1 : 0;
+	return setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on));
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*! Enable/disable reception of the packet info control message
+ *  \param[in] fd file descriptor of related socket
+ *  \param[in] enable Enable (true) or disable (false) IP_PKTINFO / IPV6_RECVPKTINFO
+ *  \returns 0 on success; negative otherwise
+ *
+ *  This allows a socket bound to a wildcard address to learn the local
+ *  address and interface each datagram was received on. */
+int osmo_sock_pktinfo_set(int fd, bool enable)
+{
+	int domain, on = enable ? 1 : 0;
+
+	domain = sock_get_domain(fd);
+	if (domain < 0)
+		return domain;
+
+	switch (domain) {
+#ifdef IP_PKTINFO
+	case AF_INET:
+		return setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &on, sizeof(on));
+#endif
+#ifdef IPV6_RECVPKTINFO
+	case AF_INET6:
+		return setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on));
+#endif
+	default:
+		return -EINVAL;
+	}
+}
+
+/*! Set the process-wide socket tuning
+ *  \param[in] tuning new tuning parameters, copied
+ *
+ *  The tuning is applied to all sockets subsequently created with
+ *  \ref OSMO_SOCK_F_TUNING; existing sockets are not modified. */
+void osmo_sock_tuning_set(const struct osmo_sock_tuning *tuning)
+{
+	g_sock_tuning = *tuning;
+}
+
+/*! Get the process-wide socket tuning
+ *  \returns tuning as set by osmo_sock_tuning_set() */
+const struct osmo_sock_tuning *osmo_sock_tuning_get(void)
+{
+	return &g_sock_tuning;
+}
+
 /*! Determine the matching local IP-address for a given remote IP-Address.
  *  \param[out] local_ip caller provided memory for resulting local IP-address
  *  \param[in] remote_ip remote IP-address
@@ -50,10 +50,20 @@
  *  overwritten.  Lost values are skipped when getting values from the
  *  item.
  *
+ *  An item whose description refers to a \ref osmo_stat_hist_desc
+ *  additionally records every value set in a \ref osmo_stat_hist,
+ *  which allows reporting percentiles of e.g. a latency.  The
+ *  histogram uses log-linear buckets (as known from HdrHistogram):
+ *  values below 2^(precision_bits+1) get a bucket each, every larger
+ *  power of two is split in 2^precision_bits buckets.  Recording a
+ *  value is O(1), and histograms of the same layout can be merged by
+ *  adding up their buckets.
+ *
  */
 
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/linuxlist.h>
@@ -136,6 +146,15 @@ struct osmo_stat_item_group *osmo_stat_item_group_alloc(void *ctx,
 			item->values[i].value = desc->item_desc[item_idx].default_value;
 			item->values[i].id = OSMO_STAT_ITEM_NOVALUE_ID;
 		}
+
+		if (item->desc->hist) {
+			item->hist = osmo_stat_hist_alloc(group, item->desc->hist);
+			item->hist_reported = osmo_stat_hist_alloc(group, item->desc->hist);
+			if (!item->hist || !item->hist_reported) {
+				talloc_free(group);
+				return NULL;
+			}
+		}
 	}
 
 	llist_add(&group->list, &osmo_stat_item_groups);
@@ -192,6 +211,9 @@ void osmo_stat_item_set(struct osmo_stat_item *item, int32_t value)
 
 	item->values[item->last_offs].value = value;
 	item->values[item->last_offs].id    = global_value_id;
+
+	if (item->hist)
+		osmo_stat_hist_record(item->hist, value < 0 ? 0 : value);
 }
 
 /*! Retrieve the next value from the osmo_stat_item object.
@@ -356,4 +378,182 @@ int osmo_stat_item_for_each_group(osmo_stat_item_group_handler_t handle_group, v
 	return rc;
 }
 
+/* bucket index of \a value, see the module description */
+static unsigned int hist_bucket(uint8_t bits, uint32_t value)
+{
+	unsigned int shift;
+
+	if (value < (2U << bits))
+		return value;
+
+	shift = 31 - __builtin_clz(value) - bits;
+	return ((shift + 1) << bits) + (value >> shift) - (1U << bits);
+}
+
+/* largest value falling into bucket \a idx */
+static uint32_t hist_bucket_max(uint8_t bits, unsigned int idx)
+{
+	unsigned int shift;
+	uint64_t mantissa;
+
+	if (idx < (2U << bits))
+		return idx;
+
+	shift = (idx >> bits) - 1;
+	mantissa = (idx & ((1U << bits) - 1)) + (1U << bits);
+	return ((mantissa + 1) << shift) - 1;
+}
+
+/* smallest value falling into bucket \a idx */
+static uint32_t hist_bucket_min(uint8_t bits, unsigned int idx)
+{
+	return idx ? hist_bucket_max(bits, idx - 1) + 1 : 0;
+}
+
+/*! Allocate a histogram
+ *  \param[in] ctx talloc context to allocate from
+ *  \param[in] desc value range and precision
+ *  \returns pointer to the empty histogram; NULL on error */
+struct osmo_stat_hist *osmo_stat_hist_alloc(void *ctx, const struct osmo_stat_hist_desc *desc)
+{
+	struct osmo_stat_hist *hist;
+	unsigned int num_buckets;
+
+	if (desc->precision_bits > 16)
+		return NULL;
+
+	num_buckets = hist_bucket(desc->precision_bits, desc->max_value) + 1;
+	hist = talloc_zero_size(ctx, sizeof(*hist) + num_buckets * sizeof(hist->buckets[0]));
+	if (!hist)
+		return NULL;
+
+	talloc_set_name_const(hist, "struct osmo_stat_hist");
+	hist->precision_bits = desc->precision_bits;
+	hist->num_buckets = num_buckets;
+	hist->min = UINT32_MAX;
+
+	return hist;
+}
+
+/*! Record a value in a histogram
+ *  \param[in] hist histogram to record in
+ *  \param[in] value value to record */
+void osmo_stat_hist_record(struct osmo_stat_hist *hist, uint32_t value)
+{
+	unsigned int idx = hist_bucket(hist->precision_bits, value);
+
+	if (idx >= hist->num_buckets)
+		idx = hist->num_buckets - 1;
+
+	hist->buckets[idx]++;
+	hist->count++;
+	hist->sum += value;
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+/*! Add all values recorded in one histogram to another one
+ *  \param[in] dst histogram to add to
+ *  \param[in] src histogram to add, allocated with the same \ref osmo_stat_hist_desc
+ *  \returns 0 on success; -EINVAL if the bucket layouts differ */
+int osmo_stat_hist_merge(struct osmo_stat_hist *dst, const struct osmo_stat_hist *src)
+{
+	unsigned int i;
+
+	if (dst->precision_bits != src->precision_bits || dst->num_buckets != src->num_buckets)
+		return -EINVAL;
+
+	for (i = 0; i < dst->num_buckets; i++)
+		dst->buckets[i] += src->buckets[i];
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+
+	return 0;
+}
+
+/*! Discard all values recorded in a histogram */
+void osmo_stat_hist_reset(struct osmo_stat_hist *hist)
+{
+	memset(hist->buckets, 0, hist->num_buckets * sizeof(hist->buckets[0]));
+	hist->count = 0;
+	hist->sum = 0;
+	hist->min = UINT32_MAX;
+	hist->max = 0;
+}
+
+/*! Replace an earlier copy of a histogram by the values recorded since
+ *  \param[in,out] prev copy of \a cur taken earlier, e.g. via \ref osmo_stat_hist_merge
+ *  \param[in] cur histogram that kept recording since
+ *  \returns 0 on success; -EINVAL if the bucket layouts differ
+ *
+ *  The smallest and largest value of the result are only known up to the
+ *  bounds of their buckets, and are clamped to those of \a cur. */
+int osmo_stat_hist_since(struct osmo_stat_hist *prev, const struct osmo_stat_hist *cur)
+{
+	unsigned int i, lo = cur->num_buckets, hi = 0;
+
+	if (prev->precision_bits != cur->precision_bits || prev->num_buckets != cur->num_buckets)
+		return -EINVAL;
+
+	for (i = 0; i < cur->num_buckets; i++) {
+		prev->buckets[i] = cur->buckets[i] - prev->buckets[i];
+		if (!prev->buckets[i])
+			continue;
+		if (i < lo)
+			lo = i;
+		hi = i;
+	}
+
+	prev->count = cur->count - prev->count;
+	prev->sum = cur->sum - prev->sum;
+	if (!prev->count) {
+		prev->min = UINT32_MAX;
+		prev->max = 0;
+		return 0;
+	}
+	prev->min = OSMO_MAX(hist_bucket_min(cur->precision_bits, lo), cur->min);
+	/* the last bucket also holds all values beyond the range */
+	if (hi == cur->num_buckets - 1)
+		prev->max = cur->max;
+	else
+		prev->max = OSMO_MIN(hist_bucket_max(cur->precision_bits, hi), cur->max);
+
+	return 0;
+}
+
+/*! Get a percentile of the values recorded in a histogram
+ *  \param[in] hist histogram to evaluate
+ *  \param[in] percent percentile, e.g. 99 for the value not exceeded by 99% of all values
+ *  \returns upper bound of the bucket containing the percentile; 0 if the histogram is empty */
+uint32_t osmo_stat_hist_percentile(const struct osmo_stat_hist *hist, unsigned int percent)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (!hist->count)
+		return 0;
+	if (percent >= 100)
+		return hist->max;
+
+	/* rank of the percentile, counting from 1 */
+	rank = (hist->count * percent + 99) / 100;
+	if (!rank)
+		rank = 1;
+
+	for (i = 0; i < hist->num_buckets; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return OSMO_MIN(hist_bucket_max(hist->precision_bits, i), hist->max);
+}
+
 /*! @} */
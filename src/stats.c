@@ -60,6 +60,11 @@
  * \ref osmo_stats_reporter.  If you have multiple \ref
  * osmo_stats_reporter, they will each report all counters/stat_items.
  *
+ * A stat_item with a histogram (\ref osmo_stat_hist) additionally reports
+ * the values "<name>.p50", "<name>.p90", "<name>.p99", "<name>.max" and
+ * "<name>.count" of the distribution since the previous report.  The
+ * histogram itself keeps all values.
+ *
  * \file stats.c */
 
 #include "config.h"
@@ -614,7 +619,7 @@ static int rate_ctr_group_handler(struct rate_ctr_group *ctrg, void *sctx_)
 static int osmo_stats_reporter_send_item(struct osmo_stats_reporter *srep,
 	const struct osmo_stat_item_group *statg,
 	const struct osmo_stat_item_desc *desc,
-	int32_t value)
+	int64_t value)
 {
 	if (!srep->send_item)
 		return 0;
@@ -622,6 +627,54 @@ static int osmo_stats_reporter_send_item(struct osmo_stats_reporter *srep,
 	return srep->send_item(srep, statg, desc, value);
 }
 
+/* report the distribution of the values set in a histogram item since the
+ * previous report as separate values.  item->hist itself, as shown by VTY
+ * and CTRL, keeps all values. */
+static int osmo_stat_hist_handler(
+	struct osmo_stat_item_group *statg, struct osmo_stat_item *item)
+{
+	static const unsigned int percentiles[] = { 50, 90, 99 };
+	struct osmo_stats_reporter *srep;
+	struct osmo_stat_item_desc desc = *item->desc;
+	struct osmo_stat_hist *hist = item->hist_reported;
+	char name[128];
+	unsigned int i;
+
+	osmo_stat_hist_since(hist, item->hist);
+
+	llist_for_each_entry(srep, &osmo_stats_reporter_list, list) {
+		if (!srep->running)
+			continue;
+
+		if (!hist->count && !srep->force_single_flush)
+			continue;
+
+		if (!osmo_stats_reporter_check_config(srep,
+				statg->idx, statg->desc->class_id))
+			continue;
+
+		desc.name = name;
+		for (i = 0; i < ARRAY_SIZE(percentiles); i++) {
+			snprintf(name, sizeof(name), "%s.p%u", item->desc->name, percentiles[i]);
+			osmo_stats_reporter_send_item(srep, statg, &desc,
+				osmo_stat_hist_percentile(hist, percentiles[i]));
+		}
+		snprintf(name, sizeof(name), "%s.max", item->desc->name);
+		osmo_stats_reporter_send_item(srep, statg, &desc, hist->max);
+
+		desc.unit = OSMO_STAT_ITEM_NO_UNIT;
+		snprintf(name, sizeof(name), "%s.count", item->desc->name);
+		osmo_stats_reporter_send_item(srep, statg, &desc, hist->count);
+		desc.unit = item->desc->unit;
+	}
+
+	/* the copy for the next report */
+	osmo_stat_hist_reset(hist);
+	osmo_stat_hist_merge(hist, item->hist);
+
+	return 0;
+}
+
 static int osmo_stat_item_handler(
 	struct osmo_stat_item_group *statg, struct osmo_stat_item *item, void *sctx_)
 {
@@ -657,6 +710,9 @@ static int osmo_stat_item_handler(
 		have_value = osmo_stat_item_get_next(item, &idx, &value) > 0;
 	} while (have_value);
 
+	if (item->hist)
+		osmo_stat_hist_handler(statg, item);
+
 	return 0;
 }
 
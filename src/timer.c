@@ -38,6 +38,7 @@
 #include <osmocom/core/timer.h>
 #include <osmocom/core/timer_compat.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/loop_stats_internal.h>
 
 /* These store the amount of time that we wait until next timer expires. */
 static struct timeval nearest;
@@ -253,7 +254,12 @@ int osmo_timers_update(void)
 restart:
 	llist_for_each_entry(this, &timer_eviction_list, list) {
 		osmo_timer_del(this);
-		if (this->cb)
+		if (this->cb && osmo_loop_stats_sample_rate) {
+			void (*cb)(void *) = this->cb;
+			uint64_t start = osmo_loop_stats_cb_begin(OSMO_LOOP_CB_TIMER, cb, cb, -1);
+			cb(this->data);
+			osmo_loop_stats_cb_end(OSMO_LOOP_CB_TIMER, cb, start);
+		} else if (this->cb)
 			this->cb(this->data);
 		work = 1;
 		goto restart;
@@ -25,6 +25,7 @@
 
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
@@ -34,6 +35,8 @@
 #include <osmocom/core/utils.h>
 #include <osmocom/core/bit64gen.h>
 
+#include "../config.h"
+
 
 /*! \addtogroup utils
  * @{
@@ -43,6 +46,227 @@
 
 static __thread char namebuf[255];
 
+/* Lookup index of a registered value_string array: either a directly indexed
+ * array for dense values, or an open addressing hash table for sparse ones.
+ * Strings map back to the array index through a case-insensitive hash table. */
+struct vs_index {
+	const struct value_string *vs;
+	/* dense: direct[val - min] for val - min < range */
+	uint32_t min;
+	uint32_t range;
+	const char **direct;
+	/* sparse: (value, str) pairs, str == NULL marks an empty slot */
+	struct value_string *slots;
+	uint32_t slots_mask;
+	/* reverse: index into vs + 1, 0 marks an empty slot */
+	unsigned int *rev;
+	uint32_t rev_mask;
+};
+
+/* registered indexes, open addressing by array address */
+static struct vs_index **vs_indexes;
+static unsigned int vs_indexes_mask;
+static unsigned int vs_indexes_count;
+
+static inline uint32_t vs_hash_u32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	return x;
+}
+
+static inline uint32_t vs_hash_ptr(const void *p)
+{
+	return vs_hash_u32((uintptr_t)p ^ ((uint64_t)(uintptr_t)p >> 32));
+}
+
+/* must agree with strcasecmp() for the ASCII strings found in value_string arrays */
+static uint32_t vs_hash_str(const char *str)
+{
+	uint32_t h = 2166136261u;
+	for (; *str; str++) {
+		char c = *str;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		h = (h ^ (uint8_t)c) * 16777619u;
+	}
+	return h;
+}
+
+static unsigned int vs_pow2_above(unsigned int n)
+{
+	unsigned int size = 8;
+	while (size < n)
+		size <<= 1;
+	return size;
+}
+
+static const struct vs_index *vs_index_find(const struct value_string *vs)
+{
+	unsigned int i;
+
+	if (!vs_indexes_count)
+		return NULL;
+
+	for (i = vs_hash_ptr(vs) & vs_indexes_mask; vs_indexes[i]; i = (i + 1) & vs_indexes_mask) {
+		if (vs_indexes[i]->vs == vs)
+			return vs_indexes[i];
+	}
+	return NULL;
+}
+
+static const char *vs_index_lookup(const struct vs_index *idx, uint32_t val)
+{
+	uint32_t i;
+
+	if (idx->direct) {
+		if (val - idx->min >= idx->range)
+			return NULL;
+		return idx->direct[val - idx->min];
+	}
+
+	for (i = vs_hash_u32(val) & idx->slots_mask; idx->slots[i].str; i = (i + 1) & idx->slots_mask) {
+		if (idx->slots[i].value == val)
+			return idx->slots[i].str;
+	}
+	return NULL;
+}
+
+static int vs_index_lookup_str(const struct vs_index *idx, const char *str)
+{
+	uint32_t i;
+
+	for (i = vs_hash_str(str) & idx->rev_mask; idx->rev[i]; i = (i + 1) & idx->rev_mask) {
+		const struct value_string *e = &idx->vs[idx->rev[i] - 1];
+		if (!strcasecmp(e->str, str))
+			return e->value;
+	}
+	return -EINVAL;
+}
+
+static void vs_index_free(struct vs_index *idx)
+{
+	free(idx->direct);
+	free(idx->slots);
+	free(idx->rev);
+	free(idx);
+}
+
+static struct vs_index *vs_index_build(const struct value_string *vs)
+{
+	struct vs_index *idx;
+	unsigned int count, i, j;
+	uint32_t min = UINT32_MAX, max = 0;
+
+	for (count = 0; vs[count].value || vs[count].str; count++) {
+		min = OSMO_MIN(min, vs[count].value);
+		max = OSMO_MAX(max, vs[count].value);
+	}
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+	idx->vs = vs;
+
+	/* the first of several entries with the same value or string wins, as in the linear search */
+	if (count && max - min < 2 * count + 16) {
+		idx->min = min;
+		idx->range = max - min + 1;
+		idx->direct = calloc(idx->range, sizeof(*idx->direct));
+		if (!idx->direct)
+			goto enomem;
+		for (i = count; i > 0; i--)
+			idx->direct[vs[i - 1].value - min] = vs[i - 1].str;
+	} else {
+		idx->slots_mask = vs_pow2_above(2 * count) - 1;
+		idx->slots = calloc(idx->slots_mask + 1, sizeof(*idx->slots));
+		if (!idx->slots)
+			goto enomem;
+		for (i = 0; i < count; i++) {
+			if (!vs[i].str)
+				continue;
+			for (j = vs_hash_u32(vs[i].value) & idx->slots_mask; idx->slots[j].str;
+			     j = (j + 1) & idx->slots_mask) {
+				if (idx->slots[j].value == vs[i].value)
+					break;
+			}
+			if (!idx->slots[j].str)
+				idx->slots[j] = vs[i];
+		}
+	}
+
+	idx->rev_mask = vs_pow2_above(2 * count) - 1;
+	idx->rev = calloc(idx->rev_mask + 1, sizeof(*idx->rev));
+	if (!idx->rev)
+		goto enomem;
+	for (i = 0; i < count; i++) {
+		if (!vs[i].str)
+			continue;
+		for (j = vs_hash_str(vs[i].str) & idx->rev_mask; idx->rev[j]; j = (j + 1) & idx->rev_mask) {
+			if (!strcasecmp(vs[idx->rev[j] - 1].str, vs[i].str))
+				break;
+		}
+		if (!idx->rev[j])
+			idx->rev[j] = i + 1;
+	}
+
+	return idx;
+
+enomem:
+	vs_index_free(idx);
+	return NULL;
+}
+
+/*! Register a value_string array for indexed lookup.
+ *  \param[in] vs Array of value_string tuples
+ *  \returns 0 on success (or if already registered); negative in case of error
+ *
+ * Afterwards, get_value_string(), get_value_string_or_null() and get_string_value() look up \a vs in constant time
+ * instead of scanning it. Values are indexed directly if they are dense enough, otherwise hashed. The string lookup
+ * is hashed case-insensitively. The results are the same as without the index.
+ *
+ * The array must not be modified or freed after registration. Registration is not thread-safe, so do it during
+ * initialization, before any other thread may look up strings.
+ */
+int osmo_value_string_index(const struct value_string *vs)
+{
+	struct vs_index *idx;
+	unsigned int i;
+
+	if (!vs)
+		return -EINVAL;
+	if (vs_index_find(vs))
+		return 0;
+
+	/* keep the load factor at or below one half */
+	if (2 * (vs_indexes_count + 1) > vs_indexes_mask + 1) {
+		unsigned int new_mask = vs_pow2_above(4 * (vs_indexes_count + 1)) - 1;
+		struct vs_index **new_indexes = calloc(new_mask + 1, sizeof(*new_indexes));
+		if (!new_indexes)
+			return -ENOMEM;
+		for (i = 0; vs_indexes && i <= vs_indexes_mask; i++) {
+			unsigned int j;
+			if (!vs_indexes[i])
+				continue;
+			for (j = vs_hash_ptr(vs_indexes[i]->vs) & new_mask; new_indexes[j]; j = (j + 1) & new_mask);
+			new_indexes[j] = vs_indexes[i];
+		}
+		free(vs_indexes);
+		vs_indexes = new_indexes;
+		vs_indexes_mask = new_mask;
+	}
+
+	idx = vs_index_build(vs);
+	if (!idx)
+		return -ENOMEM;
+
+	for (i = vs_hash_ptr(vs) & vs_indexes_mask; vs_indexes[i]; i = (i + 1) & vs_indexes_mask);
+	vs_indexes[i] = idx;
+	vs_indexes_count++;
+	return 0;
+}
+
 /*! get human-readable string for given value
  *  \param[in] vs Array of value_string tuples
  *  \param[in] val Value to be converted
@@ -71,11 +295,16 @@ const char *get_value_string(const struct value_string *vs, uint32_t val)
 const char *get_value_string_or_null(const struct value_string *vs,
 				     uint32_t val)
 {
+	const struct vs_index *idx;
 	int i;
 
 	if (!vs)
 		return NULL;
 
+	idx = vs_index_find(vs);
+	if (idx)
+		return vs_index_lookup(idx, val);
+
 	for (i = 0;; i++) {
 		if (vs[i].value == 0 && vs[i].str == NULL)
 			break;
@@ -93,8 +322,13 @@ const char *get_value_string_or_null(const struct value_string *vs,
  */
 int get_string_value(const struct value_string *vs, const char *str)
 {
+	const struct vs_index *idx;
 	int i;
 
+	idx = vs_index_find(vs);
+	if (idx)
+		return vs_index_lookup_str(idx, str);
+
 	for (i = 0;; i++) {
 		if (vs[i].value == 0 && vs[i].str == NULL)
 			break;
@@ -104,32 +338,35 @@ int get_string_value(const struct value_string *vs, const char *str)
 	return -EINVAL;
 }
 
+static const char bcd_chars[] = "0123456789ABCDEF";
+
 /*! Convert BCD-encoded digit into printable character
  *  \param[in] bcd A single BCD-encoded digit
  *  \returns single printable character
  */
 char osmo_bcd2char(uint8_t bcd)
 {
-	if (bcd < 0xa)
-		return '0' + bcd;
+	if (bcd < 0x10)
+		return bcd_chars[bcd];
 	else
 		return 'A' + (bcd - 0xa);
 }
 
+/* ASCII to nibble value: '0'-'9', 'A'-'F' and 'a'-'f' map to their value, everything else to 0 */
+static const uint8_t char2bcd_tbl[256] = {
+	['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+	['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+	['A'] = 0xa, ['B'] = 0xb, ['C'] = 0xc, ['D'] = 0xd, ['E'] = 0xe, ['F'] = 0xf,
+	['a'] = 0xa, ['b'] = 0xb, ['c'] = 0xc, ['d'] = 0xd, ['e'] = 0xe, ['f'] = 0xf,
+};
+
 /*! Convert number in ASCII to BCD value
  *  \param[in] c ASCII character
  *  \returns BCD encoded value of character
  */
 uint8_t osmo_char2bcd(char c)
 {
-	if (c >= '0' && c <= '9')
-		return c - 0x30;
-	else if (c >= 'A' && c <= 'F')
-		return 0xa + (c - 'A');
-	else if (c >= 'a' && c <= 'f')
-		return 0xa + (c - 'a');
-	else
-		return 0;
+	return char2bcd_tbl[(uint8_t)c];
 }
 
 /*! Convert BCD to string.
@@ -148,31 +385,106 @@ uint8_t osmo_char2bcd(char c)
  */
 int osmo_bcd2str(char *dst, size_t dst_size, const uint8_t *bcd, int start_nibble, int end_nibble, bool allow_hex)
 {
-	char *dst_end = dst + dst_size - 1;
-	int nibble_i;
-	int rc = 0;
+	int nibble_i = start_nibble;
+	int nibble_end;
+	uint8_t hex = 0;
 
 	if (!dst || dst_size < 1)
 		return -ENOMEM;
 
-	for (nibble_i = start_nibble; nibble_i < end_nibble && dst < dst_end; nibble_i++, dst++) {
-		uint8_t nibble = bcd[nibble_i >> 1];
-		if ((nibble_i & 1))
-			nibble >>= 4;
-		nibble &= 0xf;
-
-		if (!allow_hex && nibble > 9)
-			rc = -EINVAL;
-
-		*dst = osmo_bcd2char(nibble);
+	/* Only as many nibbles as fit in dst are converted (and checked for hex digits) */
+	nibble_end = end_nibble;
+	if (nibble_end > nibble_i && (size_t)(nibble_end - nibble_i) > dst_size - 1)
+		nibble_end = nibble_i + (int)(dst_size - 1);
+
+	/* Leading high nibble, then two digits per whole octet, then a trailing low nibble. A nibble > 9 is
+	 * detected without branching: adding 6 carries into bit 4 exactly for 0xa..0xf. */
+	if (nibble_i < nibble_end && (nibble_i & 1)) {
+		uint8_t nibble = bcd[nibble_i >> 1] >> 4;
+		hex |= nibble + 6;
+		*dst++ = bcd_chars[nibble];
+		nibble_i++;
+	}
+	for (; nibble_i + 1 < nibble_end; nibble_i += 2) {
+		uint8_t octet = bcd[nibble_i >> 1];
+		hex |= ((octet & 0xf) + 6) | ((octet >> 4) + 6);
+		*dst++ = bcd_chars[octet & 0xf];
+		*dst++ = bcd_chars[octet >> 4];
+	}
+	if (nibble_i < nibble_end) {
+		uint8_t nibble = bcd[nibble_i >> 1] & 0xf;
+		hex |= nibble + 6;
+		*dst++ = bcd_chars[nibble];
 	}
 	*dst = '\0';
 
-	if (rc < 0)
-		return rc;
+	if (!allow_hex && (hex & 0x10))
+		return -EINVAL;
 	return OSMO_MAX(0, end_nibble - start_nibble);
 }
 
+/* Accelerated hex encoding / decoding, see hexdump_sse*.c. Each of these
+ * returns the number of input elements it processed; the generic code
+ * below takes care of the remainder. */
+#if defined(HAVE_SSSE3)
+size_t osmo_hex_sse_enc(char *out, const uint8_t *in, size_t len);
+size_t osmo_hex_sse_enc_delim(char *out, const uint8_t *in, size_t len, char delim);
+size_t osmo_hex_sse_dec(uint8_t *out, const char *in, size_t len);
+size_t osmo_ubit_sse_dump(char *out, const uint8_t *bits, size_t len);
+#endif
+
+#if defined(HAVE_SSSE3) && defined(HAVE_AVX2)
+size_t osmo_hex_sse_avx_enc(char *out, const uint8_t *in, size_t len);
+size_t osmo_hex_sse_avx_enc_delim(char *out, const uint8_t *in, size_t len, char delim);
+size_t osmo_hex_sse_avx_dec(uint8_t *out, const char *in, size_t len);
+size_t osmo_ubit_sse_avx_dump(char *out, const uint8_t *bits, size_t len);
+#endif
+
+static size_t hex_gen_enc(char *out, const uint8_t *in, size_t len)
+{
+	return 0;
+}
+
+static size_t hex_gen_enc_delim(char *out, const uint8_t *in, size_t len, char delim)
+{
+	return 0;
+}
+
+static size_t hex_gen_dec(uint8_t *out, const char *in, size_t len)
+{
+	return 0;
+}
+
+static size_t ubit_gen_dump(char *out, const uint8_t *bits, size_t len)
+{
+	return 0;
+}
+
+static size_t (*hex_acc_enc)(char *out, const uint8_t *in, size_t len) = hex_gen_enc;
+static size_t (*hex_acc_enc_delim)(char *out, const uint8_t *in, size_t len, char delim) = hex_gen_enc_delim;
+static size_t (*hex_acc_dec)(uint8_t *out, const char *in, size_t len) = hex_gen_dec;
+static size_t (*ubit_acc_dump)(char *out, const uint8_t *bits, size_t len) = ubit_gen_dump;
+
+static __attribute__((constructor)) void on_dso_load_hex(void)
+{
+#if defined(HAVE___BUILTIN_CPU_SUPPORTS) && defined(HAVE_SSSE3)
+	if (!__builtin_cpu_supports("ssse3"))
+		return;
+	hex_acc_enc = osmo_hex_sse_enc;
+	hex_acc_enc_delim = osmo_hex_sse_enc_delim;
+	hex_acc_dec = osmo_hex_sse_dec;
+	ubit_acc_dump = osmo_ubit_sse_dump;
+#if defined(HAVE_AVX2)
+	if (!__builtin_cpu_supports("avx2"))
+		return;
+	hex_acc_enc = osmo_hex_sse_avx_enc;
+	hex_acc_enc_delim = osmo_hex_sse_avx_enc_delim;
+	hex_acc_dec = osmo_hex_sse_avx_dec;
+	ubit_acc_dump = osmo_ubit_sse_avx_dump;
+#endif
+#endif
+}
+
 /*! Parse a string containing hexadecimal digits
  *  \param[in] str string containing ASCII encoded hexadecimal digits
  *  \param[out] b output buffer
@@ -185,11 +497,28 @@ int osmo_hexparse(const char *str, uint8_t *b, int max_len)
 	char c;
 	uint8_t v;
 	const char *strpos;
+	const char *str_end;
+	const char *acc_retry;
 	unsigned int nibblepos = 0;
 
 	memset(b, 0x00, max_len);
 
+	str_end = str + strlen(str);
+	acc_retry = str;
+
 	for (strpos = str; (c = *strpos); strpos++) {
+		/* convert runs of hex digits in bulk; if there are none here,
+		 * continue one by one for a while before trying again */
+		if (!(nibblepos & 1) && strpos >= acc_retry && max_len > 0) {
+			size_t n = OSMO_MIN((size_t)(str_end - strpos), ((size_t)max_len << 1) - nibblepos);
+			size_t done = hex_acc_dec(b + (nibblepos >> 1), strpos, n);
+			nibblepos += done;
+			strpos += done;
+			acc_retry = strpos + 32;
+			if (!(c = *strpos))
+				break;
+		}
+
 		/* skip whitespace */
 		if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
 			continue;
@@ -241,9 +570,10 @@ static const char hex_chars[] = "0123456789abcdef";
 const char *osmo_hexdump_buf(char *out_buf, size_t out_buf_size, const unsigned char *buf, int len, const char *delim,
 			     bool delim_after_last)
 {
-	int i;
+	size_t i, n;
 	char *cur = out_buf;
 	size_t delim_len;
+	bool last_without_delim = false;
 
 	if (!out_buf || !out_buf_size)
 		return "";
@@ -251,28 +581,59 @@ const char *osmo_hexdump_buf(char *out_buf, size_t out_buf_size, const unsigned
 	delim = delim ? : "";
 	delim_len = strlen(delim);
 
-	for (i = 0; i < len; i++) {
-		const char *delimp = delim;
-		int len_remain = out_buf_size - (cur - out_buf) - 1;
-		if (len_remain < (2 + delim_len)
-		    && !(!delim_after_last && i == (len - 1) && len_remain >= 2))
-			break;
+	if (len <= 0) {
+		*cur = '\0';
+		return out_buf;
+	}
 
+	/* Figure out up front how many bytes fit, so that the conversion itself needs no checks. If the output is
+	 * truncated, it always ends in a complete delim. */
+	if (!delim_after_last && osmo_hexdump_len(len, delim, false) < out_buf_size) {
+		n = len - 1;
+		last_without_delim = true;
+	} else
+		n = OSMO_MIN(len, (out_buf_size - 1) / (2 + delim_len));
+
+	if (!delim_len) {
+		i = hex_acc_enc(cur, buf, n);
+		cur += 2 * i;
+	} else if (delim_len == 1) {
+		i = hex_acc_enc_delim(cur, buf, n, *delim);
+		cur += 3 * i;
+	} else
+		i = 0;
+
+	for (; i < n; i++) {
 		*cur++ = hex_chars[buf[i] >> 4];
 		*cur++ = hex_chars[buf[i] & 0xf];
+		memcpy(cur, delim, delim_len);
+		cur += delim_len;
+	}
 
-		if (i == (len - 1) && !delim_after_last)
-			break;
-
-		while (len_remain > 1 && *delimp) {
-			*cur++ = *delimp++;
-			len_remain--;
-		}
+	if (last_without_delim) {
+		*cur++ = hex_chars[buf[n] >> 4];
+		*cur++ = hex_chars[buf[n] & 0xf];
 	}
+
 	*cur = '\0';
 	return out_buf;
 }
 
+/*! Return the exact string length osmo_hexdump_buf() produces for the given arguments, given enough space.
+ *  \param[in] len  Length of input buf in number of bytes.
+ *  \param[in] delim  String to separate each byte; NULL or "" for no delim.
+ *  \param[in] delim_after_last  If true, end the string in delim.
+ *  \returns number of characters, not including the terminating nul; allocate one more than that.
+ */
+size_t osmo_hexdump_len(int len, const char *delim, bool delim_after_last)
+{
+	size_t delim_len = delim ? strlen(delim) : 0;
+
+	if (len <= 0)
+		return 0;
+	return (size_t)len * (2 + delim_len) - (delim_after_last ? 0 : delim_len);
+}
+
 /*! Convert a sequence of unpacked bits to ASCII string, in user-supplied buffer.
  * \param[out] buf caller-provided output string buffer
  * \param[out] buf_len size of buf in bytes
@@ -282,13 +643,12 @@ const char *osmo_hexdump_buf(char *out_buf, size_t out_buf_size, const unsigned
  */
 char *osmo_ubit_dump_buf(char *buf, size_t buf_len, const uint8_t *bits, unsigned int len)
 {
-	int i;
+	size_t i;
 
 	if (len > buf_len-1)
 		len = buf_len-1;
-	memset(buf, 0, buf_len);
 
-	for (i = 0; i < len; i++) {
+	for (i = ubit_acc_dump(buf, bits, len); i < len; i++) {
 		char outch;
 		switch (bits[i]) {
 		case 0:
@@ -306,7 +666,7 @@ char *osmo_ubit_dump_buf(char *buf, size_t buf_len, const uint8_t *bits, unsigne
 		}
 		buf[i] = outch;
 	}
-	buf[buf_len-1] = 0;
+	buf[len] = '\0';
 	return buf;
 }
 
@@ -407,7 +767,6 @@ char *osmo_osmo_hexdump_nospc(const unsigned char *buf, int len)
 	__attribute__((weak, alias("osmo_hexdump_nospc")));
 #endif
 
-#include "../config.h"
 #ifdef HAVE_CTYPE_H
 #include <ctype.h>
 /*! Convert an entire string to lower case
@@ -61,6 +61,10 @@ void *tall_vty_cmd_ctx;
    each daemon maintains each own cmdvec. */
 vector cmdvec;
 
+/* Per node index of the keywords commands start with, see cmd_node_candidates(). Indexed
+ * by node type like cmdvec. */
+static vector cmd_keyword_vec;
+
 /* Host information structure. */
 struct host host;
 
@@ -167,6 +171,8 @@ static void install_node_bare(struct cmd_node *node, int (*func) (struct vty *))
 	vector_set_index(cmdvec, node->node, node);
 	node->func = func;
 	node->cmd_vector = vector_init(VECTOR_MIN_SIZE);
+	talloc_free(vector_lookup(cmd_keyword_vec, node->node));
+	vector_set_index(cmd_keyword_vec, node->node, NULL);
 	if (!*node->name)
 		node_name_from_prompt(node->prompt, node->name, sizeof(node->name));
 }
@@ -758,6 +764,150 @@ static int check_element_exists(struct cmd_node *cnode, const char *cmdstring)
 	return 0;
 }
 
+/* A literal keyword a command may start with */
+struct cmd_keyword {
+	const char *keyword;
+	struct cmd_element *cmd;
+};
+
+/* Index of the commands of one node by their first word. Matching a line
+ * against every command of a node is expensive, as the matchers are run for
+ * every word of every command; the index narrows this down to the commands that
+ * can possibly match the first word of the line. */
+struct cmd_node_keywords {
+	/*! literal first words of all commands, sorted by keyword if 'sorted' */
+	struct cmd_keyword *keywords;
+	unsigned int num_keywords;
+	bool sorted;
+	/*! commands starting with an argument or optional word, which always
+	 *  have to be matched */
+	struct cmd_element **others;
+	unsigned int num_others;
+};
+
+static int cmp_keyword(const void *p, const void *q)
+{
+	const struct cmd_keyword *a = p;
+	const struct cmd_keyword *b = q;
+
+	return strcmp(a->keyword, b->keyword);
+}
+
+/* Add a command to the keyword index of a node */
+static void cmd_keywords_add(int ntype, struct cmd_element *cmd)
+{
+	struct cmd_node_keywords *nk = vector_lookup(cmd_keyword_vec, ntype);
+	vector descvec = NULL;
+	unsigned int i;
+
+	if (!nk) {
+		nk = talloc_zero(tall_vty_cmd_ctx, struct cmd_node_keywords);
+		OSMO_ASSERT(nk);
+		vector_set_index(cmd_keyword_vec, ntype, nk);
+	}
+
+	if (cmd->strvec && vector_active(cmd->strvec))
+		descvec = vector_slot(cmd->strvec, 0);
+
+	/* only a first word consisting of literal keywords alone can be indexed */
+	for (i = 0; descvec && i < vector_active(descvec); i++) {
+		struct desc *desc = vector_slot(descvec, i);
+		if (!desc || CMD_OPTION(desc->cmd) || CMD_VARIABLE(desc->cmd) || CMD_VARARG(desc->cmd))
+			descvec = NULL;
+	}
+
+	if (!descvec || !vector_active(descvec)) {
+		nk->others = talloc_realloc(nk, nk->others, struct cmd_element *, nk->num_others + 1);
+		OSMO_ASSERT(nk->others);
+		nk->others[nk->num_others++] = cmd;
+		return;
+	}
+
+	nk->keywords = talloc_realloc(nk, nk->keywords, struct cmd_keyword,
+				      nk->num_keywords + vector_active(descvec));
+	OSMO_ASSERT(nk->keywords);
+	for (i = 0; i < vector_active(descvec); i++) {
+		struct desc *desc = vector_slot(descvec, i);
+		nk->keywords[nk->num_keywords++] = (struct cmd_keyword){
+			.keyword = desc->cmd,
+			.cmd = cmd,
+		};
+	}
+	nk->sorted = false;
+}
+
+static vector cmd_node_vector(vector v, enum node_type ntype);
+
+static int cmp_cmd_element_ptr(const void *p, const void *q)
+{
+	uintptr_t a = (uintptr_t)*(struct cmd_element **)p;
+	uintptr_t b = (uintptr_t)*(struct cmd_element **)q;
+
+	return a < b ? -1 : (a > b);
+}
+
+/* Return a new vector of all commands of a node that may match a line; that is
+ * the result of vector_copy(cnode->cmd_vector) after filtering it by the first
+ * word of the line, just quicker. The order of the commands differs, which
+ * does not matter to the matching. */
+static vector cmd_node_candidates(enum node_type ntype, vector vline)
+{
+	struct cmd_node_keywords *nk = vector_lookup(cmd_keyword_vec, ntype);
+	struct cmd_element **cands;
+	const char *word;
+	size_t len;
+	unsigned int lo, hi, i, num = 0;
+	vector v;
+
+	if (!nk || !vector_active(vline) || !(word = vector_slot(vline, 0)))
+		return vector_copy(cmd_node_vector(cmdvec, ntype));
+
+	if (!nk->sorted) {
+		qsort(nk->keywords, nk->num_keywords, sizeof(*nk->keywords), cmp_keyword);
+		nk->sorted = true;
+	}
+
+	/* find the first keyword that is not less than the word ... */
+	len = strlen(word);
+	lo = 0;
+	hi = nk->num_keywords;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (strcmp(nk->keywords[mid].keyword, word) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	/* ... and all following ones the word is a prefix of */
+	for (hi = lo; hi < nk->num_keywords; hi++) {
+		if (strncmp(nk->keywords[hi].keyword, word, len))
+			break;
+	}
+
+	cands = talloc_array(tall_vty_cmd_ctx, struct cmd_element *, hi - lo + nk->num_others);
+	OSMO_ASSERT(cands);
+	for (i = lo; i < hi; i++)
+		cands[num++] = nk->keywords[i].cmd;
+	/* "(one|once)" gives the same command for "on" twice */
+	if (num > 1) {
+		unsigned int j = 0;
+		qsort(cands, num, sizeof(*cands), cmp_cmd_element_ptr);
+		for (i = 1; i < num; i++) {
+			if (cands[i] != cands[j])
+				cands[++j] = cands[i];
+		}
+		num = j + 1;
+	}
+	for (i = 0; i < nk->num_others; i++)
+		cands[num++] = nk->others[i];
+
+	v = vector_init(num ? num : 1);
+	for (i = 0; i < num; i++)
+		vector_set_index(v, i, cands[i]);
+	talloc_free(cands);
+	return v;
+}
+
 /*! Install a command into a node
  *  \param[in] ntype Node Type
  *  \param[cmd] element to be installed
@@ -777,6 +927,8 @@ void install_element(int ntype, struct cmd_element *cmd)
 
 	cmd->strvec = cmd_make_descvec(cmd->string, cmd->doc);
 	cmd->cmdsize = cmd_cmdsize(cmd->strvec);
+
+	cmd_keywords_add(ntype, cmd);
 }
 
 /* Install a command into VIEW and ENABLE node */
@@ -2228,8 +2380,8 @@ cmd_execute_command_real(vector vline, struct vty *vty,
 	   argv[] generation */
 	void *cmd_deopt_ctx = NULL;
 
-	/* Make copy of command elements. */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make copy of the command elements that may match. */
+	cmd_vector = cmd_node_candidates(vty->node, vline);
 
 	for (index = 0; index < vector_active(vline); index++) {
 		if ((command = vector_slot(vline, index))) {
@@ -2419,8 +2571,8 @@ cmd_execute_command_strict(vector vline, struct vty *vty,
 	enum match_type match = 0;
 	char *command;
 
-	/* Make copy of command element */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make copy of the command elements that may match. */
+	cmd_vector = cmd_node_candidates(vty->node, vline);
 
 	for (index = 0; index < vector_active(vline); index++)
 		if ((command = vector_slot(vline, index))) {
@@ -3849,6 +4001,7 @@ void cmd_init(int terminal)
 {
 	/* Allocate initial top vector of commands. */
 	cmdvec = vector_init(VECTOR_MIN_SIZE);
+	cmd_keyword_vec = vector_init(VECTOR_MIN_SIZE);
 
 	/* Default host value settings. */
 	host.name = NULL;
@@ -0,0 +1,114 @@
+/*! \file gsmtap_vty.c
+ * Configure the source filter of a GSMTAP instance from VTY. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <errno.h>
+
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/talloc.h>
+
+#include <osmocom/vty/vty.h>
+#include <osmocom/vty/command.h>
+#include <osmocom/vty/misc.h>
+#include <osmocom/vty/gsmtap_vty.h>
+
+/*! GSMTAP instance as set by gsmtap_vty_init() */
+static struct gsmtap_inst *vty_gti;
+
+#define GSMTAP_FILTER_STR "Filter, sample and rate limit the GSMTAP messages at the source\n"
+
+DEFUN(cfg_gsmtap_filter, cfg_gsmtap_filter_cmd,
+      "gsmtap-filter .SPEC",
+      GSMTAP_FILTER_STR
+      "Space separated keys of: type=LIST chan=LIST arfcn=MIN[-MAX] ts=LIST ss=LIST"
+      " sample=N rate=N, where LIST is a comma separated list of numbers or ranges\n")
+{
+	struct gsmtap_filter flt;
+	char *spec;
+	int rc;
+
+	spec = argv_concat(argv, argc, 0);
+	rc = gsmtap_filter_parse(&flt, spec);
+	if (rc < 0) {
+		vty_out(vty, "%% Invalid GSMTAP filter '%s'%s", spec, VTY_NEWLINE);
+		talloc_free(spec);
+		return CMD_WARNING;
+	}
+	talloc_free(spec);
+
+	gsmtap_inst_set_filter(vty_gti, &flt);
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_gsmtap_filter, cfg_no_gsmtap_filter_cmd,
+      "no gsmtap-filter",
+      NO_STR GSMTAP_FILTER_STR)
+{
+	gsmtap_inst_set_filter(vty_gti, NULL);
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_gsmtap, show_gsmtap_cmd,
+      "show gsmtap",
+      SHOW_STR "Show the GSMTAP source filter and counters\n")
+{
+	char buf[256];
+
+	if (vty_gti->filter) {
+		gsmtap_filter_to_str_buf(buf, sizeof(buf), vty_gti->filter);
+		vty_out(vty, "Filter: %s%s", buf, VTY_NEWLINE);
+	} else
+		vty_out(vty, "Filter: none%s", VTY_NEWLINE);
+	if (vty_gti->ctrg)
+		vty_out_rate_ctr_group(vty, " ", vty_gti->ctrg);
+	return CMD_SUCCESS;
+}
+
+/*! Install the VTY commands to configure the source filter of a GSMTAP instance.
+ *  \param[in] parent_node node to install the configuration commands on.
+ *  \param[in] gti GSMTAP instance to configure.
+ *  \returns 0 on success; -EEXIST if already installed
+ *
+ *  Only a single GSMTAP instance can be configured per program. Its filter
+ *  is written to the configuration by gsmtap_vty_write(). */
+int gsmtap_vty_init(enum node_type parent_node, struct gsmtap_inst *gti)
+{
+	if (vty_gti)
+		return -EEXIST;
+	vty_gti = gti;
+
+	install_element_ve(&show_gsmtap_cmd);
+	install_element(parent_node, &cfg_gsmtap_filter_cmd);
+	install_element(parent_node, &cfg_no_gsmtap_filter_cmd);
+	return 0;
+}
+
+/*! Write the source filter configuration of the GSMTAP instance passed to gsmtap_vty_init().
+ *  \param[in] vty VTY context.
+ *  \param[in] indent String to print before each line.
+ */
+void gsmtap_vty_write(struct vty *vty, const char *indent)
+{
+	char buf[256];
+
+	if (!vty_gti || !vty_gti->filter)
+		return;
+	gsmtap_filter_to_str_buf(buf, sizeof(buf), vty_gti->filter);
+	vty_out(vty, "%sgsmtap-filter %s%s", indent ? : "", buf, VTY_NEWLINE);
+}
@@ -739,6 +739,44 @@ DEFUN(cfg_log_gsmtap, cfg_log_gsmtap_cmd,
 	return CMD_SUCCESS;
 }
 
+#define GSMTAP_BATCH_STR "Send several log records per GSMTAP datagram\n"
+
+DEFUN(cfg_log_gsmtap_batch, cfg_log_gsmtap_batch_cmd,
+	"logging gsmtap-batch <103-65507> interval <0-60000>",
+	LOGGING_STR GSMTAP_BATCH_STR
+	"Maximum size of a datagram in bytes\n"
+	"Maximum time a log record is held back\n"
+	"Time in milliseconds; 0 to send at the end of each event loop iteration\n")
+{
+	struct log_target *tgt = osmo_log_vty2tgt(vty);
+
+	if (!tgt)
+		return CMD_WARNING;
+	if (tgt->type != LOG_TGT_TYPE_GSMTAP) {
+		vty_out(vty, "%% Batching applies to GSMTAP log targets only%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (log_target_gsmtap_set_batch(tgt, atoi(argv[0]), atoi(argv[1])) < 0) {
+		vty_out(vty, "%% Unable to configure GSMTAP batching%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_log_gsmtap_batch, cfg_no_log_gsmtap_batch_cmd,
+	"no logging gsmtap-batch",
+	NO_STR LOGGING_STR GSMTAP_BATCH_STR)
+{
+	struct log_target *tgt = osmo_log_vty2tgt(vty);
+
+	if (!tgt)
+		return CMD_WARNING;
+	if (tgt->type == LOG_TGT_TYPE_GSMTAP)
+		log_target_gsmtap_set_batch(tgt, 0, 0);
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_log_stderr, cfg_log_stderr_cmd,
 	"log stderr",
 	LOG_STR "Logging via STDERR of the process\n")
@@ -919,6 +957,10 @@ static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 		get_value_string(logging_print_file_args, tgt->print_filename2),
 		VTY_NEWLINE);
 
+	if (tgt->type == LOG_TGT_TYPE_GSMTAP && tgt->tgt_gsmtap.batch_size)
+		vty_out(vty, " logging gsmtap-batch %u interval %u%s", tgt->tgt_gsmtap.batch_size,
+			tgt->tgt_gsmtap.batch_flush_ms, VTY_NEWLINE);
+
 	if (tgt->loglevel) {
 		const char *level_str = get_value_string_or_null(loglevel_strs, tgt->loglevel);
 		level_str = osmo_str_tolower(level_str);
@@ -1038,6 +1080,8 @@ void logging_vty_add_cmds()
 	install_element(CFG_LOG_NODE, &deprecated_logging_level_everything_cmd);
 	install_element(CFG_LOG_NODE, &deprecated_logging_level_all_cmd);
 	install_element(CFG_LOG_NODE, &deprecated_logging_level_all_everything_cmd);
+	install_element(CFG_LOG_NODE, &cfg_log_gsmtap_batch_cmd);
+	install_element(CFG_LOG_NODE, &cfg_no_log_gsmtap_batch_cmd);
 
 	install_element(CONFIG_NODE, &cfg_log_stderr_cmd);
 	install_element(CONFIG_NODE, &cfg_no_log_stderr_cmd);
@@ -0,0 +1,140 @@
+/*! \file socket_vty.c
+ * Configure the process-wide socket tuning from VTY. */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmocom/core/socket.h>
+#include <osmocom/core/utils.h>
+
+#include <osmocom/vty/vty.h>
+#include <osmocom/vty/command.h>
+#include <osmocom/vty/socket_vty.h>
+
+#define SOCK_TUNING_STR "Tuning of sockets opened with OSMO_SOCK_F_TUNING (applies to new sockets only)\n"
+
+enum sock_tuning_param {
+	SOCK_TUNING_RX_BUFFER,
+	SOCK_TUNING_TX_BUFFER,
+	SOCK_TUNING_BUSY_POLL,
+	SOCK_TUNING_UDP_SEGMENT,
+};
+
+static const struct value_string sock_tuning_param_names[] = {
+	{ SOCK_TUNING_RX_BUFFER,	"rx-buffer" },
+	{ SOCK_TUNING_TX_BUFFER,	"tx-buffer" },
+	{ SOCK_TUNING_BUSY_POLL,	"busy-poll" },
+	{ SOCK_TUNING_UDP_SEGMENT,	"udp-segment" },
+	{ 0, NULL }
+};
+
+static unsigned int *sock_tuning_field(struct osmo_sock_tuning *t, enum sock_tuning_param param)
+{
+	switch (param) {
+	case SOCK_TUNING_RX_BUFFER:
+		return &t->rcvbuf;
+	case SOCK_TUNING_TX_BUFFER:
+		return &t->sndbuf;
+	case SOCK_TUNING_BUSY_POLL:
+		return &t->busy_poll_us;
+	case SOCK_TUNING_UDP_SEGMENT:
+	default:
+		return &t->udp_segment;
+	}
+}
+
+static void sock_tuning_param_set(enum sock_tuning_param param, unsigned int val)
+{
+	struct osmo_sock_tuning t = *osmo_sock_tuning_get();
+
+	*sock_tuning_field(&t, param) = val;
+	osmo_sock_tuning_set(&t);
+}
+
+DEFUN(cfg_sock_tuning_buffer, cfg_sock_tuning_buffer_cmd,
+      "socket-tuning (rx-buffer|tx-buffer) <0-268435456>",
+      SOCK_TUNING_STR
+      "Kernel receive buffer size (SO_RCVBUF)\n"
+      "Kernel send buffer size (SO_SNDBUF)\n"
+      "Size in bytes, 0 for the system default\n")
+{
+	sock_tuning_param_set(get_string_value(sock_tuning_param_names, argv[0]), atoi(argv[1]));
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_sock_tuning_busy_poll, cfg_sock_tuning_busy_poll_cmd,
+      "socket-tuning busy-poll <0-1000000>",
+      SOCK_TUNING_STR
+      "Busy poll the device queue on receive (SO_BUSY_POLL)\n"
+      "Time in microseconds, 0 to disable\n")
+{
+	sock_tuning_param_set(SOCK_TUNING_BUSY_POLL, atoi(argv[0]));
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_sock_tuning_udp_segment, cfg_sock_tuning_udp_segment_cmd,
+      "socket-tuning udp-segment <0-65507>",
+      SOCK_TUNING_STR
+      "UDP generic segmentation offload (UDP_SEGMENT)\n"
+      "Segment size in bytes, 0 to disable\n")
+{
+	sock_tuning_param_set(SOCK_TUNING_UDP_SEGMENT, atoi(argv[0]));
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_sock_tuning, show_sock_tuning_cmd,
+      "show socket-tuning",
+      SHOW_STR "Show the tuning of sockets opened with OSMO_SOCK_F_TUNING\n")
+{
+	struct osmo_sock_tuning t = *osmo_sock_tuning_get();
+	const struct value_string *vs;
+
+	for (vs = sock_tuning_param_names; vs->str; vs++)
+		vty_out(vty, "%s: %u%s", vs->str, *sock_tuning_field(&t, vs->value), VTY_NEWLINE);
+	return CMD_SUCCESS;
+}
+
+/*! Install the VTY commands to configure the process-wide socket tuning.
+ *  \param[in] parent_node node to install the configuration commands on.
+ *
+ *  The tuning is written to the configuration by osmo_sock_vty_write(). */
+void osmo_sock_vty_init(enum node_type parent_node)
+{
+	install_element_ve(&show_sock_tuning_cmd);
+	install_element(parent_node, &cfg_sock_tuning_buffer_cmd);
+	install_element(parent_node, &cfg_sock_tuning_busy_poll_cmd);
+	install_element(parent_node, &cfg_sock_tuning_udp_segment_cmd);
+}
+
+/*! Write the process-wide socket tuning, omitting parameters left at the default.
+ *  \param[in] vty VTY context.
+ *  \param[in] indent String to print before each line.
+ */
+void osmo_sock_vty_write(struct vty *vty, const char *indent)
+{
+	struct osmo_sock_tuning t = *osmo_sock_tuning_get();
+	const struct value_string *vs;
+	unsigned int val;
+
+	for (vs = sock_tuning_param_names; vs->str; vs++) {
+		val = *sock_tuning_field(&t, vs->value);
+		if (val)
+			vty_out(vty, "%ssocket-tuning %s %u%s", indent ? : "", vs->str, val, VTY_NEWLINE);
+	}
+}
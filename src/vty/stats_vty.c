@@ -24,6 +24,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <inttypes.h>
 
 #include "../../config.h"
 
@@ -37,6 +39,11 @@
 #include <osmocom/core/stats.h>
 #include <osmocom/core/counter.h>
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/loop_stats.h>
+
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
 
 #define CFG_STATS_STR "Configure stats sub-system\n"
 #define CFG_REPORTER_STR "Configure a stats reporter\n"
@@ -286,6 +293,29 @@ DEFUN(cfg_stats_interval, cfg_stats_interval_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_stats_event_loop, cfg_stats_event_loop_cmd,
+	"stats event-loop sample-rate <1-65535>",
+	CFG_STATS_STR "Collect statistics about the event loop and its call-backs\n"
+	"Set how often the duration of a call-back is measured\n"
+	"Measure every n-th call-back, 1 to measure all\n")
+{
+	int rc = osmo_loop_stats_enable(atoi(argv[0]));
+	if (rc < 0) {
+		vty_out(vty, "%% Unable to enable event loop statistics: %s%s",
+			strerror(-rc), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_stats_event_loop, cfg_no_stats_event_loop_cmd,
+	"no stats event-loop",
+	NO_STR CFG_STATS_STR "Collect statistics about the event loop and its call-backs\n")
+{
+	osmo_loop_stats_disable();
+	return CMD_SUCCESS;
+}
 
 DEFUN(cfg_no_stats_reporter_statsd, cfg_no_stats_reporter_statsd_cmd,
 	"no stats reporter statsd",
@@ -547,6 +577,94 @@ DEFUN(show_rate_counters,
 	return CMD_SUCCESS;
 }
 
+struct loop_cb_list {
+	const struct osmo_loop_cb_stats **cbs;
+	unsigned int num;
+};
+
+static int loop_cb_collect(const struct osmo_loop_cb_stats *cbs, void *data)
+{
+	struct loop_cb_list *list = data;
+
+	list->cbs = talloc_realloc(tall_vty_ctx, list->cbs, const struct osmo_loop_cb_stats *,
+				   list->num + 1);
+	if (!list->cbs)
+		return -ENOMEM;
+	list->cbs[list->num++] = cbs;
+	return 0;
+}
+
+static int loop_cb_cmp(const void *a, const void *b)
+{
+	const struct osmo_loop_cb_stats *x = *(const struct osmo_loop_cb_stats **)a;
+	const struct osmo_loop_cb_stats *y = *(const struct osmo_loop_cb_stats **)b;
+
+	if (x->total_ns != y->total_ns)
+		return x->total_ns < y->total_ns ? 1 : -1;
+	if (x->count != y->count)
+		return x->count < y->count ? 1 : -1;
+	return 0;
+}
+
+static void vty_out_loop_cb(struct vty *vty, const struct osmo_loop_cb_stats *cbs)
+{
+	char name[32];
+	char **syms = NULL;
+#ifdef HAVE_EXECINFO_H
+	void *addr = (void *)cbs->cb;
+	syms = backtrace_symbols(&addr, 1);
+#endif
+
+	if (cbs->type == OSMO_LOOP_CB_FD)
+		snprintf(name, sizeof(name), "fd %d", cbs->fd);
+	else
+		snprintf(name, sizeof(name), "timer");
+
+	vty_out(vty, " %-8s %10"PRIu64" calls, %8"PRIu64" sampled: avg %8"PRIu64" us, max %8"PRIu64" us, ",
+		name, cbs->count, cbs->sampled,
+		cbs->sampled ? cbs->total_ns / cbs->sampled / 1000 : 0,
+		cbs->max_ns / 1000);
+	if (syms)
+		vty_out(vty, "%s%s", syms[0], VTY_NEWLINE);
+	else
+		vty_out(vty, "%p%s", cbs->cb, VTY_NEWLINE);
+	free(syms);
+}
+
+DEFUN(show_event_loop_stats,
+      show_event_loop_stats_cmd,
+      "show event-loop stats",
+      SHOW_STR "Show event loop information\n"
+      "Show statistics about the event loop and its call-backs, slowest first\n")
+{
+	const struct osmo_loop_stats *ls = osmo_loop_stats_get();
+	struct loop_cb_list list = {};
+	unsigned int i;
+
+	if (!osmo_loop_stats_sample_rate)
+		vty_out(vty, "Event loop statistics are disabled, see 'stats event-loop'%s", VTY_NEWLINE);
+	else
+		vty_out(vty, "Event loop statistics, measuring 1 in %u call-backs:%s",
+			osmo_loop_stats_sample_rate, VTY_NEWLINE);
+
+	vty_out(vty, " %"PRIu64" iterations: busy %"PRIu64" ms, idle %"PRIu64" ms, "
+		"longest iteration %"PRIu64" us%s",
+		ls->iterations, ls->busy_ns / 1000000, ls->idle_ns / 1000000,
+		ls->max_busy_ns / 1000, VTY_NEWLINE);
+	if (ls->dropped)
+		vty_out(vty, " %"PRIu64" call-backs not accounted for, table full%s",
+			ls->dropped, VTY_NEWLINE);
+
+	osmo_loop_stats_for_each_cb(loop_cb_collect, &list);
+	if (list.num)
+		qsort(list.cbs, list.num, sizeof(*list.cbs), loop_cb_cmp);
+	for (i = 0; i < list.num; i++)
+		vty_out_loop_cb(vty, list.cbs[i]);
+	talloc_free(list.cbs);
+
+	return CMD_SUCCESS;
+}
+
 static int config_write_stats_reporter(struct vty *vty, struct osmo_stats_reporter *srep)
 {
 	if (srep == NULL)
@@ -606,6 +724,8 @@ static int config_write_stats(struct vty *vty)
 	config_write_stats_reporter(vty, srep);
 
 	vty_out(vty, "stats interval %d%s", osmo_stats_config->interval, VTY_NEWLINE);
+	if (osmo_loop_stats_sample_rate)
+		vty_out(vty, "stats event-loop sample-rate %u%s", osmo_loop_stats_sample_rate, VTY_NEWLINE);
 
 	return 1;
 }
@@ -624,6 +744,8 @@ void osmo_stats_vty_add_cmds()
 	install_element(CONFIG_NODE, &cfg_stats_reporter_log_cmd);
 	install_element(CONFIG_NODE, &cfg_no_stats_reporter_log_cmd);
 	install_element(CONFIG_NODE, &cfg_stats_interval_cmd);
+	install_element(CONFIG_NODE, &cfg_stats_event_loop_cmd);
+	install_element(CONFIG_NODE, &cfg_no_stats_event_loop_cmd);
 
 	install_node(&cfg_stats_node, config_write_stats);
 
@@ -641,4 +763,5 @@ void osmo_stats_vty_add_cmds()
 
 	install_element_ve(&show_stats_asciidoc_table_cmd);
 	install_element_ve(&show_rate_counters_cmd);
+	install_element_ve(&show_event_loop_stats_cmd);
 }
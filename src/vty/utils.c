@@ -253,6 +253,17 @@ static int osmo_stat_item_handler(
 		item->desc->unit != OSMO_STAT_ITEM_NO_UNIT ?
 		item->desc->unit : "";
 
+	if (item->hist) {
+		vty_out(vty, " %s%s: p50 %" PRIu32 " p90 %" PRIu32 " p99 %" PRIu32
+			" max %" PRIu32 " %s (%" PRIu64 " values)%s",
+			vctx->prefix, item->desc->description,
+			osmo_stat_hist_percentile(item->hist, 50),
+			osmo_stat_hist_percentile(item->hist, 90),
+			osmo_stat_hist_percentile(item->hist, 99),
+			item->hist->max, unit, item->hist->count, VTY_NEWLINE);
+		return 0;
+	}
+
 	vty_out(vty, " %s%s: %8" PRIi32 " %s%s",
 		vctx->prefix, item->desc->description,
 		osmo_stat_item_get_last(item),
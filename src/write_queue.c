@@ -22,16 +22,182 @@
  *
  */
 
+#define _GNU_SOURCE	/* sendmmsg() */
 #include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "../config.h"
+
 #include <osmocom/core/write_queue.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/utils.h>
 
 /*! \addtogroup write_queue
  *  @{
  *  Write queue for writing \ref msgb to sockets/fds.
  *
+ *  By default, \ref osmo_wqueue_bfd_cb hands one message per write event
+ *  to \ref osmo_wqueue.write_cb. A long queue thus costs one select()
+ *  round-trip and one system call per message. With \ref osmo_wqueue_set_mode,
+ *  the queue instead writes as many messages as the socket takes with one
+ *  writev() or sendmmsg() per batch, without involving write_cb.
+ *
  * \file write_queue.c */
 
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+/* number of messages per writev() */
+#define WQUEUE_WRITEV_BATCH	OSMO_MIN(IOV_MAX, 256)
+/* number of messages per sendmmsg() */
+#define WQUEUE_SENDMMSG_BATCH	64
+/* number of messages written per write event at most, so that other file
+ * descriptors get their turn */
+#define WQUEUE_DRAIN_MAX	1024
+
+static void wqueue_update_stats(struct osmo_wqueue *queue)
+{
+	if (queue->length_item)
+		osmo_stat_item_set(queue->length_item, queue->current_length);
+	if (queue->bytes_item)
+		osmo_stat_item_set(queue->bytes_item, queue->current_bytes);
+}
+
+static struct msgb *wqueue_dequeue(struct osmo_wqueue *queue)
+{
+	struct msgb *msg = msgb_dequeue(&queue->msg_queue);
+
+	--queue->current_length;
+	/* the queue may have been tampered with by the user */
+	queue->current_bytes -= OSMO_MIN(queue->current_bytes, msgb_length(msg));
+	return msg;
+}
+
+/* Write the head of the queue with writev(), releasing all messages written
+ * completely. Returns the number of messages released, or a negative errno;
+ * *full is set if not everything offered was taken. */
+static int wqueue_writev(struct osmo_wqueue *queue, bool *full)
+{
+	struct iovec iov[WQUEUE_WRITEV_BATCH];
+	struct msgb *msg;
+	unsigned int n = 0, done = 0;
+	ssize_t rc;
+
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		iov[n].iov_base = msgb_data(msg);
+		iov[n].iov_len = msgb_length(msg);
+		if (++n == ARRAY_SIZE(iov))
+			break;
+	}
+
+	rc = writev(queue->bfd.fd, iov, n);
+	if (rc < 0)
+		return -errno;
+
+	*full = false;
+	while (!llist_empty(&queue->msg_queue)) {
+		msg = llist_first_entry(&queue->msg_queue, struct msgb, list);
+		if (msgb_length(msg) > rc) {
+			/* partial write: resume with the remainder next time */
+			msgb_pull(msg, rc);
+			queue->current_bytes -= OSMO_MIN(queue->current_bytes, rc);
+			*full = true;
+			break;
+		}
+		rc -= msgb_length(msg);
+		msgb_free(wqueue_dequeue(queue));
+		done++;
+	}
+	if (queue->sent_ctr)
+		rate_ctr_add(queue->sent_ctr, done);
+
+	return done;
+}
+
+/* Send the head of the queue with sendmmsg(), releasing all messages sent.
+ * Returns the number of messages released, or a negative errno; *full is set
+ * if not everything offered was taken. */
+static int wqueue_sendmmsg(struct osmo_wqueue *queue, bool *full)
+{
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr mmsg[WQUEUE_SENDMMSG_BATCH];
+	struct iovec iov[WQUEUE_SENDMMSG_BATCH];
+	struct msgb *msg;
+	unsigned int n = 0;
+	int i, rc;
+
+	memset(mmsg, 0, sizeof(mmsg));
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		iov[n].iov_base = msgb_data(msg);
+		iov[n].iov_len = msgb_length(msg);
+		mmsg[n].msg_hdr.msg_iov = &iov[n];
+		mmsg[n].msg_hdr.msg_iovlen = 1;
+		if (++n == ARRAY_SIZE(mmsg))
+			break;
+	}
+
+	rc = sendmmsg(queue->bfd.fd, mmsg, n, 0);
+	if (rc < 0)
+		return -errno;
+
+	*full = rc < n;
+	for (i = 0; i < rc; i++)
+		msgb_free(wqueue_dequeue(queue));
+	if (queue->sent_ctr)
+		rate_ctr_add(queue->sent_ctr, rc);
+	return rc;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/* Write as many queued messages as possible in the configured batch mode */
+static void wqueue_drain(struct osmo_wqueue *queue)
+{
+	unsigned int done = 0;
+	bool full = false;
+	int rc;
+
+	while (!llist_empty(&queue->msg_queue) && !full && done < WQUEUE_DRAIN_MAX) {
+		if (queue->mode == OSMO_WQUEUE_MODE_SENDMMSG)
+			rc = wqueue_sendmmsg(queue, &full);
+		else
+			rc = wqueue_writev(queue, &full);
+
+		if (rc == -EAGAIN || rc == -EWOULDBLOCK || rc == -EINTR || rc == -ENOBUFS)
+			break;
+
+		if (rc < 0 && queue->mode == OSMO_WQUEUE_MODE_SENDMMSG) {
+			/* drop the datagram that could not be sent, like a write_cb
+			 * ignoring the error would; e.g. ECONNREFUSED is common */
+			LOGP(DLGLOBAL, LOGL_DEBUG, "wqueue(%p) failed to send to fd %d: %s\n",
+			     queue, queue->bfd.fd, strerror(-rc));
+			msgb_free(wqueue_dequeue(queue));
+			done++;
+			continue;
+		}
+
+		if (rc < 0) {
+			/* the stream is broken, there is no point in keeping
+			 * anything queued; the read side will notice as well */
+			LOGP(DLGLOBAL, LOGL_ERROR, "wqueue(%p) failed to write to fd %d: %s\n",
+			     queue, queue->bfd.fd, strerror(-rc));
+			osmo_wqueue_clear(queue);
+			break;
+		}
+
+		done += rc;
+	}
+}
+
 /*! Select loop function for write queue handling
  *  \param[in] fd osmocom file descriptor
  *  \param[in] what bit-mask of events that have happened
@@ -65,12 +231,18 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 		fd->when &= ~OSMO_FD_WRITE;
 
 		/* the queue might have been emptied */
-		if (!llist_empty(&queue->msg_queue)) {
-			--queue->current_length;
-
-			msg = msgb_dequeue(&queue->msg_queue);
+		if (queue->mode != OSMO_WQUEUE_MODE_CB) {
+			wqueue_drain(queue);
+			wqueue_update_stats(queue);
+			if (!llist_empty(&queue->msg_queue))
+				fd->when |= OSMO_FD_WRITE;
+		} else if (!llist_empty(&queue->msg_queue)) {
+			msg = wqueue_dequeue(queue);
+			wqueue_update_stats(queue);
 			rc = queue->write_cb(fd, msg);
 			msgb_free(msg);
+			if (rc >= 0 && queue->sent_ctr)
+				rate_ctr_inc(queue->sent_ctr);
 
 			if (rc == -EBADF)
 				goto err_badfd;
@@ -93,6 +265,12 @@ void osmo_wqueue_init(struct osmo_wqueue *queue, int max_length)
 {
 	queue->max_length = max_length;
 	queue->current_length = 0;
+	queue->max_bytes = 0;
+	queue->current_bytes = 0;
+	queue->mode = OSMO_WQUEUE_MODE_CB;
+	queue->length_item = NULL;
+	queue->bytes_item = NULL;
+	queue->sent_ctr = NULL;
 	queue->read_cb = NULL;
 	queue->write_cb = NULL;
 	queue->except_cb = NULL;
@@ -100,6 +278,26 @@ void osmo_wqueue_init(struct osmo_wqueue *queue, int max_length)
 	INIT_LLIST_HEAD(&queue->msg_queue);
 }
 
+/*! Set how a \ref osmo_wqueue writes queued messages
+ *  \param[in] queue Write queue to operate on
+ *  \param[in] mode OSMO_WQUEUE_MODE_CB to hand each message to write_cb, or a batch mode
+ *  \returns 0 on success; -ENOTSUP if the mode is not available on this system
+ *
+ * In the batch modes, messages are written to queue->bfd.fd directly and
+ * write_cb is not called. Write errors are logged; a datagram that can not
+ * be sent is dropped, while a stream that can not be written to has all its
+ * queued messages dropped.
+ */
+int osmo_wqueue_set_mode(struct osmo_wqueue *queue, enum osmo_wqueue_mode mode)
+{
+#ifndef HAVE_SENDMMSG
+	if (mode == OSMO_WQUEUE_MODE_SENDMMSG)
+		return -ENOTSUP;
+#endif
+	queue->mode = mode;
+	return 0;
+}
+
 /*! Enqueue a new \ref msgb into a write queue
  *  \param[in] queue Write queue to be used
  *  \param[in] data to-be-enqueued message buffer
@@ -113,9 +311,17 @@ int osmo_wqueue_enqueue(struct osmo_wqueue *queue, struct msgb *data)
 		return -ENOSPC;
 	}
 
+	if (queue->max_bytes && queue->current_bytes + msgb_length(data) > queue->max_bytes) {
+		LOGP(DLGLOBAL, LOGL_ERROR,
+			"wqueue(%p) is full (%u bytes). Rejecting msgb\n", queue, queue->current_bytes);
+		return -ENOSPC;
+	}
+
 	++queue->current_length;
+	queue->current_bytes += msgb_length(data);
 	msgb_enqueue(&queue->msg_queue, data);
 	queue->bfd.when |= OSMO_FD_WRITE;
+	wqueue_update_stats(queue);
 
 	return 0;
 }
@@ -133,7 +339,9 @@ void osmo_wqueue_clear(struct osmo_wqueue *queue)
 	}
 
 	queue->current_length = 0;
+	queue->current_bytes = 0;
 	queue->bfd.when &= ~OSMO_FD_WRITE;
+	wqueue_update_stats(queue);
 }
 
 /*! @} */
@@ -0,0 +1,26 @@
+/*! \file bench.h
+ * Optional benchmarks in the unit tests.
+ *
+ * A test started with -b additionally measures throughput and prints the
+ * results to stderr. stdout, which is compared against the .ok file, does
+ * not change. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+/*! Return true if the test was started with -b */
+static inline bool bench_requested(int argc, char **argv)
+{
+	return argc > 1 && !strcmp(argv[1], "-b");
+}
+
+/*! Return the monotonic clock in seconds */
+static inline double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -9,8 +9,12 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/gsm/protocol/ipaccess.h>
 #include <osmocom/ctrl/control_if.h>
+#include <osmocom/ctrl/gsmtap_ctrl_commands.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
 
 static void check_type(enum ctrl_type c)
 {
@@ -449,6 +453,139 @@ static void test_deferred_cmd()
 	printf("success\n");
 }
 
+CTRL_CMD_DEFINE_RO(test_bulk, "test-bulk *");
+static int get_test_bulk(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = talloc_asprintf(cmd, "value of %s", cmd->variable);
+	return CTRL_CMD_REPLY;
+}
+
+static const struct rate_ctr_desc test_ctr_desc[] = {
+	{ "rx", "Received" },
+	{ "tx", "Transmitted" },
+};
+
+static const struct rate_ctr_group_desc test_ctrg_desc = {
+	.group_name_prefix = "bulk",
+	.group_description = "Bulk GET test",
+	.num_ctr = ARRAY_SIZE(test_ctr_desc),
+	.ctr_desc = test_ctr_desc,
+};
+
+static const struct one_test test_bulk_list[] = {
+	{ "GET 1 test-bulk.a,test-bulk.b",
+		{
+			.type = CTRL_TYPE_GET,
+			.id = "1",
+			.variable = "test-bulk.a,test-bulk.b",
+		},
+		"GET_REPLY 1 test-bulk.a,test-bulk.b test-bulk.a value of test-bulk.a\n"
+		"test-bulk.b value of test-bulk.b",
+	},
+	{ "GET 2 rate_ctr.abs.bulk.3.rx,rate_ctr.abs.bulk.3.tx,rate_ctr.abs.bulk.3,rate_ctr.abs.bulk.4.rx",
+		{
+			.type = CTRL_TYPE_GET,
+			.id = "2",
+			.variable = "rate_ctr.abs.bulk.3.rx,rate_ctr.abs.bulk.3.tx,rate_ctr.abs.bulk.3,"
+				    "rate_ctr.abs.bulk.4.rx",
+		},
+		"GET_REPLY 2 rate_ctr.abs.bulk.3.rx,rate_ctr.abs.bulk.3.tx,rate_ctr.abs.bulk.3,"
+		"rate_ctr.abs.bulk.4.rx rate_ctr.abs.bulk.3.rx 5\n"
+		"rate_ctr.abs.bulk.3.tx 7\n"
+		"rate_ctr.abs.bulk.3 rx 5;tx 7;\n"
+		"rate_ctr.abs.bulk.4.rx ERROR Counter group with given name and index not found",
+	},
+	{ "GET 3 test-bulk.a,nonexistent",
+		{
+			.type = CTRL_TYPE_GET,
+			.id = "3",
+			.variable = "test-bulk.a,nonexistent",
+		},
+		"GET_REPLY 3 test-bulk.a,nonexistent test-bulk.a value of test-bulk.a\n"
+		"nonexistent ERROR Command not found",
+	},
+	{ "GET 4 test-bulk.a,test-defer,test-bulk.b",
+		{
+			.type = CTRL_TYPE_GET,
+			.id = "4",
+			.variable = "test-bulk.a,test-defer,test-bulk.b",
+		},
+		"GET_REPLY 4 test-bulk.a,test-defer,test-bulk.b test-bulk.a value of test-bulk.a\n"
+		"test-defer ERROR Deferred reply not supported in bulk GET\n"
+		"test-bulk.b value of test-bulk.b",
+	},
+};
+
+static void test_bulk_get()
+{
+	struct ctrl_handle *ctrl;
+	struct ctrl_connection *ccon;
+	struct rate_ctr_group *ctrg;
+	int i;
+
+	printf("\n%s\n", __func__);
+
+	ctrl = ctrl_handle_alloc2(ctx, NULL, NULL, 0);
+	ccon = talloc_zero(ctx, struct ctrl_connection);
+	INIT_LLIST_HEAD(&ccon->def_cmds);
+	osmo_wqueue_init(&ccon->write_queue, 1);
+
+	ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_test_bulk);
+
+	/* many groups, to be found by name and index */
+	for (i = 0; i < 300; i++)
+		OSMO_ASSERT(rate_ctr_group_alloc(ctrl, &test_ctrg_desc, i != 3 ? i + 1000 : 3));
+	ctrg = rate_ctr_get_group_by_name_idx("bulk", 3);
+	OSMO_ASSERT(ctrg && ctrg->idx == 3);
+	rate_ctr_add(&ctrg->ctr[0], 5);
+	rate_ctr_add(&ctrg->ctr[1], 7);
+
+	for (i = 0; i < ARRAY_SIZE(test_bulk_list); i++)
+		assert_test(ctrl, ccon, &test_bulk_list[i]);
+
+	talloc_free(ccon);
+	talloc_free(ctrl);
+}
+
+static const struct one_test test_gsmtap_list[] = {
+	{ "GET 1 gsmtap-filter",
+		{
+			.type = CTRL_TYPE_GET,
+			.id = "1",
+			.variable = "gsmtap-filter",
+		},
+		"GET_REPLY 1 gsmtap-filter none",
+	},
+};
+
+static void test_gsmtap_install()
+{
+	struct ctrl_handle *ctrl;
+	struct ctrl_connection *ccon;
+	struct gsmtap_inst *gti, *gti2;
+	int i;
+
+	printf("\n%s\n", __func__);
+
+	ctrl = ctrl_handle_alloc2(ctx, NULL, NULL, 0);
+	ccon = talloc_zero(ctx, struct ctrl_connection);
+	INIT_LLIST_HEAD(&ccon->def_cmds);
+	osmo_wqueue_init(&ccon->write_queue, 1);
+
+	gti = gsmtap_source_init("127.0.0.1", GSMTAP_UDP_PORT, 0);
+	gti2 = gsmtap_source_init("127.0.0.1", GSMTAP_UDP_PORT, 0);
+	OSMO_ASSERT(gti && gti2);
+	printf("install: %d\n", gsmtap_ctrl_cmds_install(gti));
+	/* only a single GSMTAP instance is supported */
+	printf("install again: %d\n", gsmtap_ctrl_cmds_install(gti2));
+
+	for (i = 0; i < ARRAY_SIZE(test_gsmtap_list); i++)
+		assert_test(ctrl, ccon, &test_gsmtap_list[i]);
+
+	talloc_free(ccon);
+	talloc_free(ctrl);
+}
+
 static struct log_info_cat test_categories[] = {
 };
 
@@ -478,6 +615,10 @@ int main(int argc, char **argv)
 
 	test_deferred_cmd();
 
+	test_bulk_get();
+
+	test_gsmtap_install();
+
 	/* Expecting root ctx + msgb root ctx + 5 logging elements */
 	if (talloc_total_blocks(ctx) != 7) {
 		talloc_report_full(ctx, stdout);
@@ -9,8 +9,11 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/stat_item.h>
 #include <osmocom/ctrl/control_if.h>
 
+#include "bench.h"
+
 enum {
 	DMAIN,
 };
@@ -386,6 +389,195 @@ static void test_state_chg_T()
 	fprintf(stderr, "--- %s() done\n", __func__);
 }
 
+static void test_coarse_timeouts()
+{
+	struct osmo_fsm_inst *fi, *fi2;
+	struct timeval remaining;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	fsm.timer_cb = timer_cb;
+	fsm.coarse_timeouts = true;
+	fake_time_start();
+
+	fi = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "coarse");
+	OSMO_ASSERT(fi);
+	fi2 = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "cancelled");
+	OSMO_ASSERT(fi2);
+
+	/* expires at the first full second after the deadline, with its T */
+	timeout_fired = -1;
+	osmo_fsm_inst_state_chg_ms(fi, ST_ONE, 2500, 23);
+	osmo_fsm_inst_state_chg(fi2, ST_ONE, 1, 42);
+	fake_time_passes(0, 500000);
+	osmo_fsm_inst_state_chg_keep_timer(fi, ST_TWO);
+	osmo_fsm_inst_state_chg(fi2, ST_TWO, 0, 0);
+	OSMO_ASSERT(osmo_fsm_inst_timer_remaining(fi, &remaining) == 0);
+	OSMO_ASSERT(remaining.tv_sec == 2 && remaining.tv_usec == 0);
+	OSMO_ASSERT(osmo_fsm_inst_timer_remaining(fi2, &remaining) == -1);
+	fake_time_passes(2, 0);
+	OSMO_ASSERT(timeout_fired == -1);
+	fake_time_passes(0, 500000);
+	OSMO_ASSERT(timeout_fired == 23);
+
+	osmo_fsm_inst_term(fi, OSMO_FSM_TERM_REQUEST, NULL);
+	osmo_fsm_inst_term(fi2, OSMO_FSM_TERM_REQUEST, NULL);
+
+	/* timeouts beyond one revolution of the wheel */
+	fi = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "long");
+	OSMO_ASSERT(fi);
+	timeout_fired = -1;
+	osmo_fsm_inst_state_chg(fi, ST_ONE, 100, 11);
+	fake_time_passes(99, 0);
+	OSMO_ASSERT(timeout_fired == -1);
+	fake_time_passes(1, 0);
+	OSMO_ASSERT(timeout_fired == 11);
+	osmo_fsm_inst_term(fi, OSMO_FSM_TERM_REQUEST, NULL);
+	fsm.coarse_timeouts = false;
+	fsm.timer_cb = NULL;
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static void test_event_names()
+{
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	/* resolved by index after osmo_fsm_register() */
+	OSMO_ASSERT(osmo_fsm_event_name(&fsm, EV_A) == test_fsm_event_names[0].str);
+	OSMO_ASSERT(osmo_fsm_event_name(&fsm, EV_B) == test_fsm_event_names[1].str);
+	fprintf(stderr, "%s %s %s\n", osmo_fsm_event_name(&fsm, EV_A),
+		osmo_fsm_event_name(&fsm, EV_B), osmo_fsm_event_name(&fsm, 23));
+
+	fprintf(stderr, "\n--- %s() done\n\n", __func__);
+}
+
+static void test_event_queue()
+{
+	struct osmo_fsm_inst *fi[3];
+	struct osmo_stat_item_group *statg;
+	unsigned int i;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	OSMO_ASSERT(osmo_fsm_event_queue_init(g_ctx, 2) == 0);
+	statg = osmo_fsm_event_queue_statg();
+	OSMO_ASSERT(statg);
+
+	for (i = 0; i < ARRAY_SIZE(fi); i++) {
+		fi[i] = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, NULL);
+		OSMO_ASSERT(fi[i]);
+		osmo_fsm_inst_update_id_f(fi[i], "q%u", i);
+	}
+
+	/* nothing happens until the select loop runs, then in FIFO order */
+	OSMO_ASSERT(osmo_fsm_inst_post_batch(fi, ARRAY_SIZE(fi), EV_A, (void *)23) == 0);
+	OSMO_ASSERT(osmo_fsm_inst_post(fi[0], EV_B, (void *)42) == 0);
+	OSMO_ASSERT(osmo_fsm_event_queue_depth() == 4);
+	OSMO_ASSERT(osmo_stat_item_get_last(statg->items[OSMO_FSM_EVQ_STAT_DEPTH]) == 4);
+	for (i = 0; i < ARRAY_SIZE(fi); i++)
+		OSMO_ASSERT(fi[i]->state == ST_NULL);
+
+	fake_time_passes(0, 0);
+	OSMO_ASSERT(osmo_fsm_event_queue_depth() == 0);
+	OSMO_ASSERT(fi[0]->state == ST_TWO);
+	OSMO_ASSERT(fi[1]->state == ST_ONE);
+	OSMO_ASSERT(fi[2]->state == ST_ONE);
+
+	/* events for a freed instance are dropped */
+	OSMO_ASSERT(osmo_fsm_inst_post(fi[1], EV_B, (void *)42) == 0);
+	osmo_fsm_inst_term(fi[1], OSMO_FSM_TERM_REQUEST, NULL);
+	OSMO_ASSERT(osmo_fsm_event_queue_depth() == 0);
+
+	/* latency from posting to dispatch */
+	OSMO_ASSERT(osmo_fsm_inst_post(fi[2], EV_B, (void *)42) == 0);
+	osmo_gettimeofday_override_add(0, 1500);
+	osmo_clock_override_add(CLOCK_MONOTONIC, 0, 1500 * 1000);
+	OSMO_ASSERT(osmo_fsm_event_queue_run(0) == 1);
+	OSMO_ASSERT(fi[2]->state == ST_TWO);
+	fprintf(stderr, "latency: %d us\n",
+		osmo_stat_item_get_last(statg->items[OSMO_FSM_EVQ_STAT_LATENCY]));
+
+	osmo_fsm_inst_term(fi[0], OSMO_FSM_TERM_REQUEST, NULL);
+	osmo_fsm_inst_term(fi[2], OSMO_FSM_TERM_REQUEST, NULL);
+
+	fprintf(stderr, "\n--- %s() done\n\n", __func__);
+}
+
+/* Look up many instances by id and name; with verbose set, compare the time
+ * taken against a linear scan of fsm.instances */
+static void test_lookup_scaling(struct log_target *tgt, unsigned int num, bool verbose)
+{
+	struct osmo_fsm_inst **fi = talloc_zero_array(g_ctx, struct osmo_fsm_inst *, num);
+	struct osmo_fsm_inst *it;
+	double t0, t1, t2;
+	char buf[64];
+	unsigned int i, found;
+
+	fprintf(stderr, "\n--- %s(%u)\n", __func__, num);
+	OSMO_ASSERT(fi);
+
+	/* don't log every single allocation */
+	log_set_category_filter(tgt, DMAIN, 0, LOGL_DEBUG);
+
+	for (i = 0; i < num; i++) {
+		fi[i] = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, NULL);
+		OSMO_ASSERT(fi[i]);
+		OSMO_ASSERT(osmo_fsm_inst_update_id_f(fi[i], "sub%u", i) == 0);
+	}
+
+	t0 = bench_now();
+	for (i = 0; i < num; i++) {
+		snprintf(buf, sizeof(buf), "sub%u", i);
+		OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, buf) == fi[i]);
+		snprintf(buf, sizeof(buf), "Test_FSM(sub%u)", i);
+		OSMO_ASSERT(osmo_fsm_inst_find_by_name(&fsm, buf) == fi[i]);
+	}
+	t1 = bench_now();
+	fprintf(stderr, "found all %u instances by id and name\n", num);
+
+	if (verbose) {
+		/* what osmo_fsm_inst_find_by_id() used to do, on a tenth of the lookups */
+		found = 0;
+		for (i = 0; i < num; i += 10) {
+			snprintf(buf, sizeof(buf), "sub%u", i);
+			llist_for_each_entry(it, &fsm.instances, list) {
+				if (!strcmp(buf, it->id)) {
+					found++;
+					break;
+				}
+			}
+		}
+		t2 = bench_now();
+		OSMO_ASSERT(found == (num + 9) / 10);
+		fprintf(stderr, "%u instances: %.3f ms for %u indexed lookups, %.3f ms for %u linear lookups\n",
+			num, (t1 - t0) * 1e3, 2 * num, (t2 - t1) * 1e3, found);
+	}
+
+	/* renamed instances are only found by their new id */
+	for (i = 0; i < num; i += 2)
+		OSMO_ASSERT(osmo_fsm_inst_update_id_f(fi[i], "renamed%u", i) == 0);
+	for (i = 0; i < num; i++) {
+		snprintf(buf, sizeof(buf), "sub%u", i);
+		OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, buf) == (i & 1 ? fi[i] : NULL));
+		snprintf(buf, sizeof(buf), "renamed%u", i);
+		OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, buf) == (i & 1 ? NULL : fi[i]));
+	}
+	fprintf(stderr, "found all renamed instances by their new id only\n");
+
+	/* freed instances are gone from the index */
+	for (i = 0; i < num; i++)
+		osmo_fsm_inst_free(fi[i]);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "sub1") == NULL);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_name(&fsm, "Test_FSM(renamed0)") == NULL);
+	OSMO_ASSERT(llist_empty(&fsm.instances));
+
+	log_set_category_filter(tgt, DMAIN, 1, LOGL_DEBUG);
+	talloc_free(fi);
+
+	fprintf(stderr, "\n--- %s() done\n\n", __func__);
+}
+
 static const struct log_info_cat default_categories[] = {
 	[DMAIN] = {
 		.name = "DMAIN",
@@ -431,6 +623,10 @@ int main(int argc, char **argv)
 	test_id_api();
 	test_state_chg_keep_timer();
 	test_state_chg_T();
+	test_coarse_timeouts();
+	test_event_names();
+	test_event_queue();
+	test_lookup_scaling(stderr_target, 100000, bench_requested(argc, argv));
 
 	osmo_fsm_unregister(&fsm);
 	exit(0);
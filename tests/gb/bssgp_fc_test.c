@@ -109,6 +109,84 @@ static void test_fc(uint32_t bucket_size_max, uint32_t bucket_leak_rate,
 	talloc_free(fc);
 }
 
+struct fc_ms {
+	struct bssgp_flow_control *fc;
+	unsigned long last_out;
+};
+
+static unsigned long many_out;
+
+static int fc_many_out_cb(struct bssgp_flow_control *fc, struct msgb *msg,
+			  uint32_t llc_pdu_len, void *priv)
+{
+	/* the flow control passes on its priv pointer as first argument */
+	struct fc_ms *ms = (struct fc_ms *) fc;
+
+	/* PDUs of one MS must leave in the order they came in */
+	OSMO_ASSERT(msg->cb[0] > ms->last_out);
+	ms->last_out = msg->cb[0];
+	many_out++;
+	msgb_free(msg);
+	return 0;
+}
+
+/* Many flow control instances sharing the same scheduler */
+static void test_fc_many(unsigned int num_ms, uint32_t bucket_size_max, uint32_t bucket_leak_rate,
+			 uint32_t max_queue_depth, uint32_t max_queue_bytes, uint32_t pdu_len,
+			 uint32_t pdu_count)
+{
+	struct fc_ms *ms = talloc_zero_array(ctx, struct fc_ms, num_ms);
+	unsigned long in_ok = 0, in_dropped = 0, queued;
+	unsigned int i, j;
+	int rc;
+
+	osmo_gettimeofday_override_time = (struct timeval){
+		.tv_sec = 1486385000,
+		.tv_usec = 423423,
+	};
+	osmo_gettimeofday_override = true;
+	many_out = 0;
+
+	for (i = 0; i < num_ms; i++) {
+		ms[i].fc = talloc_zero(ms, struct bssgp_flow_control);
+		bssgp_fc_init(ms[i].fc, bucket_size_max, bucket_leak_rate, max_queue_depth,
+			      fc_many_out_cb);
+		ms[i].fc->max_queue_bytes = max_queue_bytes;
+	}
+
+	osmo_gettimeofday(&tv_start, NULL);
+
+	for (j = 0; j < pdu_count; j++) {
+		for (i = 0; i < num_ms; i++) {
+			struct msgb *msg = msgb_alloc(1, "fc test");
+			msg->cb[0] = j + 1;
+			rc = bssgp_fc_in(ms[i].fc, msg, pdu_len, &ms[i]);
+			if (rc == 0)
+				in_ok++;
+			else
+				in_dropped++;
+		}
+	}
+
+	do {
+		osmo_gettimeofday_override_add(0, 100000);
+
+		osmo_timers_check();
+		osmo_timers_prepare();
+		osmo_timers_update();
+
+		queued = 0;
+		for (i = 0; i < num_ms; i++)
+			queued += ms[i].fc->queue_depth;
+	} while (queued);
+
+	printf("%u MS: %lu PDUs in, %lu dropped, %lu out, drained after %u csecs\n",
+	       num_ms, in_ok, in_dropped, many_out, get_centisec_diff());
+	OSMO_ASSERT(many_out == in_ok);
+
+	talloc_free(ms);
+}
+
 static void help(void)
 {
 	printf(" -h --help                This help message\n");
@@ -116,6 +194,8 @@ static void help(void)
 	printf(" -r --bucket-leak-rate N  Bucket leak rate in octets/sec\n");
 	printf(" -d --max-queue-depth N   Maximum length of pending PDU queue (msgs)\n");
 	printf(" -l --pdu-length N        Length of each PDU in octets\n");
+	printf(" -b --max-queue-bytes N   Maximum size of pending PDU queue (octets)\n");
+	printf(" -m --num-ms N            Number of flow controlled MS (no per-PDU output)\n");
 }
 
 int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
@@ -132,6 +212,8 @@ int main(int argc, char **argv)
 	uint32_t max_queue_depth = 5; /* messages */
 	uint32_t pdu_length = 10; /* octets */
 	uint32_t pdu_count = 20; /* messages */
+	uint32_t max_queue_bytes = 0; /* octets */
+	unsigned int num_ms = 0;
 	int c;
 	void *tall_msgb_ctx;
 	ctx = talloc_named_const(NULL, 0, "bssgp_fc_test");
@@ -142,6 +224,8 @@ int main(int argc, char **argv)
 		{ "max-queue-depth", 1, 0, 'd' },
 		{ "pdu-length", 1, 0, 'l' },
 		{ "pdu-count", 1, 0, 'c' },
+		{ "max-queue-bytes", 1, 0, 'b' },
+		{ "num-ms", 1, 0, 'm' },
 		{ "help", 0, 0, 'h' },
 		{ 0, 0, 0, 0 }
 	};
@@ -152,7 +236,7 @@ int main(int argc, char **argv)
 
 	tall_msgb_ctx = msgb_talloc_ctx_init(ctx, 0);
 
-	while ((c = getopt_long(argc, argv, "s:r:d:l:c:",
+	while ((c = getopt_long(argc, argv, "s:r:d:l:c:b:m:",
 				long_options, NULL)) != -1) {
 		switch (c) {
 		case 's':
@@ -170,6 +254,12 @@ int main(int argc, char **argv)
 		case 'c':
 			pdu_count = atoi(optarg);
 			break;
+		case 'b':
+			max_queue_bytes = atoi(optarg);
+			break;
+		case 'm':
+			num_ms = atoi(optarg);
+			break;
 		case 'h':
 			help();
 			exit(EXIT_SUCCESS);
@@ -189,8 +279,12 @@ int main(int argc, char **argv)
 	printf("size-max=%u oct, leak-rate=%u oct/s, "
 		"queue-len=%u msgs, pdu_len=%u oct, pdu_cnt=%u\n\n", bucket_size_max,
 		bucket_leak_rate, max_queue_depth, pdu_length, pdu_count);
-	test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
-		pdu_length, pdu_count);
+	if (num_ms)
+		test_fc_many(num_ms, bucket_size_max, bucket_leak_rate, max_queue_depth,
+			     max_queue_bytes, pdu_length, pdu_count);
+	else
+		test_fc(bucket_size_max, bucket_leak_rate, max_queue_depth,
+			pdu_length, pdu_count);
 	printf("msgb ctx: %zu b in %zu blocks (0 b in 1 block == just the context)\n",
 	       talloc_total_size(tall_msgb_ctx),
 	       talloc_total_blocks(tall_msgb_ctx));
@@ -13,3 +13,9 @@ $T -l 1000
 # test with 100 byte PDUs (10 second)
 $T -s 100
 
+
+# test with 20000 MS sharing the scheduler
+$T -m 20000 -d 100
+
+# test with 20000 MS and a byte limited queue
+$T -m 20000 -d 100 -b 50
@@ -289,6 +289,69 @@ static void test_bssgp_msgb_copy()
 	printf("----- %s END\n", __func__);
 }
 
+struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei);
+
+static struct msgb *dl_ud_msg(unsigned int llc_len)
+{
+	struct msgb *msg = bssgp_msgb_alloc();
+
+	memset(msgb_put(msg, llc_len), 0x2b, llc_len);
+	msgb_tlli(msg) = 0xc0001234;
+	msgb_bvci(msg) = 0x1001;
+	msgb_nsei(msg) = 0x2002;
+	return msg;
+}
+
+static void test_bssgp_dl_unitdata()
+{
+	static uint8_t ra_cap[] = { 0x13, 0x43, 0x2b, 0x25, 0x96, 0x62, 0x00, 0x60, 0x80 };
+	uint32_t old_tlli = 0xc0005678;
+	struct bssgp_dl_ud_par dup = {
+		.imsi = "001010123456789",
+		.drx_parms = 0x1234,
+		.ms_ra_cap = { .len = sizeof(ra_cap), .v = ra_cap },
+		.qos_profile = { 0x00, 0x00, 0x21 },
+	};
+	struct bssgp_dl_ud_ie_cache iec;
+	struct msgb *expected;
+	unsigned int llc_len;
+	int rc;
+
+	printf("----- %s START\n", __func__);
+
+	OSMO_ASSERT(btsctx_alloc(0x1001, 0x2002));
+
+	rc = bssgp_tx_dl_ud(dl_ud_msg(10), 1000, &dup);
+	OSMO_ASSERT(rc >= 0);
+	printf("Got message: %s\n", msgb_hexdump(last_ns_tx_msg));
+
+	dup.tlli = &old_tlli;
+	rc = bssgp_tx_dl_ud(dl_ud_msg(200), 1000, &dup);
+	OSMO_ASSERT(rc >= 0);
+	printf("Got message: %s\n", osmo_hexdump(msgb_data(last_ns_tx_msg), 64));
+
+	/* the cached IEs must result in the very same PDU */
+	OSMO_ASSERT(bssgp_dl_ud_ie_cache_update(&iec, &dup) == 0);
+	printf("Cached IEs: %s\n", osmo_hexdump(iec.data, iec.len));
+	for (llc_len = 1; llc_len < 300; llc_len += 7) {
+		rc = bssgp_tx_dl_ud(dl_ud_msg(llc_len), 1000, &dup);
+		OSMO_ASSERT(rc >= 0);
+		expected = last_ns_tx_msg;
+		last_ns_tx_msg = NULL;
+		rc = bssgp_tx_dl_ud_cached(dl_ud_msg(llc_len), 1000, &dup, &iec);
+		OSMO_ASSERT(rc >= 0);
+		OSMO_ASSERT(msgb_length(last_ns_tx_msg) == msgb_length(expected));
+		OSMO_ASSERT(memcmp(msgb_data(last_ns_tx_msg), msgb_data(expected),
+				   msgb_length(expected)) == 0);
+		msgb_free(expected);
+	}
+
+	msgb_free(last_ns_tx_msg);
+	last_ns_tx_msg = NULL;
+
+	printf("----- %s END\n", __func__);
+}
+
 static struct log_info info = {};
 
 int main(int argc, char **argv)
@@ -317,6 +380,7 @@ int main(int argc, char **argv)
 	test_bssgp_bad_reset();
 	test_bssgp_flow_control_bvc();
 	test_bssgp_msgb_copy();
+	test_bssgp_dl_unitdata();
 	printf("===== BSSGP test END\n\n");
 
 	exit(EXIT_SUCCESS);
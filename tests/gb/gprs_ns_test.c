@@ -15,6 +15,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <dlfcn.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
@@ -28,6 +29,7 @@
 #include <osmocom/gprs/gprs_msgb.h>
 #include <osmocom/gprs/gprs_ns.h>
 #include <osmocom/gprs/gprs_bssgp.h>
+#include <osmocom/gprs/gprs_bssgp_bss.h>
 
 #define REMOTE_BSS_ADDR 0x01020304
 #define REMOTE_SGSN_ADDR 0x05060708
@@ -36,6 +38,14 @@
 
 static int sent_pdu_type = 0;
 
+/* when set, the overrides below only count messages, see test_unitdata_throughput() */
+static bool bench_mode = false;
+static unsigned int bench_rx, bench_tx;
+/* PDUs sent in bench mode per destination port, see test_load_sharing() */
+#define LS_BASE_PORT 2000
+#define LS_NUM_NSVC 4
+static unsigned int bench_tx_port[LS_NUM_NSVC];
+
 static int gprs_process_message(struct gprs_ns_inst *nsi, const char *text,
 				struct sockaddr_in *peer, const unsigned char* data,
 				size_t data_len);
@@ -202,6 +212,10 @@ int gprs_ns_rcvmsg(struct gprs_ns_inst *nsi, struct msgb *msg,
 int gprs_ns_callback(enum gprs_ns_evt event, struct gprs_nsvc *nsvc,
 			 struct msgb *msg, uint16_t bvci)
 {
+	if (bench_mode) {
+		bench_rx++;
+		return 0;
+	}
 	printf("CALLBACK, event %d, msg length %td, bvci 0x%04x\n%s\n\n",
 			event, msgb_bssgp_len(msg), bvci,
 			osmo_hexdump(msgb_bssgph(msg), msgb_bssgp_len(msg)));
@@ -220,6 +234,14 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
 	if (!real_sendto)
 		real_sendto = dlsym(RTLD_NEXT, "sendto");
 
+	if (bench_mode) {
+		unsigned int port = ntohs(((struct sockaddr_in *)dest_addr)->sin_port);
+		if (port >= LS_BASE_PORT && port < LS_BASE_PORT + LS_NUM_NSVC)
+			bench_tx_port[port - LS_BASE_PORT]++;
+		bench_tx++;
+		return len;
+	}
+
 	sent_pdu_type = len > 0 ? ((uint8_t *)buf)[0] : -1;
 
 	if (dest_host == REMOTE_BSS_ADDR)
@@ -246,6 +268,9 @@ int gprs_ns_sendmsg(struct gprs_ns_inst *nsi, struct msgb *msg)
 	if (!real_gprs_ns_sendmsg)
 		real_gprs_ns_sendmsg = dlsym(RTLD_NEXT, "gprs_ns_sendmsg");
 
+	if (bench_mode)
+		return real_gprs_ns_sendmsg(nsi, msg);
+
 	if (nsei == SGSN_NSEI)
 		printf("NS UNITDATA MESSAGE to SGSN, BVCI 0x%04x, msg length %zu\n%s\n\n",
 		       bvci, len, osmo_hexdump(buf, len));
@@ -891,6 +916,136 @@ static void test_sgsn_output()
 	nsi = NULL;
 }
 
+#define LS_NSEI 0x3000
+#define LS_BVCI 0x1234
+
+/* send UL-UNITDATA for num_tlli MS and print how many each NS-VC of LS_NSEI carried */
+static void send_load_sharing(struct bssgp_bvc_ctx *bctx, struct gprs_nsvc **nsvc, unsigned int num_tlli)
+{
+	static const uint8_t qos_profile[3] = { 0x00, 0x00, 0x21 };
+	struct msgb *msg;
+	unsigned int i;
+
+	memset(bench_tx_port, 0, sizeof(bench_tx_port));
+	bench_mode = true;
+	for (i = 0; i < num_tlli; i++) {
+		msg = bssgp_msgb_alloc();
+		memset(msgb_put(msg, 20), 0x2b, 20);
+		bssgp_tx_ul_ud(bctx, 0xc0000000 + i * 0x1001, qos_profile, msg);
+	}
+	bench_mode = false;
+
+	for (i = 0; i < LS_NUM_NSVC; i++)
+		printf("    NS-VCI 0x%04x, %s, %u PDUs\n", nsvc[i]->nsvci, NS_DESC_B(nsvc[i]->state),
+		       bench_tx_port[i]);
+	printf("\n");
+}
+
+static void test_load_sharing()
+{
+	struct gprs_ns_inst *nsi = gprs_ns_instantiate(gprs_ns_callback, NULL);
+	struct sockaddr_in peer[LS_NUM_NSVC] = {{0},};
+	struct gprs_nsvc *nsvc[LS_NUM_NSVC];
+	struct bssgp_bvc_ctx *bctx;
+	unsigned int i;
+
+	printf("--- Load sharing among %u NS-VCs of one NSE ---\n\n", LS_NUM_NSVC);
+
+	bssgp_nsi = nsi;
+	bctx = btsctx_alloc(LS_BVCI, LS_NSEI);
+	OSMO_ASSERT(bctx);
+
+	bench_mode = true;
+	for (i = 0; i < LS_NUM_NSVC; i++) {
+		/* the first NS-VC gets three times the data weight of the others */
+		nsvc[i] = gprs_nsvc_create2(nsi, LS_NSEI + i, 1, i == 0 ? 3 : 1);
+		OSMO_ASSERT(nsvc[i]);
+		peer[i].sin_family = AF_INET;
+		peer[i].sin_port = htons(LS_BASE_PORT + i);
+		peer[i].sin_addr.s_addr = htonl(REMOTE_BSS_ADDR);
+		send_ns_reset(nsi, &peer[i], NS_CAUSE_OM_INTERVENTION, LS_NSEI + i, LS_NSEI);
+		send_ns_unblock(nsi, &peer[i]);
+		send_ns_alive_ack(nsi, &peer[i]);
+		OSMO_ASSERT(gprs_nsvc_by_nsvci(nsi, LS_NSEI + i) == nsvc[i]);
+	}
+	bench_mode = false;
+
+	printf("Data weight 3 on NS-VCI 0x%04x, 1 on the others:\n", nsvc[0]->nsvci);
+	send_load_sharing(bctx, nsvc, 1000);
+
+	printf("NS-VCI 0x%04x blocked:\n", nsvc[1]->nsvci);
+	bench_mode = true;
+	gprs_ns_tx_block(nsvc[1], NS_CAUSE_OM_INTERVENTION);
+	bench_mode = false;
+	send_load_sharing(bctx, nsvc, 1000);
+
+	printf("NS-VCI 0x%04x unblocked:\n", nsvc[1]->nsvci);
+	send_ns_unblock_ack(nsi, &peer[1]);
+	send_load_sharing(bctx, nsvc, 1000);
+
+	bssgp_nsi = NULL;
+	gprs_ns_destroy(nsi);
+	nsi = NULL;
+}
+
+#define BENCH_NUM_NSE 8
+#define BENCH_NUM_PDU 200000
+
+/* NSEIs of the benchmark, all in the same slot of the NS-VC lookup caches */
+#define BENCH_NSEI(i) (0x2000 + (i) * NS_LOOKUP_CACHE_SIZE)
+
+/* Pass NS-UNITDATA through gprs_ns_rcvmsg() and gprs_ns_sendmsg() for several
+ * NSEs, like a Gb proxy forwarding user data. The packet rate is printed to
+ * stderr, as it depends on the machine. */
+static void test_unitdata_throughput()
+{
+	struct gprs_ns_inst *nsi = gprs_ns_instantiate(gprs_ns_callback, NULL);
+	struct sockaddr_in peer[BENCH_NUM_NSE] = {{0},};
+	uint8_t pdu[NS_UNITDATA_HDR_LEN + 100] = { NS_PDUT_UNITDATA, 0x00, 0x12, 0x34 };
+	struct timespec start, end;
+	struct msgb *msg;
+	unsigned int i;
+	double elapsed;
+
+	printf("--- Measure NS-UNITDATA throughput ---\n\n");
+
+	for (i = 0; i < BENCH_NUM_NSE; i++) {
+		peer[i].sin_family = AF_INET;
+		peer[i].sin_port = htons(1000 + i);
+		peer[i].sin_addr.s_addr = htonl(REMOTE_BSS_ADDR);
+		send_ns_reset(nsi, &peer[i], NS_CAUSE_OM_INTERVENTION, 0x2000 + i, BENCH_NSEI(i));
+		send_ns_unblock(nsi, &peer[i]);
+		send_ns_alive_ack(nsi, &peer[i]);
+	}
+
+	bench_mode = true;
+	bench_rx = bench_tx = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCH_NUM_PDU; i++) {
+		unsigned int nse = i % BENCH_NUM_NSE;
+
+		msg = gprs_ns_msgb_alloc();
+		msg->l2h = msgb_put(msg, sizeof(pdu));
+		memcpy(msg->l2h, pdu, sizeof(pdu));
+		gprs_ns_rcvmsg(nsi, msg, &peer[nse], GPRS_NS_LL_UDP);
+
+		/* forward the BSSGP payload to the next NSE */
+		msgb_pull(msg, NS_UNITDATA_HDR_LEN);
+		msgb_nsei(msg) = BENCH_NSEI((nse + 1) % BENCH_NUM_NSE);
+		msgb_bvci(msg) = 0x1234;
+		gprs_ns_sendmsg(nsi, msg);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	bench_mode = false;
+
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("received %u, sent %u NS-UNITDATA\n\n", bench_rx, bench_tx);
+	fprintf(stderr, "NS-UNITDATA: %u PDUs rx+tx in %.3fs, %.0f PDUs/s\n",
+		BENCH_NUM_PDU, elapsed, BENCH_NUM_PDU / elapsed);
+
+	gprs_ns_destroy(nsi);
+	nsi = NULL;
+}
 
 int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
 {
@@ -920,6 +1075,8 @@ int main(int argc, char **argv)
 	test_sgsn_reset();
 	test_sgsn_reset_invalid_state();
 	test_sgsn_output();
+	test_load_sharing();
+	test_unitdata_throughput();
 	printf("===== NS protocol test END\n\n");
 
 	exit(EXIT_SUCCESS);
@@ -549,6 +549,65 @@ static void test_mid_encode_decode(void)
 	}
 }
 
+static const char *test_mid_packed_imsis[] = {
+	"123456",
+	"1234567",
+	"90170000000462",
+	"901700000004620",
+	"001010000000001",
+};
+
+static const char *test_mid_packed_invalid_hex[] = {
+	"1132547698",		/* IMSI, even number of digits, filler nibble is not 0xf */
+	"29325476a810",		/* IMSI digit > 9 */
+	"193254",		/* IMSI with too few digits */
+	"19325476981032547698",	/* IMSI with too many digits */
+	"f51234abcd",		/* TMSI with wrong length */
+	"e41234abcd",		/* TMSI without filler */
+	"4a325476981032f5",	/* IMEI */
+};
+
+static void test_mid_packed(void)
+{
+	struct osmo_mi_packed packed, decoded;
+	uint8_t buf[GSM48_MID_MAX_SIZE], ref[GSM48_MID_MAX_SIZE], mi[16];
+	int i, len, ref_len, rc;
+
+	printf("\nTesting packed Mobile Identities\n");
+
+	for (i = 0; i < ARRAY_SIZE(test_mid_packed_imsis); i++) {
+		const char *imsi = test_mid_packed_imsis[i];
+		OSMO_ASSERT(osmo_mi_packed_from_imsi_str(&packed, imsi) == 0);
+		len = gsm48_generate_mid_from_packed(buf, &packed);
+		ref_len = gsm48_generate_mid_from_imsi(ref, imsi);
+		printf("- IMSI %s -> MI-TLV-hex='%s'\n", imsi, osmo_hexdump_nospc(buf, len));
+		if (len != ref_len || memcmp(buf, ref, len))
+			printf("  ERROR: expected '%s'\n", osmo_hexdump_nospc(ref, ref_len));
+		rc = osmo_mi_packed_from_mi(&decoded, buf + 2, len - 2);
+		if (rc || osmo_mi_packed_cmp(&packed, &decoded))
+			printf("  ERROR: decoding back gives rc=%d %s\n", rc, osmo_mi_packed_name(&decoded));
+	}
+
+	osmo_mi_packed_set_tmsi(&packed, 0xaabbccdd);
+	len = gsm48_generate_mid_from_packed(buf, &packed);
+	ref_len = gsm48_generate_mid_from_tmsi(ref, 0xaabbccdd);
+	printf("- TMSI 0xaabbccdd -> MI-TLV-hex='%s'\n", osmo_hexdump_nospc(buf, len));
+	if (len != ref_len || memcmp(buf, ref, len))
+		printf("  ERROR: expected '%s'\n", osmo_hexdump_nospc(ref, ref_len));
+	rc = osmo_mi_packed_from_mi(&decoded, buf + 2, len - 2);
+	if (rc || osmo_mi_packed_cmp(&packed, &decoded))
+		printf("  ERROR: decoding back gives rc=%d %s\n", rc, osmo_mi_packed_name(&decoded));
+
+	packed.val = 0;
+	printf("- none -> len=%u\n", gsm48_generate_mid_from_packed(buf, &packed));
+
+	for (i = 0; i < ARRAY_SIZE(test_mid_packed_invalid_hex); i++) {
+		len = osmo_hexparse(test_mid_packed_invalid_hex[i], mi, sizeof(mi));
+		rc = osmo_mi_packed_from_mi(&decoded, mi, len);
+		printf("- MI-hex='%s' -> rc=%d\n", test_mid_packed_invalid_hex[i], rc);
+	}
+}
+
 static const uint8_t test_mid_decode_zero_length_types[] = { GSM_MI_TYPE_IMSI, GSM_MI_TYPE_TMSI, GSM_MI_TYPE_NONE };
 
 static void test_mid_decode_zero_length(void)
@@ -1139,6 +1198,7 @@ int main(int argc, char **argv)
 	test_mid_from_imsi();
 	test_mid_encode_decode();
 	test_mid_decode_zero_length();
+	test_mid_packed();
 	test_bcd_number_encode_decode();
 	test_ra_cap();
 	test_lai_encode_decode();
@@ -968,13 +968,8 @@ static void test_gsm0808_enc_dec_empty_speech_codec_list()
 
 static void test_gsm0808_enc_dec_channel_type()
 {
-	struct gsm0808_channel_type enc_ct = {
-		.ch_indctr = GSM0808_CHAN_SPEECH,
-		.ch_rate_type = GSM0808_SPEECH_HALF_PREF,
-		.perm_spch = { GSM0808_PERM_FR3, GSM0808_PERM_HR3 },
-		.perm_spch_len = 2,
-	};
-	struct gsm0808_channel_type dec_ct = {};
+	struct gsm0808_channel_type enc_ct;
+	struct gsm0808_channel_type dec_ct;
 	struct msgb *msg;
 	uint8_t ct_enc_expected[] = { GSM0808_IE_CHANNEL_TYPE,
 		0x04, 0x01, 0x0b, 0xa1, 0x25
@@ -982,6 +977,15 @@ static void test_gsm0808_enc_dec_channel_type()
 	uint8_t rc_enc;
 	int rc_dec;
 
+	/* the structs get compared with memcmp(), so also clear the padding */
+	memset(&enc_ct, 0, sizeof(enc_ct));
+	memset(&dec_ct, 0, sizeof(dec_ct));
+	enc_ct.ch_indctr = GSM0808_CHAN_SPEECH;
+	enc_ct.ch_rate_type = GSM0808_SPEECH_HALF_PREF;
+	enc_ct.perm_spch[0] = GSM0808_PERM_FR3;
+	enc_ct.perm_spch[1] = GSM0808_PERM_HR3;
+	enc_ct.perm_spch_len = 2;
+
 	msg = msgb_alloc(1024, "output buffer");
 	rc_enc = gsm0808_enc_channel_type(msg, &enc_ct);
 	OSMO_ASSERT(rc_enc == 6);
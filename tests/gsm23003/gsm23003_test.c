@@ -75,6 +75,54 @@ bool test_valid_imsi()
 	return pass;
 }
 
+bool test_mi_packed()
+{
+	int i;
+	bool pass = true;
+	struct osmo_mi_packed tmsi;
+	printf("----- %s\n", __func__);
+
+	for (i = 0; i < ARRAY_SIZE(test_imsis); i++) {
+		struct osmo_mi_packed mi = {};
+		char str[OSMO_IMSI_BUF_SIZE];
+		int rc = osmo_mi_packed_from_imsi_str(&mi, test_imsis[i].imsi);
+		bool ok = (rc == 0);
+
+		pass = pass && (ok == test_imsis[i].expect_ok);
+		if (!ok) {
+			printf("%2d: expect=%s result=%s rc=%d\n", i, BOOL_STR(test_imsis[i].expect_ok), BOOL_STR(ok), rc);
+			continue;
+		}
+		rc = osmo_mi_packed_to_imsi_str(str, sizeof(str), &mi);
+		printf("%2d: expect=%s result=%s val=0x%016llx %s\n", i, BOOL_STR(test_imsis[i].expect_ok),
+		       BOOL_STR(ok), (unsigned long long)mi.val, osmo_mi_packed_name(&mi));
+		pass = pass && (rc == strlen(test_imsis[i].imsi)) && !strcmp(str, test_imsis[i].imsi);
+	}
+
+	osmo_mi_packed_set_tmsi(&tmsi, 0x1234abcd);
+	printf("TMSI: val=0x%016llx %s\n", (unsigned long long)tmsi.val, osmo_mi_packed_name(&tmsi));
+	pass = pass && osmo_mi_packed_is_tmsi(&tmsi) && !osmo_mi_packed_is_imsi(&tmsi);
+	pass = pass && osmo_mi_packed_tmsi(&tmsi) == 0x1234abcd;
+
+	/* Leading zeros are significant: equal numeric value, different IMSIs */
+	{
+		struct osmo_mi_packed a, b, c;
+		char trunc[4];
+		osmo_mi_packed_from_imsi_str(&a, "001010000000001");
+		osmo_mi_packed_from_imsi_str(&b, "01010000000001");
+		osmo_mi_packed_from_imsi_str(&c, "001010000000001");
+		printf("cmp(a, b)=%d cmp(b, a)=%d cmp(a, c)=%d hash(a)==hash(c): %s\n",
+		       osmo_mi_packed_cmp(&a, &b), osmo_mi_packed_cmp(&b, &a), osmo_mi_packed_cmp(&a, &c),
+		       BOOL_STR(osmo_mi_packed_hash(&a) == osmo_mi_packed_hash(&c)));
+		pass = pass && osmo_mi_packed_cmp(&a, &b) > 0 && osmo_mi_packed_cmp(&a, &c) == 0;
+		pass = pass && osmo_mi_packed_cmp(&tmsi, &b) < 0;
+
+		printf("truncated: rc=%d str='%s'\n", osmo_mi_packed_to_imsi_str(trunc, sizeof(trunc), &a), trunc);
+		printf("TMSI as IMSI: rc=%d str='%s'\n", osmo_mi_packed_to_imsi_str(trunc, sizeof(trunc), &tmsi), trunc);
+	}
+	return pass;
+}
+
 static struct {
 	const char *msisdn;
 	bool expect_ok;
@@ -288,6 +336,7 @@ int main(int argc, char **argv)
 	bool pass = true;
 
 	pass = pass && test_valid_imsi();
+	pass = pass && test_mi_packed();
 	pass = pass && test_valid_msisdn();
 	pass = pass && test_valid_imei();
 	pass = pass && test_mnc_from_str();
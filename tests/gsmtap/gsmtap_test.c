@@ -0,0 +1,299 @@
+/* tests for the GSMTAP capture mode */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bits.h>
+#include <osmocom/core/byteswap.h>
+
+#define PCAP_PATH "gsmtap_test.pcap"
+
+static const struct log_info log_info = {};
+
+static int sink_fd;
+
+static uint16_t sink_open(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+
+	sink_fd = osmo_sock_init(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "127.0.0.1", 0,
+				 OSMO_SOCK_F_BIND | OSMO_SOCK_F_NONBLOCK);
+	OSMO_ASSERT(sink_fd >= 0);
+	OSMO_ASSERT(getsockname(sink_fd, (struct sockaddr *) &sin, &len) == 0);
+	return ntohs(sin.sin_port);
+}
+
+static void sink_read(void)
+{
+	struct gsmtap_hdr *gh;
+	uint8_t buf[512];
+	int rc;
+
+	while ((rc = recv(sink_fd, buf, sizeof(buf), 0)) > 0) {
+		gh = (struct gsmtap_hdr *) buf;
+		printf(" received fn=%u len=%d\n", ntohl(gh->frame_number), rc);
+	}
+}
+
+static void print_ctrs(struct gsmtap_inst *gti)
+{
+	printf(" tx:sent=%"PRIu64" tx:dropped=%"PRIu64" pcap:written=%"PRIu64" pcap:rotated=%"PRIu64"\n",
+	       gti->ctrg->ctr[GSMTAP_CTR_TX_SENT].current,
+	       gti->ctrg->ctr[GSMTAP_CTR_TX_DROPPED].current,
+	       gti->ctrg->ctr[GSMTAP_CTR_PCAP_WRITTEN].current,
+	       gti->ctrg->ctr[GSMTAP_CTR_PCAP_ROTATED].current);
+}
+
+static void send_frames(struct gsmtap_inst *gti, uint32_t fn, unsigned int num)
+{
+	uint8_t data[23] = { 0 };
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < num; i++) {
+		rc = gsmtap_send(gti, 1, 0, GSMTAP_CHANNEL_BCCH, 0, fn + i, -60, 10, data, sizeof(data));
+		if (rc < 0)
+			printf(" fn=%u: rc=%d\n", fn + i, rc);
+	}
+}
+
+static void test_capture_ring(struct gsmtap_inst *gti)
+{
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(gsmtap_capture_enable(gti, 6, 256) == -EINVAL);
+	OSMO_ASSERT(gsmtap_capture_enable(gti, 8, 256) == 0);
+	OSMO_ASSERT(gsmtap_capture_enable(gti, 8, 256) == -EINVAL);
+
+	send_frames(gti, 100, 10);
+	printf(" flushed %d\n", gsmtap_capture_flush(gti));
+	sink_read();
+	print_ctrs(gti);
+
+	/* the select loop flushes automatically */
+	send_frames(gti, 200, 3);
+	OSMO_ASSERT(gti->wq.bfd.when & OSMO_FD_WRITE);
+	osmo_select_main(1);
+	OSMO_ASSERT(!(gti->wq.bfd.when & OSMO_FD_WRITE));
+	sink_read();
+	print_ctrs(gti);
+}
+
+static void test_wqueue_mode(struct gsmtap_inst *gti, uint16_t port)
+{
+	struct gsmtap_inst *wq_gti;
+
+	printf("%s\n", __func__);
+
+	/* batching is opt-in, and only for instances in wait queue mode */
+	OSMO_ASSERT(gsmtap_inst_set_wqueue_mode(gti, OSMO_WQUEUE_MODE_SENDMMSG) == -EINVAL);
+
+	wq_gti = gsmtap_source_init("127.0.0.1", port, 1);
+	OSMO_ASSERT(wq_gti);
+	OSMO_ASSERT(wq_gti->wq.mode == OSMO_WQUEUE_MODE_CB);
+	OSMO_ASSERT(gsmtap_inst_set_wqueue_mode(wq_gti, OSMO_WQUEUE_MODE_SENDMMSG) == 0);
+	OSMO_ASSERT(wq_gti->wq.mode == OSMO_WQUEUE_MODE_SENDMMSG);
+
+	send_frames(wq_gti, 500, 2);
+	osmo_select_main(1);
+	sink_read();
+}
+
+static void print_file(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) == 0) {
+		printf(" %s: %lld bytes\n", path, (long long) st.st_size);
+		unlink(path);
+	} else
+		printf(" %s: missing\n", path);
+}
+
+static void test_capture_pcap(struct gsmtap_inst *gti)
+{
+	printf("%s\n", __func__);
+
+	/* 24 bytes file header, 16 + 28 + 16 + 23 bytes per message */
+	OSMO_ASSERT(gsmtap_capture_set_pcap(gti, PCAP_PATH, 24 + 2 * 83, 3) == 0);
+	send_frames(gti, 300, 7);
+	printf(" written %d\n", gsmtap_capture_flush(gti));
+	sink_read();
+	print_ctrs(gti);
+
+	gsmtap_capture_disable(gti);
+	print_file(PCAP_PATH);
+	print_file(PCAP_PATH ".1");
+	print_file(PCAP_PATH ".2");
+	print_file(PCAP_PATH ".3");
+
+	/* back to one message per write() */
+	send_frames(gti, 400, 1);
+	sink_read();
+	print_ctrs(gti);
+}
+
+static void test_filter_parse(void)
+{
+	static const char *specs[] = {
+		"",
+		"all",
+		"type=1",
+		"chan=BCCH,CCCH,SDCCH/4 arfcn=871 ts=0",
+		"ts=0-3,7 ss=1,2,3,5 arfcn=10-20",
+		"  rate=100   sample=10 type=0x01-3 ",
+		"chan=5,SACCH/8",
+		"type=256",
+		"ts=8",
+		"arfcn=20-10",
+		"foo=1",
+		"ts",
+		"ts=1-",
+		"sample=x",
+	};
+	struct gsmtap_filter flt;
+	char buf[256];
+	unsigned int i;
+	int rc;
+
+	printf("%s\n", __func__);
+
+	for (i = 0; i < ARRAY_SIZE(specs); i++) {
+		rc = gsmtap_filter_parse(&flt, specs[i]);
+		if (rc < 0) {
+			printf(" '%s' -> rc=%d\n", specs[i], rc);
+			continue;
+		}
+		gsmtap_filter_to_str_buf(buf, sizeof(buf), &flt);
+		printf(" '%s' -> '%s'\n", specs[i], buf);
+	}
+}
+
+static void test_filter_send(struct gsmtap_inst *gti)
+{
+	struct gsmtap_filter flt;
+	uint8_t data[23] = { 0 };
+	unsigned int ts;
+
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(gsmtap_filter_parse(&flt, "chan=BCCH ts=0,2") == 0);
+	OSMO_ASSERT(gsmtap_inst_set_filter(gti, &flt) == 0);
+	for (ts = 0; ts < 8; ts++) {
+		OSMO_ASSERT(gsmtap_send(gti, 1, ts, GSMTAP_CHANNEL_BCCH, 0, 500 + ts, -60, 10,
+					data, sizeof(data)) == 0);
+		OSMO_ASSERT(gsmtap_send(gti, 1, ts, GSMTAP_CHANNEL_SDCCH4, 0, 600 + ts, -60, 10,
+					data, sizeof(data)) == 0);
+	}
+	sink_read();
+
+	/* 1 in 4, at most 3 per second */
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	OSMO_ASSERT(gsmtap_filter_parse(&flt, "sample=4 rate=3") == 0);
+	OSMO_ASSERT(gsmtap_inst_set_filter(gti, &flt) == 0);
+	send_frames(gti, 700, 20);
+	sink_read();
+	osmo_clock_override_add(CLOCK_MONOTONIC, 1, 0);
+	send_frames(gti, 720, 4);
+	sink_read();
+	osmo_clock_override_enable(CLOCK_MONOTONIC, false);
+	printf(" tx:filtered=%"PRIu64" tx:rate_limited=%"PRIu64"\n",
+	       gti->ctrg->ctr[GSMTAP_CTR_TX_FILTERED].current,
+	       gti->ctrg->ctr[GSMTAP_CTR_TX_RATE_LIMITED].current);
+
+	OSMO_ASSERT(gsmtap_inst_set_filter(gti, NULL) == 0);
+	send_frames(gti, 800, 1);
+	sink_read();
+}
+
+static void test_log_batch(uint16_t port)
+{
+	struct log_target *tgt;
+	uint8_t buf[1024];
+	unsigned int i, off, reclen;
+	int rc;
+
+	printf("%s\n", __func__);
+
+	tgt = log_target_create_gsmtap("127.0.0.1", port, "gsmtap_test", false, false);
+	OSMO_ASSERT(tgt);
+	log_set_all_filter(tgt, 1);
+	log_set_log_level(tgt, LOGL_DEBUG);
+	log_add_target(tgt);
+
+	OSMO_ASSERT(log_target_gsmtap_set_batch(tgt, 20, 0) == -EINVAL);
+	OSMO_ASSERT(log_target_gsmtap_set_batch(tgt, 300, 0) == 0);
+
+	for (i = 0; i < 5; i++)
+		LOGP(DLGLOBAL, LOGL_NOTICE, "log record %u\n", i);
+	/* the last record is sent from the flush timer */
+	osmo_select_main(1);
+
+	while ((rc = recv(sink_fd, buf, sizeof(buf), 0)) > 0) {
+		struct gsmtap_hdr *gh = (struct gsmtap_hdr *) buf;
+		printf(" datagram type=0x%02x sub_type=%u len=%d:", gh->type, gh->sub_type, rc);
+		for (off = sizeof(*gh); off + 2 <= rc; off += 2 + reclen) {
+			struct gsmtap_osmocore_log_hdr *golh;
+			reclen = osmo_load16be(buf + off);
+			golh = (struct gsmtap_osmocore_log_hdr *) (buf + off + 2);
+			printf(" [%s %s:%u '%s']", golh->subsys, golh->src_file.name,
+			       osmo_ntohl(golh->src_file.line_nr) > 0,
+			       osmo_escape_str((char *) (golh + 1), reclen - sizeof(*golh)));
+		}
+		printf("\n");
+	}
+
+	log_target_destroy(tgt);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsmtap_inst *gti;
+	uint16_t port;
+
+	log_init(&log_info, NULL);
+
+	port = sink_open();
+	gti = gsmtap_source_init("127.0.0.1", port, 0);
+	OSMO_ASSERT(gti);
+
+	test_capture_ring(gti);
+	test_wqueue_mode(gti, port);
+	test_capture_pcap(gti);
+	test_filter_parse();
+	test_filter_send(gti);
+	test_log_batch(port);
+
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,222 @@
+/* tests for event loop statistics */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/loop_stats_internal.h>
+
+/* each call-back pretends to take this many microseconds */
+static unsigned int fd_cb_us = 300;
+static unsigned int timer_cb_us = 1200;
+
+static int fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	char c;
+
+	OSMO_ASSERT(read(ofd->fd, &c, 1) == 1);
+	osmo_clock_override_add(CLOCK_MONOTONIC, 0, fd_cb_us * 1000);
+	return 0;
+}
+
+/* reads and closes its osmo_fd, like on a connection loss */
+static int fd_close_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	fd_cb(ofd, what);
+	osmo_fd_close(ofd);
+	return 0;
+}
+
+static void timer_cb(void *data)
+{
+	osmo_clock_override_add(CLOCK_MONOTONIC, 0, timer_cb_us * 1000);
+}
+
+/* print the statistics of all call-backs of the type given in data */
+static int print_cb(const struct osmo_loop_cb_stats *cbs, void *data)
+{
+	if (cbs->type != *(enum osmo_loop_cb_type *)data)
+		return 0;
+	printf(" %s fd=%d count=%"PRIu64" sampled=%"PRIu64" total=%"PRIu64"us max=%"PRIu64"us\n",
+	       cbs->type == OSMO_LOOP_CB_FD ? "fd" : "timer", cbs->fd, cbs->count, cbs->sampled,
+	       cbs->total_ns / 1000, cbs->max_ns / 1000);
+	return 0;
+}
+
+static void print_cbs(void)
+{
+	enum osmo_loop_cb_type type;
+
+	/* the table is in no particular order */
+	type = OSMO_LOOP_CB_FD;
+	osmo_loop_stats_for_each_cb(print_cb, &type);
+	type = OSMO_LOOP_CB_TIMER;
+	osmo_loop_stats_for_each_cb(print_cb, &type);
+}
+
+static int count_cb(const struct osmo_loop_cb_stats *cbs, void *data)
+{
+	(*(unsigned int *)data)++;
+	return 0;
+}
+
+static void test_select_loop(void)
+{
+	struct osmo_timer_list timer;
+	struct osmo_fd ofd;
+	const struct osmo_loop_stats *ls = osmo_loop_stats_get();
+	int pfd[2];
+	int i;
+
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(pipe(pfd) == 0);
+	osmo_fd_setup(&ofd, pfd[0], OSMO_FD_READ, fd_cb, NULL, 0);
+	OSMO_ASSERT(osmo_fd_register(&ofd) == 0);
+	osmo_timer_setup(&timer, timer_cb, NULL);
+
+	OSMO_ASSERT(osmo_loop_stats_enable(2) == 0);
+
+	for (i = 0; i < 4; i++) {
+		OSMO_ASSERT(write(pfd[1], "x", 1) == 1);
+		osmo_timer_schedule(&timer, 0, 0);
+		osmo_select_main(1);
+	}
+
+	printf("iterations=%"PRIu64" busy=%"PRIu64"us dropped=%"PRIu64"\n",
+	       ls->iterations, ls->busy_ns / 1000, ls->dropped);
+	print_cbs();
+
+	/* statistics of an osmo_fd go away with it */
+	osmo_fd_close(&ofd);
+	close(pfd[1]);
+	printf("after close:\n");
+	print_cbs();
+
+	/* disabled statistics cost nothing and collect nothing */
+	osmo_loop_stats_disable();
+	osmo_timer_schedule(&timer, 0, 0);
+	osmo_select_main(1);
+	printf("disabled: iterations=%"PRIu64"\n", ls->iterations);
+	print_cbs();
+
+	osmo_loop_stats_reset();
+}
+
+/* a sample rate set without osmo_loop_stats_enable() has no stat items to
+ * record in, but still collects the statistics */
+static void test_without_stat_items(void)
+{
+	const struct osmo_loop_stats *ls = osmo_loop_stats_get();
+	struct osmo_timer_list timer;
+
+	printf("%s\n", __func__);
+
+	osmo_timer_setup(&timer, timer_cb, NULL);
+	osmo_loop_stats_sample_rate = 1;
+	osmo_timer_schedule(&timer, 0, 0);
+	osmo_select_main(1);
+	printf("iterations=%"PRIu64"\n", ls->iterations);
+	print_cbs();
+
+	osmo_loop_stats_disable();
+	osmo_loop_stats_reset();
+}
+
+/* an osmo_fd unregistered by its own call-back leaves no statistics behind */
+static void test_unregister_in_cb(void)
+{
+	struct osmo_fd ofd;
+	int pfd[2];
+	unsigned int num = 0;
+
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(pipe(pfd) == 0);
+	osmo_fd_setup(&ofd, pfd[0], OSMO_FD_READ, fd_close_cb, NULL, 0);
+	OSMO_ASSERT(osmo_fd_register(&ofd) == 0);
+
+	OSMO_ASSERT(osmo_loop_stats_enable(1) == 0);
+	OSMO_ASSERT(write(pfd[1], "x", 1) == 1);
+	osmo_select_main(1);
+	close(pfd[1]);
+
+	osmo_loop_stats_for_each_cb(count_cb, &num);
+	printf("entries=%u\n", num);
+
+	osmo_loop_stats_disable();
+	osmo_loop_stats_reset();
+}
+
+/* removing entries from the open addressing table must not lose others */
+static void test_table(void)
+{
+	static struct osmo_fd fds[600];
+	unsigned int i, num;
+
+	printf("%s\n", __func__);
+
+	osmo_loop_stats_enable(1);
+	for (i = 0; i < ARRAY_SIZE(fds); i++)
+		osmo_loop_stats_cb_begin(OSMO_LOOP_CB_FD, &fds[i], fd_cb, i);
+	for (i = 0; i < ARRAY_SIZE(fds); i += 3)
+		osmo_loop_stats_fd_unregister(&fds[i]);
+	for (i = 0; i < ARRAY_SIZE(fds); i++)
+		osmo_loop_stats_cb_begin(OSMO_LOOP_CB_FD, &fds[i], fd_cb, i);
+
+	num = 0;
+	osmo_loop_stats_for_each_cb(count_cb, &num);
+	printf("entries=%u dropped=%"PRIu64"\n", num, osmo_loop_stats_get()->dropped);
+
+	num = 0;
+	for (i = 0; i < ARRAY_SIZE(fds); i++)
+		osmo_loop_stats_fd_unregister(&fds[i]);
+	osmo_loop_stats_for_each_cb(count_cb, &num);
+	printf("entries after unregister=%u\n", num);
+
+	osmo_loop_stats_disable();
+	osmo_loop_stats_reset();
+}
+
+static const struct log_info log_info = {};
+
+int main(int argc, char **argv)
+{
+	log_init(&log_info, NULL);
+
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	osmo_clock_override_add(CLOCK_MONOTONIC, 1000, 0);
+
+	test_without_stat_items();
+	test_select_loop();
+	test_unregister_in_cb();
+	test_table();
+
+	printf("Done\n");
+	return 0;
+}
@@ -23,12 +23,15 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/msgb_compact.h>
 #include <setjmp.h>
 
 #include <errno.h>
 
 #include <string.h>
 
+#include "bench.h"
+
 #define CHECK_RC(rc)	\
 	if (rc != 0) {	\
 		printf("Operation failed rc=%d on %s:%d\n", rc, __FILE__, __LINE__); \
@@ -381,6 +384,144 @@ static void test_msgb_printf()
 	msgb_free(msg_ref);
 }
 
+static void test_msgbc_api()
+{
+	struct msgb_compact *m = msgbc_alloc_headroom_c(NULL, 256, 32, 2);
+	unsigned char *cptr;
+	int rc;
+
+	printf("Testing the compact msgb API\n");
+
+	OSMO_ASSERT(msgbc_cb(m) && !msgbc_cb(m)[0] && !msgbc_cb(m)[1]);
+	OSMO_ASSERT(!msgbc_l1(m) && !msgbc_l2(m) && !msgbc_l3(m) && !msgbc_l4(m));
+	printf("headroom=%d tailroom=%d\n", msgbc_headroom(m), msgbc_tailroom(m));
+
+	cptr = msgbc_put(m, 4);
+	memset(cptr, 0, 4);
+	msgbc_set_l2(m, cptr);
+	msgbc_put_u32(m, 0x01020304);
+	msgbc_set_l3(m, msgbc_tail(m));
+	msgbc_put_u16(m, 0x0506);
+	msgbc_put_u8(m, 0x07);
+	msgbc_push_u8(m, 0xff);
+	msgbc_set_l1(m, msgbc_data(m));
+	printf("Buffer: %s\n", osmo_hexdump(msgbc_data(m), msgbc_length(m)));
+	printf("l1len=%u l2len=%u l3len=%u headroom=%d tailroom=%d\n", msgbc_l1len(m), msgbc_l2len(m),
+	       msgbc_l3len(m), msgbc_headroom(m), msgbc_tailroom(m));
+	OSMO_ASSERT(msgbc_l2(m) == cptr);
+	OSMO_ASSERT(msgbc_l3len(m) == 3);
+
+	OSMO_ASSERT(msgbc_pull_u8(m) == 0xff);
+	rc = msgbc_trim(m, 8);
+	CHECK_RC(rc);
+	OSMO_ASSERT(msgbc_pull_u32(m) == 0);
+	OSMO_ASSERT(msgbc_pull_u32(m) == 0x01020304);
+	printf("after pull: length=%u\n", msgbc_length(m));
+	OSMO_ASSERT(msgbc_trim(m, 256) < 0);
+
+	msgbc_set_l4(m, NULL);
+	OSMO_ASSERT(!msgbc_l4(m));
+	msgbc_reset(m);
+	OSMO_ASSERT(!msgbc_length(m) && !msgbc_headroom(m) && !msgbc_l2(m));
+	msgbc_free(m);
+
+	m = msgbc_alloc_c(NULL, 16, 0);
+	OSMO_ASSERT(!msgbc_cb(m));
+	OSMO_ASSERT(msgbc_head(m) == (unsigned char *)(m + 1));
+	msgbc_free(m);
+}
+
+static void test_msgbc_convert()
+{
+	struct msgb *msg = msgb_alloc_headroom(128, 32, "data");
+	struct msgb *msg2;
+	struct msgb_compact *m;
+	int i;
+
+	printf("Testing msgb <-> compact msgb conversion\n");
+
+	msg->l2h = msgb_put(msg, 8);
+	msg->l3h = msgb_put(msg, 8);
+	for (i = 0; i < msgb_length(msg); i++)
+		msg->data[i] = (uint8_t)i;
+	msg->cb[0] = 0x1234;
+	msg->cb[4] = 0x5678;
+
+	m = msgbc_from_msgb_c(NULL, msg, 1);
+	OSMO_ASSERT(msgbc_length(m) == msgb_length(msg));
+	OSMO_ASSERT(msgbc_headroom(m) == msgb_headroom(msg));
+	OSMO_ASSERT(msgbc_tailroom(m) == msgb_tailroom(msg));
+	OSMO_ASSERT(!msgbc_l1(m) && !msgbc_l4(m));
+	OSMO_ASSERT(msgbc_l2len(m) == msgb_l2len(msg));
+	OSMO_ASSERT(msgbc_l3len(m) == msgb_l3len(msg));
+	OSMO_ASSERT(msgbc_cb(m)[0] == 0x1234);
+	OSMO_ASSERT(!memcmp(msgbc_data(m), msgb_data(msg), msgb_length(msg)));
+
+	msg2 = msgb_from_msgbc_c(NULL, m, "back");
+	OSMO_ASSERT(msgb_eq(msg, msg2));
+	OSMO_ASSERT(msgb_test_invariant(msg2));
+	OSMO_ASSERT(!msg2->l1h && !msg2->l4h);
+	OSMO_ASSERT(msgb_l2len(msg2) == msgb_l2len(msg) && msgb_l3len(msg2) == msgb_l3len(msg));
+	OSMO_ASSERT(msg2->cb[0] == 0x1234 && msg2->cb[4] == 0);
+	printf("Dst: %s\n", msgb_hexdump(msg2));
+
+	msgb_free(msg);
+	msgb_free(msg2);
+	msgbc_free(m);
+}
+
+/* Typical signalling message: 64 octets including 16 octets headroom, an L3 header and a few octets of payload */
+static void test_msgbc_footprint(bool verbose)
+{
+	const int num = 1000, iter = 1000000;
+	void *ctx = talloc_named_const(NULL, 0, "footprint");
+	void *ctx_c = talloc_named_const(NULL, 0, "footprint_c");
+	size_t total, total_c;
+	double t0, t1, t2;
+	int i;
+
+	printf("Testing compact msgb footprint\n");
+
+	for (i = 0; i < num; i++)
+		msgb_alloc_headroom_c(ctx, 64, 16, "sig");
+	for (i = 0; i < num; i++)
+		msgbc_alloc_headroom_c(ctx_c, 64, 16, 0);
+	total = talloc_total_size(ctx);
+	total_c = talloc_total_size(ctx_c);
+	printf("compact msgb uses less memory: %s\n", total_c < total ? "yes" : "no");
+	talloc_free(ctx);
+	talloc_free(ctx_c);
+
+	t0 = bench_now();
+	for (i = 0; i < iter; i++) {
+		struct msgb *msg = msgb_alloc_headroom(64, 16, "sig");
+		msg->l3h = msgb_put(msg, 4);
+		msgb_put_u32(msg, i);
+		msgb_push_u8(msg, 0x05);
+		OSMO_ASSERT(msgb_l3len(msg) == 8);
+		msgb_free(msg);
+	}
+	t1 = bench_now();
+	for (i = 0; i < iter; i++) {
+		struct msgb_compact *m = msgbc_alloc_headroom(64, 16, 0);
+		msgbc_set_l3(m, msgbc_put(m, 4));
+		msgbc_put_u32(m, i);
+		msgbc_push_u8(m, 0x05);
+		OSMO_ASSERT(msgbc_l3len(m) == 8);
+		msgbc_free(m);
+	}
+	t2 = bench_now();
+
+	if (verbose) {
+		fprintf(stderr, "header: msgb %zu bytes, compact %zu bytes\n",
+			sizeof(struct msgb), sizeof(struct msgb_compact));
+		fprintf(stderr, "%d messages of 64 octets: msgb %zu bytes, compact %zu bytes (excl. talloc chunk headers)\n",
+			num, total, total_c);
+		fprintf(stderr, "alloc+put+push+free: msgb %.0f msgs/s, compact %.0f msgs/s\n",
+			iter / (t1 - t0), iter / (t2 - t1));
+	}
+}
+
 static struct log_info info = {};
 
 int main(int argc, char **argv)
@@ -394,6 +535,9 @@ int main(int argc, char **argv)
 	test_msgb_copy();
 	test_msgb_resize_area();
 	test_msgb_printf();
+	test_msgbc_api();
+	test_msgbc_convert();
+	test_msgbc_footprint(bench_requested(argc, argv));
 
 	printf("Success.\n");
 
@@ -0,0 +1,243 @@
+/* tests for lazy and sharded rate counters */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/rate_ctr.h>
+
+enum test_ctr {
+	TEST_A_CTR,
+	TEST_B_CTR,
+};
+
+static const struct rate_ctr_desc ctr_description[] = {
+	[TEST_A_CTR] = { "ctr:a", "The A counter value"},
+	[TEST_B_CTR] = { "ctr:b", "The B counter value"},
+};
+
+static const struct rate_ctr_group_desc ctrg_desc = {
+	.group_name_prefix = "ctr-test:lazy",
+	.group_description = "Lazy counter test",
+	.num_ctr = ARRAY_SIZE(ctr_description),
+	.ctr_desc = ctr_description,
+};
+
+static void *ctx;
+
+/* let the one-second rate_ctr timer fire \a secs times */
+static void run_secs(unsigned int secs)
+{
+	while (secs--) {
+		osmo_gettimeofday_override_add(1, 0);
+		osmo_timers_update();
+	}
+}
+
+static void print_ctr(const char *label, const struct rate_ctr *ctr)
+{
+	printf("%s: %" PRIu64 " (%" PRIu64 "/s %" PRIu64 "/m %" PRIu64 "/h %" PRIu64 "/d)\n",
+	       label, ctr->current,
+	       ctr->intv[RATE_CTR_INTV_SEC].rate,
+	       ctr->intv[RATE_CTR_INTV_MIN].rate,
+	       ctr->intv[RATE_CTR_INTV_HOUR].rate,
+	       ctr->intv[RATE_CTR_INTV_DAY].rate);
+}
+
+static void assert_equal(struct rate_ctr_group *eager, struct rate_ctr_group *other)
+{
+	unsigned int i, j;
+
+	rate_ctr_group_update(other);
+	for (i = 0; i < ctrg_desc.num_ctr; i++) {
+		const struct rate_ctr *a = &eager->ctr[i];
+		const struct rate_ctr *b = &other->ctr[i];
+
+		if (a->current == b->current) {
+			for (j = 0; j < RATE_CTR_INTV_NUM; j++) {
+				if (a->intv[j].rate != b->intv[j].rate)
+					break;
+			}
+			if (j == RATE_CTR_INTV_NUM)
+				continue;
+		}
+		print_ctr("eager", a);
+		print_ctr("other", b);
+		OSMO_ASSERT(false);
+	}
+}
+
+static void test_lazy(void)
+{
+	struct rate_ctr_group *eager, *lazy;
+	unsigned int i;
+
+	printf("%s\n", __func__);
+
+	eager = rate_ctr_group_alloc(ctx, &ctrg_desc, 0);
+	lazy = rate_ctr_group_alloc(ctx, &ctrg_desc, 1);
+	OSMO_ASSERT(eager && lazy);
+	rate_ctr_group_set_lazy(lazy, true);
+
+	/* bursts of events with pauses across several minutes, hours and a day */
+	for (i = 0; i < 400; i++) {
+		unsigned int n = (i * 7) % 5;
+		unsigned int pause = (i * i * 13) % 1021;
+
+		rate_ctr_add(&eager->ctr[TEST_A_CTR], n);
+		rate_ctr_add(&lazy->ctr[TEST_A_CTR], n);
+		if (i % 3 == 0) {
+			rate_ctr_inc(&eager->ctr[TEST_B_CTR]);
+			rate_ctr_inc(&lazy->ctr[TEST_B_CTR]);
+		}
+
+		run_secs(pause);
+		/* reading in between must not disturb the lazy computation */
+		if (i % 11 == 0)
+			assert_equal(eager, lazy);
+	}
+	assert_equal(eager, lazy);
+	print_ctr("lazy a", &lazy->ctr[TEST_A_CTR]);
+	print_ctr("lazy b", &lazy->ctr[TEST_B_CTR]);
+
+	/* back to periodic computation */
+	rate_ctr_group_set_lazy(lazy, false);
+	rate_ctr_add(&eager->ctr[TEST_A_CTR], 3);
+	rate_ctr_add(&lazy->ctr[TEST_A_CTR], 3);
+	run_secs(1);
+	OSMO_ASSERT(lazy->ctr[TEST_A_CTR].intv[RATE_CTR_INTV_SEC].rate == 3);
+	assert_equal(eager, lazy);
+
+	rate_ctr_group_free(eager);
+	rate_ctr_group_free(lazy);
+}
+
+static void test_sharded(void)
+{
+	struct rate_ctr_group *eager, *sharded;
+	unsigned int i;
+
+	printf("%s\n", __func__);
+
+	eager = rate_ctr_group_alloc(ctx, &ctrg_desc, 0);
+	sharded = rate_ctr_group_alloc_sharded(ctx, &ctrg_desc, 1, 3);
+	OSMO_ASSERT(eager && sharded);
+
+	for (i = 0; i < 200; i++) {
+		rate_ctr_add(&eager->ctr[TEST_A_CTR], 1 + i % 3);
+		rate_ctr_group_shard_add(sharded, i % 3, TEST_A_CTR, 1 + i % 3);
+		/* the main thread may still use the counters directly */
+		if (i % 2) {
+			rate_ctr_inc(&eager->ctr[TEST_B_CTR]);
+			rate_ctr_inc(&sharded->ctr[TEST_B_CTR]);
+		}
+		run_secs(i % 4 == 0 ? 1 : 0);
+		if (i % 17 == 0)
+			assert_equal(eager, sharded);
+	}
+	run_secs(1);
+	assert_equal(eager, sharded);
+	print_ctr("sharded a", &sharded->ctr[TEST_A_CTR]);
+	print_ctr("sharded b", &sharded->ctr[TEST_B_CTR]);
+
+	rate_ctr_group_free(eager);
+	rate_ctr_group_free(sharded);
+}
+
+/* A lazy group adds the shards before computing the intervals expired since
+ * its last update.  The shards do not record when they were counted, so the
+ * rates match those of the periodic computation if the group is updated
+ * after each second with events. */
+static void test_lazy_sharded(void)
+{
+	struct rate_ctr_group *eager, *sharded;
+	unsigned int i;
+
+	printf("%s\n", __func__);
+
+	eager = rate_ctr_group_alloc(ctx, &ctrg_desc, 0);
+	sharded = rate_ctr_group_alloc_sharded(ctx, &ctrg_desc, 1, 2);
+	OSMO_ASSERT(eager && sharded);
+	rate_ctr_group_set_lazy(sharded, true);
+
+	for (i = 0; i < 100; i++) {
+		rate_ctr_add(&eager->ctr[TEST_A_CTR], 1 + i % 5);
+		rate_ctr_group_shard_add(sharded, i % 2, TEST_A_CTR, 1 + i % 5);
+		run_secs((i * 7) % 90);
+		assert_equal(eager, sharded);
+	}
+	assert_equal(eager, sharded);
+	print_ctr("lazy sharded a", &sharded->ctr[TEST_A_CTR]);
+
+	rate_ctr_group_free(eager);
+	rate_ctr_group_free(sharded);
+}
+
+/* a group stays findable under its new index only */
+static void test_upd_idx(void)
+{
+	struct rate_ctr_group *grp, *grp2;
+
+	printf("%s\n", __func__);
+
+	grp = rate_ctr_group_alloc(ctx, &ctrg_desc, 5);
+	OSMO_ASSERT(grp);
+	rate_ctr_group_upd_idx(grp, 7);
+	OSMO_ASSERT(!rate_ctr_get_group_by_name_idx(ctrg_desc.group_name_prefix, 5));
+	OSMO_ASSERT(rate_ctr_get_group_by_name_idx(ctrg_desc.group_name_prefix, 7) == grp);
+
+	/* index 7 is taken, so the new group gets the next unused one */
+	grp2 = rate_ctr_group_alloc(ctx, &ctrg_desc, 7);
+	OSMO_ASSERT(grp2);
+	printf("second group for index 7 got index %u\n", grp2->idx);
+	OSMO_ASSERT(rate_ctr_get_group_by_name_idx(ctrg_desc.group_name_prefix, 8) == grp2);
+
+	rate_ctr_group_free(grp);
+	OSMO_ASSERT(!rate_ctr_get_group_by_name_idx(ctrg_desc.group_name_prefix, 7));
+	rate_ctr_group_free(grp2);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct log_info log_info = {};
+
+	ctx = talloc_named_const(NULL, 0, "rate_ctr_test");
+	log_init(&log_info, ctx);
+
+	osmo_gettimeofday_override = true;
+	osmo_gettimeofday_override_time = (struct timeval){ 0, 0 };
+	rate_ctr_init(ctx);
+
+	test_lazy();
+	test_sharded();
+	test_lazy_sharded();
+	test_upd_idx();
+
+	printf("Done\n");
+	talloc_free(ctx);
+	return 0;
+}
@@ -0,0 +1,160 @@
+/* tests for the intra-application signal dispatch */
+/*
+ * (C) 2020 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <osmocom/core/signal.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include "bench.h"
+
+#define SS_A	(OSMO_SIGNAL_SS_APPS + 1)
+#define SS_B	(OSMO_SIGNAL_SS_APPS + 2)
+
+static void *ctx;
+static int verbose;
+
+static int sig_cb(unsigned int subsys, unsigned int signal, void *handler_data, void *signal_data)
+{
+	printf("  cb(%s) subsys=%u signal=%u\n", (const char *)handler_data, subsys, signal);
+	return 0;
+}
+
+static int sig_cb_unreg_self(unsigned int subsys, unsigned int signal, void *handler_data, void *signal_data)
+{
+	printf("  cb(%s) subsys=%u signal=%u: unregister self and 'c'\n",
+	       (const char *)handler_data, subsys, signal);
+	osmo_signal_unregister_handler(subsys, sig_cb_unreg_self, handler_data);
+	osmo_signal_unregister_handler(subsys, sig_cb, signal_data);
+	return 0;
+}
+
+static int sig_cb_register(unsigned int subsys, unsigned int signal, void *handler_data, void *signal_data)
+{
+	printf("  cb(%s) subsys=%u signal=%u: register 'late'\n", (const char *)handler_data, subsys, signal);
+	osmo_signal_unregister_handler(subsys, sig_cb_register, handler_data);
+	osmo_signal_register_handler(subsys, sig_cb, "late");
+	return 0;
+}
+
+static int sig_cb_nested(unsigned int subsys, unsigned int signal, void *handler_data, void *signal_data)
+{
+	printf("  cb(%s) subsys=%u signal=%u\n", (const char *)handler_data, subsys, signal);
+	if (signal == 1) {
+		printf("  nested dispatch, unregistering '%s'\n", (const char *)handler_data);
+		osmo_signal_unregister_handler(subsys, sig_cb_nested, handler_data);
+		osmo_signal_dispatch(subsys, 2, NULL);
+	}
+	return 0;
+}
+
+static void test_dispatch(void)
+{
+	static char *c = "c";
+
+	printf("%s\n", __func__);
+
+	osmo_signal_register_handler(SS_A, sig_cb, "a");
+	osmo_signal_register_handler(SS_B, sig_cb, "b");
+	osmo_signal_register_handler(SS_A, sig_cb_unreg_self, "self");
+	osmo_signal_register_handler(SS_A, sig_cb, c);
+	osmo_signal_register_handler(SS_A, sig_cb_register, "reg");
+
+	printf("dispatch SS_A\n");
+	osmo_signal_dispatch(SS_A, 1, c);
+	printf("dispatch SS_A again\n");
+	osmo_signal_dispatch(SS_A, 2, c);
+	printf("dispatch SS_B\n");
+	osmo_signal_dispatch(SS_B, 3, NULL);
+	printf("dispatch unknown subsystem\n");
+	osmo_signal_dispatch(SS_B + 1, 4, NULL);
+
+	osmo_signal_unregister_handler(SS_A, sig_cb, "a");
+	osmo_signal_unregister_handler(SS_A, sig_cb, "late");
+	osmo_signal_unregister_handler(SS_B, sig_cb, "b");
+	printf("dispatch after unregistering all\n");
+	osmo_signal_dispatch(SS_A, 5, NULL);
+	osmo_signal_dispatch(SS_B, 6, NULL);
+
+	OSMO_ASSERT(talloc_total_blocks(ctx) == 1);
+}
+
+static void test_nested(void)
+{
+	printf("%s\n", __func__);
+
+	osmo_signal_register_handler(SS_A, sig_cb_nested, "n1");
+	osmo_signal_register_handler(SS_A, sig_cb_nested, "n2");
+
+	osmo_signal_dispatch(SS_A, 1, NULL);
+	printf("dispatch after nested unregistration\n");
+	osmo_signal_dispatch(SS_A, 3, NULL);
+
+	osmo_signal_unregister_handler(SS_A, sig_cb_nested, "n2");
+	OSMO_ASSERT(talloc_total_blocks(ctx) == 1);
+}
+
+static int sig_cb_count(unsigned int subsys, unsigned int signal, void *handler_data, void *signal_data)
+{
+	(*(unsigned int *)handler_data)++;
+	return 0;
+}
+
+/* dispatch cost must not depend on the number of handlers of other subsystems */
+static void test_unrelated_handlers(unsigned int num_unrelated)
+{
+	unsigned int count = 0;
+	unsigned int i;
+	double start, end;
+
+	printf("%s\n", __func__);
+
+	for (i = 0; i < num_unrelated; i++)
+		osmo_signal_register_handler(SS_B + 1 + i % 64, sig_cb_count, &count);
+	osmo_signal_register_handler(SS_A, sig_cb_count, &count);
+
+	start = bench_now();
+	for (i = 0; i < 100000; i++)
+		osmo_signal_dispatch(SS_A, 1, NULL);
+	end = bench_now();
+
+	printf("%u dispatches with %u unrelated handlers -> %u call-backs\n", i, num_unrelated, count);
+	if (verbose)
+		fprintf(stderr, "took %.0f us\n", (end - start) * 1e6);
+
+	for (i = 0; i < num_unrelated; i++)
+		osmo_signal_unregister_handler(SS_B + 1 + i % 64, sig_cb_count, &count);
+	osmo_signal_unregister_handler(SS_A, sig_cb_count, &count);
+	OSMO_ASSERT(talloc_total_blocks(ctx) == 1);
+}
+
+int main(int argc, char **argv)
+{
+	verbose = bench_requested(argc, argv);
+
+	ctx = osmo_signal_talloc_ctx_init(talloc_named_const(NULL, 0, "signal_test"));
+
+	test_dispatch();
+	test_nested();
+	test_unrelated_handlers(10000);
+
+	printf("Done\n");
+	return 0;
+}
@@ -34,6 +34,8 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/application.h>
 
+#include "bench.h"
+
 struct log_info fake_log_info = {};
 
 struct test_case {
@@ -268,6 +270,86 @@ static void test_gen_oa(void)
 	printf("Result: len(%d) data(%s)\n", len, osmo_hexdump(oa, len));
 }
 
+static void test_utf8(void)
+{
+	static const char *texts[] = {
+		"test text",
+		"\xce\x94\xce\xa6\xce\x93\xce\x9b\xce\xa9 \xe2\x82\xac 5 {[|]} ^~\\ \xc3\xa4\xc3\xb6\xc3\xbc\xc3\x9f",
+		"\xc3\xa7" "a va?",
+		"na\xc3\xafve",			/* i with diaeresis is not in the default alphabet */
+		"\xf0\x9f\x98\x80",		/* outside the basic multilingual plane */
+		"bad \xc3",			/* truncated sequence */
+		"\xc0\xaf",			/* overlong */
+	};
+	uint8_t coded[256];
+	char text[256];
+	int i, septets, octets, nchars, len;
+
+	printf("Testing UTF-8 transcoding\n");
+
+	for (i = 0; i < ARRAY_SIZE(texts); i++) {
+		septets = gsm_7bit_encode_n_utf8(coded, sizeof(coded), texts[i], &octets);
+		printf("%s: GSM7 septets=%d", osmo_quote_str(texts[i], -1), septets);
+		if (septets >= 0) {
+			printf(" octets=%d %s", octets, osmo_hexdump_nospc(coded, octets));
+			nchars = gsm_7bit_decode_n_utf8(text, sizeof(text), coded, septets, 0);
+			printf(" -> %s", osmo_quote_str(text, nchars));
+			OSMO_ASSERT(nchars == strlen(text));
+		}
+		len = gsm_ucs2_encode_utf8(coded, sizeof(coded), texts[i]);
+		printf(", UCS2 octets=%d", len);
+		if (len >= 0) {
+			nchars = gsm_ucs2_decode_utf8(text, sizeof(text), coded, len);
+			printf(" -> %s", osmo_quote_str(text, nchars));
+		}
+		printf("\n");
+	}
+
+	/* never cut a character in two: the euro sign takes two septets, and three octets in UTF-8 */
+	septets = gsm_7bit_encode_n_utf8(coded, 2, "ab\xe2\x82\xac", &octets);
+	printf("limited to 2 octets: septets=%d octets=%d\n", septets, octets);
+	gsm_7bit_encode_n_utf8(coded, sizeof(coded), "ab\xe2\x82\xac", &octets);
+	nchars = gsm_7bit_decode_n_utf8(text, 5, coded, 4, 0);
+	printf("decoded into 5 bytes: %s\n", osmo_quote_str(text, nchars));
+
+	/* an escape to a further extension table shows as a space, a trailing escape as U+FFFD */
+	gsm_septets2octets(coded, (const uint8_t *)"a\x1b\x1b" "b\x1b", 5, 0);
+	nchars = gsm_7bit_decode_n_utf8(text, sizeof(text), coded, 5, 0);
+	printf("escapes: %s\n", osmo_quote_str(text, nchars));
+
+	/* a surrogate pair, and a lone surrogate */
+	nchars = gsm_ucs2_decode_utf8(text, sizeof(text), (const uint8_t *)"\xd8\x3d\xde\x00\x00\x41\xdc\x00", 8);
+	printf("UTF-16 surrogates: %s\n", osmo_quote_str(text, nchars));
+}
+
+static void test_7bit_throughput(bool verbose)
+{
+	/* 160 septets, the longest single SMS */
+	static const char msg[] = "The quick brown fox jumps over the lazy dog. {Escaped} [chars] cost two septets; "
+				  "the rest of this sentence is ordinary text to reach exactly one full SMS...";
+	uint8_t coded[140];
+	char text[200];
+	double t0, t1, t2;
+	int i, septets = 0, octets = 0, nchars = 0;
+	const int iter = 200000;
+
+	printf("Testing GSM7 throughput\n");
+
+	t0 = bench_now();
+	for (i = 0; i < iter; i++)
+		septets = gsm_7bit_encode_n(coded, sizeof(coded), msg, &octets);
+	t1 = bench_now();
+	for (i = 0; i < iter; i++)
+		nchars = gsm_7bit_decode_n(text, sizeof(text), coded, septets);
+	t2 = bench_now();
+
+	OSMO_ASSERT(!strcmp(text, msg));
+	printf("%d x encode + decode of %d septets in %d octets: %d chars\n", iter, septets, octets, nchars);
+
+	if (verbose)
+		fprintf(stderr, "encode: %.0f SMS/s, decode: %.0f SMS/s\n", iter / (t1 - t0), iter / (t2 - t1));
+}
+
 int main(int argc, char** argv)
 {
 	printf("SMS testing\n");
@@ -396,6 +478,8 @@ int main(int argc, char** argv)
 
 	test_octet_return();
 	test_gen_oa();
+	test_utf8();
+	test_7bit_throughput(bench_requested(argc, argv));
 
 	printf("OK\n");
 	return 0;
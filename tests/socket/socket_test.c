@@ -23,8 +23,11 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
@@ -35,6 +38,8 @@
 
 #include "../config.h"
 
+#include "bench.h"
+
 void *ctx = NULL;
 
 static int test_sockinit(void)
@@ -125,6 +130,168 @@ static int test_sockinit2(void)
 	return 0;
 }
 
+static int test_sockinit_opts(void)
+{
+	struct osmo_sock_tuning tuning = { .rcvbuf = 65536, .sndbuf = 65536 };
+	char name[OSMO_SOCK_NAME_MAXLEN];
+	char buf[64], cbuf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct msghdr mh = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = cbuf, .msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+	int fd, fd2, tx, rc, val;
+	socklen_t len = sizeof(val);
+	uint16_t port;
+	bool found = false;
+
+	printf("Checking osmo_sock_init2() for OSMO_SOCK_F_REUSEPORT\n");
+	fd = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "127.0.0.1", 0, NULL, 0,
+			     OSMO_SOCK_F_BIND|OSMO_SOCK_F_REUSEPORT);
+	OSMO_ASSERT(fd >= 0);
+	osmo_sock_get_local_ip_port(fd, name, sizeof(name));
+	port = atoi(name);
+	fd2 = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "127.0.0.1", port, NULL, 0,
+			      OSMO_SOCK_F_BIND|OSMO_SOCK_F_REUSEPORT);
+	OSMO_ASSERT(fd2 >= 0);
+	close(fd2);
+
+	printf("Checking osmo_sock_init2() for OSMO_SOCK_F_TUNING\n");
+	osmo_sock_tuning_set(&tuning);
+	fd2 = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "127.0.0.1", 0, NULL, 0,
+			      OSMO_SOCK_F_BIND|OSMO_SOCK_F_TUNING);
+	OSMO_ASSERT(fd2 >= 0);
+	rc = getsockopt(fd2, SOL_SOCKET, SO_RCVBUF, &val, &len);
+	OSMO_ASSERT(rc == 0 && val >= 65536);
+	close(fd2);
+	memset(&tuning, 0, sizeof(tuning));
+	osmo_sock_tuning_set(&tuning);
+	close(fd);
+
+	printf("Checking osmo_sock_init2() for OSMO_SOCK_F_PKTINFO\n");
+	fd = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "0.0.0.0", 0, NULL, 0,
+			     OSMO_SOCK_F_BIND|OSMO_SOCK_F_PKTINFO);
+	OSMO_ASSERT(fd >= 0);
+	osmo_sock_get_local_ip_port(fd, name, sizeof(name));
+	port = atoi(name);
+	tx = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, "127.0.0.1", port,
+			     OSMO_SOCK_F_CONNECT);
+	OSMO_ASSERT(tx >= 0);
+	rc = send(tx, "ping", 4, 0);
+	OSMO_ASSERT(rc == 4);
+	rc = recvmsg(fd, &mh, 0);
+	OSMO_ASSERT(rc == 4);
+	for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+		struct in_pktinfo *pi = (struct in_pktinfo *) CMSG_DATA(cmsg);
+		if (cmsg->cmsg_level != IPPROTO_IP || cmsg->cmsg_type != IP_PKTINFO)
+			continue;
+		OSMO_ASSERT(pi->ipi_addr.s_addr == htonl(INADDR_LOOPBACK));
+		found = true;
+	}
+	OSMO_ASSERT(found);
+	close(tx);
+	close(fd);
+
+	return 0;
+}
+
+#define BENCH_MAX_SHARDS 8
+#define BENCH_NUM_SRC 64
+
+/* Receive datagrams on fd until nothing arrives for 200ms, report the count and time of the last datagram */
+static void bench_rx_child(int fd, int pipe_fd)
+{
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+	double last = 0;
+	unsigned int count = 0;
+	char buf[256];
+	double res[2];
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	while (recv(fd, buf, sizeof(buf), 0) >= 0) {
+		count++;
+		last = bench_now();
+	}
+	res[0] = count;
+	res[1] = last;
+	if (write(pipe_fd, res, sizeof(res)) != sizeof(res))
+		_exit(1);
+	_exit(0);
+}
+
+/* Send num_pkts datagrams from BENCH_NUM_SRC source ports to num_shards receiver processes sharing one
+ * port by SO_REUSEPORT (or a single plain socket for num_shards == 1). */
+static void bench_udp_rx(unsigned int num_shards, unsigned int num_pkts, bool verbose)
+{
+	struct osmo_sock_tuning tuning = { .rcvbuf = 4 * 1024 * 1024 };
+	unsigned int flags = OSMO_SOCK_F_BIND | OSMO_SOCK_F_TUNING;
+	int rx[BENCH_MAX_SHARDS], tx[BENCH_NUM_SRC], pipe_fd[2];
+	unsigned int i, total = 0, shards_used = 0;
+	char name[OSMO_SOCK_NAME_MAXLEN];
+	char pkt[172] = {};
+	double start;
+	double res[2], last = 0;
+	uint16_t port = 0;
+	int rc;
+
+	printf("Checking UDP receive with %u shard(s)\n", num_shards);
+	OSMO_ASSERT(num_shards <= BENCH_MAX_SHARDS);
+	if (num_shards > 1)
+		flags |= OSMO_SOCK_F_REUSEPORT;
+	osmo_sock_tuning_set(&tuning);
+
+	rc = pipe(pipe_fd);
+	OSMO_ASSERT(rc == 0);
+	for (i = 0; i < num_shards; i++) {
+		rx[i] = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, "127.0.0.1", port, NULL, 0, flags);
+		OSMO_ASSERT(rx[i] >= 0);
+		if (!port) {
+			osmo_sock_get_local_ip_port(rx[i], name, sizeof(name));
+			port = atoi(name);
+		}
+	}
+	for (i = 0; i < BENCH_NUM_SRC; i++) {
+		tx[i] = osmo_sock_init2(AF_INET, SOCK_DGRAM, IPPROTO_UDP, NULL, 0, "127.0.0.1", port,
+					OSMO_SOCK_F_CONNECT);
+		OSMO_ASSERT(tx[i] >= 0);
+	}
+	for (i = 0; i < num_shards; i++) {
+		fflush(stdout);
+		if (fork() == 0)
+			bench_rx_child(rx[i], pipe_fd[1]);
+		close(rx[i]);
+	}
+
+	start = bench_now();
+	for (i = 0; i < num_pkts; i++)
+		send(tx[i % BENCH_NUM_SRC], pkt, sizeof(pkt), 0);
+
+	for (i = 0; i < num_shards; i++) {
+		rc = read(pipe_fd[0], res, sizeof(res));
+		OSMO_ASSERT(rc == sizeof(res));
+		total += res[0];
+		if (res[0] > 0)
+			shards_used++;
+		if (res[1] > last)
+			last = res[1];
+		wait(NULL);
+	}
+
+	OSMO_ASSERT(total > 0);
+	if (shards_used == num_shards)
+		printf("all shards received traffic\n");
+	if (verbose)
+		fprintf(stderr, "  %u/%u datagrams in %.3fs: %.0f datagrams/s\n", total, num_pkts,
+			last - start, total / (last - start));
+
+	for (i = 0; i < BENCH_NUM_SRC; i++)
+		close(tx[i]);
+	close(pipe_fd[0]);
+	close(pipe_fd[1]);
+	memset(&tuning, 0, sizeof(tuning));
+	osmo_sock_tuning_set(&tuning);
+}
 
 const struct log_info_cat default_categories[] = {
 };
@@ -136,6 +303,8 @@ static struct log_info info = {
 
 int main(int argc, char *argv[])
 {
+	bool bench;
+
 	ctx = talloc_named_const(NULL, 0, "socket_test");
 	osmo_init_logging2(ctx, &info);
 	log_set_use_color(osmo_stderr_target, 0);
@@ -143,6 +312,12 @@ int main(int argc, char *argv[])
 
 	test_sockinit();
 	test_sockinit2();
+	test_sockinit_opts();
+
+	/* pass -b to measure the receive throughput with more datagrams */
+	bench = bench_requested(argc, argv);
+	bench_udp_rx(1, bench ? 1000000 : 10000, bench);
+	bench_udp_rx(4, bench ? 1000000 : 10000, bench);
 
 	return EXIT_SUCCESS;
 }
@@ -29,6 +29,7 @@
 #include <osmocom/core/stats.h>
 
 #include <stdio.h>
+#include <errno.h>
 #include <inttypes.h>
 
 enum test_ctr {
@@ -490,6 +491,137 @@ static void test_reporting()
 	printf("End test: %s\n", __func__);
 }
 
+static const struct osmo_stat_hist_desc hist_desc = {
+	.max_value = 100000,
+	.precision_bits = 4,
+};
+
+static const struct osmo_stat_item_desc hist_item_description[] = {
+	{ "rtt", "The round trip time", "us", 4, 0, &hist_desc },
+};
+
+static const struct osmo_stat_item_group_desc hist_statg_desc = {
+	.group_name_prefix = "test.hist",
+	.group_description = "Histogram test",
+	.num_items = ARRAY_SIZE(hist_item_description),
+	.item_desc = hist_item_description,
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+};
+
+static void test_histogram()
+{
+	void *ctx = talloc_named_const(NULL, 1, "hist test context");
+	struct osmo_stat_item_group *statg;
+	struct osmo_stats_reporter *srep;
+	struct osmo_stat_hist *hist, *hist2;
+	const struct osmo_stat_hist_desc other_desc = { .max_value = 1000, .precision_bits = 2 };
+	int i;
+
+	printf("Start test: %s\n", __func__);
+
+	hist = osmo_stat_hist_alloc(ctx, &hist_desc);
+	OSMO_ASSERT(hist);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 50) == 0);
+
+	/* small values are exact */
+	for (i = 1; i <= 20; i++)
+		osmo_stat_hist_record(hist, i);
+	printf("1..20: p50=%u p90=%u p99=%u max=%u min=%u\n",
+	       osmo_stat_hist_percentile(hist, 50), osmo_stat_hist_percentile(hist, 90),
+	       osmo_stat_hist_percentile(hist, 99), hist->max, hist->min);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 50) == 10);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 90) == 18);
+
+	/* larger values are within 2^-precision_bits */
+	osmo_stat_hist_reset(hist);
+	for (i = 1; i <= 1000; i++)
+		osmo_stat_hist_record(hist, i * 100);
+	printf("100..100000: p50=%u p90=%u p99=%u max=%u count=%"PRIu64"\n",
+	       osmo_stat_hist_percentile(hist, 50), osmo_stat_hist_percentile(hist, 90),
+	       osmo_stat_hist_percentile(hist, 99), hist->max, hist->count);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 50) >= 50000);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 50) <= 50000 + 50000 / 16);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 100) == 100000);
+
+	/* values beyond the range are clamped, but max is kept */
+	osmo_stat_hist_record(hist, 5000000);
+	OSMO_ASSERT(hist->max == 5000000);
+	OSMO_ASSERT(osmo_stat_hist_percentile(hist, 99) <= 100000 + 100000 / 16);
+
+	/* merging */
+	hist2 = osmo_stat_hist_alloc(ctx, &hist_desc);
+	OSMO_ASSERT(hist2);
+	osmo_stat_hist_record(hist2, 7);
+	OSMO_ASSERT(osmo_stat_hist_merge(hist2, hist) == 0);
+	OSMO_ASSERT(hist2->count == 1002 && hist2->min == 7 && hist2->max == 5000000);
+	talloc_free(hist2);
+
+	/* values recorded since a copy was taken */
+	hist2 = osmo_stat_hist_alloc(ctx, &hist_desc);
+	OSMO_ASSERT(hist2);
+	OSMO_ASSERT(osmo_stat_hist_merge(hist2, hist) == 0);
+	osmo_stat_hist_record(hist, 300);
+	osmo_stat_hist_record(hist, 400);
+	OSMO_ASSERT(osmo_stat_hist_since(hist2, hist) == 0);
+	printf("since copy: count=%"PRIu64" sum=%"PRIu64" min=%u max=%u p50=%u\n",
+	       hist2->count, hist2->sum, hist2->min, hist2->max, osmo_stat_hist_percentile(hist2, 50));
+	OSMO_ASSERT(hist2->count == 2 && hist2->sum == 700);
+	OSMO_ASSERT(hist2->min <= 300 && hist2->max >= 400);
+	talloc_free(hist2);
+
+	hist2 = osmo_stat_hist_alloc(ctx, &other_desc);
+	OSMO_ASSERT(osmo_stat_hist_merge(hist2, hist) == -EINVAL);
+	OSMO_ASSERT(osmo_stat_hist_since(hist2, hist) == -EINVAL);
+
+	/* as part of a stat item */
+	statg = osmo_stat_item_group_alloc(ctx, &hist_statg_desc, 0);
+	OSMO_ASSERT(statg && statg->items[0]->hist);
+	OSMO_ASSERT(osmo_stat_item_get_by_name(statg, "rtt") == statg->items[0]);
+
+	srep = stats_reporter_create_test("test3");
+	OSMO_ASSERT(osmo_stats_reporter_enable(srep) >= 0);
+	OSMO_ASSERT(osmo_stats_reporter_set_max_class(srep, OSMO_STATS_CLASS_GLOBAL) >= 0);
+
+	printf("report (initial):\n");
+	send_count = 0;
+	osmo_stats_report();
+	OSMO_ASSERT(send_count == 1 + 5);
+
+	printf("report (should be empty):\n");
+	send_count = 0;
+	osmo_stats_report();
+	OSMO_ASSERT(send_count == 0);
+
+	printf("report (values set):\n");
+	for (i = 0; i < 100; i++)
+		osmo_stat_item_set(statg->items[0], 1000 + i * 10);
+	osmo_stat_item_set(statg->items[0], -5);
+	OSMO_ASSERT(osmo_stat_item_get_last(statg->items[0]) == -5);
+	OSMO_ASSERT(statg->items[0]->hist->min == 0);
+	send_count = 0;
+	osmo_stats_report();
+	/* the values still in the FIFO, then the distribution */
+	OSMO_ASSERT(send_count == 4 + 5);
+
+	/* reporting leaves the histogram of VTY and CTRL alone, the next report
+	 * only covers the values set since */
+	printf("report (more values set):\n");
+	OSMO_ASSERT(statg->items[0]->hist->count == 101);
+	osmo_stat_item_set(statg->items[0], 3000);
+	osmo_stat_item_set(statg->items[0], 4000);
+	send_count = 0;
+	osmo_stats_report();
+	OSMO_ASSERT(send_count == 2 + 5);
+	OSMO_ASSERT(statg->items[0]->hist->count == 103);
+	OSMO_ASSERT(osmo_stat_hist_percentile(statg->items[0]->hist, 100) == 4000);
+
+	osmo_stats_reporter_free(srep);
+	osmo_stat_item_group_free(statg);
+	talloc_free(ctx);
+
+	printf("End test: %s\n", __func__);
+}
+
 int main(int argc, char **argv)
 {
 	static const struct log_info log_info = {};
@@ -499,5 +631,6 @@ int main(int argc, char **argv)
 
 	stat_test();
 	test_reporting();
+	test_histogram();
 	return 0;
 }
@@ -28,12 +28,19 @@
 #include <osmocom/core/socket.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#include "bench.h"
 
 static void hexdump_test(void)
 {
@@ -198,6 +205,212 @@ static void hexparse_test(void)
 	printf("rc = %d\n", rc);
 }
 
+/* straightforward reference for the accelerated osmo_hexdump_buf() code paths */
+static void hexdump_ref(char *out, size_t out_size, const uint8_t *buf, int len, const char *delim,
+			bool delim_after_last)
+{
+	size_t delim_len = strlen(delim);
+	char *cur = out;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		bool last = (i == len - 1) && !delim_after_last;
+		size_t need = 2 + (last ? 0 : delim_len);
+		if (cur - out + need >= out_size)
+			break;
+		cur += sprintf(cur, "%02x%s", buf[i], last ? "" : delim);
+	}
+	*cur = '\0';
+}
+
+static void hexdump_acc_test(void)
+{
+	static const char *delims[] = { "", " ", ":", "::" };
+	uint8_t data[300];
+	uint8_t parsed[300];
+	char str[1024], ref[1024];
+	char ubits[300], ubits_ref[301];
+	int i, len, d, size, rc;
+	int errors = 0;
+
+	printf("\n%s()\n", __func__);
+
+	srand(42);
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = rand();
+
+	for (d = 0; d < ARRAY_SIZE(delims); d++) {
+		for (len = 0; len <= 130; len++) {
+			for (size = 1; size <= len * 3 + 2; size += (size < 40 ? 1 : 37)) {
+				hexdump_ref(ref, size, data, len, delims[d], false);
+				osmo_hexdump_buf(str, size, data, len, delims[d], false);
+				if (strcmp(str, ref))
+					errors++;
+				hexdump_ref(ref, size, data, len, delims[d], true);
+				osmo_hexdump_buf(str, size, data, len, delims[d], true);
+				if (strcmp(str, ref))
+					errors++;
+			}
+			osmo_hexdump_buf(str, sizeof(str), data, len, delims[d], true);
+			if (osmo_hexdump_len(len, delims[d], true) != strlen(str))
+				errors++;
+			osmo_hexdump_buf(str, sizeof(str), data, len, delims[d], false);
+			if (osmo_hexdump_len(len, delims[d], false) != strlen(str))
+				errors++;
+		}
+	}
+	printf("osmo_hexdump_buf() vs. reference: %d mismatches\n", errors);
+
+	/* round trip, in upper and lower case, with and without a whitespace in between */
+	errors = 0;
+	for (len = 0; len <= 200; len++) {
+		for (d = 0; d < 3; d++) {
+			osmo_hexdump_buf(str, sizeof(str), data, len, "", false);
+			if (d == 1)
+				for (i = 0; str[i]; i++)
+					str[i] = toupper(str[i]);
+			if (d == 2 && len > 20) {
+				memmove(str + 38, str + 37, strlen(str + 37) + 1);
+				str[37] = '\n';
+			}
+			rc = osmo_hexparse(str, parsed, len);
+			if (rc != len || memcmp(parsed, data, len))
+				errors++;
+			/* one byte short of room */
+			if (len && osmo_hexparse(str, parsed, len - 1) != -1)
+				errors++;
+		}
+		/* an invalid character at any position */
+		osmo_hexdump_buf(str, sizeof(str), data, len, "", false);
+		for (i = 0; i < len * 2; i += 7) {
+			char c = str[i];
+			str[i] = 'g';
+			if (osmo_hexparse(str, parsed, len) != -1)
+				errors++;
+			str[i] = c;
+		}
+	}
+	printf("osmo_hexparse() round trip: %d mismatches\n", errors);
+
+	errors = 0;
+	for (len = 0; len <= 100; len++) {
+		for (i = 0; i < len; i++) {
+			ubits[i] = data[i] % 4 == 3 ? 0xff : data[i] % 4 == 2 ? data[i] : data[i] & 1;
+			ubits_ref[i] = ubits[i] == 0 ? '0' : ubits[i] == 1 ? '1' : ubits[i] == (char)0xff ? '?' : 'E';
+		}
+		ubits_ref[len] = '\0';
+		if (strcmp(osmo_ubit_dump_buf(str, sizeof(str), (uint8_t *)ubits, len), ubits_ref))
+			errors++;
+	}
+	printf("osmo_ubit_dump_buf() vs. reference: %d mismatches\n", errors);
+}
+
+static void hexdump_bench(void)
+{
+	static uint8_t data[65536];
+	static char str[65536 * 3 + 1];
+	size_t len;
+	int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+
+	for (len = 64; len <= sizeof(data); len *= 4) {
+		double t0, t1, t2, t3;
+		int iter = (16 << 20) / len;
+
+		t0 = bench_now();
+		for (i = 0; i < iter; i++)
+			osmo_hexdump_buf(str, sizeof(str), data, len, "", false);
+		t1 = bench_now();
+		for (i = 0; i < iter; i++)
+			osmo_hexdump_buf(str, sizeof(str), data, len, " ", true);
+		t2 = bench_now();
+		osmo_hexdump_buf(str, sizeof(str), data, len, "", false);
+		for (i = 0; i < iter; i++)
+			osmo_hexparse(str, data, len);
+		t3 = bench_now();
+
+		fprintf(stderr, "%6zu bytes: nospc %8.1f MB/s, spc %8.1f MB/s, parse %8.1f MB/s\n", len,
+			len * iter / 1e6 / (t1 - t0), len * iter / 1e6 / (t2 - t1), len * iter / 1e6 / (t3 - t2));
+	}
+}
+
+static const struct value_string vs_dense[] = {
+	{ 3, "three" },
+	{ 4, "four" },
+	{ 5, "Five" },
+	{ 4, "four again" },
+	{ 7, "seven" },
+	{ 8, "FOUR" },
+	{ 0, "zero" },
+	{ 0, NULL }
+};
+
+static const struct value_string vs_sparse[] = {
+	{ 0x80000001, "one" },
+	{ 0x10, "Sixteen" },
+	{ 0xffffffff, "max" },
+	{ 0x10, "sixteen again" },
+	{ 1000, "SIXTEEN" },
+	{ 0, NULL }
+};
+
+/* copies of the above, which are never indexed */
+static struct value_string vs_dense_lin[ARRAY_SIZE(vs_dense)];
+static struct value_string vs_sparse_lin[ARRAY_SIZE(vs_sparse)];
+
+static void value_string_index_test(void)
+{
+	static const char *strs[] = { "three", "FOUR", "four again", "five", "zero", "Sixteen", "one", "MAX",
+				      "sixteen again", "unknown", "" };
+	uint32_t vals[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0x10, 1000, 0x80000001, 0xffffffff, 0xfffffffe };
+	int i, rc;
+	int errors = 0;
+
+	printf("\n%s()\n", __func__);
+
+	memcpy(vs_dense_lin, vs_dense, sizeof(vs_dense));
+	memcpy(vs_sparse_lin, vs_sparse, sizeof(vs_sparse));
+
+	rc = osmo_value_string_index(vs_dense);
+	printf("osmo_value_string_index(vs_dense) = %d\n", rc);
+	rc = osmo_value_string_index(vs_sparse);
+	printf("osmo_value_string_index(vs_sparse) = %d\n", rc);
+	rc = osmo_value_string_index(vs_sparse);
+	printf("osmo_value_string_index(vs_sparse) again = %d\n", rc);
+
+	for (i = 0; i < ARRAY_SIZE(vals); i++) {
+		const char *d = get_value_string_or_null(vs_dense, vals[i]);
+		const char *sp = get_value_string_or_null(vs_sparse, vals[i]);
+		printf("0x%x: dense %s, sparse %s\n", vals[i], d ? : "NULL", sp ? : "NULL");
+		if (d != get_value_string_or_null(vs_dense_lin, vals[i])
+		    || sp != get_value_string_or_null(vs_sparse_lin, vals[i]))
+			errors++;
+	}
+	printf("get_value_string(vs_sparse, 0x42) = %s\n", get_value_string(vs_sparse, 0x42));
+
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		int d = get_string_value(vs_dense, strs[i]);
+		int sp = get_string_value(vs_sparse, strs[i]);
+		printf("\"%s\": dense %d, sparse %d\n", strs[i], d, sp);
+		if (d != get_string_value(vs_dense_lin, strs[i]) || sp != get_string_value(vs_sparse_lin, strs[i]))
+			errors++;
+	}
+
+	/* many tables, to grow the registry */
+	for (i = 0; i < 100; i++) {
+		struct value_string *vs = calloc(3, sizeof(*vs));
+		vs[0] = (struct value_string){ i, "i" };
+		vs[1] = (struct value_string){ i * 1000, "i*1000" };
+		OSMO_ASSERT(osmo_value_string_index(vs) == 0);
+		if (get_string_value(vs, "I*1000") != i * 1000 || strcmp(get_value_string(vs, i), "i"))
+			errors++;
+	}
+
+	printf("indexed vs. linear lookup: %d mismatches\n", errors);
+}
+
 static void test_ipa_ccm_id_resp_parsing(void)
 {
 	struct tlv_parsed tvp;
@@ -250,6 +463,79 @@ static void test_ipa_ccm_id_resp_parsing(void)
 	OSMO_ASSERT(TLVP_LEN(&tvp, IPAC_IDTAG_SERNR) == 0x09);
 }
 
+static void test_ipa_msg_recv_batch(void)
+{
+	struct ipa_stream_rx *srx;
+	struct msgb *msg, *msg2;
+	LLIST_HEAD(msgs);
+	uint8_t frame[3 + 300];
+	unsigned int i, num = 0;
+	int sv[2], rc;
+
+	printf("\nTesting IPA streaming receiver\n");
+
+	OSMO_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	srx = ipa_stream_rx_alloc(NULL, 4096);
+	OSMO_ASSERT(srx);
+
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	printf("empty socket: rc=%d\n", rc);
+	OSMO_ASSERT(rc == -EAGAIN);
+
+	/* 10 frames of growing size in one write, plus a frame without payload */
+	for (i = 0; i < 10; i++) {
+		frame[0] = 0;
+		frame[1] = 10 + i;
+		frame[2] = IPAC_PROTO_RSL;
+		memset(frame + 3, i, 10 + i);
+		OSMO_ASSERT(write(sv[0], frame, 3 + 10 + i) == 3 + 10 + i);
+	}
+	OSMO_ASSERT(write(sv[0], "\x00\x00\xff", 3) == 3);
+	/* a frame whose second half arrives later */
+	frame[0] = 0x01;
+	frame[1] = 0x2c;
+	frame[2] = IPAC_PROTO_OML;
+	memset(frame + 3, 0xaa, 300);
+	OSMO_ASSERT(write(sv[0], frame, 150) == 150);
+
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	printf("first recv: rc=%d\n", rc);
+	llist_for_each_entry_safe(msg, msg2, &msgs, list) {
+		OSMO_ASSERT(msg->l1h == msg->data && msg->l2h == msg->data + 3);
+		OSMO_ASSERT(msgb_l2len(msg) == 10 + num);
+		OSMO_ASSERT(msg->l2h[0] == num && msg->l2h[msgb_l2len(msg) - 1] == num);
+		llist_del(&msg->list);
+		msgb_free(msg);
+		num++;
+	}
+
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	printf("nothing new: rc=%d\n", rc);
+
+	OSMO_ASSERT(write(sv[0], frame + 150, sizeof(frame) - 150) == sizeof(frame) - 150);
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	msg = msgb_dequeue(&msgs);
+	printf("second recv: rc=%d proto=0x%02x len=%u\n", rc, msg->l1h[2], msgb_l2len(msg));
+	OSMO_ASSERT(msg->l2h[0] == 0xaa && msg->l2h[299] == 0xaa);
+	msgb_free(msg);
+
+	/* a frame exceeding the maximum IPA message size terminates the stream */
+	OSMO_ASSERT(write(sv[0], "\x00\x01\x00\x42\xff\xff\x00", 7) == 7);
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	printf("bad length: rc=%d, then rc=%d\n", rc, ipa_msg_recv_batch(sv[1], srx, &msgs));
+	msgb_free(msgb_dequeue(&msgs));
+
+	ipa_stream_rx_free(srx);
+	srx = ipa_stream_rx_alloc(NULL, 0);
+	close(sv[0]);
+	rc = ipa_msg_recv_batch(sv[1], srx, &msgs);
+	printf("closed socket: rc=%d\n", rc);
+
+	ipa_stream_rx_free(srx);
+	close(sv[1]);
+}
+
 static void test_ipa_ccm_id_get_parsing(void)
 {
 	struct tlv_parsed tvp;
@@ -1065,8 +1351,11 @@ int main(int argc, char **argv)
 
 	hexdump_test();
 	hexparse_test();
+	hexdump_acc_test();
+	value_string_index_test();
 	test_ipa_ccm_id_get_parsing();
 	test_ipa_ccm_id_resp_parsing();
+	test_ipa_msg_recv_batch();
 	test_is_hexstr();
 	bcd_test();
 	bcd2str_test();
@@ -1078,5 +1367,8 @@ int main(int argc, char **argv)
 	strbuf_test();
 	strbuf_test_nolen();
 	startswith_test();
+
+	if (bench_requested(argc, argv))
+		hexdump_bench();
 	return 0;
 }
@@ -22,12 +22,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include <osmocom/core/application.h>
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/gsmtap_util.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/stats.h>
@@ -39,6 +43,7 @@
 #include <osmocom/vty/buffer.h>
 #include <osmocom/vty/logging.h>
 #include <osmocom/vty/stats.h>
+#include <osmocom/vty/gsmtap_vty.h>
 
 static enum event last_vty_connection_event = -1;
 void *ctx = NULL;
@@ -305,6 +310,7 @@ enum test_nodes {
 	LEVEL1_NODE = _LAST_OSMOVTY_NODE + 1,
 	LEVEL2_NODE,
 	LEVEL3_NODE,
+	BENCH_NODE,
 };
 
 struct cmd_node level1_node = {
@@ -460,6 +466,131 @@ void test_is_cmd_ambiguous()
 	destroy_test_vty(&test, vty);
 }
 
+struct cmd_node bench_node = {
+	BENCH_NODE,
+	"%s(config-bench)# ",
+	1
+};
+
+#define BENCH_NUM_PARAMS 300
+#define BENCH_NUM_LINES 20000
+
+static unsigned int bench_calls;
+
+DEFUN(cfg_bench, cfg_bench_cmd,
+	"bench",
+	"Node with many commands to benchmark config file loading\n")
+{
+	vty->node = BENCH_NODE;
+	return CMD_SUCCESS;
+}
+
+static int cfg_bench_param(struct cmd_element *self, struct vty *vty, int argc, const char *argv[])
+{
+	bench_calls++;
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bench_nsvc, cfg_bench_nsvc_cmd,
+	"(nsvc|nsvci) <0-65535> remote A.B.C.D",
+	"NS-VC\n" "NS-VC\n" "NS-VCI\n" "Remote address\n" "IPv4 address\n")
+{
+	bench_calls++;
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bench_shutdown, cfg_bench_shutdown_cmd,
+	"shutdown",
+	"Shut down\n")
+{
+	bench_calls++;
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bench_no_shutdown, cfg_bench_no_shutdown_cmd,
+	"no shutdown",
+	NO_STR "Shut down\n")
+{
+	bench_calls++;
+	return CMD_SUCCESS;
+}
+
+static void bench_vty_add_cmds(void)
+{
+	struct cmd_element *cmds = talloc_zero_array(ctx, struct cmd_element, BENCH_NUM_PARAMS);
+	unsigned int i;
+
+	install_element(CONFIG_NODE, &cfg_bench_cmd);
+	install_node(&bench_node, NULL);
+	for (i = 0; i < BENCH_NUM_PARAMS; i++) {
+		cmds[i].string = talloc_asprintf(cmds, "param-%u <0-65535>", i);
+		cmds[i].doc = "Parameter\nValue\n";
+		cmds[i].func = cfg_bench_param;
+		install_element(BENCH_NODE, &cmds[i]);
+	}
+	install_element(BENCH_NODE, &cfg_bench_nsvc_cmd);
+	install_element(BENCH_NODE, &cfg_bench_shutdown_cmd);
+	install_element(BENCH_NODE, &cfg_bench_no_shutdown_cmd);
+}
+
+/* Load a config file of BENCH_NUM_LINES lines in a node of BENCH_NUM_PARAMS
+ * commands; the time it takes goes to stderr. */
+static void test_config_load_bench(void)
+{
+	const char *fname = "vty_bench.cfg";
+	struct timespec start, end;
+	unsigned int i;
+	FILE *fp;
+	int rc;
+
+	printf("Going to benchmark loading a config file\n");
+
+	fp = fopen(fname, "w");
+	OSMO_ASSERT(fp);
+	fprintf(fp, "bench\n");
+	for (i = 0; i < BENCH_NUM_LINES; i++) {
+		switch (i % 4) {
+		case 0:
+			fprintf(fp, " nsvc%s %u remote 10.0.%u.%u\n", i & 4 ? "i" : "",
+				i, (i >> 8) & 0xff, i & 0xff);
+			break;
+		case 1:
+			fprintf(fp, " %sshutdown\n", i & 4 ? "no " : "");
+			break;
+		default:
+			fprintf(fp, " param-%u %u\n", i % BENCH_NUM_PARAMS, i);
+			break;
+		}
+	}
+	fclose(fp);
+
+	bench_calls = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rc = vty_read_config_file(fname, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	unlink(fname);
+
+	printf("got rc=%d, %u of %u lines executed\n", rc, bench_calls, BENCH_NUM_LINES);
+	OSMO_ASSERT(rc == 0 && bench_calls == BENCH_NUM_LINES);
+	fprintf(stderr, "loading %u lines took %ld ms\n", BENCH_NUM_LINES,
+		(end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+/* Only a single GSMTAP instance can be configured, a second one is refused */
+static void test_gsmtap_vty_init(void)
+{
+	struct gsmtap_inst *gti, *gti2;
+
+	printf("Going to test gsmtap_vty_init()\n");
+
+	gti = gsmtap_source_init("127.0.0.1", GSMTAP_UDP_PORT, 0);
+	gti2 = gsmtap_source_init("127.0.0.1", GSMTAP_UDP_PORT, 0);
+	OSMO_ASSERT(gti && gti2);
+
+	printf("install: %d\n", gsmtap_vty_init(CONFIG_NODE, gti));
+	printf("install again: %d\n", gsmtap_vty_init(CONFIG_NODE, gti2));
+}
+
 static int go_parent_cb(struct vty *vty)
 {
 	/*
@@ -509,6 +640,7 @@ int main(int argc, char **argv)
 	osmo_stats_vty_add_cmds();
 
 	test_vty_add_cmds();
+	bench_vty_add_cmds();
 
 	test_cmd_string_from_valstr();
 	test_node_tree_structure();
@@ -526,6 +658,8 @@ int main(int argc, char **argv)
 	test_exit_by_indent("ok_empty_parent.cfg", 0);
 
 	test_is_cmd_ambiguous();
+	test_config_load_bench();
+	test_gsmtap_vty_init();
 
 	/* Leak check */
 	OSMO_ASSERT(talloc_total_blocks(stats_ctx) == 1);
@@ -1,6 +1,16 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/write_queue.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/rate_ctr.h>
 
 static const struct log_info_cat default_categories[] = {
 };
@@ -65,6 +75,158 @@ static void test_wqueue_limit(void)
 	osmo_wqueue_clear(&wqueue);
 }
 
+static void test_wqueue_max_bytes(void)
+{
+	struct osmo_wqueue wqueue;
+	struct msgb *msg1, *msg2;
+
+	printf("%s\n", __func__);
+
+	osmo_wqueue_init(&wqueue, 10);
+	wqueue.max_bytes = 150;
+
+	msg1 = msgb_alloc(4096, "msg1");
+	msgb_put(msg1, 100);
+	OSMO_ASSERT(osmo_wqueue_enqueue(&wqueue, msg1) == 0);
+	OSMO_ASSERT(wqueue.current_bytes == 100);
+
+	msg2 = msgb_alloc(4096, "msg2");
+	msgb_put(msg2, 51);
+	OSMO_ASSERT(osmo_wqueue_enqueue(&wqueue, msg2) == -ENOSPC);
+	msgb_trim(msg2, 50);
+	OSMO_ASSERT(osmo_wqueue_enqueue(&wqueue, msg2) == 0);
+	OSMO_ASSERT(wqueue.current_bytes == 150);
+	OSMO_ASSERT(wqueue.current_length == 2);
+
+	osmo_wqueue_clear(&wqueue);
+	OSMO_ASSERT(wqueue.current_bytes == 0);
+}
+
+static const struct osmo_stat_item_desc wq_item_desc[] = {
+	{ "queue.length", "Messages in the queue", "", 16, 0 },
+	{ "queue.bytes", "Bytes in the queue", "B", 16, 0 },
+};
+
+static const struct osmo_stat_item_group_desc wq_statg_desc = {
+	.group_name_prefix = "wqueue",
+	.group_description = "Write queue test",
+	.num_items = ARRAY_SIZE(wq_item_desc),
+	.item_desc = wq_item_desc,
+};
+
+static int enqueue_numbered(struct osmo_wqueue *wqueue, unsigned int num, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		struct msgb *msg = msgb_alloc(len, "numbered");
+		memset(msgb_put(msg, len), 'a' + i % 26, len);
+		if (osmo_wqueue_enqueue(wqueue, msg) < 0) {
+			msgb_free(msg);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* A stream socket takes several messages per write event, and partial
+ * writes continue where they stopped. */
+static void test_wqueue_writev(void)
+{
+	struct osmo_stat_item_group *statg;
+	struct osmo_wqueue wqueue;
+	struct rate_ctr sent = {};
+	static uint8_t buf[200000];
+	unsigned int events = 0, i;
+	int sv[2], sndbuf = 4096;
+	ssize_t rc, total = 0;
+
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	OSMO_ASSERT(setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) == 0);
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+	statg = osmo_stat_item_group_alloc(NULL, &wq_statg_desc, 0);
+	osmo_wqueue_init(&wqueue, 1000);
+	OSMO_ASSERT(osmo_wqueue_set_mode(&wqueue, OSMO_WQUEUE_MODE_WRITEV) == 0);
+	wqueue.length_item = statg->items[0];
+	wqueue.bytes_item = statg->items[1];
+	wqueue.sent_ctr = &sent;
+	wqueue.bfd.fd = sv[0];
+
+	OSMO_ASSERT(enqueue_numbered(&wqueue, 500, 333) == 0);
+	printf("queued: %u messages, %u bytes, stat items %d %d\n", wqueue.current_length,
+	       wqueue.current_bytes, osmo_stat_item_get_last(wqueue.length_item),
+	       osmo_stat_item_get_last(wqueue.bytes_item));
+
+	while (wqueue.bfd.when & OSMO_FD_WRITE) {
+		osmo_wqueue_bfd_cb(&wqueue.bfd, OSMO_FD_WRITE);
+		events++;
+		while ((rc = read(sv[1], buf + total, sizeof(buf) - total)) > 0)
+			total += rc;
+	}
+
+	printf("received %zd bytes in %s write events, %"PRIu64" messages sent\n", total,
+	       events < 500 ? "less than 500" : "500 or more", sent.current);
+	OSMO_ASSERT(total == 500 * 333);
+	for (i = 0; i < 500 * 333; i++)
+		OSMO_ASSERT(buf[i] == 'a' + (i / 333) % 26);
+	printf("queued: %u messages, %u bytes, stat items %d %d\n", wqueue.current_length,
+	       wqueue.current_bytes, osmo_stat_item_get_last(wqueue.length_item),
+	       osmo_stat_item_get_last(wqueue.bytes_item));
+
+	osmo_stat_item_group_free(statg);
+	close(sv[0]);
+	close(sv[1]);
+}
+
+/* A datagram socket gets one datagram per message */
+static void test_wqueue_sendmmsg(void)
+{
+	struct osmo_wqueue wqueue;
+	struct rate_ctr sent = {};
+	uint8_t buf[1000];
+	unsigned int events = 0, received = 0;
+	int sv[2];
+	ssize_t rc;
+
+	printf("%s\n", __func__);
+
+	OSMO_ASSERT(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) == 0);
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+	osmo_wqueue_init(&wqueue, 1000);
+	if (osmo_wqueue_set_mode(&wqueue, OSMO_WQUEUE_MODE_SENDMMSG) < 0) {
+		fprintf(stderr, "%s skipped: sendmmsg() is not available\n", __func__);
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	wqueue.sent_ctr = &sent;
+	wqueue.bfd.fd = sv[0];
+
+	OSMO_ASSERT(enqueue_numbered(&wqueue, 200, 100) == 0);
+	while (wqueue.bfd.when & OSMO_FD_WRITE) {
+		osmo_wqueue_bfd_cb(&wqueue.bfd, OSMO_FD_WRITE);
+		events++;
+		while ((rc = read(sv[1], buf, sizeof(buf))) > 0) {
+			OSMO_ASSERT(rc == 100);
+			OSMO_ASSERT(buf[0] == 'a' + received % 26);
+			received++;
+		}
+	}
+
+	OSMO_ASSERT(received == 200 && sent.current == 200);
+	OSMO_ASSERT(events < 200);
+	OSMO_ASSERT(wqueue.current_length == 0 && wqueue.current_bytes == 0);
+
+	close(sv[0]);
+	close(sv[1]);
+}
+
 int main(int argc, char **argv)
 {
 	struct log_target *stderr_target;
@@ -75,6 +237,9 @@ int main(int argc, char **argv)
 	log_set_print_filename(stderr_target, 0);
 
 	test_wqueue_limit();
+	test_wqueue_max_bytes();
+	test_wqueue_writev();
+	test_wqueue_sendmmsg();
 
 	printf("Done\n");
 	return 0;
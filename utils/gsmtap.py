@@ -9,6 +9,10 @@ GSMTAP_VERSION = 0x02
 
 GSMTAP_TYPE_OSMOCORE_LOG = 0x10
 
+# sub-types for GSMTAP_TYPE_OSMOCORE_LOG
+GSMTAP_OSMOCORE_LOG_SINGLE = 0x00
+GSMTAP_OSMOCORE_LOG_BATCH = 0x01
+
 class TooSmall(RuntimeError):
     pass
 
@@ -41,6 +45,10 @@ class gsmtap_hdr():
         if self.hdr_len >= 3:
             self.type = struct.unpack('!B', data[2:3])[0]
 
+        self.sub_type = 0
+        if self.hdr_len >= 13 and len(data) >= 13:
+            self.sub_type = struct.unpack('!B', data[12:13])[0]
+
 # /*! Structure of the GSMTAP libosmocore logging header */
 # struct gsmtap_osmocore_log_hdr {
 # 	struct {
@@ -73,3 +81,18 @@ class gsmtap_log():
         message_len = len(data) - packlen
         if message_len > 0:
             self.message = data[packlen:].decode('utf-8')
+        else:
+            self.message = ''
+        self.message = self.message.rstrip('\0')
+
+def gsmtap_log_batch(data):
+    """ split a GSMTAP_OSMOCORE_LOG_BATCH payload into gsmtap_log records,
+        each preceded by its 16-bit length """
+    logs = []
+    while len(data) >= 2:
+        reclen = struct.unpack('!H', data[0:2])[0]
+        if len(data) < 2 + reclen:
+            raise TooSmall()
+        logs.append(gsmtap_log(data[2:2 + reclen]))
+        data = data[2 + reclen:]
+    return logs
@@ -7,28 +7,32 @@
 import logging
 import socket
 
-from gsmtap import GSMTAP_TYPE_OSMOCORE_LOG, gsmtap_hdr, gsmtap_log, TooSmall
+from gsmtap import GSMTAP_TYPE_OSMOCORE_LOG, GSMTAP_OSMOCORE_LOG_BATCH, \
+        gsmtap_hdr, gsmtap_log, gsmtap_log_batch, TooSmall
 
 LOG = logging.getLogger("gsmlogreader")
 
 def parse_gsm(packet):
+    """ return the list of log records in a GSMTAP packet """
     hdr = None
 
     try:
         hdr = gsmtap_hdr(packet)
     except TooSmall:
-        return None
+        return []
 
     if hdr.type != GSMTAP_TYPE_OSMOCORE_LOG:
-        return None
+        return []
 
     if len(packet) <= hdr.hdr_len:
-        return None
+        return []
 
     try:
-        return gsmtap_log(packet[hdr.hdr_len:])
+        if hdr.sub_type == GSMTAP_OSMOCORE_LOG_BATCH:
+            return gsmtap_log_batch(packet[hdr.hdr_len:])
+        return [gsmtap_log(packet[hdr.hdr_len:])]
     except TooSmall:
-        return None
+        return []
 
 def gsmtaplevel_to_loglevel(level):
     """ convert a gsmtap log level into a python log level """
@@ -83,10 +87,7 @@ if __name__ == "__main__":
 
 
     while True:
-        data, address = sock.recvfrom(4096)
-        log = parse_gsm(data)
-        if not log:
-            continue
-
-        record = logging.makeLogRecord(convert_gsmtap_log(log))
-        logger.handle(record)
+        data, address = sock.recvfrom(65535)
+        for log in parse_gsm(data):
+            record = logging.makeLogRecord(convert_gsmtap_log(log))
+            logger.handle(record)